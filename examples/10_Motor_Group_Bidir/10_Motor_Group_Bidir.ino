@@ -0,0 +1,74 @@
+/**
+ * For more info on the library usage, see the docs or other easier examples.
+ * Drives 8 bidirectional ESCs with one BidirDShotX1 each (4 on pio0, 4 on pio1), grouped by DShotMotorGroup: all packets start at the same time, and all replies are read at once.
+ * Type a value between 0 and 2000 in the serial monitor to send a throttle value to all motors.
+ * It will send the current throttle and the RPM of every motor to the Serial monitor every 100ms.
+ */
+
+#include <PIO_DShot.h>
+
+#define PIN_BASE 10
+#define MOTOR_COUNT 8
+#define MOTOR_POLES 14
+
+BidirDShotX1 *escs[MOTOR_COUNT];
+DShotMotorGroup *group;
+uint16_t throttle = 0;
+uint32_t rpm[MOTOR_COUNT] = {};
+
+void setup() {
+	Serial.begin(115200);
+	for (int i = 0; i < MOTOR_COUNT; i++) {
+		escs[i] = new BidirDShotX1(PIN_BASE + i, 600, i < 4 ? pio0 : pio1);
+	}
+	group = new DShotMotorGroup(escs, MOTOR_COUNT);
+	if (group->initError()) {
+		Serial.println("Motor group could not be initialised");
+	}
+}
+
+void loop() {
+	delayMicroseconds(100);
+
+	uint16_t throttles[MOTOR_COUNT];
+	for (int i = 0; i < MOTOR_COUNT; i++) {
+		throttles[i] = throttle;
+	}
+	group->sendThrottles(throttles);
+
+	// the replies of all ESCs arrive at about the same time: wait for them once (~95us at DShot600) and read them all
+	group->waitForReplies();
+	uint32_t values[MOTOR_COUNT];
+	BidirDshotTelemetryType types[MOTOR_COUNT];
+	group->getTelemetryRaw(values, types);
+	for (int i = 0; i < MOTOR_COUNT; i++) {
+		if (types[i] != BidirDshotTelemetryType::ERPM) continue;
+		uint32_t erpm = BidirDShotX1::convertFromRaw(values[i], types[i]);
+		if (erpm != 0xFFFFFFFF) {
+			rpm[i] = erpm / (MOTOR_POLES / 2); // eRPM = RPM * poles/2
+		}
+	}
+
+	// serial stuff
+	static uint32_t lastTime = 0;
+	if (millis() - lastTime > 100) {
+		lastTime = millis();
+		Serial.print(throttle);
+		for (int i = 0; i < MOTOR_COUNT; i++) {
+			Serial.print("\t");
+			Serial.print(rpm[i]);
+		}
+		Serial.println();
+	}
+
+	if (Serial.available()) {
+		delay(3); // wait for the rest of the input
+		String s = "";
+		while (Serial.available()) {
+			s += (char)Serial.read();
+		}
+		int32_t t = s.toInt();
+		t = constrain(t, 0, 2000);
+		throttle = t;
+	}
+}
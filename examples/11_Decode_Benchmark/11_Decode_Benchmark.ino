@@ -0,0 +1,109 @@
+/**
+ * For more info on the library usage, see the docs or other easier examples.
+ * Measures how long decoding the telemetry frames of 12 ESCs takes: one decodeFrame call per frame vs. one decodeFrames call for all of them.
+ * Also measures the eRPM conversion of 8 motors: the division that was used before vs. decodeErpmBatch (reciprocal table), and the share of the CPU that 8 motors at an 8 kHz loop need with each.
+ * No ESC needed, the frames are generated. The results are printed to the Serial monitor every second.
+ */
+
+#include <PIO_DShot.h>
+
+#define FRAME_COUNT 12
+#define ROUNDS 10000
+#define MOTOR_COUNT 8
+#define LOOP_HZ 8000
+
+const uint8_t gcrEncode[16] = {0x19, 0x1B, 0x12, 0x13, 0x1D, 0x15, 0x16, 0x17, 0x1A, 0x09, 0x0A, 0x0B, 0x1E, 0x0D, 0x0E, 0x0F};
+uint32_t frames[FRAME_COUNT];
+uint16_t erpmRaw[MOTOR_COUNT];
+
+// the eRPM conversion before decodeErpm: one division per frame
+uint32_t __not_in_flash_func(divisionErpm)(uint32_t raw) {
+	if (raw == 0xFFF) {
+		return 0;
+	}
+	uint32_t period = (raw & 0x1FF) << (raw >> 9); // eeem mmmm mmmm
+	if (!period) {
+		return 0xFFFFFFFF;
+	}
+	return (60000000 + 50 * period) / period;
+}
+
+// builds the frame an ESC would send for a 12 bit value, as it is received on the line
+uint32_t encodeFrame(uint16_t value) {
+	uint16_t data = value << 4;
+	data |= ~(value ^ (value >> 4) ^ (value >> 8)) & 0x0F;
+	uint32_t gcr = 0;
+	for (int i = 3; i >= 0; i--) {
+		gcr = (gcr << 5) | gcrEncode[(data >> (4 * i)) & 0x0F];
+	}
+	// a 1 in the GCR code is a level change, the start bit (bit 20) is low
+	uint32_t frame = 0;
+	uint32_t level = 0;
+	for (int i = 19; i >= 0; i--) {
+		level ^= (gcr >> i) & 1;
+		frame |= level << i;
+	}
+	return frame;
+}
+
+void setup() {
+	Serial.begin(115200);
+	for (int i = 0; i < FRAME_COUNT; i++) {
+		frames[i] = encodeFrame(0x100 + 37 * i); // eRPM frames
+	}
+	frames[FRAME_COUNT - 1] ^= 1 << 7; // one broken frame
+	for (int i = 0; i < MOTOR_COUNT; i++) {
+		erpmRaw[i] = (i << 9) | (0x40 + 53 * i); // all exponents
+	}
+}
+
+void loop() {
+	delay(1000);
+	uint32_t values[FRAME_COUNT];
+	BidirDshotTelemetryType types[FRAME_COUNT];
+	volatile uint32_t sink = 0; // keeps the compiler from removing the loops
+
+	noInterrupts();
+	uint32_t start = micros();
+	for (int r = 0; r < ROUNDS; r++) {
+		for (int i = 0; i < FRAME_COUNT; i++) {
+			types[i] = BidirDShotX1::decodeFrame(frames[i], &values[i]);
+		}
+		sink = sink + values[r % FRAME_COUNT];
+	}
+	uint32_t single = micros() - start;
+	start = micros();
+	for (int r = 0; r < ROUNDS; r++) {
+		sink = sink + BidirDShotX1::decodeFrames(frames, FRAME_COUNT, values, types);
+	}
+	uint32_t batch = micros() - start;
+	interrupts();
+
+	Serial.printf("%d frames: decodeFrame %d ns, decodeFrames %d ns per frame (%d.%02dx)\n", FRAME_COUNT, single * 1000 / ROUNDS / FRAME_COUNT, batch * 1000 / ROUNDS / FRAME_COUNT, single / batch, single * 100 / batch % 100);
+
+	BidirDShotErpm erpm[MOTOR_COUNT];
+	uint32_t mismatches = 0;
+	noInterrupts();
+	start = micros();
+	for (int r = 0; r < ROUNDS; r++) {
+		for (int i = 0; i < MOTOR_COUNT; i++) {
+			values[i] = divisionErpm(erpmRaw[i]);
+		}
+		sink = sink + values[r % MOTOR_COUNT];
+	}
+	uint32_t division = micros() - start;
+	start = micros();
+	for (int r = 0; r < ROUNDS; r++) {
+		sink = sink + BidirDShotX1::decodeErpmBatch(erpmRaw, erpm, MOTOR_COUNT);
+	}
+	uint32_t table = micros() - start;
+	interrupts();
+	for (int i = 0; i < MOTOR_COUNT; i++) {
+		mismatches += erpm[i].erpm != divisionErpm(erpmRaw[i]);
+	}
+
+	// CPU share of 8 motors at LOOP_HZ in 1/100 %: us per round * LOOP_HZ / 1000000 * 10000
+	uint32_t divisionLoad = (uint64_t)division * LOOP_HZ / ROUNDS / 100;
+	uint32_t tableLoad = (uint64_t)table * LOOP_HZ / ROUNDS / 100;
+	Serial.printf("%d motors: division %d ns, decodeErpmBatch %d ns per frame, at %d Hz %d.%02d%% vs. %d.%02d%% CPU, %d mismatches\n", MOTOR_COUNT, division * 1000 / ROUNDS / MOTOR_COUNT, table * 1000 / ROUNDS / MOTOR_COUNT, LOOP_HZ, divisionLoad / 100, divisionLoad % 100, tableLoad / 100, tableLoad % 100, mismatches);
+}
@@ -0,0 +1,69 @@
+/**
+ * For more info on the library usage, see the docs or other easier examples.
+ * Drives 8 bidirectional ESCs with a single state machine (BidirDShotMux): the ESCs get their packets one after the other, ~1.4kHz each at DShot600. The other 3 state machines of pio0 stay free.
+ * Type a value between 0 and 2000 in the serial monitor to send a throttle value to all motors.
+ * It will send the current throttle, the rate per ESC and the RPM of every motor to the Serial monitor every 100ms.
+ */
+
+#include <PIO_DShot.h>
+
+#define MOTOR_COUNT 8
+#define MOTOR_POLES 14
+
+const uint8_t pins[MOTOR_COUNT] = {10, 11, 12, 13, 18, 19, 20, 21}; // any pins, no need to be consecutive
+BidirDShotMux *escs;
+uint16_t throttle = 0;
+uint32_t rpm[MOTOR_COUNT] = {};
+
+void setup() {
+	Serial.begin(115200);
+	escs = new BidirDShotMux(pins, MOTOR_COUNT, 600, pio0);
+	if (escs->initError()) {
+		Serial.println("Mux could not be initialised");
+	}
+}
+
+void loop() {
+	// the packets are sent in the background, this only updates the throttles
+	uint16_t throttles[MOTOR_COUNT];
+	for (int i = 0; i < MOTOR_COUNT; i++) {
+		throttles[i] = throttle;
+	}
+	escs->sendThrottles(throttles);
+
+	for (int i = 0; i < MOTOR_COUNT; i++) {
+		uint32_t erpm;
+		if (escs->getTelemetryErpm(i, &erpm) == BidirDshotTelemetryType::ERPM) {
+			rpm[i] = erpm / (MOTOR_POLES / 2); // eRPM = RPM * poles/2
+		}
+	}
+
+	// serial stuff
+	static uint32_t lastTime = 0;
+	static uint32_t lastRotations = 0;
+	if (millis() - lastTime >= 100) {
+		lastTime = millis();
+		uint32_t rotations = escs->getRotations();
+		Serial.print(throttle);
+		Serial.print("\t");
+		Serial.print((rotations - lastRotations) * 10); // packets per second per ESC
+		Serial.print("Hz");
+		lastRotations = rotations;
+		for (int i = 0; i < MOTOR_COUNT; i++) {
+			Serial.print("\t");
+			Serial.print(rpm[i]);
+		}
+		Serial.println();
+	}
+
+	if (Serial.available()) {
+		delay(3); // wait for the rest of the input
+		String s = "";
+		while (Serial.available()) {
+			s += (char)Serial.read();
+		}
+		int32_t t = s.toInt();
+		t = constrain(t, 0, 2000);
+		throttle = t;
+	}
+}
@@ -0,0 +1,45 @@
+/**
+ * For more info on the library usage, see the docs or other easier examples.
+ * Drives 4 normal (non-bidirectional) ESCs on pins that are not consecutive with one DShotX4.
+ * The pins are sorted into windows of up to 8 GPIOs, each window gets one state machine: here 2 (pins 2...9 and pin 14).
+ * The GPIOs in the gaps of a window (3, 4, 6, 7, 8) stay usable for anything except another state machine of the same PIO.
+ * Type a value between 0 and 2000 in the serial monitor to send a throttle value to all motors.
+ */
+
+#include <PIO_DShot.h>
+
+const uint8_t pins[4] = {2, 5, 9, 14};
+
+DShotX4 *escs;
+uint16_t throttle = 0;
+
+void setup() {
+	Serial.begin(115200);
+	escs = new DShotX4(pins, 4);
+	if (escs->initError()) {
+		Serial.println("DShotX4 could not be initialised");
+	}
+}
+
+void loop() {
+	// sendThrottles is non-blocking, one FIFO burst per window. Here we use roughly 5kHz.
+	delayMicroseconds(200);
+
+	uint16_t throttles[4]; // same order as the pins array
+	for (int i = 0; i < 4; i++) {
+		throttles[i] = throttle;
+	}
+	escs->sendThrottles(throttles);
+
+	// serial stuff
+	if (Serial.available()) {
+		delay(3); // wait for the rest of the input
+		String s = "";
+		while (Serial.available()) {
+			s += (char)Serial.read();
+		}
+		int32_t t = s.toInt();
+		t = constrain(t, 0, 2000);
+		throttle = t;
+	}
+}
@@ -0,0 +1,85 @@
+/**
+ * For more info on the library usage, see the docs or other easier examples.
+ * Lets dshotPlanMotors distribute 4 bidirectional and 8 normal ESCs to BidirDShotX1 and DShotX4 drivers on the PIO blocks, prints the plan and the remaining resources and creates the drivers.
+ * Type a value between 0 and 2000 in the serial monitor to send a throttle value to all motors.
+ */
+
+#include <PIO_DShot.h>
+
+#define MOTOR_COUNT 12
+
+const DShotMotorSpec motors[MOTOR_COUNT] = {
+	{2, true, 600},
+	{5, true, 600},
+	{8, true, 600},
+	{11, true, 600},
+	{14, false, 600},
+	{15, false, 600},
+	{16, false, 600},
+	{17, false, 600},
+	{20, false, 300},
+	{22, false, 300},
+	{26, false, 300},
+	{27, false, 300},
+};
+
+DShotPlan plan;
+BidirDShotX1 *bidir[DSHOT_PLAN_MAX_DRIVERS];
+DShotX4 *normal[DSHOT_PLAN_MAX_DRIVERS];
+uint16_t throttle = 0;
+
+void setup() {
+	Serial.begin(115200);
+	delay(2000);
+	if (!dshotPlanMotors(motors, MOTOR_COUNT, &plan)) {
+		Serial.println("The motors don't fit");
+		while (true);
+	}
+
+	for (int i = 0; i < plan.driverCount; i++) {
+		DShotPlanDriver &d = plan.drivers[i];
+		Serial.printf("%s on pio%d, DShot%d, %d state machine(s), pins", d.type == DShotPlanDriverType::BIDIR_X1 ? "BidirDShotX1" : "DShotX4", pio_get_index(d.pio), d.speed, d.stateMachines);
+		for (int c = 0; c < d.pinCount; c++) {
+			Serial.printf(" %d", d.pins[c]);
+		}
+		Serial.println();
+	}
+	for (int p = 0; p < NUM_PIOS; p++) {
+		Serial.printf("pio%d: %d free state machines, %d free instructions\n", p, plan.freeSms[p], plan.freeInstructions[p]);
+	}
+
+	if (!dshotCreateDrivers(&plan, bidir, normal)) {
+		Serial.println("A driver could not be initialised");
+	}
+}
+
+void loop() {
+	delayMicroseconds(200);
+
+	// the throttle of every motor goes to its driver and channel
+	uint16_t throttles[DSHOT_PLAN_MAX_DRIVERS][4];
+	for (int m = 0; m < MOTOR_COUNT; m++) {
+		throttles[plan.motorDriver[m]][plan.motorChannel[m]] = throttle;
+	}
+	for (int i = 0; i < plan.driverCount; i++) {
+		if (bidir[i]) {
+			uint32_t erpm;
+			bidir[i]->getTelemetryErpm(&erpm);
+			bidir[i]->sendThrottle(throttles[i][0]);
+		} else {
+			normal[i]->sendThrottles(throttles[i]);
+		}
+	}
+
+	// serial stuff
+	if (Serial.available()) {
+		delay(3); // wait for the rest of the input
+		String s = "";
+		while (Serial.available()) {
+			s += (char)Serial.read();
+		}
+		int32_t t = s.toInt();
+		t = constrain(t, 0, 2000);
+		throttle = t;
+	}
+}
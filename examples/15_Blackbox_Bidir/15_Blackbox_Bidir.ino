@@ -0,0 +1,65 @@
+/**
+ * For more info on the library usage, see the docs or other easier examples.
+ * Drives 4 bidirectional ESCs at 8kHz on core 0 and logs every sent frame and every telemetry word into a DShotBlackbox. Core 1 drains the capture and writes it to Serial1 (binary, 2 MBaud).
+ * Record the UART output to a file and convert it with extras/blackbox (blackbox_decode log.bin > log.csv).
+ * Alternatively, drain it without core 1: call blackbox.drainDma(channel, &uart_get_hw(uart0)->dr, uart_get_dreq(uart0, true)) in the loop.
+ * Type a value between 0 and 2000 in the serial monitor to send a throttle value to all motors.
+ */
+
+#include <PIO_DShot.h>
+
+#define PIN_BASE 10
+#define MOTOR_COUNT 4
+
+uint8_t blackboxBuffer[16384]; // ~60ms at 8kHz with 4 motors, bridges short stalls of the consumer
+DShotBlackbox blackbox(blackboxBuffer, sizeof(blackboxBuffer));
+BidirDShotX1 *escs[MOTOR_COUNT];
+uint16_t throttle = 0;
+
+void setup() {
+	Serial.begin(115200);
+	for (int i = 0; i < MOTOR_COUNT; i++) {
+		escs[i] = new BidirDShotX1(PIN_BASE + i);
+	}
+	blackbox.start();
+}
+
+void loop() {
+	static uint32_t lastLoop = 0;
+	while (micros() - lastLoop < 125);
+	lastLoop = micros();
+
+	for (int i = 0; i < MOTOR_COUNT; i++) {
+		uint32_t raw;
+		escs[i]->getTelemetryRaw(&raw); // logs the telemetry word
+		escs[i]->sendThrottle(throttle); // logs the frame
+	}
+
+	// serial stuff
+	static uint32_t lastTime = 0;
+	if (millis() - lastTime > 1000) {
+		lastTime = millis();
+		Serial.printf("dropped entries: %d\n", blackbox.getDropped());
+	}
+
+	if (Serial.available()) {
+		delay(3); // wait for the rest of the input
+		String s = "";
+		while (Serial.available()) {
+			s += (char)Serial.read();
+		}
+		int32_t t = s.toInt();
+		t = constrain(t, 0, 2000);
+		throttle = t;
+	}
+}
+
+void setup1() {
+	Serial1.begin(2000000);
+}
+
+void loop1() {
+	uint8_t chunk[256];
+	uint32_t n = blackbox.read(chunk, sizeof(chunk));
+	if (n) Serial1.write(chunk, n);
+}
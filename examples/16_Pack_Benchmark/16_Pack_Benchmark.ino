@@ -0,0 +1,82 @@
+/**
+ * For more info on the library usage, see the docs or other easier examples.
+ * Measures how long interleaving the packets of 4 and 8 ESCs into the PIO words takes: the per-bit loop the drivers used before vs. dshotPackX4/dshotPackX8 (nibble spread tables).
+ * No ESC needed, the packets are random. The results (ns and clock cycles per call, mismatches against the per-bit loop) are printed to the Serial monitor every second.
+ */
+
+#include <PIO_DShot.h>
+#include "hardware/clocks.h"
+
+#define PACKET_COUNT 64
+#define ROUNDS 200
+
+uint16_t packets[PACKET_COUNT][8];
+
+// bit i of packet[0] is bit (i / 4 + 8) of motor i % 4, bit i of packet[1] is bit (i / 4) of motor i % 4
+void __not_in_flash_func(perBitPackX4)(const uint16_t data[4], uint32_t packet[2]) {
+	packet[0] = packet[1] = 0;
+	for (int i = 31; i >= 0; i--) {
+		int pos = i / 4;
+		int motor = i % 4;
+		packet[0] |= ((data[motor] >> (pos + 8)) & 1) << i;
+		packet[1] |= ((data[motor] >> pos) & 1) << i;
+	}
+}
+
+// bit i of packet[w] is bit (i / 8 + 12 - 4 * w) of motor i % 8
+void __not_in_flash_func(perBitPackX8)(const uint16_t data[8], uint32_t packet[4]) {
+	for (int w = 0; w < 4; w++) {
+		packet[w] = 0;
+		for (int i = 31; i >= 0; i--) {
+			packet[w] |= (uint32_t)((data[i % 8] >> (i / 8 + 12 - 4 * w)) & 1) << i;
+		}
+	}
+}
+
+// ns per call
+uint32_t measure(void (*pack)(const uint16_t *, uint32_t *)) {
+	volatile uint32_t sink = 0; // keeps the compiler from removing the loop
+	uint32_t packet[4];
+	noInterrupts();
+	uint32_t start = micros();
+	for (int r = 0; r < ROUNDS; r++) {
+		for (int i = 0; i < PACKET_COUNT; i++) {
+			pack(packets[i], packet);
+			sink = sink + packet[0];
+		}
+	}
+	uint32_t duration = micros() - start;
+	interrupts();
+	return (uint64_t)duration * 1000 / ROUNDS / PACKET_COUNT;
+}
+
+void setup() {
+	Serial.begin(115200);
+	for (int i = 0; i < PACKET_COUNT; i++) {
+		for (int m = 0; m < 8; m++) {
+			packets[i][m] = rand();
+		}
+	}
+}
+
+void loop() {
+	delay(1000);
+
+	int mismatches = 0;
+	for (int i = 0; i < PACKET_COUNT; i++) {
+		uint32_t a[4], b[4];
+		perBitPackX4(packets[i], a);
+		dshotPackX4(packets[i], b);
+		mismatches += a[0] != b[0] || a[1] != b[1];
+		perBitPackX8(packets[i], a);
+		dshotPackX8(packets[i], b);
+		mismatches += a[0] != b[0] || a[1] != b[1] || a[2] != b[2] || a[3] != b[3];
+	}
+
+	uint32_t mhz = clock_get_hz(clk_sys) / 1000000;
+	uint32_t x4Old = measure(perBitPackX4), x4New = measure(dshotPackX4);
+	uint32_t x8Old = measure(perBitPackX8), x8New = measure(dshotPackX8);
+	Serial.printf("X4: per-bit %d ns (%d cycles), dshotPackX4 %d ns (%d cycles)\n", x4Old, x4Old * mhz / 1000, x4New, x4New * mhz / 1000);
+	Serial.printf("X8: per-bit %d ns (%d cycles), dshotPackX8 %d ns (%d cycles)\n", x8Old, x8Old * mhz / 1000, x8New, x8New * mhz / 1000);
+	Serial.printf("mismatches: %d\n", mismatches);
+}
@@ -5,8 +5,9 @@
  * This is the most advanced example. It uses Extended DShot telemetry to not just get the RPM, but also all the other telemetry values. It is controlled via commands:
  * - Set your Serial Monitor or Serial Plotter to New line mode (\n)
  * - Type T1000 for sending a throttle value of 1000 (0-2000)
- * - Type C3 for sending a special command (0-47) -> 3 = beacon 3 (only send them when stopped, and all commands are sent 10 times in this example)
+ * - Type C3 for sending a special command (0-47) -> 3 = beacon 3 (only send them when stopped). Commands are queued and sent instead of the throttle by the next sendThrottle calls, with the repeats and spacing the ESC needs, without blocking the loop
  * - Type E to enable Extended DShot telemetry (this is the same as sending C13)
+ * - Type S to print the link statistics (errors, missing replies, read latency), e.g. to find bad wiring
  *
  * The Serial Monitor will print the throttle value and all other available telemetry values. Not all ESCs support all telemetry values.
  */
@@ -18,12 +19,6 @@
 
 BidirDShotX1 *esc;
 uint16_t throttle = 0;
-uint32_t rpm = 0;
-uint32_t temp = 0;
-float voltage = 0;
-uint32_t current = 0;
-uint32_t lastStatus = 0;
-uint32_t stress = 0;
 
 void setup() {
 	Serial.begin(115200);
@@ -35,58 +30,30 @@ void setup() {
 void loop() {
 	delayMicroseconds(200);
 
-	uint32_t returnValue = 0;
-	BidirDshotTelemetryType type = esc->getTelemetryPacket(&returnValue);
-	switch (type) {
-	case BidirDshotTelemetryType::ERPM:
-		rpm = returnValue / (MOTOR_POLES / 2);
-		break;
-	case BidirDshotTelemetryType::VOLTAGE:
-		voltage = (float)returnValue / 4;
-		break;
-	case BidirDshotTelemetryType::CURRENT:
-		current = returnValue;
-		break;
-	case BidirDshotTelemetryType::TEMPERATURE:
-		temp = returnValue;
-		break;
-	case BidirDshotTelemetryType::STATUS:
-		lastStatus = returnValue;
-		break;
-	case BidirDshotTelemetryType::STRESS:
-		stress = returnValue & ESC_STATUS_MAX_STRESS_MASK;
-		break;
-
-	// other possible cases are:
-	case BidirDshotTelemetryType::DEBUG_FRAME_1:
-		// custom ESC telemetry, not used in regular ESCs
-	case BidirDshotTelemetryType::DEBUG_FRAME_2:
-		// custom ESC telemetry, not used in regular ESCs
-	case BidirDshotTelemetryType::CHECKSUM_ERROR:
-		// Means the last packet was received, but corrupted. This is not a problem, just ignore it.
-	case BidirDshotTelemetryType::NO_PACKET:
-		// No telemetry packet available. Either the wait time between writing the last DShot packet and reading the telemetry packet was too short, or the ESC is not powered. This is not a problem, just ignore it.
-	default:
-		break;
-	}
+	// no need to read every telemetry packet: the driver keeps the latest value of every type (see getTelemetryState below)
+	// getTelemetryPacket still returns the individual frames, including ::CHECKSUM_ERROR (corrupted, just ignore it), ::NO_REPLY (the ESC did not answer in time) and ::NO_PACKET (nothing new)
 
 	// serial stuff
 	static uint32_t lastTime = 0;
 	if (millis() - lastTime > 100) {
 		lastTime = millis();
+		BidirDShotTelemetryState state;
+		esc->getTelemetryState(&state);
 		Serial.print(throttle);
 		Serial.print("\t");
-		Serial.print(rpm);
+		Serial.print(state.get(BidirDshotTelemetryType::ERPM).value / (MOTOR_POLES / 2));
 		Serial.print("\t");
-		Serial.print(voltage);
+		Serial.print((float)state.get(BidirDshotTelemetryType::VOLTAGE).value / 4);
 		Serial.print("\t");
-		Serial.print(current);
+		Serial.print(state.get(BidirDshotTelemetryType::CURRENT).value);
 		Serial.print("\t");
-		Serial.print(temp);
+		Serial.print(state.get(BidirDshotTelemetryType::TEMPERATURE).value);
 		Serial.print("\t");
-		Serial.print(stress);
+		Serial.print(state.get(BidirDshotTelemetryType::STRESS).value & ESC_STATUS_MAX_STRESS_MASK);
 		Serial.print("\t");
-		Serial.println(lastStatus, BIN);
+		Serial.print(state.get(BidirDshotTelemetryType::STATUS).value, BIN);
+		if (state.isStale(BidirDshotTelemetryType::ERPM, 100000)) Serial.print("\t(no eRPM for 100ms)");
+		Serial.println();
 	}
 
 	if (Serial.available()) {
@@ -102,10 +69,13 @@ void loop() {
 			throttle = value;
 			break;
 		case 'C':
-			sendSpecialCommand(value);
+			esc->queueCommand(value);
 			break;
 		case 'E':
-			sendSpecialCommand(DSHOT_CMD_EXTENDED_TELEMETRY_ENABLE);
+			esc->queueCommand(DSHOT_CMD_EXTENDED_TELEMETRY_ENABLE);
+			break;
+		case 'S':
+			printLinkStats();
 			break;
 		default:
 			throttle = 0;
@@ -116,9 +86,15 @@ void loop() {
 	esc->sendThrottle(throttle);
 }
 
-void sendSpecialCommand(uint16_t cmd) {
-	for (int i = 0; i < 10; i++) {
-		esc->sendRaw11Bit(cmd);
-		delayMicroseconds(200);
+void printLinkStats() {
+	BidirDShotLinkStats stats;
+	esc->getLinkStats(&stats);
+	Serial.printf("sent %u, replies %u, checksum errors %u, invalid GCR %u, missing %u, overruns %u, dropped %u\n", stats.framesSent, stats.replies, stats.checksumErrors, stats.invalidGcr, stats.missingReplies, stats.fifoOverruns, stats.historyDrops);
+	Serial.printf("reply turnaround: %u...%u ns\n", stats.turnaroundMinNs, stats.turnaroundMaxNs); // packet (16 bits) + max turnaround + reply (~17 bits) => shortest safe loop period
+	Serial.print("read latency (<32us, <64us, ...):");
+	for (int i = 0; i < DSHOT_LATENCY_BUCKETS; i++) {
+		Serial.print(" ");
+		Serial.print(stats.latency[i]);
 	}
+	Serial.println();
 }
@@ -0,0 +1,59 @@
+/**
+ * For more info on the library usage, see the docs or other easier examples.
+ * Drives 4 bidirectional ESCs on consecutive pins with a single state machine (BidirDShotX4).
+ * Type a value between 0 and 2000 in the serial monitor to send a throttle value to all motors.
+ * It will send the current throttle and the RPM of every motor to the Serial monitor every 100ms.
+ */
+
+#include <PIO_DShot.h>
+
+#define PIN_BASE 10
+#define PIN_COUNT 4
+#define MOTOR_POLES 14
+
+BidirDShotX4 *escs;
+uint16_t throttle = 0;
+uint32_t rpm[4] = {0, 0, 0, 0};
+
+void setup() {
+	Serial.begin(115200);
+	escs = new BidirDShotX4(PIN_BASE, PIN_COUNT); // uses one state machine and one DMA channel
+}
+
+void loop() {
+	// same timing as with BidirDShotX1. The replies of all ESCs are recorded in one window. The ESCs may start their replies a few microseconds apart (up to 14us at DShot600, 7us at DShot1200), which is no problem with regular ESCs.
+	delayMicroseconds(200);
+
+	for (int i = 0; i < PIN_COUNT; i++) {
+		uint32_t erpm = 0;
+		if (escs->getTelemetryErpm(i, &erpm) == BidirDshotTelemetryType::ERPM) {
+			rpm[i] = erpm / (MOTOR_POLES / 2); // eRPM = RPM * poles/2
+		}
+	}
+
+	uint16_t throttles[4] = {throttle, throttle, throttle, throttle}; // always hand over an array of 4 values, even if you use less motors
+	escs->sendThrottles(throttles);
+
+	// serial stuff
+	static uint32_t lastTime = 0;
+	if (millis() - lastTime > 100) {
+		lastTime = millis();
+		Serial.print(throttle);
+		for (int i = 0; i < PIN_COUNT; i++) {
+			Serial.print("\t");
+			Serial.print(rpm[i]);
+		}
+		Serial.println();
+	}
+
+	if (Serial.available()) {
+		delay(3); // wait for the rest of the input
+		String s = "";
+		while (Serial.available()) {
+			s += (char)Serial.read();
+		}
+		int32_t t = s.toInt();
+		t = constrain(t, 0, 2000);
+		throttle = t;
+	}
+}
@@ -0,0 +1,42 @@
+/**
+ * For more info on the library usage, see the docs or other easier examples.
+ * Drives 8 normal (non-bidirectional) ESCs on consecutive pins with a single state machine (DShotX8).
+ * Type a value between 0 and 2000 in the serial monitor to send a throttle value to all motors.
+ */
+
+#include <PIO_DShot.h>
+
+#define PIN_BASE 10
+#define PIN_COUNT 8
+
+DShotX8 *escs;
+uint16_t throttle = 0;
+
+void setup() {
+	Serial.begin(115200);
+	escs = new DShotX8(PIN_BASE, PIN_COUNT);
+}
+
+void loop() {
+	// sendThrottles is non-blocking. That means, we must not send it too fast (manual delayMicroseconds).
+	// the TX FIFO holds two packets, further packets are dropped until there is room again. Here we use roughly 5kHz.
+	delayMicroseconds(200);
+
+	uint16_t throttles[8]; // always hand over an array of 8 values, even if you use less motors. The other values will be ignored.
+	for (int i = 0; i < 8; i++) {
+		throttles[i] = throttle;
+	}
+	escs->sendThrottles(throttles);
+
+	// serial stuff
+	if (Serial.available()) {
+		delay(3); // wait for the rest of the input
+		String s = "";
+		while (Serial.available()) {
+			s += (char)Serial.read();
+		}
+		int32_t t = s.toInt();
+		t = constrain(t, 0, 2000);
+		throttle = t;
+	}
+}
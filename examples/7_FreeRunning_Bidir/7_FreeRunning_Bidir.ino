@@ -0,0 +1,44 @@
+/**
+ * For more info on the library usage, see the docs or other easier examples.
+ * The packets are resent by the DMA at a fixed rate (free-running mode), so the ESC stays armed even if the loop blocks.
+ * Type a value between 0 and 2000 in the serial monitor to send a throttle value.
+ * It will send the current throttle and RPM to the Serial monitor every 100ms.
+ */
+
+#include <PIO_DShot.h>
+
+#define MOTOR_POLES 14
+
+BidirDShotX1 *esc;
+uint16_t throttle = 0;
+
+void setup() {
+	Serial.begin(115200);
+	esc = new BidirDShotX1(10, 600); // pin 10, DShot600
+	esc->startFreeRunning(4000); // 4kHz, uses 2 DMA channels and 1 DMA timer. Telemetry is decoded in an interrupt.
+}
+
+void loop() {
+	// no timing needed: sendThrottle only updates the packet that is sent with the next period
+	esc->sendThrottle(throttle);
+
+	uint32_t erpm = 0;
+	esc->getCachedTelemetry(BidirDshotTelemetryType::ERPM, &erpm);
+
+	// serial stuff. Even a long delay doesn't disarm the ESC
+	delay(100);
+	Serial.print(throttle);
+	Serial.print("\t");
+	Serial.println(erpm / (MOTOR_POLES / 2)); // eRPM = RPM * poles/2
+
+	if (Serial.available()) {
+		delay(3); // wait for the rest of the input
+		String s = "";
+		while (Serial.available()) {
+			s += (char)Serial.read();
+		}
+		int32_t t = s.toInt();
+		t = constrain(t, 0, 2000);
+		throttle = t;
+	}
+}
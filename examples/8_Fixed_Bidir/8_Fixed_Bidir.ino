@@ -0,0 +1,38 @@
+/**
+ * Bidirectional DShot with all parameters fixed at compile time.
+ * Wrong pins, speeds, PIOs or state machines are reported by the compiler, and sending a packet is just a checksum and one FIFO write.
+ * Same behaviour as the blink sketch: 0% / 20% throttle, changing every 5s, and the eRPM is printed every 100ms.
+ */
+
+#include <PIO_DShot.h>
+
+// pin 10, DShot600, pio0, state machine 0. The system clock has to match the one the sketch is compiled for (F_CPU).
+FixedBidirDShotX1<10, 600, 0, 0> *esc;
+
+void setup() {
+	Serial.begin(115200);
+
+	// like the other drivers, this cannot be done globally (the hardware is not ready yet).
+	esc = new FixedBidirDShotX1<10, 600, 0, 0>();
+	if (esc->initError()) {
+		Serial.println("DShot init failed: state machine already used or wrong system clock");
+	}
+}
+
+void loop() {
+	delayMicroseconds(200);
+
+	uint16_t throttle = 0;
+	if (millis() % 10000 > 5000) {
+		throttle = 400; // maximum throttle is 2000, 400 is 20%
+	}
+	esc->sendThrottle(throttle); // 0-2000
+
+	static uint32_t rpm = 0;
+	esc->getTelemetryErpm(&rpm);
+	static uint32_t lastTime = 0;
+	if (millis() - lastTime > 100) {
+		lastTime = millis();
+		Serial.println(rpm);
+	}
+}
@@ -0,0 +1,52 @@
+/**
+ * For more info on the library usage, see the docs or other easier examples.
+ * Finds the fastest bidirectional DShot speed at which the ESC replies reliably, prints the measurements and then uses that speed.
+ * Type a value between 0 and 2000 in the serial monitor to send a throttle value.
+ */
+
+#include <PIO_DShot.h>
+
+BidirDShotX1 *esc;
+uint16_t throttle = 0;
+
+void setup() {
+	Serial.begin(115200);
+	esc = new BidirDShotX1(10, 300); // pin 10, start with DShot300
+
+	// arm the ESC
+	for (int i = 0; i < 3000; i++) {
+		esc->sendThrottle(0);
+		delayMicroseconds(1000);
+	}
+
+	// max. 1% checksum errors or missing replies, 200 packets per speed at 1kHz
+	BidirDShotSpeedResult results[DSHOT_CALIBRATION_SPEEDS];
+	uint32_t speed = dshotCalibrateSpeed(*esc, results, 10, 200, 1000);
+	for (int i = 0; i < DSHOT_CALIBRATION_SPEEDS; i++) {
+		Serial.printf("DShot%d: %d valid, %d checksum errors, %d missing => %s\n", results[i].speed, results[i].valid, results[i].checksumErrors, results[i].missing, results[i].passed ? "ok" : "too many errors");
+	}
+	if (speed)
+		Serial.printf("Using DShot%d\n", speed);
+	else
+		Serial.printf("No speed within the error budget, staying at DShot%d\n", esc->getSpeed());
+}
+
+void loop() {
+	delayMicroseconds(200);
+	esc->sendThrottle(throttle);
+
+	uint32_t erpm = 0;
+	esc->getTelemetryErpm(&erpm);
+
+	if (Serial.available()) {
+		delay(3); // wait for the rest of the input
+		String s = "";
+		while (Serial.available()) {
+			s += (char)Serial.read();
+		}
+		int32_t t = s.toInt();
+		t = constrain(t, 0, 2000);
+		throttle = t;
+		Serial.println(erpm);
+	}
+}
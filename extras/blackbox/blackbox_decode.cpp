@@ -0,0 +1,101 @@
+// Converts a DShotBlackbox stream (see src/dshot_blackbox.h) to CSV, one line per entry.
+// Usage: blackbox_decode [log.bin] > log.csv (reads stdin without a file)
+
+#include "bidir_dshot_x1.h"
+#include "dshot_blackbox.h"
+#include <cstdio>
+#include <vector>
+
+static const char *const typeNames[] = {"ERPM", "OTHER_VALUE", "CHECKSUM_ERROR", "NO_REPLY", "NO_PACKET", "VOLTAGE", "CURRENT", "TEMPERATURE", "STATUS", "STRESS", "DEBUG_FRAME_1", "DEBUG_FRAME_2"};
+
+// reads a varint at pos, false if the stream ends before it is complete
+static bool readVarint(const std::vector<uint8_t> &data, size_t *pos, uint32_t *value) {
+	*value = 0;
+	for (int shift = 0; shift < 35; shift += 7) {
+		if (*pos >= data.size()) return false;
+		uint8_t b = data[(*pos)++];
+		*value |= (uint32_t)(b & 0x7F) << shift;
+		if (!(b & 0x80)) return true;
+	}
+	return false;
+}
+
+int main(int argc, char **argv) {
+	FILE *in = argc > 1 ? fopen(argv[1], "rb") : stdin;
+	if (!in) {
+		fprintf(stderr, "cannot open %s\n", argv[1]);
+		return 1;
+	}
+	std::vector<uint8_t> data;
+	uint8_t chunk[4096];
+	size_t n;
+	while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+		data.insert(data.end(), chunk, chunk + n);
+	}
+
+	printf("time_us,gpio,entry,raw,data,telemetry_request,checksum,type,value\n");
+	uint64_t time = 0; // 64 bit, so that it doesn't wrap with time_us_32
+	uint16_t lastTx[DSHOT_BLACKBOX_PINS] = {};
+	uint32_t lastRx[DSHOT_BLACKBOX_PINS] = {};
+	bool synced = false;
+	size_t pos = 0;
+	while (pos < data.size()) {
+		size_t start = pos;
+		uint8_t header = data[pos++];
+		DShotBlackboxEntry entry = (DShotBlackboxEntry)(header >> 6);
+		uint8_t gpio = header & 0x3F;
+
+		if (entry == DShotBlackboxEntry::SYNC) {
+			if (pos + 4 > data.size()) break;
+			time = data[pos] | data[pos + 1] << 8 | data[pos + 2] << 16 | (uint32_t)data[pos + 3] << 24;
+			pos += 4;
+			for (auto &v : lastTx) v = 0;
+			for (auto &v : lastRx) v = 0;
+			synced = true;
+			printf("%llu,,SYNC,,,,,,\n", (unsigned long long)time);
+			continue;
+		}
+		if (!synced) {
+			fprintf(stderr, "stream does not start with a SYNC entry, times are relative and values may be wrong\n");
+			synced = true;
+		}
+		uint32_t delta, value;
+		if (!readVarint(data, &pos, &delta) || !readVarint(data, &pos, &value)) {
+			fprintf(stderr, "incomplete entry at byte %zu\n", start);
+			break;
+		}
+		time += delta;
+		if (entry != DShotBlackboxEntry::DROP && gpio >= DSHOT_BLACKBOX_PINS) {
+			fprintf(stderr, "invalid GPIO %d at byte %zu\n", gpio, start);
+			return 1;
+		}
+
+		switch (entry) {
+		case DShotBlackboxEntry::TX: {
+			uint16_t frame = lastTx[gpio] ^ value;
+			lastTx[gpio] = frame;
+			// normal DShot: XOR of the nibbles, bidirectional DShot: inverted
+			uint8_t csum = (frame >> 4 ^ frame >> 8 ^ frame >> 12) & 0xF;
+			const char *checksum = csum == (frame & 0xF) ? "normal" : (csum ^ 0xF) == (frame & 0xF) ? "inverted" : "bad";
+			printf("%llu,%d,TX,0x%04X,%d,%d,%s,,\n", (unsigned long long)time, gpio, frame, frame >> 5, frame >> 4 & 1, checksum);
+			break;
+		}
+		case DShotBlackboxEntry::RX: {
+			uint32_t word = lastRx[gpio] ^ value;
+			lastRx[gpio] = word;
+			uint32_t raw = 0;
+			BidirDshotTelemetryType type = word ? BidirDShotX1::decodeFrame(word, &raw) : BidirDshotTelemetryType::NO_REPLY;
+			printf("%llu,%d,RX,0x%08X,,,,%s,", (unsigned long long)time, gpio, word, typeNames[(int)type]);
+			if (type != BidirDshotTelemetryType::CHECKSUM_ERROR && type != BidirDshotTelemetryType::NO_REPLY) {
+				printf("%u", BidirDShotX1::convertFromRaw(raw, type));
+			}
+			printf("\n");
+			break;
+		}
+		default:
+			printf("%llu,,DROP,,,,,,%u\n", (unsigned long long)time, value);
+			break;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef _HARDWARE_ADDRESS_MAPPED_H
+#define _HARDWARE_ADDRESS_MAPPED_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+uint32_t pio_emu_reg_read(const volatile void *reg);
+void pio_emu_reg_write(volatile void *reg, uint32_t value);
+#ifdef __cplusplus
+}
+
+/**
+ * @brief Emulated memory-mapped register
+ *
+ * Every read and write is forwarded to the emulator, so code that accesses the register blocks directly
+ * (e.g. `pio->fdebug = mask` or `dma_hw->ints0`) and DMA transfers targeting them behave like on hardware.
+ */
+struct emu_reg {
+	uint32_t backing; // keeps the 4 byte register layout, the live value is held by the emulator
+	operator uint32_t() const { return pio_emu_reg_read(this); }
+	emu_reg &operator=(uint32_t v) {
+		pio_emu_reg_write(this, v);
+		return *this;
+	}
+	emu_reg &operator=(const emu_reg &other) { return *this = (uint32_t)other; }
+	emu_reg &operator|=(uint32_t v) { return *this = (uint32_t)*this | v; }
+	emu_reg &operator&=(uint32_t v) { return *this = (uint32_t)*this & v; }
+	emu_reg &operator^=(uint32_t v) { return *this = (uint32_t)*this ^ v; }
+};
+typedef emu_reg io_rw_32;
+typedef emu_reg io_ro_32;
+typedef emu_reg io_wo_32;
+
+static inline void hw_set_bits(io_rw_32 *addr, uint32_t mask) { *addr |= mask; }
+static inline void hw_clear_bits(io_rw_32 *addr, uint32_t mask) { *addr &= ~mask; }
+static inline void hw_xor_bits(io_rw_32 *addr, uint32_t mask) { *addr ^= mask; }
+static inline void hw_write_masked(io_rw_32 *addr, uint32_t values, uint32_t write_mask) {
+	*addr = ((uint32_t)*addr & ~write_mask) | (values & write_mask);
+}
+#else
+typedef volatile uint32_t io_rw_32;
+typedef const volatile uint32_t io_ro_32;
+typedef volatile uint32_t io_wo_32;
+#endif
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef _HARDWARE_DMA_H
+#define _HARDWARE_DMA_H
+
+#include "hardware/address_mapped.h"
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+	io_rw_32 read_addr;
+	io_rw_32 write_addr;
+	io_rw_32 transfer_count;
+	io_rw_32 ctrl_trig;
+	io_rw_32 al1_ctrl;
+	io_rw_32 al1_read_addr;
+	io_rw_32 al1_write_addr;
+	io_rw_32 al1_transfer_count_trig;
+	io_rw_32 al2_ctrl;
+	io_rw_32 al2_transfer_count;
+	io_rw_32 al2_read_addr;
+	io_rw_32 al2_write_addr_trig;
+	io_rw_32 al3_ctrl;
+	io_rw_32 al3_write_addr;
+	io_rw_32 al3_transfer_count;
+	io_rw_32 al3_read_addr_trig;
+} dma_channel_hw_t;
+
+typedef struct {
+	dma_channel_hw_t ch[NUM_DMA_CHANNELS];
+	io_rw_32 intr;
+	io_rw_32 inte0;
+	io_rw_32 intf0;
+	io_rw_32 ints0;
+	io_rw_32 inte1;
+	io_rw_32 intf1;
+	io_rw_32 ints1;
+	io_rw_32 timer[NUM_DMA_TIMERS];
+	io_wo_32 multi_channel_trigger;
+	io_rw_32 abort;
+} dma_hw_t;
+
+extern dma_hw_t dma_emu_hw;
+#define dma_hw (&dma_emu_hw)
+
+#define DMA_CH0_CTRL_TRIG_EN_BITS 0x00000001u
+#define DMA_CH0_CTRL_TRIG_HIGH_PRIORITY_BITS 0x00000002u
+#define DMA_CH0_CTRL_TRIG_DATA_SIZE_LSB 2
+#define DMA_CH0_CTRL_TRIG_DATA_SIZE_BITS 0x0000000cu
+#define DMA_CH0_CTRL_TRIG_INCR_READ_BITS 0x00000010u
+#define DMA_CH0_CTRL_TRIG_INCR_WRITE_BITS 0x00000020u
+#define DMA_CH0_CTRL_TRIG_RING_SIZE_LSB 6
+#define DMA_CH0_CTRL_TRIG_RING_SIZE_BITS 0x000003c0u
+#define DMA_CH0_CTRL_TRIG_RING_SEL_BITS 0x00000400u
+#define DMA_CH0_CTRL_TRIG_CHAIN_TO_LSB 11
+#define DMA_CH0_CTRL_TRIG_CHAIN_TO_BITS 0x00007800u
+#define DMA_CH0_CTRL_TRIG_TREQ_SEL_LSB 15
+#define DMA_CH0_CTRL_TRIG_TREQ_SEL_BITS 0x001f8000u
+#define DMA_CH0_CTRL_TRIG_IRQ_QUIET_BITS 0x00200000u
+#define DMA_CH0_CTRL_TRIG_BSWAP_BITS 0x00400000u
+#define DMA_CH0_CTRL_TRIG_BUSY_BITS 0x01000000u
+
+enum dma_channel_transfer_size {
+	DMA_SIZE_8 = 0,
+	DMA_SIZE_16 = 1,
+	DMA_SIZE_32 = 2
+};
+
+// RP2040 DREQ numbering (PIOn: n * 8 + TX0..3, RX0..3)
+#define DREQ_PIO0_TX0 0
+#define DREQ_PIO0_RX0 4
+#define DREQ_PIO1_TX0 8
+#define DREQ_PIO1_RX0 12
+#define DREQ_DMA_TIMER0 0x3b
+#define DREQ_DMA_TIMER1 0x3c
+#define DREQ_DMA_TIMER2 0x3d
+#define DREQ_DMA_TIMER3 0x3e
+#define DREQ_FORCE 0x3f
+
+typedef struct {
+	uint32_t ctrl;
+} dma_channel_config;
+
+static inline void channel_config_set_read_increment(dma_channel_config *c, bool incr) {
+	c->ctrl = incr ? (c->ctrl | DMA_CH0_CTRL_TRIG_INCR_READ_BITS) : (c->ctrl & ~DMA_CH0_CTRL_TRIG_INCR_READ_BITS);
+}
+static inline void channel_config_set_write_increment(dma_channel_config *c, bool incr) {
+	c->ctrl = incr ? (c->ctrl | DMA_CH0_CTRL_TRIG_INCR_WRITE_BITS) : (c->ctrl & ~DMA_CH0_CTRL_TRIG_INCR_WRITE_BITS);
+}
+static inline void channel_config_set_dreq(dma_channel_config *c, uint dreq) {
+	c->ctrl = (c->ctrl & ~DMA_CH0_CTRL_TRIG_TREQ_SEL_BITS) | (dreq << DMA_CH0_CTRL_TRIG_TREQ_SEL_LSB);
+}
+static inline void channel_config_set_chain_to(dma_channel_config *c, uint chain_to) {
+	c->ctrl = (c->ctrl & ~DMA_CH0_CTRL_TRIG_CHAIN_TO_BITS) | (chain_to << DMA_CH0_CTRL_TRIG_CHAIN_TO_LSB);
+}
+static inline void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) {
+	c->ctrl = (c->ctrl & ~DMA_CH0_CTRL_TRIG_DATA_SIZE_BITS) | (((uint)size) << DMA_CH0_CTRL_TRIG_DATA_SIZE_LSB);
+}
+static inline void channel_config_set_ring(dma_channel_config *c, bool write, uint size_bits) {
+	c->ctrl = (c->ctrl & ~(DMA_CH0_CTRL_TRIG_RING_SIZE_BITS | DMA_CH0_CTRL_TRIG_RING_SEL_BITS)) |
+			  (size_bits << DMA_CH0_CTRL_TRIG_RING_SIZE_LSB) |
+			  (write ? DMA_CH0_CTRL_TRIG_RING_SEL_BITS : 0);
+}
+static inline void channel_config_set_bswap(dma_channel_config *c, bool bswap) {
+	c->ctrl = bswap ? (c->ctrl | DMA_CH0_CTRL_TRIG_BSWAP_BITS) : (c->ctrl & ~DMA_CH0_CTRL_TRIG_BSWAP_BITS);
+}
+static inline void channel_config_set_irq_quiet(dma_channel_config *c, bool irq_quiet) {
+	c->ctrl = irq_quiet ? (c->ctrl | DMA_CH0_CTRL_TRIG_IRQ_QUIET_BITS) : (c->ctrl & ~DMA_CH0_CTRL_TRIG_IRQ_QUIET_BITS);
+}
+static inline void channel_config_set_high_priority(dma_channel_config *c, bool high_priority) {
+	c->ctrl = high_priority ? (c->ctrl | DMA_CH0_CTRL_TRIG_HIGH_PRIORITY_BITS) : (c->ctrl & ~DMA_CH0_CTRL_TRIG_HIGH_PRIORITY_BITS);
+}
+static inline void channel_config_set_enable(dma_channel_config *c, bool enable) {
+	c->ctrl = enable ? (c->ctrl | DMA_CH0_CTRL_TRIG_EN_BITS) : (c->ctrl & ~DMA_CH0_CTRL_TRIG_EN_BITS);
+}
+static inline uint32_t channel_config_get_ctrl_value(const dma_channel_config *config) { return config->ctrl; }
+
+static inline dma_channel_config dma_channel_get_default_config(uint channel) {
+	dma_channel_config c = {0};
+	channel_config_set_read_increment(&c, true);
+	channel_config_set_write_increment(&c, false);
+	channel_config_set_dreq(&c, DREQ_FORCE);
+	channel_config_set_chain_to(&c, channel);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+	channel_config_set_ring(&c, false, 0);
+	channel_config_set_bswap(&c, false);
+	channel_config_set_irq_quiet(&c, false);
+	channel_config_set_enable(&c, true);
+	return c;
+}
+
+static inline dma_channel_hw_t *dma_channel_hw_addr(uint channel) { return &dma_hw->ch[channel]; }
+static inline uint dma_get_timer_dreq(uint timer_num) { return DREQ_DMA_TIMER0 + timer_num; }
+
+void dma_channel_claim(uint channel);
+void dma_claim_mask(uint32_t channel_mask);
+void dma_channel_unclaim(uint channel);
+int dma_claim_unused_channel(bool required);
+bool dma_channel_is_claimed(uint channel);
+
+void dma_channel_set_config(uint channel, const dma_channel_config *config, bool trigger);
+void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger);
+void dma_channel_set_write_addr(uint channel, volatile void *write_addr, bool trigger);
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger);
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+						   const volatile void *read_addr, uint transfer_count, bool trigger);
+void dma_channel_start(uint channel);
+void dma_start_channel_mask(uint32_t chan_mask);
+void dma_channel_abort(uint channel);
+bool dma_channel_is_busy(uint channel);
+void dma_channel_wait_for_finish_blocking(uint channel);
+void dma_channel_set_irq0_enabled(uint channel, bool enabled);
+void dma_channel_set_irq1_enabled(uint channel, bool enabled);
+bool dma_channel_get_irq0_status(uint channel);
+void dma_channel_acknowledge_irq0(uint channel);
+
+void dma_timer_claim(uint timer);
+void dma_timer_unclaim(uint timer);
+int dma_claim_unused_timer(bool required);
+bool dma_timer_is_claimed(uint timer);
+void dma_timer_set_fraction(uint timer, uint16_t numerator, uint16_t denominator);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef _HARDWARE_IRQ_H
+#define _HARDWARE_IRQ_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if NUM_PIOS > 2
+// RP2350 numbering
+#define DMA_IRQ_0 10
+#define DMA_IRQ_1 11
+#define PIO0_IRQ_0 15
+#define PIO0_IRQ_1 16
+#define PIO1_IRQ_0 17
+#define PIO1_IRQ_1 18
+#define PIO2_IRQ_0 19
+#define PIO2_IRQ_1 20
+#define NUM_IRQS 52
+#else
+// RP2040 numbering
+#define PIO0_IRQ_0 7
+#define PIO0_IRQ_1 8
+#define PIO1_IRQ_0 9
+#define PIO1_IRQ_1 10
+#define DMA_IRQ_0 11
+#define DMA_IRQ_1 12
+#define NUM_IRQS 32
+#endif
+
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY 0x80
+#define PICO_SHARED_IRQ_HANDLER_HIGHEST_ORDER_PRIORITY 0xff
+#define PICO_SHARED_IRQ_HANDLER_LOWEST_ORDER_PRIORITY 0x00
+
+typedef void (*irq_handler_t)(void);
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority);
+void irq_remove_handler(uint num, irq_handler_t handler);
+bool irq_has_shared_handler(uint num);
+void irq_set_enabled(uint num, bool enabled);
+bool irq_is_enabled(uint num);
+void irq_set_priority(uint num, uint8_t hardware_priority);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
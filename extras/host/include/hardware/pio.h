@@ -0,0 +1,371 @@
+#ifndef _HARDWARE_PIO_H
+#define _HARDWARE_PIO_H
+
+#include "hardware/address_mapped.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/pio_instructions.h"
+#include "pico.h"
+
+// PIO blocks can be moved to GPIO 16...47 if the chip has more than 32 GPIOs (RP2350B), like in SDK 2.x
+#ifndef PICO_PIO_USE_GPIO_BASE
+#define PICO_PIO_USE_GPIO_BASE (NUM_BANK0_GPIOS > 32)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Register block with the RP2040 layout. Accesses are decoded by the emulator (see address_mapped.h).
+typedef struct {
+	io_rw_32 clkdiv;
+	io_rw_32 execctrl;
+	io_rw_32 shiftctrl;
+	io_ro_32 addr;
+	io_rw_32 instr;
+	io_rw_32 pinctrl;
+} pio_sm_hw_t;
+
+typedef struct {
+	io_rw_32 ctrl;
+	io_ro_32 fstat;
+	io_rw_32 fdebug;
+	io_ro_32 flevel;
+	io_wo_32 txf[NUM_PIO_STATE_MACHINES];
+	io_ro_32 rxf[NUM_PIO_STATE_MACHINES];
+	io_rw_32 irq;
+	io_wo_32 irq_force;
+	io_rw_32 input_sync_bypass;
+	io_rw_32 dbg_padout;
+	io_rw_32 dbg_padoe;
+	io_rw_32 dbg_cfginfo;
+	io_wo_32 instr_mem[PIO_INSTRUCTION_COUNT];
+	pio_sm_hw_t sm[NUM_PIO_STATE_MACHINES];
+	io_rw_32 intr;
+	io_rw_32 inte0;
+	io_rw_32 intf0;
+	io_ro_32 ints0;
+	io_rw_32 inte1;
+	io_rw_32 intf1;
+	io_ro_32 ints1;
+} pio_hw_t;
+
+typedef pio_hw_t *PIO;
+
+extern pio_hw_t pio_emu_hw[NUM_PIOS];
+#define pio0 (&pio_emu_hw[0])
+#define pio1 (&pio_emu_hw[1])
+#if NUM_PIOS > 2
+#define pio2 (&pio_emu_hw[2])
+#endif
+
+#define PIO_FDEBUG_TXSTALL_LSB 24
+#define PIO_FDEBUG_TXOVER_LSB 16
+#define PIO_FDEBUG_RXUNDER_LSB 8
+#define PIO_FDEBUG_RXSTALL_LSB 0
+
+#define PIO_SM0_CLKDIV_INT_LSB 16
+#define PIO_SM0_CLKDIV_FRAC_LSB 8
+#define PIO_SM0_EXECCTRL_SIDE_EN_BITS 0x40000000u
+#define PIO_SM0_EXECCTRL_SIDE_PINDIR_BITS 0x20000000u
+#define PIO_SM0_EXECCTRL_JMP_PIN_LSB 24
+#define PIO_SM0_EXECCTRL_JMP_PIN_BITS 0x1f000000u
+#define PIO_SM0_EXECCTRL_OUT_EN_SEL_LSB 19
+#define PIO_SM0_EXECCTRL_OUT_EN_SEL_BITS 0x00f80000u
+#define PIO_SM0_EXECCTRL_INLINE_OUT_EN_BITS 0x00040000u
+#define PIO_SM0_EXECCTRL_OUT_STICKY_BITS 0x00020000u
+#define PIO_SM0_EXECCTRL_WRAP_TOP_LSB 12
+#define PIO_SM0_EXECCTRL_WRAP_TOP_BITS 0x0001f000u
+#define PIO_SM0_EXECCTRL_WRAP_BOTTOM_LSB 7
+#define PIO_SM0_EXECCTRL_WRAP_BOTTOM_BITS 0x00000f80u
+#define PIO_SM0_EXECCTRL_STATUS_SEL_LSB 4
+#define PIO_SM0_EXECCTRL_STATUS_SEL_BITS 0x00000010u
+#define PIO_SM0_EXECCTRL_STATUS_N_LSB 0
+#define PIO_SM0_EXECCTRL_STATUS_N_BITS 0x0000000fu
+#define PIO_SM0_SHIFTCTRL_FJOIN_RX_BITS 0x80000000u
+#define PIO_SM0_SHIFTCTRL_FJOIN_TX_BITS 0x40000000u
+#define PIO_SM0_SHIFTCTRL_PULL_THRESH_LSB 25
+#define PIO_SM0_SHIFTCTRL_PULL_THRESH_BITS 0x3e000000u
+#define PIO_SM0_SHIFTCTRL_PUSH_THRESH_LSB 20
+#define PIO_SM0_SHIFTCTRL_PUSH_THRESH_BITS 0x01f00000u
+#define PIO_SM0_SHIFTCTRL_OUT_SHIFTDIR_BITS 0x00080000u
+#define PIO_SM0_SHIFTCTRL_IN_SHIFTDIR_BITS 0x00040000u
+#define PIO_SM0_SHIFTCTRL_AUTOPULL_BITS 0x00020000u
+#define PIO_SM0_SHIFTCTRL_AUTOPUSH_BITS 0x00010000u
+#define PIO_SM0_PINCTRL_SIDESET_COUNT_LSB 29
+#define PIO_SM0_PINCTRL_SIDESET_COUNT_BITS 0xe0000000u
+#define PIO_SM0_PINCTRL_SET_COUNT_LSB 26
+#define PIO_SM0_PINCTRL_SET_COUNT_BITS 0x1c000000u
+#define PIO_SM0_PINCTRL_OUT_COUNT_LSB 20
+#define PIO_SM0_PINCTRL_OUT_COUNT_BITS 0x03f00000u
+#define PIO_SM0_PINCTRL_IN_BASE_LSB 15
+#define PIO_SM0_PINCTRL_IN_BASE_BITS 0x000f8000u
+#define PIO_SM0_PINCTRL_SIDESET_BASE_LSB 10
+#define PIO_SM0_PINCTRL_SIDESET_BASE_BITS 0x00007c00u
+#define PIO_SM0_PINCTRL_SET_BASE_LSB 5
+#define PIO_SM0_PINCTRL_SET_BASE_BITS 0x000003e0u
+#define PIO_SM0_PINCTRL_OUT_BASE_LSB 0
+#define PIO_SM0_PINCTRL_OUT_BASE_BITS 0x0000001fu
+
+typedef struct {
+	uint32_t clkdiv;
+	uint32_t execctrl;
+	uint32_t shiftctrl;
+	uint32_t pinctrl;
+#if PICO_PIO_USE_GPIO_BASE
+	uint32_t pinhi; // bit n: GPIO >= 32 in field n (out, set, in, sideset, jmp), resolved against the GPIO base by pio_sm_set_config
+#endif
+} pio_sm_config;
+
+typedef struct pio_program {
+	const uint16_t *instructions;
+	uint8_t length;
+	int8_t origin;
+} pio_program_t;
+
+enum pio_fifo_join {
+	PIO_FIFO_JOIN_NONE = 0,
+	PIO_FIFO_JOIN_TX = 1,
+	PIO_FIFO_JOIN_RX = 2,
+};
+
+enum pio_mov_status_type {
+	STATUS_TX_LESSTHAN = 0,
+	STATUS_RX_LESSTHAN = 1
+};
+
+enum pio_interrupt_source {
+	pis_interrupt0 = 8,
+	pis_interrupt1 = 9,
+	pis_interrupt2 = 10,
+	pis_interrupt3 = 11,
+	pis_sm0_tx_fifo_not_full = 4,
+	pis_sm1_tx_fifo_not_full = 5,
+	pis_sm2_tx_fifo_not_full = 6,
+	pis_sm3_tx_fifo_not_full = 7,
+	pis_sm0_rx_fifo_not_empty = 0,
+	pis_sm1_rx_fifo_not_empty = 1,
+	pis_sm2_rx_fifo_not_empty = 2,
+	pis_sm3_rx_fifo_not_empty = 3,
+};
+
+// ---- state machine configuration (same encoding as the SDK) ----
+
+#if PICO_PIO_USE_GPIO_BASE
+#define PIO_EMU_PINHI_OUT 0
+#define PIO_EMU_PINHI_SET 1
+#define PIO_EMU_PINHI_IN 2
+#define PIO_EMU_PINHI_SIDESET 3
+#define PIO_EMU_PINHI_JMP 4
+static inline void pio_emu_set_pinhi(pio_sm_config *c, uint field, uint gpio) {
+	c->pinhi = (c->pinhi & ~(1u << field)) | ((gpio >> 5) << field);
+}
+#else
+#define pio_emu_set_pinhi(c, field, gpio) ((void)0)
+#endif
+
+static inline void sm_config_set_out_pins(pio_sm_config *c, uint out_base, uint out_count) {
+	pio_emu_set_pinhi(c, PIO_EMU_PINHI_OUT, out_base);
+	out_base &= 31;
+	c->pinctrl = (c->pinctrl & ~(PIO_SM0_PINCTRL_OUT_BASE_BITS | PIO_SM0_PINCTRL_OUT_COUNT_BITS)) |
+				 (out_base << PIO_SM0_PINCTRL_OUT_BASE_LSB) |
+				 (out_count << PIO_SM0_PINCTRL_OUT_COUNT_LSB);
+}
+
+static inline void sm_config_set_set_pins(pio_sm_config *c, uint set_base, uint set_count) {
+	pio_emu_set_pinhi(c, PIO_EMU_PINHI_SET, set_base);
+	set_base &= 31;
+	c->pinctrl = (c->pinctrl & ~(PIO_SM0_PINCTRL_SET_BASE_BITS | PIO_SM0_PINCTRL_SET_COUNT_BITS)) |
+				 (set_base << PIO_SM0_PINCTRL_SET_BASE_LSB) |
+				 (set_count << PIO_SM0_PINCTRL_SET_COUNT_LSB);
+}
+
+static inline void sm_config_set_in_pins(pio_sm_config *c, uint in_base) {
+	pio_emu_set_pinhi(c, PIO_EMU_PINHI_IN, in_base);
+	in_base &= 31;
+	c->pinctrl = (c->pinctrl & ~PIO_SM0_PINCTRL_IN_BASE_BITS) |
+				 (in_base << PIO_SM0_PINCTRL_IN_BASE_LSB);
+}
+
+static inline void sm_config_set_sideset_pins(pio_sm_config *c, uint sideset_base) {
+	pio_emu_set_pinhi(c, PIO_EMU_PINHI_SIDESET, sideset_base);
+	sideset_base &= 31;
+	c->pinctrl = (c->pinctrl & ~PIO_SM0_PINCTRL_SIDESET_BASE_BITS) |
+				 (sideset_base << PIO_SM0_PINCTRL_SIDESET_BASE_LSB);
+}
+
+static inline void sm_config_set_sideset(pio_sm_config *c, uint bit_count, bool optional, bool pindirs) {
+	c->pinctrl = (c->pinctrl & ~PIO_SM0_PINCTRL_SIDESET_COUNT_BITS) |
+				 (bit_count << PIO_SM0_PINCTRL_SIDESET_COUNT_LSB);
+	c->execctrl = (c->execctrl & ~(PIO_SM0_EXECCTRL_SIDE_EN_BITS | PIO_SM0_EXECCTRL_SIDE_PINDIR_BITS)) |
+				  (optional ? PIO_SM0_EXECCTRL_SIDE_EN_BITS : 0) |
+				  (pindirs ? PIO_SM0_EXECCTRL_SIDE_PINDIR_BITS : 0);
+}
+
+static inline void sm_config_set_clkdiv_int_frac(pio_sm_config *c, uint16_t div_int, uint8_t div_frac) {
+	c->clkdiv = (((uint)div_frac) << PIO_SM0_CLKDIV_FRAC_LSB) |
+				(((uint)div_int) << PIO_SM0_CLKDIV_INT_LSB);
+}
+
+static inline void pio_calculate_clkdiv_from_float(float div, uint16_t *div_int, uint8_t *div_frac) {
+	*div_int = (uint16_t)div;
+	if (*div_int == 0) {
+		*div_frac = 0;
+	} else {
+		*div_frac = (uint8_t)((div - (float)*div_int) * (1u << 8u));
+	}
+}
+
+static inline void sm_config_set_clkdiv(pio_sm_config *c, float div) {
+	uint16_t div_int;
+	uint8_t div_frac;
+	pio_calculate_clkdiv_from_float(div, &div_int, &div_frac);
+	sm_config_set_clkdiv_int_frac(c, div_int, div_frac);
+}
+
+static inline void sm_config_set_wrap(pio_sm_config *c, uint wrap_target, uint wrap) {
+	c->execctrl = (c->execctrl & ~(PIO_SM0_EXECCTRL_WRAP_TOP_BITS | PIO_SM0_EXECCTRL_WRAP_BOTTOM_BITS)) |
+				  (wrap_target << PIO_SM0_EXECCTRL_WRAP_BOTTOM_LSB) |
+				  (wrap << PIO_SM0_EXECCTRL_WRAP_TOP_LSB);
+}
+
+static inline void sm_config_set_jmp_pin(pio_sm_config *c, uint pin) {
+	pio_emu_set_pinhi(c, PIO_EMU_PINHI_JMP, pin);
+	pin &= 31;
+	c->execctrl = (c->execctrl & ~PIO_SM0_EXECCTRL_JMP_PIN_BITS) |
+				  (pin << PIO_SM0_EXECCTRL_JMP_PIN_LSB);
+}
+
+static inline void sm_config_set_in_shift(pio_sm_config *c, bool shift_right, bool autopush, uint push_threshold) {
+	c->shiftctrl = (c->shiftctrl &
+					~(PIO_SM0_SHIFTCTRL_IN_SHIFTDIR_BITS |
+					  PIO_SM0_SHIFTCTRL_AUTOPUSH_BITS |
+					  PIO_SM0_SHIFTCTRL_PUSH_THRESH_BITS)) |
+				   (shift_right ? PIO_SM0_SHIFTCTRL_IN_SHIFTDIR_BITS : 0) |
+				   (autopush ? PIO_SM0_SHIFTCTRL_AUTOPUSH_BITS : 0) |
+				   ((push_threshold & 0x1fu) << PIO_SM0_SHIFTCTRL_PUSH_THRESH_LSB);
+}
+
+static inline void sm_config_set_out_shift(pio_sm_config *c, bool shift_right, bool autopull, uint pull_threshold) {
+	c->shiftctrl = (c->shiftctrl &
+					~(PIO_SM0_SHIFTCTRL_OUT_SHIFTDIR_BITS |
+					  PIO_SM0_SHIFTCTRL_AUTOPULL_BITS |
+					  PIO_SM0_SHIFTCTRL_PULL_THRESH_BITS)) |
+				   (shift_right ? PIO_SM0_SHIFTCTRL_OUT_SHIFTDIR_BITS : 0) |
+				   (autopull ? PIO_SM0_SHIFTCTRL_AUTOPULL_BITS : 0) |
+				   ((pull_threshold & 0x1fu) << PIO_SM0_SHIFTCTRL_PULL_THRESH_LSB);
+}
+
+static inline void sm_config_set_fifo_join(pio_sm_config *c, enum pio_fifo_join join) {
+	c->shiftctrl = (c->shiftctrl & ~(PIO_SM0_SHIFTCTRL_FJOIN_TX_BITS | PIO_SM0_SHIFTCTRL_FJOIN_RX_BITS)) |
+				   (join == PIO_FIFO_JOIN_TX ? PIO_SM0_SHIFTCTRL_FJOIN_TX_BITS : 0) |
+				   (join == PIO_FIFO_JOIN_RX ? PIO_SM0_SHIFTCTRL_FJOIN_RX_BITS : 0);
+}
+
+static inline void sm_config_set_out_special(pio_sm_config *c, bool sticky, bool has_enable_pin, uint enable_pin_index) {
+	c->execctrl = (c->execctrl &
+				   (uint) ~(PIO_SM0_EXECCTRL_OUT_STICKY_BITS | PIO_SM0_EXECCTRL_INLINE_OUT_EN_BITS |
+							PIO_SM0_EXECCTRL_OUT_EN_SEL_BITS)) |
+				  (sticky ? PIO_SM0_EXECCTRL_OUT_STICKY_BITS : 0) |
+				  (has_enable_pin ? PIO_SM0_EXECCTRL_INLINE_OUT_EN_BITS : 0) |
+				  ((enable_pin_index << PIO_SM0_EXECCTRL_OUT_EN_SEL_LSB) & PIO_SM0_EXECCTRL_OUT_EN_SEL_BITS);
+}
+
+static inline void sm_config_set_mov_status(pio_sm_config *c, enum pio_mov_status_type status_sel, uint status_n) {
+	c->execctrl = (c->execctrl & ~(PIO_SM0_EXECCTRL_STATUS_SEL_BITS | PIO_SM0_EXECCTRL_STATUS_N_BITS)) |
+				  ((((uint)status_sel) << PIO_SM0_EXECCTRL_STATUS_SEL_LSB) & PIO_SM0_EXECCTRL_STATUS_SEL_BITS) |
+				  ((status_n << PIO_SM0_EXECCTRL_STATUS_N_LSB) & PIO_SM0_EXECCTRL_STATUS_N_BITS);
+}
+
+static inline pio_sm_config pio_get_default_sm_config(void) {
+	pio_sm_config c = {0};
+	sm_config_set_clkdiv_int_frac(&c, 1, 0);
+	sm_config_set_wrap(&c, 0, 31);
+	sm_config_set_in_shift(&c, true, false, 32);
+	sm_config_set_out_shift(&c, true, false, 32);
+	return c;
+}
+
+// ---- PIO block / state machine API ----
+
+static inline uint pio_get_index(PIO pio) { return (uint)(pio - pio_emu_hw); }
+static inline PIO pio_get_instance(uint instance) { return &pio_emu_hw[instance]; }
+static inline uint pio_get_dreq(PIO pio, uint sm, bool is_tx) { return pio_get_index(pio) * 8u + (is_tx ? 0u : 4u) + sm; }
+static inline uint pio_get_irq_num(PIO pio, uint irqn) { return PIO0_IRQ_0 + 2u * pio_get_index(pio) + irqn; }
+
+bool pio_can_add_program(PIO pio, const pio_program_t *program);
+bool pio_can_add_program_at_offset(PIO pio, const pio_program_t *program, uint offset);
+int pio_add_program(PIO pio, const pio_program_t *program);
+int pio_add_program_at_offset(PIO pio, const pio_program_t *program, uint offset);
+void pio_remove_program(PIO pio, const pio_program_t *program, uint loaded_offset);
+void pio_clear_instruction_memory(PIO pio);
+
+void pio_sm_claim(PIO pio, uint sm);
+void pio_claim_sm_mask(PIO pio, uint sm_mask);
+void pio_sm_unclaim(PIO pio, uint sm);
+int pio_claim_unused_sm(PIO pio, bool required);
+bool pio_sm_is_claimed(PIO pio, uint sm);
+
+int pio_set_gpio_base(PIO pio, uint gpio_base);
+uint pio_get_gpio_base(PIO pio);
+void pio_gpio_init(PIO pio, uint pin);
+int pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config);
+int pio_sm_set_config(PIO pio, uint sm, const pio_sm_config *config);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+void pio_set_sm_mask_enabled(PIO pio, uint32_t mask, bool enabled);
+void pio_sm_restart(PIO pio, uint sm);
+void pio_restart_sm_mask(PIO pio, uint32_t mask);
+void pio_sm_clkdiv_restart(PIO pio, uint sm);
+void pio_clkdiv_restart_sm_mask(PIO pio, uint32_t mask);
+void pio_enable_sm_mask_in_sync(PIO pio, uint32_t mask);
+void pio_sm_set_clkdiv(PIO pio, uint sm, float div);
+void pio_sm_set_clkdiv_int_frac(PIO pio, uint sm, uint16_t div_int, uint8_t div_frac);
+void pio_sm_set_wrap(PIO pio, uint sm, uint wrap_target, uint wrap);
+void pio_sm_set_out_pins(PIO pio, uint sm, uint out_base, uint out_count);
+void pio_sm_set_set_pins(PIO pio, uint sm, uint set_base, uint set_count);
+void pio_sm_set_in_pins(PIO pio, uint sm, uint in_base);
+void pio_sm_set_sideset_pins(PIO pio, uint sm, uint sideset_base);
+void pio_sm_set_jmp_pin(PIO pio, uint sm, uint pin);
+
+void pio_sm_exec(PIO pio, uint sm, uint instr);
+bool pio_sm_is_exec_stalled(PIO pio, uint sm);
+void pio_sm_exec_wait_blocking(PIO pio, uint sm, uint instr);
+uint8_t pio_sm_get_pc(PIO pio, uint sm);
+
+void pio_sm_set_pins(PIO pio, uint sm, uint32_t pin_values);
+void pio_sm_set_pins_with_mask(PIO pio, uint sm, uint32_t pin_values, uint32_t pin_mask);
+void pio_sm_set_pindirs_with_mask(PIO pio, uint sm, uint32_t pin_dirs, uint32_t pin_mask);
+void pio_sm_set_pins64(PIO pio, uint sm, uint64_t pin_values);
+void pio_sm_set_pins_with_mask64(PIO pio, uint sm, uint64_t pin_values, uint64_t pin_mask);
+void pio_sm_set_pindirs_with_mask64(PIO pio, uint sm, uint64_t pin_dirs, uint64_t pin_mask);
+int pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out);
+
+void pio_sm_put(PIO pio, uint sm, uint32_t data);
+void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data);
+uint32_t pio_sm_get(PIO pio, uint sm);
+uint32_t pio_sm_get_blocking(PIO pio, uint sm);
+bool pio_sm_is_rx_fifo_full(PIO pio, uint sm);
+bool pio_sm_is_rx_fifo_empty(PIO pio, uint sm);
+uint pio_sm_get_rx_fifo_level(PIO pio, uint sm);
+bool pio_sm_is_tx_fifo_full(PIO pio, uint sm);
+bool pio_sm_is_tx_fifo_empty(PIO pio, uint sm);
+uint pio_sm_get_tx_fifo_level(PIO pio, uint sm);
+void pio_sm_clear_fifos(PIO pio, uint sm);
+void pio_sm_drain_tx_fifo(PIO pio, uint sm);
+
+void pio_set_irq0_source_enabled(PIO pio, enum pio_interrupt_source source, bool enabled);
+void pio_set_irq1_source_enabled(PIO pio, enum pio_interrupt_source source, bool enabled);
+void pio_set_irq0_source_mask_enabled(PIO pio, uint32_t source_mask, bool enabled);
+void pio_set_irq1_source_mask_enabled(PIO pio, uint32_t source_mask, bool enabled);
+static inline void pio_set_irqn_source_enabled(PIO pio, uint irq_index, enum pio_interrupt_source source, bool enabled) {
+	if (irq_index) pio_set_irq1_source_enabled(pio, source, enabled);
+	else pio_set_irq0_source_enabled(pio, source, enabled);
+}
+bool pio_interrupt_get(PIO pio, uint pio_interrupt_num);
+void pio_interrupt_clear(PIO pio, uint pio_interrupt_num);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef _HARDWARE_SYNC_H
+#define _HARDWARE_SYNC_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef volatile uint32_t spin_lock_t;
+
+// the emulation runs on a single host thread: interrupts only fire while the emulation is stepped
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+static inline void __dmb(void) { __compiler_memory_barrier(); }
+static inline void __mem_fence_acquire(void) { __compiler_memory_barrier(); }
+static inline void __mem_fence_release(void) { __compiler_memory_barrier(); }
+static inline void __sev(void) {}
+static inline void __wfe(void) {}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef _PICO_H
+#define _PICO_H
+
+// Host build of the Pico SDK surface used by Pico_Bidir_DShot. See extras/host/README.md.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+
+#ifndef NUM_PIOS
+#define NUM_PIOS 2
+#endif
+#define NUM_PIO_STATE_MACHINES 4
+#define PIO_INSTRUCTION_COUNT 32
+#if NUM_PIOS > 2
+#define NUM_BANK0_GPIOS 48
+#define NUM_DMA_CHANNELS 16
+#else
+#define NUM_BANK0_GPIOS 30
+#define NUM_DMA_CHANNELS 12
+#endif
+#define NUM_DMA_TIMERS 4
+#ifndef SYS_CLK_HZ
+#if NUM_PIOS > 2
+#define SYS_CLK_HZ 150000000
+#else
+#define SYS_CLK_HZ 125000000
+#endif
+#endif
+#ifndef SYS_CLK_KHZ
+#define SYS_CLK_KHZ (SYS_CLK_HZ / 1000)
+#endif
+
+#define __not_in_flash(group)
+#define __not_in_flash_func(func_name) func_name
+#define __time_critical_func(func_name) func_name
+#define __no_inline_not_in_flash_func(func_name) func_name
+#define __force_inline inline __attribute__((always_inline))
+#ifndef __unused
+#define __unused __attribute__((unused))
+#endif
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+#define hard_assert(x) ((void)0)
+#define valid_params_if(x, test) ((void)0)
+#define invalid_params_if(x, test) ((void)0)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline void tight_loop_contents(void) {}
+static inline void __compiler_memory_barrier(void) { __asm__ volatile("" ::: "memory"); }
+static inline uint get_core_num(void) { return 0; }
+void busy_wait_at_least_cycles(uint32_t minimum_cycles); // advances the emulation, see pio_emu.cpp
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef _PICO_STDLIB_H
+#define _PICO_STDLIB_H
+
+#include "hardware/clocks.h"
+#include "hardware/gpio.h"
+#include "pico.h"
+#include "pico/time.h"
+
+#endif
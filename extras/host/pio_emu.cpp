@@ -0,0 +1,1215 @@
+#include "pio_emu_internal.h"
+#include "hardware/sync.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+pio_hw_t pio_emu_hw[NUM_PIOS];
+dma_hw_t dma_emu_hw;
+
+namespace pio_emu {
+
+Pio pios[NUM_PIOS];
+Gpio gpios[NUM_BANK0_GPIOS];
+DmaCh dmaCh[NUM_DMA_CHANNELS];
+DmaTimer dmaTimers[NUM_DMA_TIMERS];
+uint32_t dmaIntr = 0, dmaInte[2] = {0, 0}, dmaIntf[2] = {0, 0};
+uint32_t sysHz = SYS_CLK_HZ;
+
+static uint64_t cycle = 0;
+static uint64_t levels = 0; // pad levels
+static uint64_t sync1 = 0, sync2 = 0; // 2 stage input synchronizer
+static bool gpioDirty = true;
+static uint32_t timerAcc[NUM_DMA_TIMERS];
+static uint32_t timerCredits[NUM_DMA_TIMERS];
+static uint dmaRoundRobin = 0;
+
+struct Hook {
+	pio_emu_hook_t fn;
+	void *ctx;
+	int id;
+};
+static std::vector<Hook> hooks;
+static int nextHookId = 1;
+
+static uint64_t traceMask = 0;
+static std::vector<pio_emu_edge_t> trace;
+
+// ---- IRQ controller ----
+struct IrqLine {
+	bool enabled = false;
+	irq_handler_t exclusive = nullptr;
+	std::vector<irq_handler_t> shared;
+};
+static IrqLine irqLines[NUM_IRQS];
+static bool interruptsDisabled = false;
+static bool inHandler = false;
+
+uint Sm::txCap() const {
+	if (shiftctrl & PIO_SM0_SHIFTCTRL_FJOIN_TX_BITS) return 8;
+	if (shiftctrl & PIO_SM0_SHIFTCTRL_FJOIN_RX_BITS) return 0;
+	return 4;
+}
+uint Sm::rxCap() const {
+	if (shiftctrl & PIO_SM0_SHIFTCTRL_FJOIN_RX_BITS) return 8;
+	if (shiftctrl & PIO_SM0_SHIFTCTRL_FJOIN_TX_BITS) return 0;
+	return 4;
+}
+uint Sm::pushThresh() const {
+	uint t = (shiftctrl & PIO_SM0_SHIFTCTRL_PUSH_THRESH_BITS) >> PIO_SM0_SHIFTCTRL_PUSH_THRESH_LSB;
+	return t ? t : 32;
+}
+uint Sm::pullThresh() const {
+	uint t = (shiftctrl & PIO_SM0_SHIFTCTRL_PULL_THRESH_BITS) >> PIO_SM0_SHIFTCTRL_PULL_THRESH_LSB;
+	return t ? t : 32;
+}
+
+Pio &pioOf(PIO pio) {
+	return pios[pio_get_index(pio)];
+}
+
+void markGpioDirty() {
+	gpioDirty = true;
+}
+
+static bool pinLevel(uint pin, bool prev) {
+	const Gpio &g = gpios[pin];
+	if (g.func >= GPIO_FUNC_PIO0 && g.func < GPIO_FUNC_PIO0 + NUM_PIOS) {
+		const Pio &p = pios[g.func - GPIO_FUNC_PIO0];
+		uint rel = pin - p.gpioBase;
+		if (rel < 32 && (p.outDir & (1u << rel))) return p.outVal & (1u << rel);
+	} else if (g.func == GPIO_FUNC_SIO && g.sioOe) {
+		return g.sioOut;
+	}
+	if (g.extDriven) return g.extLevel;
+	if (g.pullUp && !g.pullDown) return true;
+	if (g.pullDown && !g.pullUp) return false;
+	return prev; // bus keeper
+}
+
+void refreshGpio() {
+	if (!gpioDirty) return;
+	gpioDirty = false;
+	uint64_t n = 0;
+	for (uint i = 0; i < NUM_BANK0_GPIOS; i++) {
+		if (pinLevel(i, (levels >> i) & 1)) n |= 1ull << i;
+	}
+	uint64_t changed = (n ^ levels) & traceMask;
+	while (changed) {
+		uint pin = __builtin_ctzll(changed);
+		changed &= changed - 1;
+		trace.push_back({cycle, (uint8_t)pin, (bool)((n >> pin) & 1)});
+	}
+	levels = n;
+}
+
+uint32_t pinsFrom(const Pio &p, uint base) {
+	uint32_t v = (uint32_t)(sync2 >> p.gpioBase);
+	base &= 31;
+	return base ? (v >> base) | (v << (32 - base)) : v;
+}
+
+static bool syncedPin(const Pio &p, uint pin) {
+	pin &= 31;
+	if (p.syncBypass & (1u << pin)) return (levels >> (pin + p.gpioBase)) & 1;
+	return (sync2 >> (pin + p.gpioBase)) & 1;
+}
+
+void pioSetPins(Pio &p, uint base, uint count, uint32_t values, bool dirs) {
+	for (uint i = 0; i < count; i++) {
+		uint pin = (base + i) & 31;
+		uint32_t bit = 1u << pin;
+		uint32_t &reg = dirs ? p.outDir : p.outVal;
+		if ((values >> i) & 1) reg |= bit;
+		else reg &= ~bit;
+	}
+	gpioDirty = true;
+}
+
+void smRestart(Sm &s) {
+	s.isrCount = 0;
+	s.osrCount = 32;
+	s.delay = 0;
+	s.execPending = false;
+	s.irqWaiting = false;
+	s.isr = 0;
+	s.osr = 0;
+}
+
+static void advancePc(Sm &s) {
+	uint top = (s.execctrl & PIO_SM0_EXECCTRL_WRAP_TOP_BITS) >> PIO_SM0_EXECCTRL_WRAP_TOP_LSB;
+	uint bottom = (s.execctrl & PIO_SM0_EXECCTRL_WRAP_BOTTOM_BITS) >> PIO_SM0_EXECCTRL_WRAP_BOTTOM_LSB;
+	if (s.pc == top) s.pc = bottom;
+	else s.pc = (s.pc + 1) & 31;
+}
+
+static uint irqIndex(uint idx, uint smi) {
+	if (idx & 0x10) return (idx & 4) | ((idx + smi) & 3);
+	return idx & 7;
+}
+
+static void applySideset(Pio &p, Sm &s, uint16_t ins) {
+	uint count = (s.pinctrl & PIO_SM0_PINCTRL_SIDESET_COUNT_BITS) >> PIO_SM0_PINCTRL_SIDESET_COUNT_LSB;
+	if (!count) return;
+	uint field = (ins >> 8) & 31;
+	uint side = field >> (5 - count);
+	bool opt = s.execctrl & PIO_SM0_EXECCTRL_SIDE_EN_BITS;
+	uint dataBits = count;
+	if (opt) {
+		if (!(side >> (count - 1))) return;
+		dataBits--;
+		side &= (1u << dataBits) - 1;
+	}
+	uint base = (s.pinctrl & PIO_SM0_PINCTRL_SIDESET_BASE_BITS) >> PIO_SM0_PINCTRL_SIDESET_BASE_LSB;
+	pioSetPins(p, base, dataBits, side, s.execctrl & PIO_SM0_EXECCTRL_SIDE_PINDIR_BITS);
+}
+
+static uint delayOf(const Sm &s, uint16_t ins) {
+	uint count = (s.pinctrl & PIO_SM0_PINCTRL_SIDESET_COUNT_BITS) >> PIO_SM0_PINCTRL_SIDESET_COUNT_LSB;
+	uint field = (ins >> 8) & 31;
+	return field & ((1u << (5 - count)) - 1);
+}
+
+static void outPins(Pio &p, Sm &s, uint32_t value, bool dirs) {
+	uint base = s.pinctrl & PIO_SM0_PINCTRL_OUT_BASE_BITS;
+	uint count = (s.pinctrl & PIO_SM0_PINCTRL_OUT_COUNT_BITS) >> PIO_SM0_PINCTRL_OUT_COUNT_LSB;
+	pioSetPins(p, base, count, value, dirs);
+}
+
+static uint32_t movSource(Pio &p, Sm &s, uint src) {
+	switch (src) {
+	case 0:
+		return pinsFrom(p, (s.pinctrl & PIO_SM0_PINCTRL_IN_BASE_BITS) >> PIO_SM0_PINCTRL_IN_BASE_LSB);
+	case 1:
+		return s.x;
+	case 2:
+		return s.y;
+	case 3:
+		return 0;
+	case 5: {
+		uint n = s.execctrl & PIO_SM0_EXECCTRL_STATUS_N_BITS;
+		uint level = (s.execctrl & PIO_SM0_EXECCTRL_STATUS_SEL_BITS) ? s.rx.count : s.tx.count;
+		return level < n ? 0xFFFFFFFFu : 0;
+	}
+	case 6:
+		return s.isr;
+	case 7:
+		return s.osr;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * Executes one instruction. Returns false if the instruction stalls.
+ * jumped is set if the instruction wrote the program counter.
+ */
+static bool execute(Pio &p, uint smi, uint16_t ins, bool &jumped) {
+	Sm &s = p.sm[smi];
+	uint op = ins >> 13;
+	uint arg1 = (ins >> 5) & 7;
+	uint arg2 = ins & 31;
+	jumped = false;
+	switch (op) {
+	case 0: { // JMP
+		bool take = false;
+		switch (arg1) {
+		case 0:
+			take = true;
+			break;
+		case 1:
+			take = !s.x;
+			break;
+		case 2:
+			take = s.x != 0;
+			s.x--;
+			break;
+		case 3:
+			take = !s.y;
+			break;
+		case 4:
+			take = s.y != 0;
+			s.y--;
+			break;
+		case 5:
+			take = s.x != s.y;
+			break;
+		case 6:
+			take = syncedPin(p, (s.execctrl & PIO_SM0_EXECCTRL_JMP_PIN_BITS) >> PIO_SM0_EXECCTRL_JMP_PIN_LSB);
+			break;
+		case 7:
+			take = s.osrCount < s.pullThresh();
+			break;
+		}
+		if (take) {
+			s.pc = arg2;
+			jumped = true;
+		}
+		return true;
+	}
+	case 1: { // WAIT
+		bool pol = (ins >> 7) & 1;
+		uint src = (ins >> 5) & 3;
+		bool level = false;
+		if (src == 0) {
+			level = syncedPin(p, arg2);
+		} else if (src == 1) {
+			uint inBase = (s.pinctrl & PIO_SM0_PINCTRL_IN_BASE_BITS) >> PIO_SM0_PINCTRL_IN_BASE_LSB;
+			level = syncedPin(p, inBase + arg2);
+		} else if (src == 2) {
+			uint idx = irqIndex(arg2, smi);
+			level = p.irqFlags & (1u << idx);
+			if (level == pol && pol) p.irqFlags &= ~(1u << idx);
+		}
+		return level == pol;
+	}
+	case 2: { // IN
+		uint n = arg2 ? arg2 : 32;
+		uint32_t data = movSource(p, s, arg1 == 0 ? 0 : arg1);
+		if (arg1 == 0) data = movSource(p, s, 0);
+		uint32_t mask = n == 32 ? 0xFFFFFFFFu : ((1u << n) - 1);
+		uint32_t isr;
+		if (s.shiftctrl & PIO_SM0_SHIFTCTRL_IN_SHIFTDIR_BITS) {
+			isr = n == 32 ? data : (s.isr >> n) | ((data & mask) << (32 - n));
+		} else {
+			isr = n == 32 ? data : (s.isr << n) | (data & mask);
+		}
+		uint count = s.isrCount + n;
+		if (count > 32) count = 32;
+		if ((s.shiftctrl & PIO_SM0_SHIFTCTRL_AUTOPUSH_BITS) && count >= s.pushThresh()) {
+			if (s.rx.count >= s.rxCap()) return false;
+			s.rx.push(isr);
+			s.isr = 0;
+			s.isrCount = 0;
+		} else {
+			s.isr = isr;
+			s.isrCount = count;
+		}
+		return true;
+	}
+	case 3: { // OUT
+		bool autopull = s.shiftctrl & PIO_SM0_SHIFTCTRL_AUTOPULL_BITS;
+		if (autopull && s.osrCount >= s.pullThresh()) {
+			if (!s.tx.count) {
+				p.fdebug |= 1u << (PIO_FDEBUG_TXSTALL_LSB + smi);
+				return false;
+			}
+			s.osr = s.tx.pop();
+			s.osrCount = 0;
+		}
+		uint n = arg2 ? arg2 : 32;
+		uint32_t data;
+		if (s.shiftctrl & PIO_SM0_SHIFTCTRL_OUT_SHIFTDIR_BITS) {
+			data = n == 32 ? s.osr : s.osr & ((1u << n) - 1);
+			s.osr = n == 32 ? 0 : s.osr >> n;
+		} else {
+			data = n == 32 ? s.osr : s.osr >> (32 - n);
+			s.osr = n == 32 ? 0 : s.osr << n;
+		}
+		s.osrCount = s.osrCount + n > 32 ? 32 : s.osrCount + n;
+		switch (arg1) {
+		case 0:
+			outPins(p, s, data, false);
+			break;
+		case 1:
+			s.x = data;
+			break;
+		case 2:
+			s.y = data;
+			break;
+		case 3:
+			break;
+		case 4:
+			outPins(p, s, data, true);
+			break;
+		case 5:
+			s.pc = data & 31;
+			jumped = true;
+			break;
+		case 6:
+			s.isr = data;
+			s.isrCount = n;
+			break;
+		case 7:
+			s.execPending = true;
+			s.execInstr = data;
+			break;
+		}
+		if (autopull && s.osrCount >= s.pullThresh() && s.tx.count) {
+			s.osr = s.tx.pop();
+			s.osrCount = 0;
+		}
+		return true;
+	}
+	case 4: {
+		bool ifFlag = (ins >> 6) & 1;
+		bool block = (ins >> 5) & 1;
+		if (ins & 0x80) { // PULL
+			if (ifFlag && s.osrCount < s.pullThresh()) return true;
+			if ((s.shiftctrl & PIO_SM0_SHIFTCTRL_AUTOPULL_BITS) && s.osrCount == 0) return true;
+			if (!s.tx.count) {
+				if (block) {
+					p.fdebug |= 1u << (PIO_FDEBUG_TXSTALL_LSB + smi);
+					return false;
+				}
+				s.osr = s.x;
+				s.osrCount = 0;
+				return true;
+			}
+			s.osr = s.tx.pop();
+			s.osrCount = 0;
+		} else { // PUSH
+			if (ifFlag && s.isrCount < s.pushThresh()) return true;
+			if (s.rx.count >= s.rxCap()) {
+				if (block) return false;
+				p.fdebug |= 1u << (PIO_FDEBUG_RXSTALL_LSB + smi);
+			} else {
+				s.rx.push(s.isr);
+			}
+			s.isr = 0;
+			s.isrCount = 0;
+		}
+		return true;
+	}
+	case 5: { // MOV
+		uint opn = (ins >> 3) & 3;
+		uint32_t v = movSource(p, s, ins & 7);
+		if (opn == 1) v = ~v;
+		else if (opn == 2) {
+			uint32_t r = 0;
+			for (int i = 0; i < 32; i++)
+				if (v & (1u << i)) r |= 1u << (31 - i);
+			v = r;
+		}
+		switch (arg1) {
+		case 0:
+			outPins(p, s, v, false);
+			break;
+		case 1:
+			s.x = v;
+			break;
+		case 2:
+			s.y = v;
+			break;
+		case 4:
+			s.execPending = true;
+			s.execInstr = v;
+			break;
+		case 5:
+			s.pc = v & 31;
+			jumped = true;
+			break;
+		case 6:
+			s.isr = v;
+			s.isrCount = 0;
+			break;
+		case 7:
+			s.osr = v;
+			s.osrCount = 0;
+			break;
+		}
+		return true;
+	}
+	case 6: { // IRQ
+		bool clr = (ins >> 6) & 1;
+		bool wait = (ins >> 5) & 1;
+		uint idx = irqIndex(arg2, smi);
+		if (clr) {
+			p.irqFlags &= ~(1u << idx);
+			return true;
+		}
+		if (!s.irqWaiting) {
+			p.irqFlags |= 1u << idx;
+			if (!wait) return true;
+			s.irqWaiting = true;
+			return false;
+		}
+		if (p.irqFlags & (1u << idx)) return false;
+		s.irqWaiting = false;
+		return true;
+	}
+	case 7: { // SET
+		switch (arg1) {
+		case 0: {
+			uint base = (s.pinctrl & PIO_SM0_PINCTRL_SET_BASE_BITS) >> PIO_SM0_PINCTRL_SET_BASE_LSB;
+			uint count = (s.pinctrl & PIO_SM0_PINCTRL_SET_COUNT_BITS) >> PIO_SM0_PINCTRL_SET_COUNT_LSB;
+			pioSetPins(p, base, count, arg2, false);
+			break;
+		}
+		case 1:
+			s.x = arg2;
+			break;
+		case 2:
+			s.y = arg2;
+			break;
+		case 4: {
+			uint base = (s.pinctrl & PIO_SM0_PINCTRL_SET_BASE_BITS) >> PIO_SM0_PINCTRL_SET_BASE_LSB;
+			uint count = (s.pinctrl & PIO_SM0_PINCTRL_SET_COUNT_BITS) >> PIO_SM0_PINCTRL_SET_COUNT_LSB;
+			pioSetPins(p, base, count, arg2, true);
+			break;
+		}
+		}
+		return true;
+	}
+	}
+	return true;
+}
+
+void smExec(Pio &p, uint smi, uint16_t instr) {
+	Sm &s = p.sm[smi];
+	if (s.enabled) {
+		s.execPending = true;
+		s.execInstr = instr;
+		s.execStalled = true;
+		return;
+	}
+	// a disabled state machine executes the instruction immediately
+	bool jumped;
+	s.execStalled = !execute(p, smi, instr, jumped);
+}
+
+static void smClock(Pio &p, uint smi) {
+	Sm &s = p.sm[smi];
+	if (s.delay && !s.execPending) {
+		s.delay--;
+		return;
+	}
+	bool fromExec = s.execPending;
+	uint16_t ins = fromExec ? s.execInstr : p.mem[s.pc];
+	s.execPending = false;
+	applySideset(p, s, ins);
+	bool jumped;
+	if (!execute(p, smi, ins, jumped)) {
+		if (fromExec) s.execPending = true;
+		return;
+	}
+	if (fromExec) {
+		s.execStalled = false;
+		s.delay = 0;
+		return;
+	}
+	if (!jumped) advancePc(s);
+	s.delay = delayOf(s, ins);
+}
+
+// ---- register decoding ----
+
+static uint32_t pioFstat(const Pio &p) {
+	uint32_t v = 0;
+	for (uint i = 0; i < NUM_PIO_STATE_MACHINES; i++) {
+		const Sm &s = p.sm[i];
+		if (s.rx.count >= s.rxCap()) v |= 1u << i;
+		if (!s.rx.count) v |= 1u << (8 + i);
+		if (s.tx.count >= s.txCap()) v |= 1u << (16 + i);
+		if (!s.tx.count) v |= 1u << (24 + i);
+	}
+	return v;
+}
+
+static uint32_t pioIntr(const Pio &p) {
+	uint32_t v = 0;
+	for (uint i = 0; i < NUM_PIO_STATE_MACHINES; i++) {
+		if (p.sm[i].rx.count) v |= 1u << i;
+		if (p.sm[i].tx.count < p.sm[i].txCap()) v |= 1u << (4 + i);
+	}
+	v |= (uint32_t)(p.irqFlags & 0xF) << 8;
+	return v;
+}
+
+static void pioTxWrite(Pio &p, uint smi, uint32_t v) {
+	Sm &s = p.sm[smi];
+	if (s.tx.count >= s.txCap()) {
+		p.fdebug |= 1u << (PIO_FDEBUG_TXOVER_LSB + smi);
+		return;
+	}
+	s.tx.push(v);
+}
+
+static uint32_t pioRxRead(Pio &p, uint smi) {
+	Sm &s = p.sm[smi];
+	if (!s.rx.count) {
+		p.fdebug |= 1u << (PIO_FDEBUG_RXUNDER_LSB + smi);
+		return 0;
+	}
+	return s.rx.pop();
+}
+
+static bool pioReg(const volatile void *reg, uint &pioIdx, uint &word) {
+	uintptr_t a = (uintptr_t)reg;
+	uintptr_t base = (uintptr_t)&pio_emu_hw[0];
+	if (a < base || a >= base + sizeof(pio_emu_hw)) return false;
+	pioIdx = (a - base) / sizeof(pio_hw_t);
+	word = ((a - base) % sizeof(pio_hw_t)) / 4;
+	return true;
+}
+
+static bool dmaReg(const volatile void *reg, uint &word) {
+	uintptr_t a = (uintptr_t)reg;
+	uintptr_t base = (uintptr_t)&dma_emu_hw;
+	if (a < base || a >= base + sizeof(dma_emu_hw)) return false;
+	word = (a - base) / 4;
+	return true;
+}
+
+#define PIO_WORD(field) (offsetof(pio_hw_t, field) / 4)
+#define DMA_WORD(field) (offsetof(dma_hw_t, field) / 4)
+
+static uint32_t pioRegRead(uint pi, uint w) {
+	Pio &p = pios[pi];
+	if (w == PIO_WORD(ctrl)) {
+		uint32_t v = 0;
+		for (uint i = 0; i < NUM_PIO_STATE_MACHINES; i++)
+			if (p.sm[i].enabled) v |= 1u << i;
+		return v;
+	}
+	if (w == PIO_WORD(fstat)) return pioFstat(p);
+	if (w == PIO_WORD(fdebug)) return p.fdebug;
+	if (w == PIO_WORD(flevel)) {
+		uint32_t v = 0;
+		for (uint i = 0; i < NUM_PIO_STATE_MACHINES; i++)
+			v |= ((p.sm[i].tx.count & 0xF) | ((p.sm[i].rx.count & 0xF) << 4)) << (8 * i);
+		return v;
+	}
+	if (w >= PIO_WORD(rxf) && w < PIO_WORD(rxf) + NUM_PIO_STATE_MACHINES) return pioRxRead(p, w - PIO_WORD(rxf));
+	if (w == PIO_WORD(irq)) return p.irqFlags;
+	if (w == PIO_WORD(input_sync_bypass)) return p.syncBypass;
+	if (w >= PIO_WORD(sm) && w < PIO_WORD(intr)) {
+		uint smi = (w - PIO_WORD(sm)) / 6;
+		uint r = (w - PIO_WORD(sm)) % 6;
+		Sm &s = p.sm[smi];
+		switch (r) {
+		case 0:
+			return s.clkdiv;
+		case 1:
+			return s.execctrl | (s.execStalled ? 0x80000000u : 0);
+		case 2:
+			return s.shiftctrl;
+		case 3:
+			return s.pc;
+		case 4:
+			return s.execPending ? s.execInstr : p.mem[s.pc];
+		case 5:
+			return s.pinctrl;
+		}
+	}
+	if (w == PIO_WORD(intr)) return pioIntr(p);
+	if (w == PIO_WORD(inte0)) return p.inte[0];
+	if (w == PIO_WORD(intf0)) return p.intf[0];
+	if (w == PIO_WORD(ints0)) return (pioIntr(p) & p.inte[0]) | p.intf[0];
+	if (w == PIO_WORD(inte1)) return p.inte[1];
+	if (w == PIO_WORD(intf1)) return p.intf[1];
+	if (w == PIO_WORD(ints1)) return (pioIntr(p) & p.inte[1]) | p.intf[1];
+	return 0;
+}
+
+static void pioRegWrite(uint pi, uint w, uint32_t v) {
+	Pio &p = pios[pi];
+	PIO pio = &pio_emu_hw[pi];
+	if (w == PIO_WORD(ctrl)) {
+		for (uint i = 0; i < NUM_PIO_STATE_MACHINES; i++) {
+			if (v & (1u << (4 + i))) smRestart(p.sm[i]);
+			if (v & (1u << (8 + i))) p.sm[i].divAcc = 0;
+			p.sm[i].enabled = v & (1u << i);
+		}
+	} else if (w == PIO_WORD(fdebug)) {
+		p.fdebug &= ~v;
+	} else if (w >= PIO_WORD(txf) && w < PIO_WORD(txf) + NUM_PIO_STATE_MACHINES) {
+		pioTxWrite(p, w - PIO_WORD(txf), v);
+	} else if (w == PIO_WORD(irq)) {
+		p.irqFlags &= ~v;
+	} else if (w == PIO_WORD(irq_force)) {
+		p.irqFlags |= v;
+	} else if (w == PIO_WORD(input_sync_bypass)) {
+		p.syncBypass = v;
+	} else if (w >= PIO_WORD(instr_mem) && w < PIO_WORD(instr_mem) + PIO_INSTRUCTION_COUNT) {
+		p.mem[w - PIO_WORD(instr_mem)] = v;
+	} else if (w >= PIO_WORD(sm) && w < PIO_WORD(intr)) {
+		uint smi = (w - PIO_WORD(sm)) / 6;
+		uint r = (w - PIO_WORD(sm)) % 6;
+		Sm &s = p.sm[smi];
+		switch (r) {
+		case 0:
+			s.clkdiv = v;
+			break;
+		case 1:
+			s.execctrl = v & 0x7fffffffu;
+			break;
+		case 2:
+			if ((v ^ s.shiftctrl) & (PIO_SM0_SHIFTCTRL_FJOIN_RX_BITS | PIO_SM0_SHIFTCTRL_FJOIN_TX_BITS)) {
+				s.tx.clear();
+				s.rx.clear();
+			}
+			s.shiftctrl = v;
+			break;
+		case 4:
+			smExec(p, smi, v);
+			break;
+		case 5:
+			s.pinctrl = v;
+			break;
+		}
+	} else if (w == PIO_WORD(inte0)) {
+		p.inte[0] = v;
+	} else if (w == PIO_WORD(intf0)) {
+		p.intf[0] = v;
+	} else if (w == PIO_WORD(inte1)) {
+		p.inte[1] = v;
+	} else if (w == PIO_WORD(intf1)) {
+		p.intf[1] = v;
+	}
+	(void)pio;
+}
+
+static uintptr_t withLow32(uintptr_t old, uint32_t v) {
+	if (sizeof(uintptr_t) == 4) return v;
+	uintptr_t hi = old ? old : (uintptr_t)&dma_emu_hw;
+	return (hi & ~(uintptr_t)0xFFFFFFFFu) | v;
+}
+
+static uint32_t dmaRegRead(uint w) {
+	const uint chWords = sizeof(dma_channel_hw_t) / 4;
+	if (w < NUM_DMA_CHANNELS * chWords) {
+		DmaCh &c = dmaCh[w / chWords];
+		uint32_t ctrl = c.ctrl | (c.busy ? DMA_CH0_CTRL_TRIG_BUSY_BITS : 0);
+		switch (w % chWords) {
+		case 0:
+		case 5:
+		case 10:
+		case 15:
+			return (uint32_t)c.read;
+		case 1:
+		case 6:
+		case 11:
+		case 13:
+			return (uint32_t)c.write;
+		case 2:
+		case 7:
+		case 9:
+		case 14:
+			return c.count;
+		default:
+			return ctrl;
+		}
+	}
+	if (w == DMA_WORD(intr)) return dmaIntr;
+	if (w == DMA_WORD(inte0)) return dmaInte[0];
+	if (w == DMA_WORD(intf0)) return dmaIntf[0];
+	if (w == DMA_WORD(ints0)) return (dmaIntr & dmaInte[0]) | dmaIntf[0];
+	if (w == DMA_WORD(inte1)) return dmaInte[1];
+	if (w == DMA_WORD(intf1)) return dmaIntf[1];
+	if (w == DMA_WORD(ints1)) return (dmaIntr & dmaInte[1]) | dmaIntf[1];
+	if (w >= DMA_WORD(timer) && w < DMA_WORD(timer) + NUM_DMA_TIMERS) {
+		DmaTimer &t = dmaTimers[w - DMA_WORD(timer)];
+		return ((uint32_t)t.num << 16) | t.den;
+	}
+	return 0;
+}
+
+static void dmaRegWrite(uint w, uint32_t v) {
+	const uint chWords = sizeof(dma_channel_hw_t) / 4;
+	if (w < NUM_DMA_CHANNELS * chWords) {
+		uint ch = w / chWords;
+		DmaCh &c = dmaCh[ch];
+		bool trig = false;
+		switch (w % chWords) {
+		case 0:
+		case 5:
+		case 10:
+		case 15:
+			c.read = withLow32(c.read, v);
+			trig = (w % chWords) == 15;
+			break;
+		case 1:
+		case 6:
+		case 13:
+		case 11:
+			c.write = withLow32(c.write, v);
+			trig = (w % chWords) == 11;
+			break;
+		case 2:
+		case 9:
+		case 14:
+		case 7:
+			c.reload = v;
+			trig = (w % chWords) == 7;
+			break;
+		case 3:
+		case 4:
+		case 8:
+		case 12:
+			c.ctrl = v & ~DMA_CH0_CTRL_TRIG_BUSY_BITS;
+			trig = (w % chWords) == 3;
+			break;
+		}
+		if (trig && v) dmaTrigger(ch);
+		return;
+	}
+	if (w == DMA_WORD(intr) || w == DMA_WORD(ints0) || w == DMA_WORD(ints1)) dmaIntr &= ~v;
+	else if (w == DMA_WORD(inte0)) dmaInte[0] = v;
+	else if (w == DMA_WORD(intf0)) dmaIntf[0] = v;
+	else if (w == DMA_WORD(inte1)) dmaInte[1] = v;
+	else if (w == DMA_WORD(intf1)) dmaIntf[1] = v;
+	else if (w >= DMA_WORD(timer) && w < DMA_WORD(timer) + NUM_DMA_TIMERS) {
+		DmaTimer &t = dmaTimers[w - DMA_WORD(timer)];
+		t.num = v >> 16;
+		t.den = v & 0xFFFF;
+	} else if (w == DMA_WORD(multi_channel_trigger)) {
+		for (uint i = 0; i < NUM_DMA_CHANNELS; i++)
+			if (v & (1u << i)) dmaTrigger(i);
+	} else if (w == DMA_WORD(abort)) {
+		for (uint i = 0; i < NUM_DMA_CHANNELS; i++)
+			if (v & (1u << i)) dmaAbort(i);
+	}
+}
+
+static uint32_t busRead(uintptr_t addr, uint size) {
+	uint pi, w;
+	if (pioReg((const void *)addr, pi, w)) return pioRegRead(pi, w);
+	if (dmaReg((const void *)addr, w)) return dmaRegRead(w);
+	uint32_t v = 0;
+	memcpy(&v, (const void *)addr, size);
+	return v;
+}
+
+static void busWrite(uintptr_t addr, uint size, uint32_t v) {
+	uint pi, w;
+	if (pioReg((const void *)addr, pi, w)) {
+		if (size < 4) v = size == 1 ? (v & 0xFF) * 0x01010101u : (v & 0xFFFF) * 0x00010001u;
+		pioRegWrite(pi, w, v);
+		return;
+	}
+	if (dmaReg((const void *)addr, w)) {
+		dmaRegWrite(w, v);
+		return;
+	}
+	memcpy((void *)addr, &v, size);
+}
+
+void dmaTrigger(uint ch) {
+	DmaCh &c = dmaCh[ch];
+	if (!(c.ctrl & DMA_CH0_CTRL_TRIG_EN_BITS)) return;
+	c.count = c.reload;
+	c.busy = true;
+	if (!c.count) {
+		c.busy = false;
+		if (!(c.ctrl & DMA_CH0_CTRL_TRIG_IRQ_QUIET_BITS)) dmaIntr |= 1u << ch;
+	}
+}
+
+void dmaAbort(uint ch) {
+	dmaCh[ch].busy = false;
+	dmaCh[ch].count = 0;
+}
+
+void dmaTimerRestart(uint timer) {
+	timerAcc[timer] = 0;
+	timerCredits[timer] = 0;
+}
+
+static bool dreqReady(uint treq, uint &timer) {
+	timer = NUM_DMA_TIMERS;
+	if (treq == DREQ_FORCE) return true;
+	if (treq >= DREQ_DMA_TIMER0 && treq < DREQ_DMA_TIMER0 + NUM_DMA_TIMERS) {
+		timer = treq - DREQ_DMA_TIMER0;
+		return timerCredits[timer] > 0;
+	}
+	if (treq < 8u * NUM_PIOS) {
+		Pio &p = pios[treq / 8];
+		Sm &s = p.sm[treq & 3];
+		if (treq & 4) return s.rx.count > 0;
+		return s.tx.count < s.txCap();
+	}
+	return false;
+}
+
+static uintptr_t ringStep(uintptr_t addr, uint size, bool ring, uint ringBits) {
+	if (!ring || !ringBits) return addr + size;
+	uintptr_t mask = ((uintptr_t)1 << ringBits) - 1;
+	return (addr & ~mask) | ((addr + size) & mask);
+}
+
+static void dmaStep() {
+	for (uint t = 0; t < NUM_DMA_TIMERS; t++) {
+		DmaTimer &tm = dmaTimers[t];
+		if (!tm.num || !tm.den) continue;
+		timerAcc[t] += tm.num;
+		if (timerAcc[t] >= tm.den) {
+			timerAcc[t] -= tm.den;
+			if (timerCredits[t] < 63) timerCredits[t]++; // 6 bit DREQ counter
+		}
+	}
+	// one bus transfer per cycle, round robin between the channels
+	for (uint k = 0; k < NUM_DMA_CHANNELS; k++) {
+		uint ch = (dmaRoundRobin + k) % NUM_DMA_CHANNELS;
+		DmaCh &c = dmaCh[ch];
+		if (!c.busy) continue;
+		uint treq = (c.ctrl & DMA_CH0_CTRL_TRIG_TREQ_SEL_BITS) >> DMA_CH0_CTRL_TRIG_TREQ_SEL_LSB;
+		uint timer;
+		if (!dreqReady(treq, timer)) continue;
+		if (timer < NUM_DMA_TIMERS) timerCredits[timer]--;
+		uint size = 1u << ((c.ctrl & DMA_CH0_CTRL_TRIG_DATA_SIZE_BITS) >> DMA_CH0_CTRL_TRIG_DATA_SIZE_LSB);
+		uint32_t v = busRead(c.read, size);
+		if (c.ctrl & DMA_CH0_CTRL_TRIG_BSWAP_BITS) v = size == 4 ? __builtin_bswap32(v) : size == 2 ? __builtin_bswap16(v) : v;
+		busWrite(c.write, size, v);
+		bool ringWrite = c.ctrl & DMA_CH0_CTRL_TRIG_RING_SEL_BITS;
+		uint ringBits = (c.ctrl & DMA_CH0_CTRL_TRIG_RING_SIZE_BITS) >> DMA_CH0_CTRL_TRIG_RING_SIZE_LSB;
+		if (c.ctrl & DMA_CH0_CTRL_TRIG_INCR_READ_BITS) c.read = ringStep(c.read, size, !ringWrite, ringBits);
+		if (c.ctrl & DMA_CH0_CTRL_TRIG_INCR_WRITE_BITS) c.write = ringStep(c.write, size, ringWrite, ringBits);
+		if (--c.count == 0 && c.busy) {
+			c.busy = false;
+			if (!(c.ctrl & DMA_CH0_CTRL_TRIG_IRQ_QUIET_BITS)) dmaIntr |= 1u << ch;
+			uint chain = (c.ctrl & DMA_CH0_CTRL_TRIG_CHAIN_TO_BITS) >> DMA_CH0_CTRL_TRIG_CHAIN_TO_LSB;
+			if (chain != ch) dmaTrigger(chain);
+		}
+		dmaRoundRobin = ch + 1;
+		break;
+	}
+}
+
+// ---- interrupts ----
+
+static void runHandlers(uint num) {
+	IrqLine &l = irqLines[num];
+	if (l.exclusive) l.exclusive();
+	for (size_t i = 0; i < l.shared.size(); i++)
+		l.shared[i]();
+}
+
+static bool irqPending(uint num) {
+	for (uint i = 0; i < NUM_PIOS; i++) {
+		for (uint n = 0; n < 2; n++) {
+			if (num == PIO0_IRQ_0 + 2 * i + n) {
+				Pio &p = pios[i];
+				return (pioIntr(p) & p.inte[n]) | p.intf[n];
+			}
+		}
+	}
+	if (num == DMA_IRQ_0) return (dmaIntr & dmaInte[0]) | dmaIntf[0];
+	if (num == DMA_IRQ_1) return (dmaIntr & dmaInte[1]) | dmaIntf[1];
+	return false;
+}
+
+static void serviceIrqs() {
+	if (inHandler || interruptsDisabled) return;
+	inHandler = true;
+	for (uint num = 0; num < NUM_IRQS; num++) {
+		IrqLine &l = irqLines[num];
+		if (!l.enabled || (!l.exclusive && l.shared.empty())) continue;
+		// level triggered: keep calling while the source is pending, with a guard against handlers that never clear it
+		for (int guard = 0; guard < 64 && irqPending(num); guard++)
+			runHandlers(num);
+	}
+	inHandler = false;
+}
+
+// ---- main loop ----
+
+static void stepOne() {
+	for (size_t i = 0; i < hooks.size(); i++)
+		hooks[i].fn(hooks[i].ctx, cycle);
+	refreshGpio();
+	for (uint pi = 0; pi < NUM_PIOS; pi++) {
+		Pio &p = pios[pi];
+		for (uint smi = 0; smi < NUM_PIO_STATE_MACHINES; smi++) {
+			Sm &s = p.sm[smi];
+			if (!s.enabled) continue;
+			uint32_t div = s.clkdiv >> 8; // 16.8 fixed point
+			if (!div) div = 1u << 24;
+			s.divAcc += 256;
+			if (s.divAcc < div) continue;
+			s.divAcc -= div;
+			smClock(p, smi);
+		}
+	}
+	dmaStep();
+	refreshGpio();
+	sync2 = sync1;
+	sync1 = levels;
+	cycle++;
+	serviceIrqs();
+}
+
+void waitUntil(bool (*cond)(void *), void *ctx, const char *what) {
+	uint64_t limit = (uint64_t)sysHz; // one emulated second
+	for (uint64_t i = 0; i < limit; i++) {
+		if (cond(ctx)) return;
+		stepOne();
+	}
+	fprintf(stderr, "pio_emu: %s did not complete within 1s of emulated time\n", what);
+	abort();
+}
+
+static uint64_t usBase = 0;
+static uint64_t usBaseCycle = 0;
+
+} // namespace pio_emu
+
+using namespace pio_emu;
+
+extern "C" {
+
+uint32_t pio_emu_reg_read(const volatile void *reg) {
+	uint pi, w;
+	if (pioReg(reg, pi, w)) return pioRegRead(pi, w);
+	if (dmaReg(reg, w)) return dmaRegRead(w);
+	return 0;
+}
+
+void pio_emu_reg_write(volatile void *reg, uint32_t value) {
+	uint pi, w;
+	if (pioReg(reg, pi, w)) pioRegWrite(pi, w, value);
+	else if (dmaReg(reg, w)) dmaRegWrite(w, value);
+}
+
+void pio_emu_reset(void) {
+	for (uint i = 0; i < NUM_PIOS; i++)
+		pios[i] = Pio();
+	for (uint i = 0; i < NUM_BANK0_GPIOS; i++)
+		gpios[i] = Gpio();
+	for (uint i = 0; i < NUM_DMA_CHANNELS; i++)
+		dmaCh[i] = DmaCh();
+	for (uint i = 0; i < NUM_DMA_TIMERS; i++) {
+		dmaTimers[i] = DmaTimer();
+		timerAcc[i] = timerCredits[i] = 0;
+	}
+	dmaIntr = dmaInte[0] = dmaInte[1] = dmaIntf[0] = dmaIntf[1] = 0;
+	for (uint i = 0; i < NUM_IRQS; i++)
+		irqLines[i] = IrqLine();
+	interruptsDisabled = false;
+	inHandler = false;
+	hooks.clear();
+	trace.clear();
+	traceMask = 0;
+	cycle = 0;
+	usBase = usBaseCycle = 0;
+	sysHz = SYS_CLK_HZ;
+	levels = sync1 = sync2 = 0;
+	gpioDirty = true;
+	refreshGpio();
+}
+
+void pio_emu_set_sys_clock(uint32_t hz) {
+	usBase += (cycle - usBaseCycle) * 1000000ull / sysHz;
+	usBaseCycle = cycle;
+	sysHz = hz;
+}
+
+void pio_emu_set_time_us(uint64_t us) {
+	usBase = us;
+	usBaseCycle = cycle;
+}
+
+uint64_t pio_emu_cycles(void) {
+	return cycle;
+}
+
+void pio_emu_step(uint64_t cycles) {
+	for (uint64_t i = 0; i < cycles; i++)
+		stepOne();
+}
+
+void pio_emu_run_us(uint32_t us) {
+	pio_emu_step((uint64_t)us * sysHz / 1000000u);
+}
+
+bool pio_emu_run_until(bool (*cond)(void *ctx), void *ctx, uint64_t max_cycles) {
+	for (uint64_t i = 0; i < max_cycles; i++) {
+		if (cond(ctx)) return true;
+		stepOne();
+	}
+	return cond(ctx);
+}
+
+int pio_emu_add_hook(pio_emu_hook_t hook, void *ctx) {
+	hooks.push_back({hook, ctx, nextHookId});
+	return nextHookId++;
+}
+
+void pio_emu_remove_hook(int id) {
+	for (size_t i = 0; i < hooks.size(); i++) {
+		if (hooks[i].id == id) {
+			hooks.erase(hooks.begin() + i);
+			return;
+		}
+	}
+}
+
+void pio_emu_gpio_drive(uint pin, bool level) {
+	gpios[pin].extDriven = true;
+	gpios[pin].extLevel = level;
+	gpioDirty = true;
+}
+
+void pio_emu_gpio_release(uint pin) {
+	gpios[pin].extDriven = false;
+	gpioDirty = true;
+}
+
+bool pio_emu_gpio_level(uint pin) {
+	refreshGpio();
+	return (levels >> pin) & 1;
+}
+
+bool pio_emu_gpio_is_output(uint pin) {
+	const Gpio &g = gpios[pin];
+	if (g.func >= GPIO_FUNC_PIO0 && g.func < GPIO_FUNC_PIO0 + NUM_PIOS) {
+		const Pio &p = pios[g.func - GPIO_FUNC_PIO0];
+		uint rel = pin - p.gpioBase;
+		return rel < 32 && (p.outDir & (1u << rel));
+	}
+	return g.func == GPIO_FUNC_SIO && g.sioOe;
+}
+
+void pio_emu_trace_pins(uint64_t pin_mask) {
+	traceMask = pin_mask;
+}
+
+size_t pio_emu_trace_count(void) {
+	return trace.size();
+}
+
+const pio_emu_edge_t *pio_emu_trace_data(void) {
+	return trace.data();
+}
+
+void pio_emu_trace_clear(void) {
+	trace.clear();
+}
+
+uint pio_emu_tx_level(PIO pio, uint sm) {
+	return pioOf(pio).sm[sm].tx.count;
+}
+
+uint32_t pio_emu_tx_peek(PIO pio, uint sm, uint index) {
+	return pioOf(pio).sm[sm].tx.peek(index);
+}
+
+uint pio_emu_rx_level(PIO pio, uint sm) {
+	return pioOf(pio).sm[sm].rx.count;
+}
+
+uint32_t pio_emu_rx_peek(PIO pio, uint sm, uint index) {
+	return pioOf(pio).sm[sm].rx.peek(index);
+}
+
+uint32_t pio_emu_sm_x(PIO pio, uint sm) {
+	return pioOf(pio).sm[sm].x;
+}
+
+uint32_t pio_emu_sm_y(PIO pio, uint sm) {
+	return pioOf(pio).sm[sm].y;
+}
+
+uint32_t pio_emu_sm_isr(PIO pio, uint sm) {
+	return pioOf(pio).sm[sm].isr;
+}
+
+uint32_t pio_emu_sm_osr(PIO pio, uint sm) {
+	return pioOf(pio).sm[sm].osr;
+}
+
+uint pio_emu_used_instructions(PIO pio) {
+	return __builtin_popcount(pioOf(pio).usedMask);
+}
+
+// ---- pico/time.h ----
+
+uint64_t time_us_64(void) {
+	return usBase + (cycle - usBaseCycle) * 1000000ull / sysHz;
+}
+
+uint32_t time_us_32(void) {
+	return (uint32_t)time_us_64();
+}
+
+void busy_wait_cycles(uint32_t cycles) {
+	pio_emu_step(cycles);
+}
+
+void busy_wait_at_least_cycles(uint32_t minimum_cycles) {
+	pio_emu_step(minimum_cycles);
+}
+
+void busy_wait_us_32(uint32_t delay_us) {
+	pio_emu_run_us(delay_us);
+}
+
+void busy_wait_us(uint64_t delay_us) {
+	uint64_t end = time_us_64() + delay_us;
+	while (time_us_64() < end)
+		stepOne();
+}
+
+void sleep_us(uint64_t us) {
+	busy_wait_us(us);
+}
+
+void sleep_ms(uint32_t ms) {
+	busy_wait_us((uint64_t)ms * 1000u);
+}
+
+// ---- hardware/clocks.h ----
+
+uint32_t clock_get_hz(enum clock_index clk_index) {
+	if (clk_index == clk_ref) return 12000000;
+	if (clk_index == clk_usb || clk_index == clk_adc) return 48000000;
+	return sysHz;
+}
+
+bool set_sys_clock_khz(uint32_t freq_khz, bool required) {
+	(void)required;
+	pio_emu_set_sys_clock(freq_khz * 1000u);
+	return true;
+}
+
+// ---- hardware/irq.h, hardware/sync.h ----
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+	irqLines[num].exclusive = handler;
+}
+
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority) {
+	(void)order_priority;
+	irqLines[num].shared.push_back(handler);
+}
+
+void irq_remove_handler(uint num, irq_handler_t handler) {
+	IrqLine &l = irqLines[num];
+	if (l.exclusive == handler) l.exclusive = nullptr;
+	for (size_t i = 0; i < l.shared.size(); i++) {
+		if (l.shared[i] == handler) {
+			l.shared.erase(l.shared.begin() + i);
+			return;
+		}
+	}
+}
+
+bool irq_has_shared_handler(uint num) {
+	return !irqLines[num].shared.empty();
+}
+
+void irq_set_enabled(uint num, bool enabled) {
+	irqLines[num].enabled = enabled;
+}
+
+bool irq_is_enabled(uint num) {
+	return irqLines[num].enabled;
+}
+
+void irq_set_priority(uint num, uint8_t hardware_priority) {
+	(void)num;
+	(void)hardware_priority;
+}
+
+uint32_t save_and_disable_interrupts(void) {
+	uint32_t prev = interruptsDisabled;
+	interruptsDisabled = true;
+	return prev;
+}
+
+void restore_interrupts(uint32_t status) {
+	interruptsDisabled = status;
+}
+
+} // extern "C"
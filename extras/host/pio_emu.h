@@ -0,0 +1,91 @@
+#ifndef PIO_EMU_H
+#define PIO_EMU_H
+
+#include "hardware/pio.h"
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief A level change on a traced GPIO
+ */
+typedef struct {
+	uint64_t cycle; /// system clock cycle of the change
+	uint8_t pin; /// GPIO number
+	bool level; /// new level
+} pio_emu_edge_t;
+
+/**
+ * @brief Called once per system clock cycle, before the state machines are clocked
+ *
+ * Use it to model devices on the pins, e.g. an ESC that answers with telemetry.
+ */
+typedef void (*pio_emu_hook_t)(void *ctx, uint64_t cycle);
+
+/// @brief Reset all emulated hardware (PIO, DMA, GPIO, IRQ, clocks, time) to power-on state
+void pio_emu_reset(void);
+
+/// @brief Set the emulated system clock (default SYS_CLK_HZ)
+void pio_emu_set_sys_clock(uint32_t hz);
+
+/// @brief Set the microsecond timer (time_us_64), e.g. close to the wraparound of time_us_32
+void pio_emu_set_time_us(uint64_t us);
+
+/// @brief Number of emulated system clock cycles since reset
+uint64_t pio_emu_cycles(void);
+
+/// @brief Advance the emulation by the given number of system clock cycles
+void pio_emu_step(uint64_t cycles);
+
+/// @brief Advance the emulation by the given number of microseconds
+void pio_emu_run_us(uint32_t us);
+
+/**
+ * @brief Advance the emulation until a condition is met
+ *
+ * @param cond checked after every cycle
+ * @param max_cycles upper bound for the emulated time
+ * @return true if the condition was met, false on timeout
+ */
+bool pio_emu_run_until(bool (*cond)(void *ctx), void *ctx, uint64_t max_cycles);
+
+/// @brief Register a per-cycle hook, returns its id
+int pio_emu_add_hook(pio_emu_hook_t hook, void *ctx);
+void pio_emu_remove_hook(int id);
+
+/// @brief Drive a GPIO from outside (like a connected device). The PIO wins if it drives the pin as well.
+void pio_emu_gpio_drive(uint pin, bool level);
+/// @brief Stop driving a GPIO from outside, the pulls take over again
+void pio_emu_gpio_release(uint pin);
+/// @brief Current pad level of a GPIO
+bool pio_emu_gpio_level(uint pin);
+/// @brief Whether the pin is currently driven as an output (by a PIO or SIO)
+bool pio_emu_gpio_is_output(uint pin);
+
+/// @brief Record level changes of the pins in the mask (bit n = GPIO n)
+void pio_emu_trace_pins(uint64_t pin_mask);
+size_t pio_emu_trace_count(void);
+const pio_emu_edge_t *pio_emu_trace_data(void);
+void pio_emu_trace_clear(void);
+
+/// @brief FIFO contents, index 0 is the oldest entry
+uint pio_emu_tx_level(PIO pio, uint sm);
+uint32_t pio_emu_tx_peek(PIO pio, uint sm, uint index);
+uint pio_emu_rx_level(PIO pio, uint sm);
+uint32_t pio_emu_rx_peek(PIO pio, uint sm, uint index);
+
+/// @brief Scratch registers of a state machine
+uint32_t pio_emu_sm_x(PIO pio, uint sm);
+uint32_t pio_emu_sm_y(PIO pio, uint sm);
+uint32_t pio_emu_sm_isr(PIO pio, uint sm);
+uint32_t pio_emu_sm_osr(PIO pio, uint sm);
+/// @brief Number of instructions used in the instruction memory of a PIO block
+uint pio_emu_used_instructions(PIO pio);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
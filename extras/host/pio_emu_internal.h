@@ -0,0 +1,118 @@
+#ifndef PIO_EMU_INTERNAL_H
+#define PIO_EMU_INTERNAL_H
+
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "pio_emu.h"
+
+namespace pio_emu {
+
+struct Fifo {
+	uint32_t data[8];
+	uint8_t head = 0;
+	uint8_t count = 0;
+
+	void clear() { head = count = 0; }
+	void push(uint32_t v) {
+		data[(head + count) & 7] = v;
+		count++;
+	}
+	uint32_t pop() {
+		uint32_t v = data[head];
+		head = (head + 1) & 7;
+		count--;
+		return v;
+	}
+	uint32_t peek(uint i) const { return data[(head + i) & 7]; }
+};
+
+struct Sm {
+	bool claimed = false;
+	bool enabled = false;
+	uint32_t clkdiv = 1u << 16;
+	uint32_t execctrl = 0;
+	uint32_t shiftctrl = 0;
+	uint32_t pinctrl = 0;
+	uint32_t divAcc = 0;
+	uint8_t pc = 0;
+	uint32_t x = 0, y = 0, isr = 0, osr = 0;
+	uint8_t isrCount = 0;
+	uint8_t osrCount = 32;
+	uint32_t delay = 0;
+	bool execPending = false;
+	uint16_t execInstr = 0;
+	bool execStalled = false;
+	bool irqWaiting = false;
+	Fifo tx, rx;
+
+	uint txCap() const;
+	uint rxCap() const;
+	uint pushThresh() const;
+	uint pullThresh() const;
+};
+
+struct Pio {
+	uint16_t mem[PIO_INSTRUCTION_COUNT] = {};
+	uint32_t usedMask = 0;
+	Sm sm[NUM_PIO_STATE_MACHINES];
+	uint32_t outVal = 0;
+	uint32_t outDir = 0;
+	uint8_t irqFlags = 0;
+	uint32_t fdebug = 0;
+	uint32_t inte[2] = {0, 0};
+	uint32_t intf[2] = {0, 0};
+	uint32_t syncBypass = 0;
+	uint gpioBase = 0; // GPIO of PIO pin 0, see pio_set_gpio_base
+};
+
+struct Gpio {
+	uint8_t func = GPIO_FUNC_NULL;
+	bool pullUp = false;
+	bool pullDown = true;
+	bool sioOut = false;
+	bool sioOe = false;
+	bool extDriven = false;
+	bool extLevel = false;
+};
+
+struct DmaCh {
+	bool claimed = false;
+	bool busy = false;
+	uintptr_t read = 0;
+	uintptr_t write = 0;
+	uint32_t count = 0;
+	uint32_t reload = 0;
+	uint32_t ctrl = 0;
+};
+
+struct DmaTimer {
+	bool claimed = false;
+	uint16_t num = 0;
+	uint16_t den = 0;
+};
+
+extern Pio pios[NUM_PIOS];
+extern Gpio gpios[NUM_BANK0_GPIOS];
+extern DmaCh dmaCh[NUM_DMA_CHANNELS];
+extern DmaTimer dmaTimers[NUM_DMA_TIMERS];
+extern uint32_t dmaIntr, dmaInte[2], dmaIntf[2];
+extern uint32_t sysHz;
+
+Pio &pioOf(PIO pio);
+void smRestart(Sm &s);
+void smExec(Pio &p, uint smi, uint16_t instr);
+void pioSetPins(Pio &p, uint base, uint count, uint32_t values, bool dirs);
+void dmaTrigger(uint ch);
+void dmaAbort(uint ch);
+void dmaTimerRestart(uint timer);
+void markGpioDirty();
+void refreshGpio();
+void waitUntil(bool (*cond)(void *), void *ctx, const char *what);
+uint32_t pinsFrom(const Pio &p, uint base);
+
+} // namespace pio_emu
+
+#endif
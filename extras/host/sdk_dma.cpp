@@ -0,0 +1,196 @@
+// Host implementation of the hardware_dma and hardware_gpio APIs on top of the emulator in pio_emu.cpp
+#include "pio_emu_internal.h"
+#include <cstdio>
+#include <cstdlib>
+
+using namespace pio_emu;
+
+extern "C" {
+
+void dma_channel_claim(uint channel) {
+	if (dmaCh[channel].claimed) {
+		fprintf(stderr, "pio_emu: DMA channel %u already claimed\n", channel);
+		abort();
+	}
+	dmaCh[channel].claimed = true;
+}
+
+void dma_claim_mask(uint32_t channel_mask) {
+	for (uint i = 0; i < NUM_DMA_CHANNELS; i++)
+		if (channel_mask & (1u << i)) dma_channel_claim(i);
+}
+
+void dma_channel_unclaim(uint channel) {
+	dmaCh[channel].claimed = false;
+}
+
+int dma_claim_unused_channel(bool required) {
+	for (uint i = 0; i < NUM_DMA_CHANNELS; i++) {
+		if (!dmaCh[i].claimed) {
+			dmaCh[i].claimed = true;
+			return i;
+		}
+	}
+	if (required) {
+		fprintf(stderr, "pio_emu: no free DMA channel\n");
+		abort();
+	}
+	return -1;
+}
+
+bool dma_channel_is_claimed(uint channel) {
+	return dmaCh[channel].claimed;
+}
+
+void dma_channel_set_config(uint channel, const dma_channel_config *config, bool trigger) {
+	if (trigger) dma_hw->ch[channel].ctrl_trig = config->ctrl;
+	else dma_hw->ch[channel].al1_ctrl = config->ctrl;
+}
+
+void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger) {
+	dmaCh[channel].read = (uintptr_t)read_addr;
+	if (trigger) dmaTrigger(channel);
+}
+
+void dma_channel_set_write_addr(uint channel, volatile void *write_addr, bool trigger) {
+	dmaCh[channel].write = (uintptr_t)write_addr;
+	if (trigger) dmaTrigger(channel);
+}
+
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger) {
+	dmaCh[channel].reload = trans_count;
+	if (trigger) dmaTrigger(channel);
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+						   const volatile void *read_addr, uint transfer_count, bool trigger) {
+	dma_channel_set_read_addr(channel, read_addr, false);
+	dma_channel_set_write_addr(channel, write_addr, false);
+	dma_channel_set_trans_count(channel, transfer_count, false);
+	dma_channel_set_config(channel, config, trigger);
+}
+
+void dma_channel_start(uint channel) {
+	dmaTrigger(channel);
+}
+
+void dma_start_channel_mask(uint32_t chan_mask) {
+	for (uint i = 0; i < NUM_DMA_CHANNELS; i++)
+		if (chan_mask & (1u << i)) dmaTrigger(i);
+}
+
+void dma_channel_abort(uint channel) {
+	dmaAbort(channel);
+}
+
+bool dma_channel_is_busy(uint channel) {
+	return dmaCh[channel].busy;
+}
+
+static bool dmaIdle(void *ctx) {
+	return !dmaCh[*(uint *)ctx].busy;
+}
+
+void dma_channel_wait_for_finish_blocking(uint channel) {
+	waitUntil(dmaIdle, &channel, "dma_channel_wait_for_finish_blocking");
+}
+
+void dma_channel_set_irq0_enabled(uint channel, bool enabled) {
+	if (enabled) dmaInte[0] |= 1u << channel;
+	else dmaInte[0] &= ~(1u << channel);
+}
+
+void dma_channel_set_irq1_enabled(uint channel, bool enabled) {
+	if (enabled) dmaInte[1] |= 1u << channel;
+	else dmaInte[1] &= ~(1u << channel);
+}
+
+bool dma_channel_get_irq0_status(uint channel) {
+	return ((dmaIntr & dmaInte[0]) | dmaIntf[0]) & (1u << channel);
+}
+
+void dma_channel_acknowledge_irq0(uint channel) {
+	dmaIntr &= ~(1u << channel);
+}
+
+void dma_timer_claim(uint timer) {
+	if (dmaTimers[timer].claimed) {
+		fprintf(stderr, "pio_emu: DMA timer %u already claimed\n", timer);
+		abort();
+	}
+	dmaTimers[timer].claimed = true;
+}
+
+void dma_timer_unclaim(uint timer) {
+	dmaTimers[timer].claimed = false;
+}
+
+int dma_claim_unused_timer(bool required) {
+	for (uint i = 0; i < NUM_DMA_TIMERS; i++) {
+		if (!dmaTimers[i].claimed) {
+			dmaTimers[i].claimed = true;
+			return i;
+		}
+	}
+	if (required) {
+		fprintf(stderr, "pio_emu: no free DMA timer\n");
+		abort();
+	}
+	return -1;
+}
+
+bool dma_timer_is_claimed(uint timer) {
+	return dmaTimers[timer].claimed;
+}
+
+void dma_timer_set_fraction(uint timer, uint16_t numerator, uint16_t denominator) {
+	dmaTimers[timer].num = numerator;
+	dmaTimers[timer].den = denominator;
+	dmaTimerRestart(timer); // pending requests of the old rate are dropped
+}
+
+// ---- hardware/gpio.h ----
+
+void _gpio_init(uint gpio) {
+	gpios[gpio].sioOe = false;
+	gpios[gpio].sioOut = false;
+	gpio_set_function(gpio, GPIO_FUNC_SIO);
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn) {
+	gpios[gpio].func = fn;
+	markGpioDirty();
+}
+
+enum gpio_function gpio_get_function(uint gpio) {
+	return (enum gpio_function)gpios[gpio].func;
+}
+
+void gpio_set_pulls(uint gpio, bool up, bool down) {
+	gpios[gpio].pullUp = up;
+	gpios[gpio].pullDown = down;
+	markGpioDirty();
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+	gpios[gpio].sioOe = out;
+	markGpioDirty();
+}
+
+void gpio_put(uint gpio, bool value) {
+	gpios[gpio].sioOut = value;
+	markGpioDirty();
+}
+
+bool gpio_get(uint gpio) {
+	return pio_emu_gpio_level(gpio);
+}
+
+uint32_t gpio_get_all(void) {
+	uint32_t v = 0;
+	for (uint i = 0; i < 32 && i < NUM_BANK0_GPIOS; i++)
+		if (pio_emu_gpio_level(i)) v |= 1u << i;
+	return v;
+}
+
+} // extern "C"
@@ -0,0 +1,426 @@
+// Host implementation of the hardware_pio API on top of the emulator in pio_emu.cpp
+#include "pio_emu_internal.h"
+#include <cstdio>
+#include <cstdlib>
+
+using namespace pio_emu;
+
+static int findOffset(const Pio &p, const pio_program_t *program) {
+	if (program->length > PIO_INSTRUCTION_COUNT) return -1;
+	uint32_t mask = program->length == 32 ? 0xFFFFFFFFu : ((1u << program->length) - 1);
+	if (program->origin >= 0) {
+		if (program->origin > 32 - program->length) return -1;
+		return (p.usedMask & (mask << program->origin)) ? -1 : program->origin;
+	}
+	// the SDK places programs as high as possible
+	for (int off = 32 - program->length; off >= 0; off--) {
+		if (!(p.usedMask & (mask << off))) return off;
+	}
+	return -1;
+}
+
+static void load(Pio &p, const pio_program_t *program, uint offset) {
+	for (uint i = 0; i < program->length; i++) {
+		uint16_t ins = program->instructions[i];
+		// relocate jmp targets, like pio_add_program does
+		if ((ins >> 13) == 0) ins += offset;
+		p.mem[offset + i] = ins;
+	}
+	p.usedMask |= (program->length == 32 ? 0xFFFFFFFFu : ((1u << program->length) - 1)) << offset;
+}
+
+// absolute GPIO -> PIO pin index, relative to the GPIO base of the block
+static uint relPin(PIO pio, uint gpio) {
+	return (gpio - pioOf(pio).gpioBase) & 31;
+}
+
+extern "C" {
+
+bool pio_can_add_program(PIO pio, const pio_program_t *program) {
+	return findOffset(pioOf(pio), program) >= 0;
+}
+
+bool pio_can_add_program_at_offset(PIO pio, const pio_program_t *program, uint offset) {
+	const Pio &p = pioOf(pio);
+	if (program->origin >= 0 && (uint)program->origin != offset) return false;
+	if (offset + program->length > PIO_INSTRUCTION_COUNT) return false;
+	uint32_t mask = program->length == 32 ? 0xFFFFFFFFu : ((1u << program->length) - 1);
+	return !(p.usedMask & (mask << offset));
+}
+
+int pio_add_program(PIO pio, const pio_program_t *program) {
+	Pio &p = pioOf(pio);
+	int off = findOffset(p, program);
+	if (off < 0) {
+		fprintf(stderr, "pio_emu: no program space\n");
+		abort();
+	}
+	load(p, program, off);
+	return off;
+}
+
+int pio_add_program_at_offset(PIO pio, const pio_program_t *program, uint offset) {
+	if (!pio_can_add_program_at_offset(pio, program, offset)) {
+		fprintf(stderr, "pio_emu: no program space\n");
+		abort();
+	}
+	load(pioOf(pio), program, offset);
+	return offset;
+}
+
+void pio_remove_program(PIO pio, const pio_program_t *program, uint loaded_offset) {
+	uint32_t mask = program->length == 32 ? 0xFFFFFFFFu : ((1u << program->length) - 1);
+	pioOf(pio).usedMask &= ~(mask << loaded_offset);
+}
+
+void pio_clear_instruction_memory(PIO pio) {
+	Pio &p = pioOf(pio);
+	p.usedMask = 0;
+	for (uint i = 0; i < PIO_INSTRUCTION_COUNT; i++)
+		p.mem[i] = pio_encode_jmp(i);
+}
+
+void pio_sm_claim(PIO pio, uint sm) {
+	Sm &s = pioOf(pio).sm[sm];
+	if (s.claimed) {
+		fprintf(stderr, "pio_emu: PIO %u SM %u already claimed\n", pio_get_index(pio), sm);
+		abort();
+	}
+	s.claimed = true;
+}
+
+void pio_claim_sm_mask(PIO pio, uint sm_mask) {
+	for (uint i = 0; i < NUM_PIO_STATE_MACHINES; i++)
+		if (sm_mask & (1u << i)) pio_sm_claim(pio, i);
+}
+
+void pio_sm_unclaim(PIO pio, uint sm) {
+	pioOf(pio).sm[sm].claimed = false;
+}
+
+int pio_claim_unused_sm(PIO pio, bool required) {
+	Pio &p = pioOf(pio);
+	for (uint i = 0; i < NUM_PIO_STATE_MACHINES; i++) {
+		if (!p.sm[i].claimed) {
+			p.sm[i].claimed = true;
+			return i;
+		}
+	}
+	if (required) {
+		fprintf(stderr, "pio_emu: no free state machine\n");
+		abort();
+	}
+	return -1;
+}
+
+bool pio_sm_is_claimed(PIO pio, uint sm) {
+	return pioOf(pio).sm[sm].claimed;
+}
+
+int pio_set_gpio_base(PIO pio, uint gpio_base) {
+	// like the SDK: 0 or 16, and only on chips with more than 32 GPIOs
+	if (gpio_base != 0 && (!PICO_PIO_USE_GPIO_BASE || gpio_base != 16)) return -1;
+	pioOf(pio).gpioBase = gpio_base;
+	markGpioDirty();
+	return 0;
+}
+
+uint pio_get_gpio_base(PIO pio) {
+	return pioOf(pio).gpioBase;
+}
+
+void pio_gpio_init(PIO pio, uint pin) {
+	gpio_set_function(pin, (enum gpio_function)(GPIO_FUNC_PIO0 + pio_get_index(pio)));
+}
+
+int pio_sm_set_config(PIO pio, uint sm, const pio_sm_config *config) {
+	pio->sm[sm].clkdiv = config->clkdiv;
+	pio->sm[sm].shiftctrl = config->shiftctrl;
+	uint32_t pinctrl = config->pinctrl;
+	uint32_t execctrl = config->execctrl;
+#if PICO_PIO_USE_GPIO_BASE
+	// the config holds GPIO numbers (bit 5 in pinhi), the registers hold pins relative to the GPIO base
+	uint base = pioOf(pio).gpioBase;
+	if (base || config->pinhi) {
+		static const uint32_t lsb[5] = {PIO_SM0_PINCTRL_OUT_BASE_LSB, PIO_SM0_PINCTRL_SET_BASE_LSB, PIO_SM0_PINCTRL_IN_BASE_LSB, PIO_SM0_PINCTRL_SIDESET_BASE_LSB, PIO_SM0_EXECCTRL_JMP_PIN_LSB};
+		for (uint f = 0; f < 5; f++) {
+			uint32_t &reg = f == PIO_EMU_PINHI_JMP ? execctrl : pinctrl;
+			uint gpio = ((reg >> lsb[f]) & 31) | ((config->pinhi >> f & 1) << 5);
+			reg = (reg & ~(31u << lsb[f])) | (((gpio - base) & 31) << lsb[f]);
+		}
+	}
+#endif
+	pio->sm[sm].execctrl = execctrl;
+	pio->sm[sm].pinctrl = pinctrl;
+	return 0;
+}
+
+int pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config) {
+	pio_sm_set_enabled(pio, sm, false);
+	if (config) {
+		pio_sm_set_config(pio, sm, config);
+	} else {
+		pio_sm_config c = pio_get_default_sm_config();
+		pio_sm_set_config(pio, sm, &c);
+	}
+	pio_sm_clear_fifos(pio, sm);
+	pio->fdebug = (1u << PIO_FDEBUG_RXSTALL_LSB | 1u << PIO_FDEBUG_RXUNDER_LSB | 1u << PIO_FDEBUG_TXOVER_LSB | 1u << PIO_FDEBUG_TXSTALL_LSB) << sm;
+	pio_sm_restart(pio, sm);
+	pio_sm_clkdiv_restart(pio, sm);
+	pio_sm_exec(pio, sm, pio_encode_jmp(initial_pc));
+	return 0;
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled) {
+	pioOf(pio).sm[sm].enabled = enabled;
+}
+
+void pio_set_sm_mask_enabled(PIO pio, uint32_t mask, bool enabled) {
+	for (uint i = 0; i < NUM_PIO_STATE_MACHINES; i++)
+		if (mask & (1u << i)) pio_sm_set_enabled(pio, i, enabled);
+}
+
+void pio_sm_restart(PIO pio, uint sm) {
+	smRestart(pioOf(pio).sm[sm]);
+}
+
+void pio_restart_sm_mask(PIO pio, uint32_t mask) {
+	for (uint i = 0; i < NUM_PIO_STATE_MACHINES; i++)
+		if (mask & (1u << i)) pio_sm_restart(pio, i);
+}
+
+void pio_sm_clkdiv_restart(PIO pio, uint sm) {
+	pioOf(pio).sm[sm].divAcc = 0;
+}
+
+void pio_clkdiv_restart_sm_mask(PIO pio, uint32_t mask) {
+	for (uint i = 0; i < NUM_PIO_STATE_MACHINES; i++)
+		if (mask & (1u << i)) pio_sm_clkdiv_restart(pio, i);
+}
+
+void pio_enable_sm_mask_in_sync(PIO pio, uint32_t mask) {
+	for (uint i = 0; i < NUM_PIO_STATE_MACHINES; i++) {
+		if (mask & (1u << i)) {
+			pio_sm_clkdiv_restart(pio, i);
+			pio_sm_set_enabled(pio, i, true);
+		}
+	}
+}
+
+void pio_sm_set_clkdiv_int_frac(PIO pio, uint sm, uint16_t div_int, uint8_t div_frac) {
+	pioOf(pio).sm[sm].clkdiv = ((uint32_t)div_int << PIO_SM0_CLKDIV_INT_LSB) | ((uint32_t)div_frac << PIO_SM0_CLKDIV_FRAC_LSB);
+}
+
+void pio_sm_set_clkdiv(PIO pio, uint sm, float div) {
+	uint16_t div_int = (uint16_t)div;
+	uint8_t div_frac = div_int ? (uint8_t)((div - div_int) * 256) : 0;
+	pio_sm_set_clkdiv_int_frac(pio, sm, div_int, div_frac);
+}
+
+void pio_sm_set_wrap(PIO pio, uint sm, uint wrap_target, uint wrap) {
+	Sm &s = pioOf(pio).sm[sm];
+	s.execctrl = (s.execctrl & ~(PIO_SM0_EXECCTRL_WRAP_TOP_BITS | PIO_SM0_EXECCTRL_WRAP_BOTTOM_BITS)) |
+				 (wrap_target << PIO_SM0_EXECCTRL_WRAP_BOTTOM_LSB) | (wrap << PIO_SM0_EXECCTRL_WRAP_TOP_LSB);
+}
+
+void pio_sm_set_out_pins(PIO pio, uint sm, uint out_base, uint out_count) {
+	Sm &s = pioOf(pio).sm[sm];
+	s.pinctrl = (s.pinctrl & ~(PIO_SM0_PINCTRL_OUT_BASE_BITS | PIO_SM0_PINCTRL_OUT_COUNT_BITS)) |
+				(relPin(pio, out_base) << PIO_SM0_PINCTRL_OUT_BASE_LSB) | (out_count << PIO_SM0_PINCTRL_OUT_COUNT_LSB);
+}
+
+void pio_sm_set_set_pins(PIO pio, uint sm, uint set_base, uint set_count) {
+	Sm &s = pioOf(pio).sm[sm];
+	s.pinctrl = (s.pinctrl & ~(PIO_SM0_PINCTRL_SET_BASE_BITS | PIO_SM0_PINCTRL_SET_COUNT_BITS)) |
+				(relPin(pio, set_base) << PIO_SM0_PINCTRL_SET_BASE_LSB) | (set_count << PIO_SM0_PINCTRL_SET_COUNT_LSB);
+}
+
+void pio_sm_set_in_pins(PIO pio, uint sm, uint in_base) {
+	Sm &s = pioOf(pio).sm[sm];
+	s.pinctrl = (s.pinctrl & ~PIO_SM0_PINCTRL_IN_BASE_BITS) | (relPin(pio, in_base) << PIO_SM0_PINCTRL_IN_BASE_LSB);
+}
+
+void pio_sm_set_sideset_pins(PIO pio, uint sm, uint sideset_base) {
+	Sm &s = pioOf(pio).sm[sm];
+	s.pinctrl = (s.pinctrl & ~PIO_SM0_PINCTRL_SIDESET_BASE_BITS) | (relPin(pio, sideset_base) << PIO_SM0_PINCTRL_SIDESET_BASE_LSB);
+}
+
+void pio_sm_set_jmp_pin(PIO pio, uint sm, uint pin) {
+	Sm &s = pioOf(pio).sm[sm];
+	s.execctrl = (s.execctrl & ~PIO_SM0_EXECCTRL_JMP_PIN_BITS) | (relPin(pio, pin) << PIO_SM0_EXECCTRL_JMP_PIN_LSB);
+}
+
+void pio_sm_exec(PIO pio, uint sm, uint instr) {
+	smExec(pioOf(pio), sm, instr);
+}
+
+bool pio_sm_is_exec_stalled(PIO pio, uint sm) {
+	return pioOf(pio).sm[sm].execStalled;
+}
+
+struct ExecWait {
+	Sm *s;
+};
+static bool execDone(void *ctx) {
+	return !((ExecWait *)ctx)->s->execStalled;
+}
+
+void pio_sm_exec_wait_blocking(PIO pio, uint sm, uint instr) {
+	pio_sm_exec(pio, sm, instr);
+	ExecWait w = {&pioOf(pio).sm[sm]};
+	waitUntil(execDone, &w, "pio_sm_exec_wait_blocking");
+}
+
+uint8_t pio_sm_get_pc(PIO pio, uint sm) {
+	return pioOf(pio).sm[sm].pc;
+}
+
+// the masks are GPIO numbers (bit n = GPIO n), like in the SDK
+void pio_sm_set_pins64(PIO pio, uint sm, uint64_t pin_values) {
+	pio_sm_set_pins_with_mask64(pio, sm, pin_values, 0xFFFFFFFFull << pioOf(pio).gpioBase);
+}
+
+void pio_sm_set_pins_with_mask64(PIO pio, uint sm, uint64_t pin_values, uint64_t pin_mask) {
+	(void)sm;
+	Pio &p = pioOf(pio);
+	uint32_t values = (uint32_t)(pin_values >> p.gpioBase);
+	uint32_t mask = (uint32_t)(pin_mask >> p.gpioBase);
+	p.outVal = (p.outVal & ~mask) | (values & mask);
+	markGpioDirty();
+}
+
+void pio_sm_set_pindirs_with_mask64(PIO pio, uint sm, uint64_t pin_dirs, uint64_t pin_mask) {
+	(void)sm;
+	Pio &p = pioOf(pio);
+	uint32_t dirs = (uint32_t)(pin_dirs >> p.gpioBase);
+	uint32_t mask = (uint32_t)(pin_mask >> p.gpioBase);
+	p.outDir = (p.outDir & ~mask) | (dirs & mask);
+	markGpioDirty();
+}
+
+void pio_sm_set_pins(PIO pio, uint sm, uint32_t pin_values) {
+	pio_sm_set_pins64(pio, sm, pin_values);
+}
+
+void pio_sm_set_pins_with_mask(PIO pio, uint sm, uint32_t pin_values, uint32_t pin_mask) {
+	pio_sm_set_pins_with_mask64(pio, sm, pin_values, pin_mask);
+}
+
+void pio_sm_set_pindirs_with_mask(PIO pio, uint sm, uint32_t pin_dirs, uint32_t pin_mask) {
+	pio_sm_set_pindirs_with_mask64(pio, sm, pin_dirs, pin_mask);
+}
+
+int pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out) {
+	(void)sm;
+	pioSetPins(pioOf(pio), relPin(pio, pin_base), pin_count, is_out ? 0xFFFFFFFFu : 0, true);
+	return 0;
+}
+
+void pio_sm_put(PIO pio, uint sm, uint32_t data) {
+	pio->txf[sm] = data;
+}
+
+struct FifoWait {
+	Sm *s;
+};
+static bool txNotFull(void *ctx) {
+	Sm *s = ((FifoWait *)ctx)->s;
+	return s->tx.count < s->txCap();
+}
+static bool rxNotEmpty(void *ctx) {
+	return ((FifoWait *)ctx)->s->rx.count;
+}
+
+void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data) {
+	FifoWait w = {&pioOf(pio).sm[sm]};
+	waitUntil(txNotFull, &w, "pio_sm_put_blocking");
+	pio_sm_put(pio, sm, data);
+}
+
+uint32_t pio_sm_get(PIO pio, uint sm) {
+	return pio->rxf[sm];
+}
+
+uint32_t pio_sm_get_blocking(PIO pio, uint sm) {
+	FifoWait w = {&pioOf(pio).sm[sm]};
+	waitUntil(rxNotEmpty, &w, "pio_sm_get_blocking");
+	return pio_sm_get(pio, sm);
+}
+
+bool pio_sm_is_rx_fifo_full(PIO pio, uint sm) {
+	const Sm &s = pioOf(pio).sm[sm];
+	return s.rx.count >= s.rxCap();
+}
+
+bool pio_sm_is_rx_fifo_empty(PIO pio, uint sm) {
+	return !pioOf(pio).sm[sm].rx.count;
+}
+
+uint pio_sm_get_rx_fifo_level(PIO pio, uint sm) {
+	return pioOf(pio).sm[sm].rx.count;
+}
+
+bool pio_sm_is_tx_fifo_full(PIO pio, uint sm) {
+	const Sm &s = pioOf(pio).sm[sm];
+	return s.tx.count >= s.txCap();
+}
+
+bool pio_sm_is_tx_fifo_empty(PIO pio, uint sm) {
+	return !pioOf(pio).sm[sm].tx.count;
+}
+
+uint pio_sm_get_tx_fifo_level(PIO pio, uint sm) {
+	return pioOf(pio).sm[sm].tx.count;
+}
+
+void pio_sm_clear_fifos(PIO pio, uint sm) {
+	Sm &s = pioOf(pio).sm[sm];
+	s.tx.clear();
+	s.rx.clear();
+}
+
+void pio_sm_drain_tx_fifo(PIO pio, uint sm) {
+	Pio &p = pioOf(pio);
+	Sm &s = p.sm[sm];
+	while (s.tx.count) {
+		smExec(p, sm, pio_encode_pull(false, false));
+		if (s.enabled) {
+			// executed on the next SM clock
+			FifoWait w = {&s};
+			(void)w;
+			s.execPending = false;
+			s.osr = s.tx.pop();
+			s.osrCount = 0;
+		}
+	}
+}
+
+void pio_set_irq0_source_enabled(PIO pio, enum pio_interrupt_source source, bool enabled) {
+	pio_set_irq0_source_mask_enabled(pio, 1u << source, enabled);
+}
+
+void pio_set_irq1_source_enabled(PIO pio, enum pio_interrupt_source source, bool enabled) {
+	pio_set_irq1_source_mask_enabled(pio, 1u << source, enabled);
+}
+
+void pio_set_irq0_source_mask_enabled(PIO pio, uint32_t source_mask, bool enabled) {
+	Pio &p = pioOf(pio);
+	if (enabled) p.inte[0] |= source_mask;
+	else p.inte[0] &= ~source_mask;
+}
+
+void pio_set_irq1_source_mask_enabled(PIO pio, uint32_t source_mask, bool enabled) {
+	Pio &p = pioOf(pio);
+	if (enabled) p.inte[1] |= source_mask;
+	else p.inte[1] &= ~source_mask;
+}
+
+bool pio_interrupt_get(PIO pio, uint pio_interrupt_num) {
+	return pioOf(pio).irqFlags & (1u << pio_interrupt_num);
+}
+
+void pio_interrupt_clear(PIO pio, uint pio_interrupt_num) {
+	pioOf(pio).irqFlags &= ~(1u << pio_interrupt_num);
+}
+
+} // extern "C"
@@ -5,8 +5,16 @@
 #error [Pico_Bidir_DShot]: The board you are trying to compile for does not have the PIO hardware. This library is only supported on RP2040/RP235x based devices. If you believe this message to be an error, please file an issue on GitHub. In this case, you can disable this message and try to compile anyway by going to the PIO_DShot.h file (exact location should be mentioned just before this error) and comment out this line.
 #endif
 
+#include "bidir_dshot_mux.h"
 #include "bidir_dshot_x1.h"
+#include "bidir_dshot_x4.h"
+#include "dshot_blackbox.h"
+#include "dshot_calibration.h"
+#include "dshot_fixed.h"
+#include "dshot_planner.h"
 #include "dshot_x4.h"
+#include "dshot_x8.h"
+#include "motor_group.h"
 
 enum DShotCommand : uint16_t {
 	DSHOT_CMD_MOTOR_STOP = 0,
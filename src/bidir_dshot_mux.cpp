@@ -0,0 +1,400 @@
+#include "bidir_dshot_mux.h"
+#include "dshot_blackbox.h"
+#include "dshot_common.h"
+#include "dshot_registry.h"
+#include "hardware/clocks.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "pio/bidir_dshot_x1.pio.h"
+#include "pio/bidir_dshot_x1_fast.pio.h"
+
+#define BIDIR_X1_PULL_PC 3 // "pull block" in bidir_dshot_x1.pio and bidir_dshot_x1_fast.pio: the state machine waits for the next packet
+
+BidirDShotMux *BidirDShotMux::irqInstances[NUM_PIOS][4] = {};
+
+static DShotProgram programFor(uint8_t cyclesPerBit) {
+	return cyclesPerBit == 40 ? DShotProgram::BIDIR_X1 : DShotProgram::BIDIR_X1_FAST;
+}
+
+static uint32_t calcReplyTimeout(uint32_t speed, uint8_t cyclesPerBit) {
+	// the PIO waits for the reply in loops of 2 cycles, same as BidirDShotX1
+	uint32_t timeoutLoops = DSHOT_REPLY_TIMEOUT_US * speed * cyclesPerBit / 2000;
+	if (timeoutLoops > 0xFFFF) timeoutLoops = 0xFFFF;
+	return timeoutLoops << 16;
+}
+
+BidirDShotMux::BidirDShotMux(const uint8_t *pins, uint8_t pinCount, uint32_t speed, PIO pio, int8_t sm) {
+#if DBG
+	char pioStr[32] = "";
+	pioToPioStr(pio, pioStr);
+#else
+	char *pioStr = nullptr;
+#endif
+
+	// ensure valid parameters
+	if (sm >= 4 || sm < -1 ||
+		!pins || !pinCount || pinCount > DSHOT_MUX_MAX_PINS ||
+		speed < 150 || speed > 4800 ||
+		(pio != pio0 && pio != pio1
+#if NUM_PIOS > 2
+		 && pio != pio2
+#endif
+		 )) {
+		// Bidir Dshot 150 is not official, but since the protocol itself is fine with it, it is allowed here
+		DEBUG_PRINTF("Invalid parameters: Check that sm is -1...3, pinCount is 1...%d, speed is 150...4800 and pio is pio0 or pio1 (or pio2 on RP2350). You supplied: sm=%d, pinCount=%d, speed=%d, pio=%s\n", DSHOT_MUX_MAX_PINS, sm, pinCount, speed, pioStr);
+		iError = true;
+		return;
+	}
+	uint64_t pinMask = 0;
+	for (int i = 0; i < pinCount; i++) {
+		if (pins[i] >= NUM_BANK0_GPIOS || (pinMask & (1ULL << pins[i]))) {
+			DEBUG_PRINTF("Invalid or duplicate pin: %d\n", pins[i]);
+			iError = true;
+			return;
+		}
+		pinMask |= 1ULL << pins[i];
+	}
+
+	if (speed != 300 && speed != 600 && speed != 1200 && speed != 2400) {
+		DEBUG_PRINTF("Unofficial speed: %d. Unless you know what you are doing, please select DShot 300, 600, 1200 or 2400.\n", speed);
+	}
+
+	uint32_t clkSys = clock_get_hz(clk_sys);
+	uint8_t cyclesPerBit = dshotBidirCyclesPerBit(clkSys, speed);
+	if (!cyclesPerBit) {
+		DEBUG_PRINTF("Speed %d is too high for the system clock of %d Hz\n", speed, clkSys);
+		iError = true;
+		return;
+	}
+
+	// Check if SM is claimed, then claim it
+	if (sm == -1) {
+		sm = pio_claim_unused_sm(pio, false);
+		if (sm < 0) {
+			DEBUG_PRINTF("No free state machines available, pio=%s\n", pioStr);
+			iError = true;
+			return;
+		}
+	} else {
+		if (pio_sm_is_claimed(pio, sm)) {
+			DEBUG_PRINTF("SM provided but already claimed, pio=%s, sm=%d", pioStr, sm);
+			iError = true;
+			return;
+		}
+		pio_sm_claim(pio, sm);
+	}
+	this->sm = sm;
+
+	// load the program, unless it is already loaded on this PIO (e.g. by BidirDShotX1)
+	int o = dshotClaimProgram(pio, programFor(cyclesPerBit));
+	if (o < 0) {
+		DEBUG_PRINTF("No space for program on %s", pioStr);
+		iError = true;
+		pio_sm_unclaim(pio, sm);
+		return;
+	}
+	this->offset = o;
+
+	// store the parameters
+	this->pio = pio;
+	this->pinCount = pinCount;
+	this->speed = speed;
+	this->cyclesPerBit = cyclesPerBit;
+	this->replyTimeout = calcReplyTimeout(speed, cyclesPerBit);
+	for (int i = 0; i < pinCount; i++) {
+		this->pins[i] = pins[i];
+		this->packets[i] = this->replyTimeout | (uint16_t)~appendChecksum(0); // motor stop until the first packet is set
+	}
+
+	// set up GPIOs, all idle high
+	for (int i = 0; i < pinCount; i++) {
+		pio_gpio_init(pio, pins[i]);
+		gpio_set_pulls(pins[i], true, false);
+		dshotSmSetPinsHigh(pio, this->sm, 1ull << pins[i]);
+		pio_sm_set_consecutive_pindirs(pio, this->sm, pins[i], 1, true);
+	}
+
+	// set up the state machine, the pins are set by startSlot
+	pio_sm_config c = cyclesPerBit == 40 ? bidir_dshot_x1_program_get_default_config(this->offset) : bidir_dshot_x1_fast_program_get_default_config(this->offset);
+	sm_config_set_set_pins(&c, pins[0], 1);
+	sm_config_set_out_pins(&c, pins[0], 1);
+	sm_config_set_in_pins(&c, pins[0]);
+	sm_config_set_jmp_pin(&c, pins[0]);
+	sm_config_set_out_shift(&c, false, false, 32);
+	sm_config_set_in_shift(&c, false, false, 32);
+	uint32_t clkDiv = dshotCalcClkDiv(clkSys, speed, cyclesPerBit);
+	sm_config_set_clkdiv_int_frac(&c, clkDiv >> 8, clkDiv & 0xFF);
+	pio_sm_init(pio, this->sm, this->offset + 2, &c); // skip the push of the empty ISR
+	pio_sm_set_enabled(pio, this->sm, true);
+
+	// the first instance on this PIO installs the handler
+	uint pioIndex = pio_get_index(pio);
+	bool irqUsed = false;
+	for (int i = 0; i < 4; i++) {
+		if (BidirDShotMux::irqInstances[pioIndex][i]) irqUsed = true;
+	}
+	BidirDShotMux::irqInstances[pioIndex][this->sm] = this;
+	if (!irqUsed) {
+		uint irqNum = PIO0_IRQ_0 + 2 * pioIndex;
+		irq_add_shared_handler(irqNum, BidirDShotMux::irqHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+		irq_set_enabled(irqNum, true);
+	}
+	pio_set_irq0_source_enabled(pio, (pio_interrupt_source)(pis_sm0_rx_fifo_not_empty + this->sm), true);
+	dshotRegisterClockCallback(pio, this->sm, BidirDShotMux::onClockChange, this);
+}
+
+BidirDShotMux::~BidirDShotMux() {
+	// if this instance is not initialized, do nothing
+	if (this->iError) {
+		return;
+	}
+
+	// detach from the interrupt, remove the handler if no other instance on this PIO needs it
+	uint pioIndex = pio_get_index(this->pio);
+	pio_set_irq0_source_enabled(this->pio, (pio_interrupt_source)(pis_sm0_rx_fifo_not_empty + this->sm), false);
+	BidirDShotMux::irqInstances[pioIndex][this->sm] = nullptr;
+	bool irqUsed = false;
+	for (int i = 0; i < 4; i++) {
+		if (BidirDShotMux::irqInstances[pioIndex][i]) irqUsed = true;
+	}
+	if (!irqUsed) {
+		uint irqNum = PIO0_IRQ_0 + 2 * pioIndex;
+		irq_remove_handler(irqNum, BidirDShotMux::irqHandler);
+		if (!irq_has_shared_handler(irqNum)) irq_set_enabled(irqNum, false);
+	}
+
+	// stop the state machine
+	this->running = false;
+	pio_sm_set_enabled(this->pio, this->sm, false);
+	pio_sm_unclaim(this->pio, this->sm);
+	dshotReleaseProgram(this->pio, programFor(this->cyclesPerBit));
+	dshotRegisterClockCallback(this->pio, this->sm, nullptr, nullptr);
+
+	// free the GPIO pins => pull up to reduce artifacts
+	for (int i = 0; i < this->pinCount; i++) {
+		gpio_set_pulls(this->pins[i], true, false);
+		gpio_set_dir(this->pins[i], GPIO_IN);
+		gpio_set_function(this->pins[i], GPIO_FUNC_NULL);
+	}
+}
+
+void BidirDShotMux::sendThrottles(const uint16_t *throttles) {
+	uint16_t data[DSHOT_MUX_MAX_PINS];
+	for (int i = 0; i < this->pinCount; i++) {
+		// check if the throttle value is valid
+		uint16_t t = throttles[i] > 2000 ? 2000 : throttles[i];
+		if (t) t += 47;
+		data[i] = t << 1;
+	}
+	this->sendRaw12Bit(data);
+}
+
+void BidirDShotMux::sendRaw12Bit(const uint16_t *data) {
+	if (this->iError) {
+		return;
+	}
+	// single word writes, the interrupt always sends a complete packet
+	for (int i = 0; i < this->pinCount; i++) {
+		uint16_t frame = appendChecksum(data[i]);
+		dshotBlackboxTx(this->pins[i], frame);
+		this->packets[i] = this->replyTimeout | (uint16_t)~frame;
+	}
+	if (this->running) {
+		return;
+	}
+
+	// the state machine waits in its pull after the init or the last slot before stop
+	uint32_t irqState = save_and_disable_interrupts();
+	dshotWaitBetweenFrames(this->pio, this->sm);
+	while (!pio_sm_is_rx_fifo_empty(this->pio, this->sm)) {
+		this->onSlotEnd(); // reply of the last slot before stop, running is still false
+	}
+	this->running = true;
+	this->startSlot(0);
+	restore_interrupts(irqState);
+}
+
+void BidirDShotMux::stop() {
+	this->running = false;
+}
+
+void BidirDShotMux::startSlot(uint8_t channel) {
+	uint8_t pin = this->pins[channel];
+	pio_sm_set_set_pins(this->pio, this->sm, pin, 1);
+	pio_sm_set_out_pins(this->pio, this->sm, pin, 1);
+	pio_sm_set_in_pins(this->pio, this->sm, pin);
+	pio_sm_set_jmp_pin(this->pio, this->sm, pin);
+	this->current = channel;
+	this->sendTime[channel] = time_us_32();
+	this->linkStats[channel].countSent();
+	pio_sm_put(this->pio, this->sm, this->packets[channel]);
+}
+
+void __not_in_flash_func(BidirDShotMux::onSlotEnd)() {
+	uint8_t ch = this->current;
+	while (!pio_sm_is_rx_fifo_empty(this->pio, this->sm)) {
+		uint32_t frame = pio_sm_get(this->pio, this->sm);
+		dshotBlackboxRx(this->pins[ch], frame);
+
+		// same word as in BidirDShotX1: turnaround in the upper 11 bits, 0 if the ESC didn't reply
+		uint16_t turnaroundNs = 0;
+		uint32_t window = this->replyTimeout >> 16;
+		if (frame && window < 0x800) {
+			uint32_t ns = ((window - (frame >> 21)) & 0x7FF) * (2000000 / this->cyclesPerBit) / this->speed;
+			turnaroundNs = ns > 0xFFFF ? 0xFFFF : ns;
+		}
+		uint32_t raw = 0;
+		BidirDshotTelemetryType type = frame ? BidirDShotX1::decodeFrame(frame, &raw) : BidirDshotTelemetryType::NO_REPLY;
+		uint32_t timestamp = this->sendTime[ch];
+
+		this->linkStats[ch].countTurnaround(turnaroundNs);
+		this->history[ch].push(raw, type, timestamp, turnaroundNs);
+		this->latestRaw[ch] = raw;
+		this->latestType[ch] = type;
+		this->latestAvailable[ch] = true;
+		if (type == BidirDshotTelemetryType::NO_REPLY)
+			this->linkStats[ch].countMissing();
+		else
+			this->linkStats[ch].countReply(type != BidirDshotTelemetryType::CHECKSUM_ERROR, type != BidirDshotTelemetryType::CHECKSUM_ERROR || BidirDShotX1::isValidGcr(frame));
+		if (type != BidirDshotTelemetryType::CHECKSUM_ERROR && type != BidirDshotTelemetryType::NO_REPLY) {
+			uint32_t v = BidirDShotX1::convertFromRaw(raw, type);
+			if (v != 0xFFFFFFFF) this->telemetry[ch].update(type, v, timestamp);
+		}
+	}
+	if (!this->running) {
+		return;
+	}
+
+	// the push is followed by 2 instructions until the pull, only then the pins may be moved
+	while (pio_sm_get_pc(this->pio, this->sm) != this->offset + BIDIR_X1_PULL_PC) {
+		busy_wait_at_least_cycles(4);
+	}
+	uint8_t next = ch + 1;
+	if (next >= this->pinCount) {
+		next = 0;
+		this->rotations = this->rotations + 1;
+	}
+	this->startSlot(next);
+}
+
+void __not_in_flash_func(BidirDShotMux::irqHandler)() {
+	for (int p = 0; p < NUM_PIOS; p++) {
+		for (int i = 0; i < 4; i++) {
+			BidirDShotMux *inst = BidirDShotMux::irqInstances[p][i];
+			if (inst && !pio_sm_is_rx_fifo_empty(inst->pio, inst->sm)) inst->onSlotEnd();
+		}
+	}
+}
+
+uint16_t BidirDShotMux::appendChecksum(uint16_t data) {
+	int csum = data;
+	csum ^= data >> 4;
+	csum ^= data >> 8;
+	csum = ~csum;
+	csum &= 0xF;
+	return (data << 4) | csum;
+}
+
+bool BidirDShotMux::checkTelemetryAvailable(uint8_t channel) {
+	return channel < this->pinCount && this->latestAvailable[channel];
+}
+
+BidirDshotTelemetryType BidirDShotMux::getTelemetryRaw(uint8_t channel, uint32_t *value) {
+	if (!this->checkTelemetryAvailable(channel)) {
+		return BidirDshotTelemetryType::NO_PACKET;
+	}
+
+	// the interrupt may store a newer frame meanwhile
+	uint32_t irqState = save_and_disable_interrupts();
+	this->latestAvailable[channel] = false;
+	uint32_t raw = this->latestRaw[channel];
+	BidirDshotTelemetryType type = this->latestType[channel];
+	uint32_t timestamp = this->sendTime[channel];
+	restore_interrupts(irqState);
+
+	this->linkStats[channel].countLatency(time_us_32() - timestamp);
+	if (type != BidirDshotTelemetryType::CHECKSUM_ERROR && type != BidirDshotTelemetryType::NO_REPLY) {
+		*value = raw;
+	}
+	return type;
+}
+
+BidirDshotTelemetryType BidirDShotMux::getTelemetryErpm(uint8_t channel, uint32_t *erpm) {
+	uint32_t raw;
+	BidirDshotTelemetryType ret = this->getTelemetryRaw(channel, &raw);
+	if (ret > BidirDshotTelemetryType::NO_PACKET) {
+		return BidirDshotTelemetryType::OTHER_VALUE;
+	}
+	if (ret > BidirDshotTelemetryType::ERPM) {
+		return ret;
+	}
+	raw = BidirDShotX1::convertFromRaw(raw, BidirDshotTelemetryType::ERPM);
+	if (raw == 0xFFFFFFFF) {
+		return BidirDshotTelemetryType::CHECKSUM_ERROR; // not quite right, but close enough
+	}
+	*erpm = raw;
+	return BidirDshotTelemetryType::ERPM;
+}
+
+uint8_t BidirDShotMux::getTelemetryHistory(uint8_t channel, BidirDShotTelemetryFrame *frames, uint8_t maxFrames) {
+	if (channel >= this->pinCount) {
+		return 0;
+	}
+	uint8_t count = this->history[channel].read(frames, maxFrames);
+	uint32_t now = time_us_32();
+	for (uint8_t i = 0; i < count; i++) {
+		this->linkStats[channel].countLatency(now - frames[i].timestamp);
+	}
+	return count;
+}
+
+bool BidirDShotMux::getLinkStats(uint8_t channel, BidirDShotLinkStats *stats) {
+	if (channel >= this->pinCount) {
+		return false;
+	}
+	this->linkStats[channel].snapshot(stats);
+	stats->historyDrops = this->history[channel].getOverflows();
+	return true;
+}
+
+bool BidirDShotMux::getTelemetryState(uint8_t channel, BidirDShotTelemetryState *state) {
+	if (channel >= this->pinCount) {
+		return false;
+	}
+	this->telemetry[channel].snapshot(state);
+	return true;
+}
+
+bool BidirDShotMux::setSpeed(uint32_t speed) {
+	if (this->iError) {
+		return false;
+	}
+	if (speed < 150 || speed > 4800) {
+		DEBUG_PRINTF("Invalid speed: %d, must be 150...4800\n", speed);
+		return false;
+	}
+	uint32_t clkSys = clock_get_hz(clk_sys);
+	if (dshotBidirCyclesPerBit(clkSys, speed) != this->cyclesPerBit) {
+		DEBUG_PRINTF("Speed %d needs another program at a system clock of %d Hz\n", speed, clkSys);
+		return false;
+	}
+
+	// without interrupts, the state machine stays in its pull after the current slot
+	uint32_t irqState = save_and_disable_interrupts();
+	dshotSetClkDivBetweenFrames(this->pio, this->sm, dshotCalcClkDiv(clkSys, speed, this->cyclesPerBit));
+	uint32_t timeout = calcReplyTimeout(speed, this->cyclesPerBit);
+	for (int i = 0; i < this->pinCount; i++) {
+		this->packets[i] = timeout | (this->packets[i] & 0xFFFF);
+	}
+	this->onSlotEnd(); // reply of the current slot (decoded at the old speed), then the next slot at the new one
+	this->replyTimeout = timeout;
+	this->speed = speed;
+	restore_interrupts(irqState);
+	return true;
+}
+
+void BidirDShotMux::onClockChange(void *driver) {
+	BidirDShotMux *d = (BidirDShotMux *)driver;
+	d->setSpeed(d->speed);
+}
@@ -0,0 +1,209 @@
+#ifndef BIDIR_DSHOT_MUX_H
+#define BIDIR_DSHOT_MUX_H
+
+#include "bidir_dshot_x1.h"
+#include "hardware/pio.h"
+
+#define DSHOT_MUX_MAX_PINS 16 /// max. ESCs served by one BidirDShotMux
+
+/**
+ * @brief Bidirectional DShot for several ESCs on one state machine, served one after the other
+ *
+ * Uses the BidirDShotX1 program (and shares it with BidirDShotX1 instances on the same PIO), but instead of one state machine per ESC, the state machine is moved from pin to pin: whenever the reply window of one ESC is over, the RX interrupt stores its reply, points the set/out/in/jmp pins to the next ESC and sends its packet. So one PIO can drive any number of ESCs (up to DSHOT_MUX_MAX_PINS per state machine), at a lower rate per ESC: each ESC gets one packet every pinCount slots, a slot is one packet + reply (e.g. ~90us at DShot600 => ~1.4kHz per ESC with 8 ESCs).
+ *
+ * The rotation runs in the background (PIO interrupt 0, shared with BidirDShotX1::enableTelemetryIrq) from the first send call on, always with the latest throttle of each ESC. The pins that are not served are driven high by the PIO, as the line is idle between packets.
+ */
+class BidirDShotMux {
+public:
+	BidirDShotMux() = delete;
+	/**
+	 * @brief Initialize a new BidirDShotMux instance
+	 *
+	 * @param pins array of pinCount ESC pins, any order, no need to be consecutive. Copied.
+	 * @param pinCount the number of ESCs, 1...DSHOT_MUX_MAX_PINS
+	 * @param speed DShot speed in kBaud, e.g. 600 for DShot600
+	 * @param pio the PIO instance to use, default is pio0
+	 * @param sm the state machine to use, default (-1) is autodetect
+	 */
+	BidirDShotMux(const uint8_t *pins, uint8_t pinCount, uint32_t speed = 600, PIO pio = pio0, int8_t sm = -1);
+
+	/**
+	 * @brief Deinitialize the BidirDShotMux instance
+	 *
+	 * This will stop the rotation and the state machine and free the pins. If this is the last instance on this PIO block, the PIO programm will be removed.
+	 */
+	~BidirDShotMux();
+
+	/**
+	 * @brief Set the throttle values of all ESCs, sent in their next slot
+	 *
+	 * UART telemetry request bit IS NOT set (separate wire). Checksum is appended automatically. Starts the rotation if it is not running yet. ESCs keep getting the last value until it is changed.
+	 *
+	 * @param throttles array of pinCount throttle values, 0-2000
+	 */
+	void sendThrottles(const uint16_t *throttles);
+
+	/**
+	 * @brief Set the raw packets of all ESCs, useful for special commands
+	 *
+	 * UART telemetry request bit can be set arbitrarily. Checksum is appended automatically. Starts the rotation if it is not running yet. Note that the packet is repeated until it is changed.
+	 *
+	 * @param data array of pinCount values, 12 bits each: xxxx dddd dddd dddt where d is data, t is telemetry request bit and x is ignored
+	 */
+	void sendRaw12Bit(const uint16_t *data);
+
+	/**
+	 * @brief Stop the rotation after the current slot, the pins stay high. The next send call starts it again with the first ESC.
+	 */
+	void stop();
+
+	/**
+	 * @brief check if a telemetry packet is available for an ESC
+	 *
+	 * Returns true regardless of the checksum validity or packet type.
+	 *
+	 * @param channel the ESC (index into pins)
+	 * @return true if packet is available
+	 * @return false if no packet is available
+	 */
+	bool checkTelemetryAvailable(uint8_t channel);
+
+	/**
+	 * @brief Get the raw telemetry packet of an ESC
+	 *
+	 * Same values as BidirDShotX1::getTelemetryRaw, use BidirDShotX1::convertFromRaw to convert them. No-op (does not stall) if no packet is available.
+	 *
+	 * @param channel the ESC (index into pins)
+	 * @param value pointer to a uint32_t to store the telemetry value. Must be a valid pointer, not nullptr.
+	 * @return BidirDshotTelemetryType, all values except ::OTHER_VALUE may be returned
+	 */
+	BidirDshotTelemetryType getTelemetryRaw(uint8_t channel, uint32_t *value);
+
+	/**
+	 * @brief Get the current eRPM of an ESC, provided the telemetry packet is valid and of type ERPM
+	 *
+	 * Leaves the erpm pointer unchanged if no packet is available, the checksum is invalid or the packet type is not ERPM. No-op (does not stall) if no packet is available.
+	 *
+	 * @param channel the ESC (index into pins)
+	 * @param erpm pointer to a uint32_t to store the erpm. Must be a valid pointer, not nullptr.
+	 * @return BidirDshotTelemetryType ::ERPM, ::OTHER_VALUE, ::NO_PACKET, ::NO_REPLY or ::CHECKSUM_ERROR
+	 */
+	BidirDshotTelemetryType getTelemetryErpm(uint8_t channel, uint32_t *erpm);
+
+	/**
+	 * @brief Get all telemetry frames of an ESC that were received since the last call
+	 *
+	 * Same as BidirDShotX1::getTelemetryHistory, the timestamps are the send times of the packets of this ESC.
+	 *
+	 * @param channel the ESC (index into pins)
+	 * @param frames array to store the frames, oldest first
+	 * @param maxFrames size of the array. Frames that don't fit are returned by the next call.
+	 * @return uint8_t number of frames stored in the array
+	 */
+	uint8_t getTelemetryHistory(uint8_t channel, BidirDShotTelemetryFrame *frames, uint8_t maxFrames);
+
+	/**
+	 * @brief Get the link statistics of an ESC, same as BidirDShotX1::getLinkStats
+	 *
+	 * @param channel the ESC (index into pins)
+	 * @param stats pointer to store the statistics. Must be a valid pointer, not nullptr.
+	 * @return false if the channel is invalid
+	 */
+	bool getLinkStats(uint8_t channel, BidirDShotLinkStats *stats);
+
+	/**
+	 * @brief Get the latest value, timestamp and count of every telemetry type of an ESC, same as BidirDShotX1::getTelemetryState
+	 *
+	 * @param channel the ESC (index into pins)
+	 * @param state pointer to store the snapshot. Must be a valid pointer, not nullptr.
+	 * @return false if the channel is invalid
+	 */
+	bool getTelemetryState(uint8_t channel, BidirDShotTelemetryState *state);
+
+	/**
+	 * @brief Get the number of completed rotations (every ESC got one packet), e.g. to measure the rate per ESC
+	 */
+	uint32_t getRotations() {
+		return rotations;
+	}
+
+	/**
+	 * @brief Changes the DShot speed without reinitialising the driver
+	 *
+	 * The new divider is applied between two slots. Also used by dshotClockChanged.
+	 *
+	 * @param speed speed in kBaud, e.g. 600 for DShot600, 150...4800
+	 * @return true if the speed was changed
+	 * @return false if the driver is not initialised, the speed is invalid or it would need the other BidirDShotX1 program (see dshotBidirCyclesPerBit)
+	 */
+	bool setSpeed(uint32_t speed);
+
+	/**
+	 * @brief checks if there was an error during initialisation of the DShot driver
+	 *
+	 * define DSHOT_DEBUG in src/dshot_config.h to enable information on Serial why the initialisation failed
+	 *
+	 * @return true if there was an error
+	 * @return false if everything worked fine
+	 */
+	bool initError() {
+		return iError;
+	}
+
+private:
+	PIO pio; /// which PIO is used for the DShot driver
+	uint8_t pins[DSHOT_MUX_MAX_PINS]; /// the ESC pins, in the order of the channels
+	uint8_t pinCount = 0; /// number of ESCs
+	uint8_t sm; /// which state machine is used for the DShot driver
+	uint32_t speed; /// speed in kBaud, e.g. 600 for DShot600
+	uint8_t offset; /// program offset in the PIO instruction memory
+	uint8_t cyclesPerBit; /// PIO cycles per bit of the loaded program, see dshotBidirCyclesPerBit
+	uint32_t replyTimeout; /// reply timeout of the PIO program, already shifted into the upper 16 bits of a packet
+	bool iError = false; /// shows if there was an error during initialisation
+
+	volatile uint32_t packets[DSHOT_MUX_MAX_PINS]; /// the next packet of each ESC, including the reply timeout
+	volatile bool running = false; /// whether the interrupt sends the next packet after each reply
+	volatile uint8_t current = 0; /// the ESC whose packet or reply is on the line
+	volatile uint32_t rotations = 0; /// completed rotations, see getRotations
+	uint32_t sendTime[DSHOT_MUX_MAX_PINS]; /// time_us_32() of the last packet of each ESC
+	BidirDShotTelemetryHistory history[DSHOT_MUX_MAX_PINS]; /// all received frames of each ESC until they are read
+	uint16_t latestRaw[DSHOT_MUX_MAX_PINS]; /// raw value of the latest frame of each ESC
+	BidirDshotTelemetryType latestType[DSHOT_MUX_MAX_PINS]; /// type of the latest frame of each ESC
+	volatile bool latestAvailable[DSHOT_MUX_MAX_PINS] = {}; /// whether the latest frame of each ESC was not read yet (one byte each, written by the interrupt and the reader)
+	BidirDShotLinkCounters linkStats[DSHOT_MUX_MAX_PINS]; /// statistics of each ESC for getLinkStats
+	BidirDShotTelemetryAggregator telemetry[DSHOT_MUX_MAX_PINS]; /// last valid value per type of each ESC, for getTelemetryState
+
+	static BidirDShotMux *irqInstances[NUM_PIOS][4]; /// instances per PIO and state machine, for the interrupt handler
+
+	/**
+	 * @brief stores the reply of the current ESC and starts the slot of the next one (if running)
+	 */
+	void onSlotEnd();
+
+	/**
+	 * @brief points the state machine to an ESC and sends its packet. Only call while the state machine waits for a packet.
+	 */
+	void startSlot(uint8_t channel);
+
+	/**
+	 * @brief shared PIO interrupt handler of all instances
+	 */
+	static void irqHandler();
+
+	/**
+	 * @brief appends a checksum to the outgoing DShot packet
+	 *
+	 * nibble-wise XOR, then bitwise invert.
+	 *
+	 * @param data 12 bit LSB-aligned (right-aligned) packet data (11 bits data + 1 bit telemetry)
+	 * @return uint16_t 16 bit full packet with checksum appended
+	 */
+	static uint16_t appendChecksum(uint16_t data);
+
+	/**
+	 * @brief clock change callback, see dshotRegisterClockCallback
+	 */
+	static void onClockChange(void *driver);
+};
+
+#endif // BIDIR_DSHOT_MUX_H
@@ -1,15 +1,56 @@
 #include "bidir_dshot_x1.h"
+#include "dshot_blackbox.h"
 #include "dshot_common.h"
+#include "dshot_registry.h"
 #include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
 #include "pio/bidir_dshot_x1.pio.h"
+#include "pio/bidir_dshot_x1_capture.pio.h"
+#include "pio/bidir_dshot_x1_fast.pio.h"
 
-vector<BidirDShotX1 *> BidirDShotX1::instances;
+BidirDShotX1 *BidirDShotX1::irqInstances[NUM_PIOS][4] = {};
+
+static DShotProgram programFor(uint8_t cyclesPerBit, bool capture) {
+	if (capture) return DShotProgram::BIDIR_X1_CAPTURE;
+	return cyclesPerBit == 40 ? DShotProgram::BIDIR_X1 : DShotProgram::BIDIR_X1_FAST;
+}
+
+// "pull block" of the programs: the state machine waits for the next packet
+#define BIDIR_X1_PULL_PC 3
+#define BIDIR_X1_CAPTURE_PULL_PC 1
 
 #define iv 0xFFFFFFFF
-const uint32_t escDecodeLut[32] = {
+constexpr uint32_t escDecodeLut[32] = {
 	iv, iv, iv, iv, iv, iv, iv, iv, iv, 9, 10, 11, iv, 13, 14, 15,
 	iv, iv, 2, 3, iv, 5, 6, 7, iv, 0, 8, 1, iv, 4, 12, iv};
 
+// decoded byte for two GCR quintets at once (index = high quintet << 5 | low quintet), 0x100 if one of them is invalid
+struct GcrPairLut {
+	uint16_t v[1024];
+	constexpr GcrPairLut() : v() {
+		for (uint32_t i = 0; i < 1024; i++) {
+			uint32_t lo = escDecodeLut[i & 0x1F];
+			uint32_t hi = escDecodeLut[i >> 5];
+			v[i] = lo == iv || hi == iv ? 0x100 : hi << 4 | lo;
+		}
+	}
+};
+static const GcrPairLut __not_in_flash("dshot") gcrPairLut;
+
+// 60000000 / m for all 9 bit eRPM mantissas, turns the eRPM division into a lookup and a shift
+struct ErpmReciprocals {
+	uint32_t v[512];
+	constexpr ErpmReciprocals() : v() {
+		for (uint32_t m = 1; m < 512; m++) {
+			v[m] = 60000000 / m;
+		}
+	}
+};
+static const ErpmReciprocals __not_in_flash("dshot") erpmReciprocals;
+
 const BidirDshotTelemetryType telemetryTypeLut[16] = {BidirDshotTelemetryType::ERPM, BidirDshotTelemetryType::ERPM, BidirDshotTelemetryType::TEMPERATURE, BidirDshotTelemetryType::ERPM, BidirDshotTelemetryType::VOLTAGE, BidirDshotTelemetryType::ERPM, BidirDshotTelemetryType::CURRENT, BidirDshotTelemetryType::ERPM, BidirDshotTelemetryType::DEBUG_FRAME_1, BidirDshotTelemetryType::ERPM, BidirDshotTelemetryType::DEBUG_FRAME_2, BidirDshotTelemetryType::ERPM, BidirDshotTelemetryType::STRESS, BidirDshotTelemetryType::ERPM, BidirDshotTelemetryType::STATUS, BidirDshotTelemetryType::ERPM};
 
 BidirDShotX1::BidirDShotX1(uint8_t pin, uint32_t speed, PIO pio, int8_t sm) {
@@ -39,6 +80,14 @@ BidirDShotX1::BidirDShotX1(uint8_t pin, uint32_t speed, PIO pio, int8_t sm) {
 		DEBUG_PRINTF("Unofficial speed: %d. Unless you know what you are doing, please select DShot 300, 600, 1200 or 2400.\n", speed);
 	}
 
+	uint32_t clkSys = clock_get_hz(clk_sys);
+	uint8_t cyclesPerBit = dshotBidirCyclesPerBit(clkSys, speed);
+	if (!cyclesPerBit) {
+		DEBUG_PRINTF("Speed %d is too high for the system clock of %d Hz\n", speed, clkSys);
+		iError = true;
+		return;
+	}
+
 	// Check if SM is claimed, then claim it
 	if (sm == -1) {
 		sm = pio_claim_unused_sm(pio, false);
@@ -57,52 +106,32 @@ BidirDShotX1::BidirDShotX1(uint8_t pin, uint32_t speed, PIO pio, int8_t sm) {
 	}
 	this->sm = sm;
 
-	// check if the program is already loaded, if not, try to load it
-	uint8_t o = 255;
-	for (auto inst : this->instances) {
-		if (inst->pio == pio && inst->initError() == false) {
-			o = inst->offset;
-			break;
-		}
-	}
-	if (o == 255) {
-		if (pio_can_add_program(pio, &bidir_dshot_x1_program)) {
-			this->offset = pio_add_program(pio, &bidir_dshot_x1_program);
-		} else {
-			DEBUG_PRINTF("No space for program on %s", pioStr);
-			iError = true;
-			pio_sm_unclaim(pio, sm);
-			return;
-		}
-	} else {
-		this->offset = o;
+	// load the program, unless it is already loaded on this PIO
+	int o = dshotClaimProgram(pio, programFor(cyclesPerBit, false));
+	if (o < 0) {
+		DEBUG_PRINTF("No space for program on %s", pioStr);
+		iError = true;
+		pio_sm_unclaim(pio, sm);
+		return;
 	}
+	this->offset = o;
+	this->cyclesPerBit = cyclesPerBit;
 
 	// set up GPIO
 	pio_gpio_init(pio, pin);
 	gpio_set_pulls(pin, true, false);
 
-	// set up the state machine
-	pio_sm_config c = bidir_dshot_x1_program_get_default_config(this->offset);
-	sm_config_set_set_pins(&c, pin, 1);
-	sm_config_set_out_pins(&c, pin, 1);
-	sm_config_set_in_pins(&c, pin);
-	sm_config_set_jmp_pin(&c, pin);
-	sm_config_set_out_shift(&c, false, false, 32);
-	sm_config_set_in_shift(&c, false, false, 32);
-	pio_sm_init(pio, this->sm, this->offset, &c);
-	pio_sm_set_consecutive_pindirs(pio, this->sm, pin, 1, true);
-	pio_sm_set_enabled(pio, this->sm, true);
-	uint32_t targetClock = 12000000 / 300 * speed; // 12 MHz for DShot300
-	uint32_t cpuClock = clock_get_hz(clk_sys);
-	pio_sm_set_clkdiv(pio, this->sm, (float)cpuClock / targetClock);
-
-	// add this instance to the list of instances
+	// store the parameters
 	this->pio = pio;
 	this->pin = pin;
 	this->speed = speed;
 	this->iError = false;
-	BidirDShotX1::instances.push_back(this);
+	this->replyTimeout = calcReplyTimeout(speed, cyclesPerBit, false);
+	this->freeRunPacket = this->makePacket(0); // motor stop until the first packet is sent
+
+	// set up the state machine
+	this->initSm(dshotCalcClkDiv(clkSys, speed, cyclesPerBit));
+	dshotRegisterClockCallback(pio, this->sm, BidirDShotX1::onClockChange, this);
 }
 
 BidirDShotX1::~BidirDShotX1() {
@@ -111,47 +140,111 @@ BidirDShotX1::~BidirDShotX1() {
 		return;
 	}
 
+	this->stopFreeRunning();
+
+	// detach from the interrupt, remove the handler if no other instance on this PIO needs it
+	if (this->irqEnabled) {
+		uint pioIndex = pio_get_index(this->pio);
+		pio_set_irq0_source_enabled(this->pio, (pio_interrupt_source)(pis_sm0_rx_fifo_not_empty + this->sm), false);
+		BidirDShotX1::irqInstances[pioIndex][this->sm] = nullptr;
+		bool irqUsed = false;
+		for (int i = 0; i < 4; i++) {
+			if (BidirDShotX1::irqInstances[pioIndex][i]) irqUsed = true;
+		}
+		if (!irqUsed) {
+			uint irqNum = PIO0_IRQ_0 + 2 * pioIndex;
+			irq_remove_handler(irqNum, BidirDShotX1::telemetryIrqHandler);
+			if (!irq_has_shared_handler(irqNum)) irq_set_enabled(irqNum, false);
+		}
+	}
+
 	// stop the state machine
 	pio_sm_set_enabled(this->pio, this->sm, false);
+	if (this->captureDma >= 0) {
+		dma_channel_abort(this->captureDma);
+		dma_channel_unclaim(this->captureDma);
+	}
 	if (this->sm >= 0) {
 		pio_sm_unclaim(this->pio, this->sm);
 	}
-	bool isLast = true;
-	for (auto inst : BidirDShotX1::instances) {
-		if (inst != this && inst->pio == this->pio && inst->initError() == false) {
-			isLast = false;
-			break;
-		}
-	}
-	if (isLast) {
-		pio_remove_program(this->pio, &bidir_dshot_x1_program, this->offset);
-	}
+	dshotReleaseProgram(this->pio, programFor(this->cyclesPerBit, this->capture));
+	dshotRegisterClockCallback(this->pio, this->sm, nullptr, nullptr);
 
 	// free the GPIO pin => pull up to reduce artifacts
 	gpio_set_pulls(this->pin, true, false);
 	gpio_set_dir(this->pin, GPIO_IN);
 	gpio_set_function(this->pin, GPIO_FUNC_NULL);
+}
 
-	// remove this instance from the list of instances
-	auto it = BidirDShotX1::instances.begin();
-	while (it != BidirDShotX1::instances.end()) {
-		if (*it == this) {
-			it = BidirDShotX1::instances.erase(it);
-		} else {
-			it++;
-		}
+void BidirDShotX1::initSm(uint32_t clkDiv) {
+	pio_sm_config c;
+	if (this->capture)
+		c = bidir_dshot_x1_capture_program_get_default_config(this->offset);
+	else if (this->cyclesPerBit == 40)
+		c = bidir_dshot_x1_program_get_default_config(this->offset);
+	else
+		c = bidir_dshot_x1_fast_program_get_default_config(this->offset);
+	sm_config_set_set_pins(&c, this->pin, 1);
+	sm_config_set_out_pins(&c, this->pin, 1);
+	sm_config_set_in_pins(&c, this->pin);
+	sm_config_set_jmp_pin(&c, this->pin);
+	sm_config_set_out_shift(&c, false, false, 32);
+	sm_config_set_in_shift(&c, false, this->capture, this->capture ? 16 : 32); // the capture program pushes every edge on its own
+	sm_config_set_clkdiv_int_frac(&c, clkDiv >> 8, clkDiv & 0xFF);
+	pio_sm_init(this->pio, this->sm, this->offset + (this->capture ? 0 : 2), &c); // skip the push of the empty ISR
+	dshotSmSetPinsHigh(this->pio, this->sm, 1ull << this->pin); // idle high until the first packet
+	pio_sm_set_consecutive_pindirs(this->pio, this->sm, this->pin, 1, true);
+	pio_sm_set_enabled(this->pio, this->sm, true);
+}
+
+bool BidirDShotX1::switchProgram(uint8_t cyclesPerBit, bool capture, uint32_t clkDiv) {
+	dshotWaitBetweenFrames(this->pio, this->sm);
+
+	// pio_sm_init clears the FIFOs, and the interrupt must not read them meanwhile
+	uint32_t irqState = save_and_disable_interrupts();
+	this->readFifo();
+	pio_sm_set_enabled(this->pio, this->sm, false);
+
+	// two programs don't fit into one PIO: release the old one first, so that the new one can take its place
+	dshotReleaseProgram(this->pio, programFor(this->cyclesPerBit, this->capture));
+	int o = dshotClaimProgram(this->pio, programFor(cyclesPerBit, capture));
+	bool ok = o >= 0;
+	if (!ok) {
+		cyclesPerBit = this->cyclesPerBit;
+		capture = this->capture;
+		clkDiv = dshotCalcClkDiv(clock_get_hz(clk_sys), this->speed, cyclesPerBit);
+		o = dshotClaimProgram(this->pio, programFor(cyclesPerBit, capture)); // fits, it was just released
 	}
+	this->offset = o;
+	this->cyclesPerBit = cyclesPerBit;
+	this->capture = capture;
+	this->initSm(clkDiv);
+	restore_interrupts(irqState);
+	return ok;
+}
+
+bool BidirDShotX1::isIdle() {
+	uint pullPc = this->offset + (this->capture ? BIDIR_X1_CAPTURE_PULL_PC : BIDIR_X1_PULL_PC);
+	return pio_sm_get_pc(this->pio, this->sm) == pullPc && pio_sm_is_tx_fifo_empty(this->pio, this->sm);
 }
 
 void BidirDShotX1::sendThrottle(uint16_t throttle) {
+	this->sendRaw12Bit(this->nextThrottleData(throttle));
+}
+
+uint16_t BidirDShotX1::nextThrottleData(uint16_t throttle) {
+	uint16_t command;
+	if (this->commands.next(&command)) {
+		return (command << 1) | 1;
+	}
+
 	// check if the throttle value is valid
 	if (throttle > 2000) {
 		throttle = 2000;
 	}
 
 	if (throttle) throttle += 47;
-	throttle <<= 1;
-	this->sendRaw12Bit(throttle);
+	return throttle << 1;
 }
 
 void BidirDShotX1::sendRaw11Bit(uint16_t data) {
@@ -160,11 +253,53 @@ void BidirDShotX1::sendRaw11Bit(uint16_t data) {
 }
 
 void BidirDShotX1::sendRaw12Bit(uint16_t data) {
-	data = this->appendChecksum(data);
+	uint32_t packet = this->makePacket(data);
+	this->freeRunPacket = packet;
+	if (this->freeRunTimer >= 0) {
+		return;
+	}
+	this->sendPacket(packet);
+}
+
+uint32_t BidirDShotX1::makePacket(uint16_t data) {
+	uint16_t frame = this->appendChecksum(data);
+	dshotBlackboxTx(this->pin, frame);
+	return this->replyTimeout | (uint16_t)~frame;
+}
 
-	if (pio_sm_get_pc(this->pio, this->sm) != this->offset + 2)
-		pio_sm_exec(pio, sm, pio_encode_jmp(this->offset + 1));
-	pio_sm_put(this->pio, this->sm, ~data);
+void BidirDShotX1::sendPacket(uint32_t packet) {
+	// the state machine returns to pull by itself after the reply window, so a packet sent during the reply is only delayed
+	if (!this->irqEnabled) this->readFifo();
+
+	// replies that were not read in time stalled the state machine, a full TX FIFO would drop the packet
+	uint32_t stallMask = 1u << (PIO_FDEBUG_RXSTALL_LSB + this->sm);
+	if (this->pio->fdebug & stallMask) {
+		this->pio->fdebug = stallMask;
+		this->linkStats.countOverrun();
+	}
+	if (pio_sm_is_tx_fifo_full(this->pio, this->sm)) {
+		this->linkStats.countOverrun();
+		return;
+	}
+	this->lastSendTime = time_us_32();
+	pio_sm_put(this->pio, this->sm, packet);
+	this->linkStats.countSent();
+}
+
+bool BidirDShotX1::queueCommand(uint16_t command) {
+	return this->commands.push(command);
+}
+
+bool BidirDShotX1::queueCommand(uint16_t command, uint8_t repeats, uint32_t spacingUs) {
+	return this->commands.push(command, repeats, spacingUs);
+}
+
+uint8_t BidirDShotX1::getQueuedCommands() {
+	return this->commands.pending();
+}
+
+void BidirDShotX1::clearCommandQueue() {
+	this->commands.clear();
 }
 
 uint16_t BidirDShotX1::appendChecksum(uint16_t data) {
@@ -177,7 +312,8 @@ uint16_t BidirDShotX1::appendChecksum(uint16_t data) {
 }
 
 bool BidirDShotX1::checkTelemetryAvailable() {
-	return !pio_sm_is_rx_fifo_empty(this->pio, this->sm);
+	if (!this->irqEnabled) this->readFifo();
+	return this->latestAvailable;
 }
 
 BidirDshotTelemetryType BidirDShotX1::getTelemetryErpm(uint32_t *value) {
@@ -189,15 +325,10 @@ BidirDshotTelemetryType BidirDShotX1::getTelemetryErpm(uint32_t *value) {
 	if (ret > BidirDshotTelemetryType::ERPM) {
 		return ret;
 	}
-	if (raw == 0xFFF) {
-		*value = 0;
-		return BidirDshotTelemetryType::ERPM;
-	}
-	raw = (raw & 0x1FF) << (raw >> 9); // eeem mmmm mmmm
-	if (!raw) {
+	raw = BidirDShotX1::convertFromRaw(raw, BidirDshotTelemetryType::ERPM);
+	if (raw == 0xFFFFFFFF) {
 		return BidirDshotTelemetryType::CHECKSUM_ERROR; // not quite right, but close enough
 	}
-	raw = (60000000 + 50 * raw) / raw;
 	*value = raw;
 	return BidirDshotTelemetryType::ERPM;
 }
@@ -207,15 +338,10 @@ BidirDshotTelemetryType BidirDShotX1::getTelemetryPacket(uint32_t *value) {
 	BidirDshotTelemetryType ret = this->getTelemetryRaw(&raw);
 
 	if (ret == BidirDshotTelemetryType::ERPM) {
-		if (raw == 0xFFF) {
-			*value = 0;
-			return BidirDshotTelemetryType::ERPM;
-		}
-		raw = (raw & 0x1FF) << (raw >> 9); // eeem mmmm mmmm
-		if (!raw) {
+		raw = BidirDShotX1::convertFromRaw(raw, ret);
+		if (raw == 0xFFFFFFFF) {
 			return BidirDshotTelemetryType::CHECKSUM_ERROR; // not quite right, but close enough
 		}
-		raw = (60000000 + 50 * raw) / raw;
 		*value = raw;
 	} else if (ret > BidirDshotTelemetryType::NO_PACKET) {
 		*value = raw & 0xFF;
@@ -224,21 +350,454 @@ BidirDshotTelemetryType BidirDShotX1::getTelemetryPacket(uint32_t *value) {
 }
 
 BidirDshotTelemetryType BidirDShotX1::getTelemetryRaw(uint32_t *value) {
-	if (pio_sm_is_rx_fifo_empty(this->pio, this->sm)) {
+	if (!this->irqEnabled) this->readFifo();
+	if (!this->latestAvailable) {
 		return BidirDshotTelemetryType::NO_PACKET;
 	}
 
-	// get most current data
-	uint32_t raw = pio_sm_get_blocking(this->pio, this->sm);
+	// the interrupt must not replace the frame while it is read
+	uint32_t irqState = save_and_disable_interrupts();
+	uint16_t raw = this->latestRaw;
+	BidirDshotTelemetryType type = this->latestType;
+	uint32_t timestamp = this->latestTime;
+	this->latestAvailable = false;
+	restore_interrupts(irqState);
+	this->linkStats.countLatency(time_us_32() - timestamp);
+
+	if (type != BidirDshotTelemetryType::CHECKSUM_ERROR && type != BidirDshotTelemetryType::NO_REPLY) {
+		*value = raw;
+	}
+	return type;
+}
+
+void BidirDShotX1::readFifo() {
+	if (this->captureDma >= 0) {
+		this->readCapture();
+		return;
+	}
 	while (!pio_sm_is_rx_fifo_empty(this->pio, this->sm)) {
-		raw = pio_sm_get_blocking(this->pio, this->sm);
+		uint32_t frame = pio_sm_get(this->pio, this->sm);
+
+		// the PIO puts the low 11 bits of the remaining reply window (loops of 2 cycles, cyclesPerBit / 2 per bit) above the frame
+		uint16_t turnaroundNs = 0;
+		uint32_t window = this->replyTimeout >> 16;
+		if (frame && window < 0x800) {
+			uint32_t ns = ((window - (frame >> 21)) & 0x7FF) * (2000000 / this->cyclesPerBit) / this->speed;
+			turnaroundNs = ns > 0xFFFF ? 0xFFFF : ns;
+		}
+		this->storeFrame(frame, turnaroundNs);
 	}
+}
 
-	raw = raw ^ (raw >> 1);
-	uint32_t data = escDecodeLut[raw & 0x1F];
-	data |= escDecodeLut[(raw >> 5) & 0x1F] << 4;
-	data |= escDecodeLut[(raw >> 10) & 0x1F] << 8;
-	data |= escDecodeLut[(raw >> 15) & 0x1F] << 12;
+void BidirDShotX1::readCapture() {
+	uint32_t written = 0xFFFFFFFF - dma_hw->ch[this->captureDma].transfer_count;
+	if (written - this->captureRead > DSHOT_CAPTURE_BUFFER) {
+		// the DMA overwrote edges that were not processed yet: skip to the next complete reply
+		this->captureRead = written - DSHOT_CAPTURE_BUFFER;
+		this->captureCount = 0xFF;
+		this->linkStats.countOverrun();
+	}
+	uint32_t window = this->replyTimeout >> 16;
+	while (this->captureRead != written) {
+		uint16_t v = this->captureBuffer[this->captureRead++ & (DSHOT_CAPTURE_BUFFER - 1)];
+		if (v != 0xFFFF) {
+			// every edge costs one uncounted loop on the PIO
+			if (this->captureCount < DSHOT_CAPTURE_EDGES) {
+				this->captureEdges[this->captureCount] = window - v + this->captureCount;
+				this->captureCount++;
+			}
+			continue;
+		}
+		if (this->captureCount == 0xFF) {
+			this->captureCount = 0;
+			continue;
+		}
+
+		// end of the window: reply bits are 4/5 of the packet bits, 2 cycles per loop
+		uint8_t count = this->captureCount;
+		uint32_t frame = BidirDShotX1::decodeEdges(this->captureEdges, count, this->cyclesPerBit * 256 * 4 / 5 / 2);
+		uint16_t turnaroundNs = 0;
+		if (frame) {
+			uint32_t ns = this->captureEdges[0] * (2000000 / this->cyclesPerBit) / this->speed;
+			turnaroundNs = ns > 0xFFFF ? 0xFFFF : ns;
+		}
+		for (uint8_t i = 0; i < count; i++) {
+			this->lastEdges[i] = this->captureEdges[i];
+		}
+		this->lastEdgeCount = count;
+		this->captureCount = 0;
+		this->storeFrame(frame, turnaroundNs);
+	}
+
+	// the transfer count runs out after 2^32 edges
+	if (!dma_channel_is_busy(this->captureDma)) {
+		dma_channel_set_trans_count(this->captureDma, 0xFFFFFFFF, true);
+		this->captureRead = 0;
+	}
+}
+
+void BidirDShotX1::storeFrame(uint32_t frame, uint16_t turnaroundNs) {
+	dshotBlackboxRx(this->pin, frame);
+	uint32_t raw = 0;
+	BidirDshotTelemetryType type = frame ? BidirDShotX1::decodeFrame(frame, &raw) : BidirDshotTelemetryType::NO_REPLY; // 0: reply window passed without a start bit
+	uint32_t timestamp = this->freeRunTimer >= 0 ? time_us_32() : this->lastSendTime;
+
+	this->linkStats.countTurnaround(turnaroundNs);
+	this->history.push(raw, type, timestamp, turnaroundNs);
+	this->latestRaw = raw;
+	this->latestType = type;
+	this->latestTime = timestamp;
+	if (this->freeRunTimer >= 0) this->linkStats.countSent(); // the DMA sends without the CPU, but every packet results in one word
+	if (type == BidirDshotTelemetryType::NO_REPLY)
+		this->linkStats.countMissing();
+	else
+		this->linkStats.countReply(type != BidirDshotTelemetryType::CHECKSUM_ERROR, type != BidirDshotTelemetryType::CHECKSUM_ERROR || BidirDShotX1::isValidGcr(frame));
+	this->latestAvailable = true;
+	if (type != BidirDshotTelemetryType::CHECKSUM_ERROR && type != BidirDshotTelemetryType::NO_REPLY) {
+		uint32_t v = BidirDShotX1::convertFromRaw(raw, type);
+		if (v != 0xFFFFFFFF) {
+			this->telemetry.update(type, v, timestamp);
+		}
+	}
+}
+
+uint8_t BidirDShotX1::getTelemetryHistory(BidirDShotTelemetryFrame *frames, uint8_t maxFrames) {
+	if (!this->irqEnabled) this->readFifo();
+	uint8_t count = this->history.read(frames, maxFrames);
+	uint32_t now = time_us_32();
+	for (uint8_t i = 0; i < count; i++) {
+		this->linkStats.countLatency(now - frames[i].timestamp);
+	}
+	return count;
+}
+
+uint32_t BidirDShotX1::getTelemetryOverflows() {
+	return this->history.getOverflows();
+}
+
+void BidirDShotX1::getLinkStats(BidirDShotLinkStats *stats) {
+	this->linkStats.snapshot(stats);
+	stats->historyDrops = this->history.getOverflows();
+}
+
+void BidirDShotX1::resetLinkStats() {
+	this->linkStats.reset();
+}
+
+bool BidirDShotX1::startFreeRunning(uint32_t rate) {
+	if (this->iError) {
+		return false;
+	}
+	if (this->capture) {
+		DEBUG_PRINTF("Free-running mode not available in the edge capture mode, pin=%d\n", this->pin);
+		return false;
+	}
+	this->stopFreeRunning();
+
+	// packet, reply window and reply (~0.8 bit times per bit) need to fit into one period
+	uint32_t minPeriod = 33000 / this->speed + DSHOT_REPLY_TIMEOUT_US;
+	if (!rate || 1000000 / rate < minPeriod) {
+		DEBUG_PRINTF("Rate too high: %d, the period must be at least %dus\n", rate, minPeriod);
+		return false;
+	}
+	int timer = claimDmaPacingTimer(rate);
+	if (timer < 0) {
+		DEBUG_PRINTF("No DMA timer available or rate out of range: %d\n", rate);
+		return false;
+	}
+	int startCh = dma_claim_unused_channel(false);
+	int packetCh = startCh < 0 ? -1 : dma_claim_unused_channel(false);
+	if (packetCh < 0) {
+		DEBUG_PRINTF("No free DMA channels available, pin=%d\n", this->pin);
+		if (startCh >= 0) dma_channel_unclaim(startCh);
+		dma_timer_unclaim(timer);
+		return false;
+	}
+	this->enableTelemetryIrq();
+
+	// every period, [0] points [1] to the packet (and triggers it), [1] writes it and re-arms [0]
+	dma_channel_config c = dma_channel_get_default_config(startCh);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+	channel_config_set_read_increment(&c, false);
+	channel_config_set_write_increment(&c, false);
+	channel_config_set_dreq(&c, dma_get_timer_dreq(timer));
+	dma_channel_configure(startCh, &c, &dma_hw->ch[packetCh].al3_read_addr_trig, &this->freeRunSource, 1, false);
+	c = dma_channel_get_default_config(packetCh);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+	channel_config_set_read_increment(&c, false);
+	channel_config_set_write_increment(&c, false);
+	channel_config_set_dreq(&c, pio_get_dreq(this->pio, this->sm, true));
+	channel_config_set_chain_to(&c, startCh);
+	dma_channel_configure(packetCh, &c, &this->pio->txf[this->sm], &this->freeRunPacket, 1, false);
+
+	this->freeRunTimer = timer;
+	this->freeRunRate = rate;
+	this->freeRunDma[0] = startCh;
+	this->freeRunDma[1] = packetCh;
+	dma_channel_start(startCh);
+	return true;
+}
+
+void BidirDShotX1::stopFreeRunning() {
+	if (this->freeRunTimer < 0) {
+		return;
+	}
+
+	// disable both channels first, so that an abort can't be undone by the chain trigger of the other one
+	for (int i = 0; i < 2; i++) {
+		hw_clear_bits(&dma_hw->ch[this->freeRunDma[i]].al1_ctrl, DMA_CH0_CTRL_TRIG_EN_BITS);
+	}
+	for (int i = 0; i < 2; i++) {
+		dma_channel_abort(this->freeRunDma[i]);
+		dma_channel_unclaim(this->freeRunDma[i]);
+		this->freeRunDma[i] = -1;
+	}
+	dma_timer_set_fraction(this->freeRunTimer, 0, 0); // stop the timer
+	dma_timer_unclaim(this->freeRunTimer);
+	this->freeRunTimer = -1;
+}
+
+bool BidirDShotX1::setSpeed(uint32_t speed) {
+	if (this->iError) {
+		return false;
+	}
+	if (speed < 150 || speed > 4800) {
+		DEBUG_PRINTF("Invalid speed: %d, must be 150...4800\n", speed);
+		return false;
+	}
+
+	uint32_t clkSys = clock_get_hz(clk_sys);
+	uint8_t cyclesPerBit = dshotBidirCyclesPerBit(clkSys, speed);
+	if (this->capture && cyclesPerBit) cyclesPerBit = 20; // the capture program always runs at 20 cycles per bit
+	if (!cyclesPerBit) {
+		DEBUG_PRINTF("Speed %d is too high for the system clock of %d Hz\n", speed, clkSys);
+		return false;
+	}
+
+	// the DMA would keep sending while waiting for the gap, and its pacing timer runs on clk_sys
+	uint32_t rate = this->freeRunTimer >= 0 ? this->freeRunRate : 0;
+	this->stopFreeRunning();
+
+	uint32_t clkDiv = dshotCalcClkDiv(clkSys, speed, cyclesPerBit);
+	bool ok = true;
+	if (cyclesPerBit == this->cyclesPerBit) {
+		dshotSetClkDivBetweenFrames(this->pio, this->sm, clkDiv);
+	} else if (!this->switchProgram(cyclesPerBit, this->capture, clkDiv)) {
+		DEBUG_PRINTF("No space for the program for DShot%d on the PIO of pin %d\n", speed, this->pin);
+		ok = false;
+	}
+	if (ok) {
+		this->speed = speed;
+		this->replyTimeout = calcReplyTimeout(speed, cyclesPerBit, this->capture);
+		this->freeRunPacket = this->replyTimeout | (this->freeRunPacket & 0xFFFF);
+	}
+
+	if (rate) {
+		return this->startFreeRunning(rate) && ok;
+	}
+	return ok;
+}
+
+uint32_t BidirDShotX1::calcReplyTimeout(uint32_t speed, uint8_t cyclesPerBit, bool capture) {
+	// the PIO waits for the reply in loops of 2 cycles
+	uint32_t timeoutLoops = DSHOT_REPLY_TIMEOUT_US * speed * cyclesPerBit / 2000;
+	if (capture) {
+		// the reply (21 bits of 4/5 packet bits) has to end within the window, 0xFFFF is the end marker
+		timeoutLoops += 20 * cyclesPerBit / 2;
+		if (timeoutLoops > 0xFFFE) timeoutLoops = 0xFFFE;
+	}
+	if (timeoutLoops > 0xFFFF) timeoutLoops = 0xFFFF;
+	return timeoutLoops << 16;
+}
+
+void BidirDShotX1::onClockChange(void *driver) {
+	BidirDShotX1 *d = (BidirDShotX1 *)driver;
+	d->setSpeed(d->speed);
+}
+
+bool BidirDShotX1::enableTelemetryIrq() {
+	if (this->iError) {
+		return false;
+	}
+	if (this->irqEnabled) {
+		return true;
+	}
+	if (this->capture) {
+		DEBUG_PRINTF("Telemetry interrupt not available in the edge capture mode, pin=%d\n", this->pin);
+		return false;
+	}
+
+	// the first instance on this PIO installs the handler
+	uint pioIndex = pio_get_index(this->pio);
+	bool irqUsed = false;
+	for (int i = 0; i < 4; i++) {
+		if (BidirDShotX1::irqInstances[pioIndex][i]) irqUsed = true;
+	}
+	BidirDShotX1::irqInstances[pioIndex][this->sm] = this;
+	this->irqEnabled = true;
+	if (!irqUsed) {
+		uint irqNum = PIO0_IRQ_0 + 2 * pioIndex;
+		irq_add_shared_handler(irqNum, BidirDShotX1::telemetryIrqHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+		irq_set_enabled(irqNum, true);
+	}
+	pio_set_irq0_source_enabled(this->pio, (pio_interrupt_source)(pis_sm0_rx_fifo_not_empty + this->sm), true);
+	return true;
+}
+
+void BidirDShotX1::telemetryIrqHandler() {
+	for (int p = 0; p < NUM_PIOS; p++) {
+		for (int i = 0; i < 4; i++) {
+			BidirDShotX1 *inst = BidirDShotX1::irqInstances[p][i];
+			if (inst) inst->readFifo();
+		}
+	}
+}
+
+bool BidirDShotX1::enableEdgeCapture() {
+	if (this->iError) {
+		return false;
+	}
+	if (this->capture) {
+		return true;
+	}
+	if (this->irqEnabled || this->freeRunTimer >= 0) {
+		DEBUG_PRINTF("Edge capture mode not available with the telemetry interrupt or free-running mode, pin=%d\n", this->pin);
+		return false;
+	}
+	uint32_t clkSys = clock_get_hz(clk_sys);
+	if (!dshotBidirCyclesPerBit(clkSys, this->speed)) {
+		DEBUG_PRINTF("Speed %d is too high for the system clock of %d Hz\n", this->speed, clkSys);
+		return false;
+	}
+	int ch = dma_claim_unused_channel(false);
+	if (ch < 0) {
+		DEBUG_PRINTF("No free DMA channels available, pin=%d\n", this->pin);
+		return false;
+	}
+	if (!this->switchProgram(20, true, dshotCalcClkDiv(clkSys, this->speed, 20))) {
+		DEBUG_PRINTF("No space for the edge capture program on the PIO of pin %d\n", this->pin);
+		dma_channel_unclaim(ch);
+		return false;
+	}
+	this->replyTimeout = calcReplyTimeout(this->speed, 20, true);
+	this->freeRunPacket = this->replyTimeout | (this->freeRunPacket & 0xFFFF);
+	this->captureRead = 0;
+	this->captureCount = 0;
+	this->lastEdgeCount = 0;
+
+	// one halfword per edge, wrapping around in captureBuffer
+	dma_channel_config c = dma_channel_get_default_config(ch);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+	channel_config_set_read_increment(&c, false);
+	channel_config_set_write_increment(&c, true);
+	channel_config_set_ring(&c, true, __builtin_ctz(DSHOT_CAPTURE_BUFFER * 2));
+	channel_config_set_dreq(&c, pio_get_dreq(this->pio, this->sm, false));
+	dma_channel_configure(ch, &c, this->captureBuffer, &this->pio->rxf[this->sm], 0xFFFFFFFF, true);
+	this->captureDma = ch;
+	return true;
+}
+
+bool BidirDShotX1::disableEdgeCapture() {
+	if (!this->capture) {
+		return true;
+	}
+	uint32_t clkSys = clock_get_hz(clk_sys);
+	uint8_t cyclesPerBit = dshotBidirCyclesPerBit(clkSys, this->speed);
+	if (!this->switchProgram(cyclesPerBit, false, dshotCalcClkDiv(clkSys, this->speed, cyclesPerBit))) {
+		DEBUG_PRINTF("No space for the program for DShot%d on the PIO of pin %d\n", this->speed, this->pin);
+		return false;
+	}
+	// switchProgram has decoded the last reply, the FIFO was cleared by the restart
+	dma_channel_abort(this->captureDma);
+	dma_channel_unclaim(this->captureDma);
+	this->captureDma = -1;
+	this->lastEdgeCount = 0;
+	this->replyTimeout = calcReplyTimeout(this->speed, cyclesPerBit, false);
+	this->freeRunPacket = this->replyTimeout | (this->freeRunPacket & 0xFFFF);
+	return true;
+}
+
+uint8_t BidirDShotX1::getCapturedEdges(uint32_t *edgesNs, uint8_t maxEdges) {
+	if (this->captureDma < 0) {
+		return 0;
+	}
+	this->readFifo();
+	uint8_t count = this->lastEdgeCount < maxEdges ? this->lastEdgeCount : maxEdges;
+	for (uint8_t i = 0; i < count; i++) {
+		edgesNs[i] = (uint64_t)this->lastEdges[i] * (2000000 / this->cyclesPerBit) / this->speed;
+	}
+	return count;
+}
+
+uint32_t BidirDShotX1::decodeEdges(const uint16_t *edges, uint8_t count, uint32_t bitTime256) {
+	if (count < 2) {
+		return 0;
+	}
+	uint32_t span = edges[count - 1] - edges[0];
+	if (!span) span = 1;
+
+	// number of bits between the first and the last edge, for bit lengths of 0.75...1.25 times the nominal one. The margin over the documented ±20% is needed, at exactly 0.8/1.2 the truncated edge times put the true bit count just outside
+	uint32_t kMin = (span * 256 * 4 + 5 * bitTime256 - 1) / (5 * bitTime256);
+	uint32_t kMax = span * 256 * 4 / (3 * bitTime256);
+	uint32_t kNominal = (span * 256 + bitTime256 / 2) / bitTime256;
+	if (kMin < 1) kMin = 1;
+	if (kMax > 21) kMax = 21;
+	if (kNominal < kMin) kNominal = kMin;
+	if (kNominal > kMax) kNominal = kMax;
+
+	// the bit count where the edges are closest to bit boundaries, ties resolved towards the nominal bit length
+	uint32_t bestK = kNominal;
+	uint32_t bestError = 0xFFFFFFFF;
+	for (uint32_t k = kMin; k <= kMax; k++) {
+		uint32_t error = 0;
+		for (uint8_t i = 1; i < count - 1; i++) {
+			uint32_t frac = ((edges[i] - edges[0]) * k * 256 / span) & 0xFF;
+			error += frac < 128 ? frac : 256 - frac;
+		}
+		uint32_t distance = k > kNominal ? k - kNominal : kNominal - k;
+		uint32_t bestDistance = bestK > kNominal ? bestK - kNominal : kNominal - bestK;
+		if (error < bestError || (error == bestError && distance < bestDistance)) {
+			bestError = error;
+			bestK = k;
+		}
+	}
+
+	// after a falling edge (even index) the line is low, after a rising edge high. The first bit is the start bit (bit 20).
+	uint32_t frame = 0;
+	uint32_t bit = 0;
+	for (uint8_t i = 0; i < count && bit < 21; i++) {
+		uint32_t next = 21;
+		if (i + 1 < count) {
+			next = ((edges[i + 1] - edges[0]) * bestK * 256 / span + 128) >> 8;
+			if (next > 21) next = 21;
+		}
+		for (; bit < next; bit++) {
+			if (i & 1) frame |= 1u << (20 - bit);
+		}
+	}
+	return frame;
+}
+
+bool BidirDShotX1::getCachedTelemetry(BidirDshotTelemetryType type, uint32_t *value) {
+	return this->telemetry.get(type, value);
+}
+
+void BidirDShotX1::getTelemetryState(BidirDShotTelemetryState *state) {
+	this->telemetry.snapshot(state);
+}
+
+void BidirDShotX1::getTelemetryStates(BidirDShotX1 *const *drivers, uint8_t count, BidirDShotTelemetryState *states) {
+	for (uint8_t i = 0; i < count; i++) {
+		drivers[i]->telemetry.snapshot(&states[i]);
+	}
+}
+
+BidirDshotTelemetryType BidirDShotX1::decodeFrame(uint32_t frame, uint32_t *value) {
+	frame = frame ^ (frame >> 1);
+	uint32_t data = escDecodeLut[frame & 0x1F];
+	data |= escDecodeLut[(frame >> 5) & 0x1F] << 4;
+	data |= escDecodeLut[(frame >> 10) & 0x1F] << 8;
+	data |= escDecodeLut[(frame >> 15) & 0x1F] << 12;
 	uint32_t checksum = (data >> 8) ^ data;
 	checksum ^= checksum >> 4;
 	checksum &= 0x0F;
@@ -250,17 +809,90 @@ BidirDshotTelemetryType BidirDShotX1::getTelemetryRaw(uint32_t *value) {
 	return telemetryTypeLut[data >> 12];
 }
 
+bool BidirDShotX1::isValidGcr(uint32_t frame) {
+	frame = frame ^ (frame >> 1);
+	for (int i = 0; i < 4; i++) {
+		if (escDecodeLut[(frame >> (5 * i)) & 0x1F] == iv) return false;
+	}
+	return true;
+}
+
+uint32_t __not_in_flash_func(BidirDShotX1::decodeFrames)(const uint32_t *frames, uint8_t count, uint32_t *values, BidirDshotTelemetryType *types) {
+	uint32_t valid = 0;
+	for (int i = 0; i < count; i += 2) {
+		// two frames per pass: transition decoding, then 2 lookups per frame
+		uint32_t a = frames[i] ^ (frames[i] >> 1);
+		uint32_t b = i + 1 < count ? frames[i + 1] ^ (frames[i + 1] >> 1) : 0;
+		uint32_t aLo = gcrPairLut.v[a & 0x3FF], aHi = gcrPairLut.v[(a >> 10) & 0x3FF];
+		uint32_t bLo = gcrPairLut.v[b & 0x3FF], bHi = gcrPairLut.v[(b >> 10) & 0x3FF];
+		uint32_t invalid = (aLo | aHi) | (bLo | bHi) << 16; // 0x100 / 0x1000000: invalid symbol
+
+		// both checksums in one word: the nibble XOR of each 16 bit half ends up in its low nibble
+		uint32_t data = (aLo & 0xFF) | (aHi & 0xFF) << 8 | (bLo & 0xFF) << 16 | (bHi & 0xFF) << 24;
+		uint32_t checksum = data ^ (data >> 8);
+		checksum ^= checksum >> 4;
+		checksum = (checksum & 0x000F000F) ^ 0x000F000F; // 0 if valid
+		checksum |= invalid & 0x01000100;
+
+		for (int j = 0; j < 2 && i + j < count; j++) {
+			uint32_t d = (data >> (16 * j)) & 0xFFFF;
+			if ((checksum >> (16 * j)) & 0xFFFF) {
+				types[i + j] = BidirDshotTelemetryType::CHECKSUM_ERROR;
+				continue;
+			}
+			values[i + j] = d >> 4;
+			types[i + j] = telemetryTypeLut[d >> 12];
+			valid |= 1u << (i + j);
+		}
+	}
+	return valid;
+}
+
 uint32_t BidirDShotX1::convertFromRaw(uint32_t raw, BidirDshotTelemetryType type) {
 	if (type == BidirDshotTelemetryType::ERPM) {
-		if (raw == 0xFFF) {
-			return 0;
-		}
-		raw = (raw & 0x1FF) << (raw >> 9); // eeem mmmm mmmm
-		if (!raw) {
+		BidirDShotErpm e;
+		if (!BidirDShotX1::decodeErpm(raw, &e)) {
 			return -1; // not quite right, but close enough
 		}
-		raw = (60000000 + 50 * raw) / raw;
-		return raw;
+		return e.erpm;
 	}
 	return raw & 0xFF;
 }
+
+bool __not_in_flash_func(BidirDShotX1::decodeErpm)(uint32_t raw, BidirDShotErpm *out, uint32_t hzFactor) {
+	if (raw == 0xFFF) {
+		out->periodUs = 0;
+		out->erpm = 0;
+		out->mechHz = 0;
+		return true;
+	}
+	uint32_t mantissa = raw & 0x1FF; // eeem mmmm mmmm
+	uint32_t exponent = (raw >> 9) & 0x7;
+	if (!mantissa) {
+		return false;
+	}
+	// 60000000 / (m << e) == (60000000 / m) >> e, so the division is in the table
+	uint32_t recip = erpmReciprocals.v[mantissa];
+	out->periodUs = mantissa << exponent;
+	out->erpm = (recip >> exponent) + 50;
+	out->mechHz = hzFactor ? ((uint64_t)recip * hzFactor) >> (16 + exponent) : 0;
+	return true;
+}
+
+uint8_t __not_in_flash_func(BidirDShotX1::decodeErpmBatch)(const uint16_t *raw, BidirDShotErpm *out, uint8_t count, uint32_t hzFactor) {
+	uint8_t valid = 0;
+	for (int i = 0; i < count; i++) {
+		if (BidirDShotX1::decodeErpm(raw[i], &out[i], hzFactor)) {
+			valid |= 1 << i;
+		}
+	}
+	return valid;
+}
+
+uint32_t BidirDShotX1::getHzFactor(uint8_t poleCount) {
+	if (!poleCount) {
+		return 0;
+	}
+	// mechanical Hz = eRPM * 2 / 60 / poles, in 1/256 Hz: 60000000 / m * 512 / (60 * poles), 16 fractional bits
+	return ((512ULL << 16) + 30 * poleCount) / (60 * poleCount);
+}
@@ -1,14 +1,17 @@
 #ifndef BIDIR_DSHOT_X1_H
 #define BIDIR_DSHOT_X1_H
 
+#include "command_queue.h"
 #include "hardware/pio.h"
-#include <vector>
-using std::vector;
+#include "link_stats.h"
+#include "telemetry_history.h"
+#include "telemetry_state.h"
 
 enum class BidirDshotTelemetryType : uint8_t {
 	ERPM,
 	OTHER_VALUE,
 	CHECKSUM_ERROR,
+	NO_REPLY,
 	NO_PACKET,
 	VOLTAGE,
 	CURRENT,
@@ -19,6 +22,17 @@ enum class BidirDshotTelemetryType : uint8_t {
 	DEBUG_FRAME_2,
 };
 
+/**
+ * @brief Decoded eRPM telemetry value, see BidirDShotX1::decodeErpm
+ */
+struct BidirDShotErpm {
+	uint32_t periodUs; /// electrical period in us, 0 if the motor is stopped
+	uint32_t erpm; /// electrical RPM, same as getTelemetryErpm
+	uint32_t mechHz; /// mechanical rotation speed in 1/256 Hz, 0 if no pole count was given
+};
+
+#define DSHOT_CAPTURE_EDGES 24 /// max. edges per reply in the edge capture mode (start bit + 20 transitions + end of the last bit, with margin)
+
 #define ESC_STATUS_MAX_STRESS_MASK 0b00001111
 #define ESC_STATUS_ERROR_MASK 0b00100000
 #define ESC_STATUS_WARNING_MASK 0b01000000
@@ -26,12 +40,14 @@ enum class BidirDshotTelemetryType : uint8_t {
 
 class BidirDShotX1 {
 public:
-	static vector<BidirDShotX1 *> instances;
-
 	BidirDShotX1() = delete;
 	/**
 	 * @brief Initialize a new BidirDShotX1 instance
 	 *
+	 * The state machine samples each bit 40 times (32 times per reply bit). If the system clock is too slow for that (above DShot2400 at 125MHz), a second program with half the oversampling (8 samples per reply bit) is used instead, e.g. DShot4800 needs 96MHz then. Both programs need 30 instructions, so drivers that use different ones can't share a PIO.
+	 *
+	 * The reduced oversampling tolerates less drift of the ESC clock: replies are decoded if their bit time is within ±10% (-12...+16% with the full oversampling). For ESCs that are marginal at such a speed, use enableEdgeCapture (±20%).
+	 *
 	 * @param pin the ESC pin
 	 * @param speed DShot speed in kBaud, e.g. 600 for DShot600
 	 * @param pio the PIO instance to use, default is pio0
@@ -73,6 +89,38 @@ public:
 	 */
 	void sendRaw12Bit(uint16_t data);
 
+	/**
+	 * @brief Queue a special command, sent by the next calls of sendThrottle instead of the throttle
+	 *
+	 * Non-blocking: every sendThrottle call sends one packet of the command (with the telemetry request bit set), until it was sent often enough. Then the throttle is sent again until the spacing of the command has passed, and the next queued command follows. Repeats and spacing are chosen by command, e.g. 10 packets for DSHOT_CMD_SAVE_SETTINGS and 35ms until the next command. Only send commands while the motor is stopped.
+	 *
+	 * @param command special command, 0...47 (see DShotCommand)
+	 * @return true if the command was queued
+	 * @return false if the command is invalid or the queue (DSHOT_COMMAND_QUEUE entries) is full
+	 */
+	bool queueCommand(uint16_t command);
+
+	/**
+	 * @brief Queue a special command with a custom repeat count and spacing, see queueCommand(uint16_t)
+	 *
+	 * @param command special command, 0...47 (see DShotCommand)
+	 * @param repeats number of consecutive packets, 1...255
+	 * @param spacingUs minimum time after the last packet of this command until the next command is sent
+	 * @return true if the command was queued
+	 * @return false if the parameters are invalid or the queue is full
+	 */
+	bool queueCommand(uint16_t command, uint8_t repeats, uint32_t spacingUs);
+
+	/**
+	 * @brief Get the number of queued commands that were not completely sent yet (including the spacing after the last one)
+	 */
+	uint8_t getQueuedCommands();
+
+	/**
+	 * @brief Remove all queued commands, a partially sent command is cut off
+	 */
+	void clearCommandQueue();
+
 	/**
 	 * @brief check if a telemetry packet is available
 	 *
@@ -89,7 +137,7 @@ public:
 	 * Leaves the erpm pointer unchanged if no packet is available, the checksum is invalid or the packet type is not ERPM. No-op (does not stall) if no packet is available.
 	 *
 	 * @param erpm pointer to a uint32_t to store the erpm. Must be a valid pointer, not nullptr.
-	 * @return BidirDshotTelemetryType ::ERPM, ::OTHER_VALUE, ::NO_PACKET or ::CHECKSUM_ERROR
+	 * @return BidirDshotTelemetryType ::ERPM, ::OTHER_VALUE, ::NO_PACKET, ::NO_REPLY or ::CHECKSUM_ERROR
 	 */
 	BidirDshotTelemetryType getTelemetryErpm(uint32_t *erpm);
 
@@ -119,6 +167,137 @@ public:
 	 */
 	BidirDshotTelemetryType getTelemetryRaw(uint32_t *value);
 
+	/**
+	 * @brief Get all telemetry frames that were received since the last call
+	 *
+	 * Independent of the other getTelemetry functions: every frame ends up in the history, even if it was already read as the latest packet. The history holds DSHOT_TELEMETRY_HISTORY frames (see dshot_config.h), newer frames are dropped and counted (getTelemetryOverflows) until it is read.
+	 *
+	 * @param frames array to store the frames, oldest first
+	 * @param maxFrames size of the array. Frames that don't fit are returned by the next call.
+	 * @return uint8_t number of frames stored in the array
+	 */
+	uint8_t getTelemetryHistory(BidirDShotTelemetryFrame *frames, uint8_t maxFrames);
+
+	/**
+	 * @brief Get the number of telemetry frames that were dropped because the history was full
+	 *
+	 * @return uint32_t total count since initialisation
+	 */
+	uint32_t getTelemetryOverflows();
+
+	/**
+	 * @brief Get the link statistics of this ESC: sent packets, replies, errors, overruns and the read latency
+	 *
+	 * Cheap (copies a few words, no locking), may be called from the other core or an interrupt.
+	 *
+	 * @param stats pointer to store the statistics. Must be a valid pointer, not nullptr.
+	 */
+	void getLinkStats(BidirDShotLinkStats *stats);
+
+	/**
+	 * @brief Sets all link statistics to 0, except historyDrops (see getTelemetryOverflows). Call from the core that sends the packets.
+	 */
+	void resetLinkStats();
+
+	/**
+	 * @brief Let the DMA resend the packet at a fixed rate, without any CPU involvement
+	 *
+	 * Uses 2 DMA channels and 1 DMA pacing timer. The send functions then only replace the packet that is sent with the next period, so the ESC stays armed even if the CPU is busy. Also enables the telemetry interrupt (see enableTelemetryIrq), timestamps in the history are then the time the frame was received.
+	 *
+	 * @param rate packets per second. The packet, the ESC's reply and the turnaround time need to fit into one period (e.g. max. ~10kHz for DShot600), min. clk_sys / 65535 (~1.9kHz at 125MHz)
+	 * @return true if the free-running mode was started
+	 * @return false if the rate is out of range, no DMA channel/timer is free or there was an initialisation error
+	 */
+	bool startFreeRunning(uint32_t rate);
+
+	/**
+	 * @brief Stop the free-running mode, the send functions send immediately again
+	 */
+	void stopFreeRunning();
+
+	/**
+	 * @brief Decode telemetry in an interrupt as soon as it arrives
+	 *
+	 * Uses the RX FIFO not empty interrupt (PIOx_IRQ_0, shared handler) of the state machine. All reading functions keep working, but they only read memory instead of polling the PIO. Call the reading functions from the core that called this function.
+	 *
+	 * @return true if the interrupt is enabled
+	 * @return false if there was an initialisation error
+	 */
+	bool enableTelemetryIrq();
+
+	/**
+	 * @brief Switch to the edge capture mode: the PIO records the time of every edge of the reply, the CPU recovers the bit clock and decodes the frame
+	 *
+	 * Instead of counting fixed bit lengths on the PIO, the time of every edge (resolution 1/8 reply bit) is written to a ring buffer (DSHOT_CAPTURE_BUFFER, see dshot_config.h) by a DMA channel. When the telemetry is read (or the next packet is sent), decodeEdges fits the bit period to all edges, so ESC clock errors of up to ±20% are tolerated, and the program needs only 20 PIO cycles per bit (e.g. 96MHz for DShot4800). Costs a few microseconds of CPU time per reply. The edges of the last reply can be read with getCapturedEdges to debug ESC timing. All telemetry functions keep working.
+	 *
+	 * Not available together with the telemetry interrupt and the free-running mode. Uses 21 instructions, which don't fit next to the other BidirDShotX1 programs on one PIO.
+	 *
+	 * @return true if the edge capture mode is active
+	 * @return false if there was an initialisation error, the telemetry interrupt or free-running mode is enabled, the system clock is too slow for the speed, no DMA channel is free or the program doesn't fit
+	 */
+	bool enableEdgeCapture();
+
+	/**
+	 * @brief Switch back to decoding on the PIO, see enableEdgeCapture
+	 *
+	 * @return true if the edge capture mode is off
+	 * @return false if the normal program doesn't fit into the PIO, the edge capture mode stays active
+	 */
+	bool disableEdgeCapture();
+
+	/**
+	 * @brief Get the edges of the last reply in the edge capture mode
+	 *
+	 * The first edge is the falling edge of the start bit (its time is the turnaround), then rising and falling edges alternate.
+	 *
+	 * @param edgesNs array to store the time of every edge in ns after the end of the packet, resolution 1/8 reply bit
+	 * @param maxEdges size of the array, max. DSHOT_CAPTURE_EDGES
+	 * @return uint8_t number of edges stored, 0 if the last packet wasn't answered or the edge capture mode is off
+	 */
+	uint8_t getCapturedEdges(uint32_t *edgesNs, uint8_t maxEdges);
+
+	/**
+	 * @brief Recovers a reply frame from edge times, used by the edge capture mode
+	 *
+	 * Fits the bit period to the edges: every possible number of bits between the first and the last edge within ±25% of the nominal bit length is tried (margin for the ±20% of enableEdgeCapture), and the one where all edges are closest to bit boundaries is used. The levels between the edges then give the bits.
+	 *
+	 * @param edges time of every edge, increasing, first one = falling edge of the start bit, in any unit
+	 * @param count number of edges
+	 * @param bitTime256 nominal length of one reply bit (4/5 of a packet bit) in the unit of edges, multiplied by 256
+	 * @return uint32_t 21 bit frame for decodeFrame, 0 if there are less than 2 edges
+	 */
+	static uint32_t decodeEdges(const uint16_t *edges, uint8_t count, uint32_t bitTime256);
+
+	/**
+	 * @brief Get the last valid value of a telemetry type
+	 *
+	 * Every valid frame is stored (converted, see getTelemetryPacket) per type, no matter if it was read by another function. Useful with enableTelemetryIrq, e.g. to read the temperature once in a while while the eRPM is read every loop.
+	 *
+	 * @param type ::ERPM, ::TEMPERATURE, ::VOLTAGE, ::CURRENT, ::STATUS, ::STRESS, ::DEBUG_FRAME_1 or ::DEBUG_FRAME_2
+	 * @param value pointer to a uint32_t to store the value. Must be a valid pointer, not nullptr.
+	 * @return true if a value of this type was received since initialisation
+	 * @return false if not, value is left unchanged
+	 */
+	bool getCachedTelemetry(BidirDshotTelemetryType type, uint32_t *value);
+
+	/**
+	 * @brief Get the latest value, timestamp and count of every telemetry type at once
+	 *
+	 * Same values as getCachedTelemetry, updated whenever frames are read from the PIO (by the send and getTelemetry functions, or by the interrupt). Replaces the switch over all types: e.g. state.get(BidirDshotTelemetryType::VOLTAGE).value, and state.isStale(...) to detect an ESC that stopped sending a type. O(1), consistent even if called from the other core.
+	 *
+	 * @param state pointer to store the snapshot. Must be a valid pointer, not nullptr.
+	 */
+	void getTelemetryState(BidirDShotTelemetryState *state);
+
+	/**
+	 * @brief Get the telemetry state of several ESCs with one call, see getTelemetryState
+	 *
+	 * @param drivers array of drivers
+	 * @param count number of drivers
+	 * @param states array of count states, in the order of the drivers
+	 */
+	static void getTelemetryStates(BidirDShotX1 *const *drivers, uint8_t count, BidirDShotTelemetryState *states);
+
 	/**
 	 * @brief Converts a getTelemetryRaw value to a getTelemetryPacket value
 	 *
@@ -130,6 +309,90 @@ public:
 	 */
 	static uint32_t convertFromRaw(uint32_t raw, BidirDshotTelemetryType type);
 
+	/**
+	 * @brief Decodes the raw value of an ERPM frame into period, eRPM and mechanical speed
+	 *
+	 * Division-free (reciprocal table in RAM), use it for filters that need the motor speed of every frame.
+	 *
+	 * @param raw the raw 12 bit value from getTelemetryRaw or the history, type ::ERPM
+	 * @param out pointer to store the result. Must be a valid pointer, not nullptr.
+	 * @param hzFactor result of getHzFactor for the pole count of the motor, 0 if mechHz is not needed
+	 * @return true if the value is valid
+	 * @return false if the mantissa is 0 (usually declared as CHECKSUM_ERROR), out is left unchanged
+	 */
+	static bool decodeErpm(uint32_t raw, BidirDShotErpm *out, uint32_t hzFactor = 0);
+
+	/**
+	 * @brief Decodes the raw values of several ERPM frames, e.g. of all motors, see decodeErpm
+	 *
+	 * @param raw array of count raw 12 bit values
+	 * @param out array of count results, invalid values are left unchanged
+	 * @param count number of values, max. 8
+	 * @param hzFactor result of getHzFactor for the pole count of the motors, 0 if mechHz is not needed
+	 * @return uint8_t bit mask of the valid values
+	 */
+	static uint8_t decodeErpmBatch(const uint16_t *raw, BidirDShotErpm *out, uint8_t count, uint32_t hzFactor = 0);
+
+	/**
+	 * @brief Calculates the factor for the mechanical speed in decodeErpm (one division, call it once at startup)
+	 *
+	 * @param poleCount number of magnetic poles of the motor (e.g. 14 for most 5" quad motors)
+	 * @return uint32_t factor for decodeErpm and decodeErpmBatch
+	 */
+	static uint32_t getHzFactor(uint8_t poleCount);
+
+	/**
+	 * @brief Decodes a telemetry frame as it was received on the line
+	 *
+	 * Undoes the transition encoding and the GCR encoding and verifies the checksum. Used by all bidirectional drivers.
+	 *
+	 * @param frame 21 bit frame, first received bit (start bit, always 0) in bit 20, one bit per reply bit
+	 * @param value pointer to a uint32_t to store the 12 bit raw value (see getTelemetryRaw), only written if the frame is valid
+	 * @return BidirDshotTelemetryType, all values except ::OTHER_VALUE, ::NO_REPLY and ::NO_PACKET may be returned
+	 */
+	static BidirDshotTelemetryType decodeFrame(uint32_t frame, uint32_t *value);
+
+	/**
+	 * @brief Checks if all 4 GCR symbols of a frame are valid, to tell bit errors from checksum errors
+	 *
+	 * @param frame 21 bit frame, same as decodeFrame
+	 * @return true if all symbols are valid GCR codes
+	 */
+	static bool isValidGcr(uint32_t frame);
+
+	/**
+	 * @brief Decodes several telemetry frames in one pass, same results as calling decodeFrame for each
+	 *
+	 * Two frames are checked per pass (both checksums in one word) and two GCR symbols per lookup (2kB table in RAM), so there are half the table loads and no function call per frame. See the Decode_Benchmark example for the speedup on the target.
+	 *
+	 * @param frames array of count 21 bit frames, see decodeFrame
+	 * @param count number of frames, max. 32
+	 * @param values array of count 12 bit raw values, only written for valid frames
+	 * @param types array of count types, ::CHECKSUM_ERROR or the type of the frame
+	 * @return uint32_t bit mask of the valid frames (bit n = frame n)
+	 */
+	static uint32_t decodeFrames(const uint32_t *frames, uint8_t count, uint32_t *values, BidirDshotTelemetryType *types);
+
+	/**
+	 * @brief Changes the DShot speed without reinitialising the driver
+	 *
+	 * The state machine, the pins and the program stay claimed. The new divider is applied between two packets (the call blocks until the current packet and its reply window is done). If the new speed needs the other program (see BidirDShotX1::BidirDShotX1), the state machine is restarted with it, unread replies are kept. Free-running mode is stopped and restarted with the same rate. Also used by dshotClockChanged to recalculate the divider for a new system clock.
+	 *
+	 * @param speed speed in kBaud, e.g. 600 for DShot600, 150...4800
+	 * @return true if the speed was changed
+	 * @return false if the driver is not initialised or the speed is invalid or too high for the system clock, the other program doesn't fit into the PIO, or free-running mode could not be restarted (rate too high for the new speed)
+	 */
+	bool setSpeed(uint32_t speed);
+
+	/**
+	 * @brief Get the current DShot speed
+	 *
+	 * @return uint32_t speed in kBaud, e.g. 600 for DShot600
+	 */
+	uint32_t getSpeed() {
+		return speed;
+	}
+
 	/**
 	 * @brief checks if there was an error during initialisation of the DShot driver
 	 *
@@ -148,7 +411,36 @@ private:
 	uint8_t sm; /// which state machine is used for the DShot driver
 	uint32_t speed; /// speed in kBaud, e.g. 600 for DShot600
 	uint8_t offset; /// program offset in the PIO instruction memory (needed to point to the same memory location in the next driver)
+	uint8_t cyclesPerBit = 40; /// PIO cycles per bit of the loaded program: 40 (bidir_dshot_x1) or 20 (bidir_dshot_x1_fast, bidir_dshot_x1_capture)
+	bool capture = false; /// whether bidir_dshot_x1_capture is loaded (edge capture mode)
 	bool iError = false; /// shows if there was an error during initialisation
+	bool irqEnabled = false; /// whether the FIFO is read by the interrupt handler
+	int freeRunTimer = -1; /// DMA pacing timer in free-running mode, -1 if not free-running
+	uint32_t freeRunRate = 0; /// packets per second in free-running mode, used to restart it after a speed change
+	int freeRunDma[2] = {-1, -1}; /// free-running DMA channels: [0] paced by the timer, starts [1], [1] writes the packet and re-arms [0]
+	uint32_t replyTimeout = 0; /// reply window of the PIO program, in the left 16 bits of every word written to the TX FIFO
+	volatile uint32_t freeRunPacket = 0; /// last packet (as written to the TX FIFO), resent by [1] in free-running mode
+	volatile uint32_t *freeRunSource = &freeRunPacket; /// [0] copies this to the read address of [1]
+	volatile uint32_t lastSendTime = 0; /// time_us_32() of the last sent packet, timestamp for its reply
+	BidirDShotTelemetryHistory history; /// all received frames until they are read
+	uint16_t latestRaw = 0; /// raw value of the latest frame
+	BidirDshotTelemetryType latestType; /// type of the latest frame
+	volatile bool latestAvailable = false; /// whether the latest frame has not been read yet
+	uint32_t latestTime = 0; /// timestamp of the latest frame, same as in the history
+	BidirDShotLinkCounters linkStats; /// statistics for getLinkStats
+	DShotCommandQueue commands; /// special commands that are sent instead of the throttle
+	BidirDShotTelemetryAggregator telemetry; /// last valid value per type, for getCachedTelemetry and getTelemetryState
+	int captureDma = -1; /// DMA channel that empties the RX FIFO into captureBuffer in the edge capture mode, -1 if off
+	uint32_t captureRead = 0; /// number of halfwords of captureBuffer that were processed (the DMA counts the written ones)
+	uint16_t captureEdges[DSHOT_CAPTURE_EDGES]; /// edge times of the reply that is currently collected, in loops since the end of the packet
+	uint8_t captureCount = 0; /// number of edges in captureEdges, 0xFF while skipping the rest of a reply that was partially overwritten
+	uint16_t lastEdges[DSHOT_CAPTURE_EDGES]; /// edge times of the last complete reply, for getCapturedEdges
+	uint8_t lastEdgeCount = 0; /// number of edges in lastEdges
+	alignas(DSHOT_CAPTURE_BUFFER * 2) uint16_t captureBuffer[DSHOT_CAPTURE_BUFFER]; /// ring buffer of the DMA: remaining window at every edge, 0xFFFF at the end of every window
+
+	static BidirDShotX1 *irqInstances[NUM_PIOS][4]; /// instances with enabled interrupt, by PIO and state machine
+
+	friend class DShotMotorGroup; // sends the packets of several instances together
 
 	/**
 	 * @brief appends a checksum to the outgoing DShot packet
@@ -159,6 +451,79 @@ private:
 	 * @return uint16_t 16 bit full packet with checksum appended
 	 */
 	static uint16_t appendChecksum(uint16_t data);
+
+	/**
+	 * @brief gets the 12 bit data for sendThrottle: the next queued command, or the throttle
+	 */
+	uint16_t nextThrottleData(uint16_t throttle);
+
+	/**
+	 * @brief builds the word for the TX FIFO: reply window and inverted packet with checksum
+	 *
+	 * @param data 12 bit data, see sendRaw12Bit
+	 */
+	uint32_t makePacket(uint16_t data);
+
+	/**
+	 * @brief writes a packet to the TX FIFO (not in free-running mode), reads the RX FIFO and counts overruns
+	 */
+	void sendPacket(uint32_t packet);
+
+	/**
+	 * @brief moves all frames from the RX FIFO (or the capture buffer) to the history and the latest frame
+	 */
+	void readFifo();
+
+	/**
+	 * @brief decodes all complete replies in the capture buffer, called by readFifo in the edge capture mode
+	 */
+	void readCapture();
+
+	/**
+	 * @brief decodes a frame and stores it in the history, the latest frame, the statistics and the telemetry state
+	 *
+	 * @param frame 21 bit frame, see decodeFrame, 0 if there was no reply
+	 * @param turnaroundNs measured turnaround, 0 if unknown
+	 */
+	void storeFrame(uint32_t frame, uint16_t turnaroundNs);
+
+	/**
+	 * @brief checks if the state machine waits for the next packet (the previous packet and its reply window are done) and the TX FIFO is empty
+	 */
+	bool isIdle();
+
+	/**
+	 * @brief shared interrupt handler for all PIOs, reads the FIFOs of all instances with enabled interrupt
+	 */
+	static void telemetryIrqHandler();
+
+	/**
+	 * @brief configures and starts the state machine at the loaded program (offset, cyclesPerBit), idle high
+	 *
+	 * @param clkDiv divider in 16.8 fixed point, see dshotCalcClkDiv
+	 */
+	void initSm(uint32_t clkDiv);
+
+	/**
+	 * @brief restarts the state machine with the program for cyclesPerBit and capture, between two packets
+	 *
+	 * @return false if the program doesn't fit, the state machine keeps the current program and speed
+	 */
+	bool switchProgram(uint8_t cyclesPerBit, bool capture, uint32_t clkDiv);
+
+	/**
+	 * @brief calculates the reply window (PIO loops of 2 cycles) for the packet word, see DSHOT_REPLY_TIMEOUT_US
+	 *
+	 * @param cyclesPerBit PIO cycles per bit of the program
+	 * @param capture the window of bidir_dshot_x1_capture also has to cover the reply itself
+	 * @return uint32_t the window, already shifted into the upper 16 bits
+	 */
+	static uint32_t calcReplyTimeout(uint32_t speed, uint8_t cyclesPerBit, bool capture);
+
+	/**
+	 * @brief clock change callback, see dshotRegisterClockCallback
+	 */
+	static void onClockChange(void *driver);
 };
 
 #endif // BIDIR_DSHOT_X1_H
@@ -0,0 +1,458 @@
+#include "bidir_dshot_x4.h"
+#include "dshot_blackbox.h"
+#include "dshot_common.h"
+#include "dshot_registry.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/timer.h"
+#include "pio/bidir_dshot_x4.pio.h"
+
+BidirDShotX4::BidirDShotX4(uint8_t pinBase, uint8_t pinCount, uint32_t speed, PIO pio, int8_t sm) {
+#if DBG
+	char pioStr[32] = "";
+	pioToPioStr(pio, pioStr);
+#else
+	char *pioStr = nullptr;
+#endif
+
+	// ensure valid parameters
+	if (sm >= 4 || sm < -1 ||
+		pinBase >= NUM_BANK0_GPIOS || pinCount > 4 || !pinCount ||
+		speed < 150 || speed > 4800 ||
+		(pio != pio0 && pio != pio1
+#if NUM_PIOS > 2
+		 && pio != pio2
+#endif
+		 )) {
+		// Bidir Dshot 150 is not official, but since the protocol itself is fine with it, it is allowed here
+		DEBUG_PRINTF("Invalid parameters: Check that sm is -1...3, pinBase is 0...29 (or 0...47 on RP2350), pinCount is 1...4, speed is 150...4800 and pio is pio0 or pio1 (or pio2 on RP2350). You supplied: sm=%d, pinBase=%d, pinCount=%d, speed=%d, pio=%s\n", sm, pinBase, pinCount, speed, pioStr);
+		iError = true;
+		return;
+	}
+
+	if (speed != 300 && speed != 600 && speed != 1200 && speed != 2400) {
+		DEBUG_PRINTF("Unofficial speed: %d. Unless you know what you are doing, please select DShot 300, 600, 1200 or 2400.\n", speed);
+	}
+
+	uint32_t clkSys = clock_get_hz(clk_sys);
+	if (dshotCalcClkDiv(clkSys, speed) < 256) {
+		DEBUG_PRINTF("Speed %d is too high for the system clock of %d Hz\n", speed, clkSys);
+		iError = true;
+		return;
+	}
+
+	// Check if SM is claimed, then claim it
+	if (sm == -1) {
+		sm = pio_claim_unused_sm(pio, false);
+		if (sm < 0) {
+			DEBUG_PRINTF("No free state machines available, pio=%s\n", pioStr);
+			iError = true;
+			return;
+		}
+	} else {
+		if (pio_sm_is_claimed(pio, sm)) {
+			DEBUG_PRINTF("SM provided but already claimed, pio=%s, sm=%d", pioStr, sm);
+			iError = true;
+			return;
+		}
+		pio_sm_claim(pio, sm);
+	}
+	this->sm = sm;
+
+	// claim a DMA channel for the telemetry capture
+	this->dmaChannel = dma_claim_unused_channel(false);
+	if (this->dmaChannel < 0) {
+		DEBUG_PRINTF("No free DMA channels available, pio=%s\n", pioStr);
+		iError = true;
+		pio_sm_unclaim(pio, sm);
+		return;
+	}
+
+	// load the program, unless it is already loaded on this PIO
+	int o = dshotClaimProgram(pio, DShotProgram::BIDIR_X4);
+	if (o < 0) {
+		DEBUG_PRINTF("No space for program on %s", pioStr);
+		iError = true;
+		dma_channel_unclaim(this->dmaChannel);
+		pio_sm_unclaim(pio, sm);
+		return;
+	}
+	this->offset = o;
+
+	// set up GPIOs
+	uint64_t pinMask = ((1ull << pinCount) - 1) << pinBase;
+	for (int i = 0; i < pinCount; i++) {
+		uint8_t pin = pinBase + i;
+		pio_gpio_init(pio, pin);
+		gpio_set_pulls(pin, true, false);
+	}
+
+	// set up the state machine
+	pio_sm_config c = bidir_dshot_x4_program_get_default_config(this->offset);
+	sm_config_set_set_pins(&c, pinBase, pinCount);
+	sm_config_set_out_pins(&c, pinBase, pinCount);
+	sm_config_set_in_pins(&c, pinBase);
+	sm_config_set_out_shift(&c, false, false, 32);
+	sm_config_set_in_shift(&c, false, true, 32);
+	uint32_t clkDiv = dshotCalcClkDiv(clkSys, speed);
+	sm_config_set_clkdiv_int_frac(&c, clkDiv >> 8, clkDiv & 0xFF);
+	pio_sm_init(pio, this->sm, this->offset, &c);
+	dshotSmSetPinsHigh(pio, this->sm, pinMask); // idle high
+	pio_sm_set_consecutive_pindirs(pio, this->sm, pinBase, pinCount, true);
+	pio_sm_set_enabled(pio, this->sm, true);
+
+	// set up the DMA channel, it is started with every packet
+	dma_channel_config dc = dma_channel_get_default_config(this->dmaChannel);
+	channel_config_set_transfer_data_size(&dc, DMA_SIZE_32);
+	channel_config_set_read_increment(&dc, false);
+	channel_config_set_write_increment(&dc, true);
+	channel_config_set_dreq(&dc, pio_get_dreq(pio, this->sm, false));
+	this->captureWords = calcCaptureWords(speed);
+	dma_channel_configure(this->dmaChannel, &dc, this->captureBuffer, &pio->rxf[this->sm], this->captureWords, false);
+
+	// store the parameters
+	this->pio = pio;
+	this->pinBase = pinBase;
+	this->pinCount = pinCount;
+	this->speed = speed;
+	this->iError = false;
+	dshotRegisterClockCallback(pio, this->sm, BidirDShotX4::onClockChange, this);
+}
+
+BidirDShotX4::~BidirDShotX4() {
+	// if this instance is not initialized, do nothing
+	if (this->iError) {
+		return;
+	}
+
+	// stop the state machine and the DMA channel
+	pio_sm_set_enabled(this->pio, this->sm, false);
+	if (this->sm >= 0) {
+		pio_sm_unclaim(this->pio, this->sm);
+	}
+	dma_channel_abort(this->dmaChannel);
+	dma_channel_unclaim(this->dmaChannel);
+	dshotReleaseProgram(this->pio, DShotProgram::BIDIR_X4);
+	dshotRegisterClockCallback(this->pio, this->sm, nullptr, nullptr);
+
+	// free the GPIO pins => pull up to reduce artifacts
+	for (int i = 0; i < this->pinCount; i++) {
+		uint8_t pin = this->pinBase + i;
+		gpio_set_pulls(pin, true, false);
+		gpio_set_dir(pin, GPIO_IN);
+		gpio_set_function(pin, GPIO_FUNC_NULL);
+	}
+}
+
+bool BidirDShotX4::setSpeed(uint32_t speed) {
+	if (this->iError) {
+		return false;
+	}
+	if (speed < 150 || speed > 4800) {
+		DEBUG_PRINTF("Invalid speed: %d, must be 150...4800\n", speed);
+		return false;
+	}
+	uint32_t clkSys = clock_get_hz(clk_sys);
+	uint32_t clkDiv = dshotCalcClkDiv(clkSys, speed);
+	if (clkDiv < 256) {
+		DEBUG_PRINTF("Speed %d is too high for the system clock of %d Hz\n", speed, clkSys);
+		return false;
+	}
+
+	dshotSetClkDivBetweenFrames(this->pio, this->sm, clkDiv);
+	this->processCapture(); // decode the last capture with its length, an unfinished one is discarded by the next packet
+	this->captureWords = calcCaptureWords(speed);
+	this->speed = speed;
+	return true;
+}
+
+uint8_t BidirDShotX4::calcCaptureWords(uint32_t speed) {
+	// 5 reply bits per 4 DShot bits, 2 reply bits per word
+	uint32_t skewBits = (BIDIR_DSHOT_X4_REPLY_SKEW_US * speed * 5 / 4 + 999) / 1000;
+	if (skewBits < 11) skewBits = 11;
+	uint32_t words = (21 + skewBits + 1) / 2;
+	return words > BIDIR_DSHOT_X4_CAPTURE_WORDS ? BIDIR_DSHOT_X4_CAPTURE_WORDS : words;
+}
+
+void BidirDShotX4::onClockChange(void *driver) {
+	BidirDShotX4 *d = (BidirDShotX4 *)driver;
+	d->setSpeed(d->speed);
+}
+
+void BidirDShotX4::sendThrottles(uint16_t throttles[4]) {
+	// check if the throttle value is valid
+	for (int i = 0; i < 4; i++) {
+		if (throttles[i] > 2000) {
+			throttles[i] = 2000;
+		}
+		if (throttles[i]) throttles[i] += 47;
+		throttles[i] <<= 1;
+	}
+	this->sendRaw12Bit(throttles);
+}
+
+void BidirDShotX4::sendRaw11Bit(uint16_t data[4]) {
+	for (int i = 0; i < 4; i++)
+		data[i] = (data[i] << 1) | 1;
+	this->sendRaw12Bit(data);
+}
+
+void BidirDShotX4::sendRaw12Bit(uint16_t data[4]) {
+	for (int i = 0; i < 4; i++)
+		data[i] = this->appendChecksum(data[i]);
+	for (int i = 0; i < this->pinCount; i++)
+		dshotBlackboxTx(this->pinBase + i, data[i]);
+
+	uint32_t motorPacket[2];
+	dshotPackX4(data, motorPacket);
+
+	// decode the replies to the previous packet, so that the history doesn't miss any frame
+	this->processCapture();
+
+	uint8_t pc = pio_sm_get_pc(this->pio, this->sm);
+	if (pc != this->offset + 2) {
+		// still sending or waiting for/receiving replies => start over
+		if (this->capturePending) {
+			// no edge at all (PC in wait_for_edge) means no ESC replied, otherwise the capture is cut short
+			bool noEdge = pc >= this->offset + 12 && pc <= this->offset + 16;
+			if (noEdge) this->latestTime = this->captureTime;
+			for (int i = 0; i < this->pinCount; i++) {
+				if (noEdge) {
+					// same as a capture without a reply on this channel
+					dshotBlackboxRx(this->pinBase + i, 0);
+					this->storeNoReply(i);
+				} else {
+					this->linkStats[i].countOverrun();
+				}
+			}
+		}
+		pio_sm_exec(this->pio, this->sm, pio_encode_jmp(this->offset));
+		dma_channel_abort(this->dmaChannel);
+		pio_sm_clear_fifos(this->pio, this->sm);
+	}
+	this->captureTime = time_us_32();
+	dma_channel_set_write_addr(this->dmaChannel, this->captureBuffer, false);
+	dma_channel_set_trans_count(this->dmaChannel, this->captureWords, true);
+	this->capturePending = true;
+
+	pio_sm_put(this->pio, this->sm, ~motorPacket[0]);
+	pio_sm_put(this->pio, this->sm, ~motorPacket[1]);
+	pio_sm_put(this->pio, this->sm, this->captureWords * 2 - 1); // capture length in reply bits - 1
+	for (int i = 0; i < this->pinCount; i++)
+		this->linkStats[i].countSent();
+}
+
+uint16_t BidirDShotX4::appendChecksum(uint16_t data) {
+	int csum = data;
+	csum ^= data >> 4;
+	csum ^= data >> 8;
+	csum = ~csum;
+	csum &= 0xF;
+	return (data << 4) | csum;
+}
+
+/**
+ * @brief finds the next sample of a channel that does not have the given level
+ *
+ * @param samples capture buffer, 8 samples per word, first sample in the highest nibble
+ * @param words number of words in the capture buffer
+ * @param channel the channel (bit within each nibble)
+ * @param pos first sample to check
+ * @param level the current level
+ * @return int the index of the sample, words * 8 if the level does not change anymore
+ */
+static int findLevelChange(const uint32_t *samples, uint8_t words, uint8_t channel, int pos, bool level) {
+	const uint32_t flip = level ? 0x11111111 : 0;
+	int word = pos >> 3;
+	uint32_t w = (((samples[word] >> channel) & 0x11111111) ^ flip) << ((pos & 7) * 4);
+	if (w) {
+		return pos + (__builtin_clz(w) >> 2);
+	}
+	while (++word < words) {
+		w = ((samples[word] >> channel) & 0x11111111) ^ flip;
+		if (w) {
+			return word * 8 + (__builtin_clz(w) >> 2);
+		}
+	}
+	return words * 8;
+}
+
+bool BidirDShotX4::extractFrame(const uint32_t *samples, uint8_t words, uint8_t channel, uint32_t *frame) {
+	// the start bit is the first low sample, the capture has to reach into the last bit
+	int end = words * 8;
+	int pos = findLevelChange(samples, words, channel, 0, true);
+	if (pos + 20 * 4 >= end) {
+		return false;
+	}
+
+	// one bit takes 4 samples, so every run of equal samples is rounded to the nearest multiple of 4
+	uint32_t f = 0;
+	int bits = 0;
+	bool level = false;
+	while (bits < 21) {
+		int next = findLevelChange(samples, words, channel, pos, level);
+		if (next == end) {
+			// no more edges: the remaining bits are 1s if the line stays high. If it is low, the capture has to cover them, otherwise the reply is cut off (e.g. slow ESC clock)
+			int n = 21 - bits;
+			if (!level && ((end - pos + 2) >> 2) < n) {
+				return false;
+			}
+			f <<= n;
+			if (level) f |= (1 << n) - 1;
+			break;
+		}
+		int n = (next - pos + 2) >> 2;
+		if (n > 21 - bits) n = 21 - bits;
+		f <<= n;
+		if (level) f |= (1 << n) - 1;
+		bits += n;
+		level = !level;
+		pos = next;
+	}
+
+	*frame = f;
+	return true;
+}
+
+void BidirDShotX4::processCapture() {
+	if (!this->capturePending || dma_channel_is_busy(this->dmaChannel)) {
+		return;
+	}
+	this->capturePending = false;
+	this->latestTime = this->captureTime;
+
+	// extract all frames first, then decode them in one pass
+	uint32_t frames[4] = {};
+	uint8_t replied = 0;
+	for (int i = 0; i < this->pinCount; i++) {
+		if (extractFrame(this->captureBuffer, this->captureWords, i, &frames[i])) replied |= 1 << i;
+		dshotBlackboxRx(this->pinBase + i, replied & (1 << i) ? frames[i] : 0);
+	}
+	uint32_t raws[4] = {};
+	BidirDshotTelemetryType types[4];
+	BidirDShotX1::decodeFrames(frames, this->pinCount, raws, types);
+
+	for (int i = 0; i < this->pinCount; i++) {
+		if (replied & (1 << i)) {
+			uint32_t raw = raws[i];
+			BidirDshotTelemetryType type = types[i];
+			this->history[i].push(raw, type, this->captureTime);
+			this->latestRaw[i] = raw;
+			this->latestType[i] = type;
+			this->framesAvailable |= 1 << i;
+			this->linkStats[i].countReply(type != BidirDshotTelemetryType::CHECKSUM_ERROR, type != BidirDshotTelemetryType::CHECKSUM_ERROR || BidirDShotX1::isValidGcr(frames[i]));
+			if (type != BidirDshotTelemetryType::CHECKSUM_ERROR) {
+				uint32_t v = BidirDShotX1::convertFromRaw(raw, type);
+				if (v != 0xFFFFFFFF) this->telemetry[i].update(type, v, this->captureTime);
+			}
+		} else {
+			this->storeNoReply(i);
+		}
+	}
+}
+
+void BidirDShotX4::storeNoReply(uint8_t channel) {
+	this->history[channel].push(0, BidirDshotTelemetryType::NO_REPLY, this->captureTime);
+	this->latestRaw[channel] = 0;
+	this->latestType[channel] = BidirDshotTelemetryType::NO_REPLY;
+	this->framesAvailable |= 1 << channel;
+	this->linkStats[channel].countMissing();
+}
+
+bool BidirDShotX4::checkTelemetryAvailable(uint8_t channel) {
+	this->processCapture();
+	return this->framesAvailable & (1 << channel);
+}
+
+BidirDshotTelemetryType BidirDShotX4::getTelemetryErpm(uint8_t channel, uint32_t *erpm) {
+	uint32_t raw;
+	BidirDshotTelemetryType ret = this->getTelemetryRaw(channel, &raw);
+	if (ret > BidirDshotTelemetryType::NO_PACKET) {
+		return BidirDshotTelemetryType::OTHER_VALUE;
+	}
+	if (ret > BidirDshotTelemetryType::ERPM) {
+		return ret;
+	}
+	raw = BidirDShotX1::convertFromRaw(raw, BidirDshotTelemetryType::ERPM);
+	if (raw == 0xFFFFFFFF) {
+		return BidirDshotTelemetryType::CHECKSUM_ERROR; // not quite right, but close enough
+	}
+	*erpm = raw;
+	return BidirDshotTelemetryType::ERPM;
+}
+
+BidirDshotTelemetryType BidirDShotX4::getTelemetryPacket(uint8_t channel, uint32_t *value) {
+	uint32_t raw;
+	BidirDshotTelemetryType ret = this->getTelemetryRaw(channel, &raw);
+
+	if (ret == BidirDshotTelemetryType::ERPM) {
+		raw = BidirDShotX1::convertFromRaw(raw, ret);
+		if (raw == 0xFFFFFFFF) {
+			return BidirDshotTelemetryType::CHECKSUM_ERROR; // not quite right, but close enough
+		}
+		*value = raw;
+	} else if (ret > BidirDshotTelemetryType::NO_PACKET) {
+		*value = raw & 0xFF;
+	}
+	return ret;
+}
+
+BidirDshotTelemetryType BidirDShotX4::getTelemetryRaw(uint8_t channel, uint32_t *value) {
+	if (channel >= this->pinCount || !this->checkTelemetryAvailable(channel)) {
+		return BidirDshotTelemetryType::NO_PACKET;
+	}
+	this->framesAvailable &= ~(1 << channel);
+	this->linkStats[channel].countLatency(time_us_32() - this->latestTime);
+
+	if (this->latestType[channel] != BidirDshotTelemetryType::CHECKSUM_ERROR && this->latestType[channel] != BidirDshotTelemetryType::NO_REPLY) {
+		*value = this->latestRaw[channel];
+	}
+	return this->latestType[channel];
+}
+
+uint8_t BidirDShotX4::getTelemetryHistory(uint8_t channel, BidirDShotTelemetryFrame *frames, uint8_t maxFrames) {
+	if (channel >= this->pinCount) {
+		return 0;
+	}
+	this->processCapture();
+	uint8_t count = this->history[channel].read(frames, maxFrames);
+	uint32_t now = time_us_32();
+	for (uint8_t i = 0; i < count; i++) {
+		this->linkStats[channel].countLatency(now - frames[i].timestamp);
+	}
+	return count;
+}
+
+uint32_t BidirDShotX4::getTelemetryOverflows(uint8_t channel) {
+	if (channel >= this->pinCount) {
+		return 0;
+	}
+	return this->history[channel].getOverflows();
+}
+
+bool BidirDShotX4::getLinkStats(uint8_t channel, BidirDShotLinkStats *stats) {
+	if (channel >= this->pinCount) {
+		return false;
+	}
+	this->linkStats[channel].snapshot(stats);
+	stats->historyDrops = this->history[channel].getOverflows();
+	return true;
+}
+
+void BidirDShotX4::resetLinkStats() {
+	for (int i = 0; i < 4; i++)
+		this->linkStats[i].reset();
+}
+
+bool BidirDShotX4::getTelemetryState(uint8_t channel, BidirDShotTelemetryState *state) {
+	if (channel >= this->pinCount) {
+		return false;
+	}
+	this->telemetry[channel].snapshot(state);
+	return true;
+}
+
+void BidirDShotX4::getTelemetryStates(BidirDShotTelemetryState *states) {
+	for (int i = 0; i < this->pinCount; i++)
+		this->telemetry[i].snapshot(&states[i]);
+}
@@ -0,0 +1,262 @@
+#ifndef BIDIR_DSHOT_X4_H
+#define BIDIR_DSHOT_X4_H
+
+#include "bidir_dshot_x1.h"
+#include "hardware/pio.h"
+
+#define BIDIR_DSHOT_X4_REPLY_SKEW_US 20 /// min. time between the first and the last reply start of the ESCs that the capture covers (at least 11 reply bits)
+#define BIDIR_DSHOT_X4_CAPTURE_WORDS 72 /// max. RX words per capture, 8 samples (4 pins each) per word, i.e. 2 reply bits per word. Enough for DShot4800
+
+/**
+ * @brief Bidirectional DShot for up to 4 ESCs on consecutive pins with one state machine
+ *
+ * The packets are sent in parallel. Then the pins of all ESCs are sampled together, starting with the first edge of any ESC, and the replies are extracted from the samples by the CPU. The ESCs don't reply at exactly the same time (turnaround differences, usually a few us). A reply that starts too late after the first one is cut off by the end of the capture and reported as ::NO_REPLY. The capture covers the following skew between the reply starts (see BIDIR_DSHOT_X4_REPLY_SKEW_US):
+ * - DShot300: 29 us
+ * - DShot600: 20 us
+ * - DShot1200: 20.7 us
+ * - DShot2400: 20.3 us
+ *
+ * The capture takes 21 reply bits + this skew after the first reply started, no new packet should be sent before it is done (e.g. ~40us after the first reply at DShot600).
+ *
+ * If no ESC replies at all, the capture waits for the first edge until the next packet is sent. Then every channel gets a ::NO_REPLY frame, as in BidirDShotX1.
+ */
+class BidirDShotX4 {
+public:
+	BidirDShotX4() = delete;
+	/**
+	 * @brief Initialize a new BidirDShotX4 instance
+	 *
+	 * Uses one state machine and one DMA channel for up to 4 ESCs on consecutive pins.
+	 *
+	 * @param pinBase the first ESC pin
+	 * @param pinCount the number of ESC pins (1-4). If less than 4, the remaining pins of the 4 pin window should not toggle, as they are still sampled.
+	 * @param speed DShot speed in kBaud, e.g. 600 for DShot600, max. clk_sys / 40 kHz (DShot3125 at 125 MHz), otherwise initError
+	 * @param pio the PIO instance to use, default is pio0
+	 * @param sm the state machine to use, default (-1) is autodetect
+	 */
+	BidirDShotX4(uint8_t pinBase, uint8_t pinCount, uint32_t speed = 600, PIO pio = pio0, int8_t sm = -1);
+
+	/**
+	 * @brief Deinitialize the BidirDShotX4 instance
+	 *
+	 * This will stop the state machine, free the DMA channel and the pins. If this is the last instance on this PIO block, the PIO programm will be removed.
+	 */
+	~BidirDShotX4();
+
+	/**
+	 * @brief Send throttle values to the ESCs (array of 4)
+	 *
+	 * UART telemetry request bit IS NOT set (separate wire). Checksum is appended automatically. Call one of the send functions regularly (usually > 500Hz) to keep the ESCs alive.
+	 *
+	 * @param throttles the throttle values, 0-2000
+	 */
+	void sendThrottles(uint16_t throttles[4]);
+
+	/**
+	 * @brief Send a raw packet to the ESCs, useful for special commands
+	 *
+	 * UART telemetry request bit IS set (separate wire). See DSHOT_CMD_ commands. Checksum is appended automatically. Call one of the send functions regularly (usually > 500Hz) to keep the ESCs alive.
+	 *
+	 * @param data the raw data to send, 11 bits, or 0-2047
+	 */
+	void sendRaw11Bit(uint16_t data[4]);
+
+	/**
+	 * @brief Send a raw packet to the ESCs, useful for special commands
+	 *
+	 * UART telemetry request bit can be set arbitrarily. Checksum is appended automatically. Call one of the send functions regularly (usually > 500Hz) to keep the ESCs alive.
+	 *
+	 * @param data the raw data to send, 12 bits: xxxx dddd dddd dddt where d is data, t is telemetry request bit and x is ignored
+	 */
+	void sendRaw12Bit(uint16_t data[4]);
+
+	/**
+	 * @brief check if a telemetry packet is available for an ESC
+	 *
+	 * Returns true regardless of the checksum validity or packet type.
+	 *
+	 * @param channel the ESC (0 = pinBase, 1 = pinBase + 1, ...)
+	 * @return true if packet is available
+	 * @return false if no packet is available
+	 */
+	bool checkTelemetryAvailable(uint8_t channel);
+
+	/**
+	 * @brief Get the current eRPM of an ESC, provided the telemetry packet is valid and of type ERPM
+	 *
+	 * Leaves the erpm pointer unchanged if no packet is available, the checksum is invalid or the packet type is not ERPM. No-op (does not stall) if no packet is available.
+	 *
+	 * @param channel the ESC (0 = pinBase, 1 = pinBase + 1, ...)
+	 * @param erpm pointer to a uint32_t to store the erpm. Must be a valid pointer, not nullptr.
+	 * @return BidirDshotTelemetryType ::ERPM, ::OTHER_VALUE, ::NO_PACKET, ::NO_REPLY or ::CHECKSUM_ERROR
+	 */
+	BidirDshotTelemetryType getTelemetryErpm(uint8_t channel, uint32_t *erpm);
+
+	/**
+	 * @brief Get the telemetry packet of an ESC
+	 *
+	 * Same values as BidirDShotX1::getTelemetryPacket. No-op (does not stall) if no packet is available.
+	 *
+	 * @param channel the ESC (0 = pinBase, 1 = pinBase + 1, ...)
+	 * @param value pointer to a uint32_t to store the telemetry value. Must be a valid pointer, not nullptr.
+	 * @return BidirDshotTelemetryType, all values except ::OTHER_VALUE may be returned
+	 */
+	BidirDshotTelemetryType getTelemetryPacket(uint8_t channel, uint32_t *value);
+
+	/**
+	 * @brief Get the raw telemetry packet of an ESC
+	 *
+	 * Same values as BidirDShotX1::getTelemetryRaw, use BidirDShotX1::convertFromRaw to convert them. No-op (does not stall) if no packet is available.
+	 *
+	 * @param channel the ESC (0 = pinBase, 1 = pinBase + 1, ...)
+	 * @param value pointer to a uint32_t to store the telemetry value. Must be a valid pointer, not nullptr.
+	 * @return BidirDshotTelemetryType, all values except ::OTHER_VALUE may be returned
+	 */
+	BidirDshotTelemetryType getTelemetryRaw(uint8_t channel, uint32_t *value);
+
+	/**
+	 * @brief Get all telemetry frames of an ESC that were received since the last call
+	 *
+	 * Same as BidirDShotX1::getTelemetryHistory. Replies are decoded when the next packet is sent or any telemetry function is called.
+	 *
+	 * @param channel the ESC (0 = pinBase, 1 = pinBase + 1, ...)
+	 * @param frames array to store the frames, oldest first
+	 * @param maxFrames size of the array. Frames that don't fit are returned by the next call.
+	 * @return uint8_t number of frames stored in the array
+	 */
+	uint8_t getTelemetryHistory(uint8_t channel, BidirDShotTelemetryFrame *frames, uint8_t maxFrames);
+
+	/**
+	 * @brief Get the number of telemetry frames of an ESC that were dropped because the history was full
+	 *
+	 * @param channel the ESC (0 = pinBase, 1 = pinBase + 1, ...)
+	 * @return uint32_t total count since initialisation
+	 */
+	uint32_t getTelemetryOverflows(uint8_t channel);
+
+	/**
+	 * @brief Get the link statistics of an ESC, same as BidirDShotX1::getLinkStats
+	 *
+	 * A capture that is aborted by the next packet counts as missingReplies on all channels if no ESC replied at all, otherwise as fifoOverruns (packet sent before the replies were complete).
+	 *
+	 * @param channel the ESC (0 = pinBase, 1 = pinBase + 1, ...)
+	 * @param stats pointer to store the statistics. Must be a valid pointer, not nullptr.
+	 * @return false if the channel is invalid
+	 */
+	bool getLinkStats(uint8_t channel, BidirDShotLinkStats *stats);
+
+	/**
+	 * @brief Sets the link statistics of all ESCs to 0, except historyDrops. Call from the core that sends the packets.
+	 */
+	void resetLinkStats();
+
+	/**
+	 * @brief Get the latest value, timestamp and count of every telemetry type of an ESC, same as BidirDShotX1::getTelemetryState
+	 *
+	 * Updated whenever the replies are decoded (by the send and getTelemetry functions).
+	 *
+	 * @param channel the ESC (0 = pinBase, 1 = pinBase + 1, ...)
+	 * @param state pointer to store the snapshot. Must be a valid pointer, not nullptr.
+	 * @return false if the channel is invalid
+	 */
+	bool getTelemetryState(uint8_t channel, BidirDShotTelemetryState *state);
+
+	/**
+	 * @brief Get the telemetry state of all ESCs with one call
+	 *
+	 * @param states array of pinCount states, one per ESC
+	 */
+	void getTelemetryStates(BidirDShotTelemetryState *states);
+
+	/**
+	 * @brief Changes the DShot speed without reinitialising the driver
+	 *
+	 * The state machine, the pins and the program stay claimed. The new divider is applied between two packets (the call blocks until the current packet and its reply capture is done). Also used by dshotClockChanged to recalculate the divider for a new system clock.
+	 *
+	 * @param speed speed in kBaud, e.g. 600 for DShot600, 150...4800
+	 * @return true if the speed was changed
+	 * @return false if the driver is not initialised, the speed is invalid or too high for the system clock (the old divider is kept)
+	 */
+	bool setSpeed(uint32_t speed);
+
+	/**
+	 * @brief checks if there was an error during initialisation of the DShot driver
+	 *
+	 * define DSHOT_DEBUG in src/dshot_config.h to enable information on Serial why the initialisation failed
+	 *
+	 * @return true if there was an error
+	 * @return false if everything worked fine
+	 */
+	bool initError() {
+		return iError;
+	}
+
+private:
+	PIO pio; /// which PIO is used for the DShot driver
+	uint8_t pinBase; /// the first pin that is used for DShot output/input
+	uint8_t pinCount; /// the assigned pin count (up to 4)
+	uint8_t sm; /// which state machine is used for the DShot driver
+	uint32_t speed; /// speed in kBaud, e.g. 600 for DShot600
+	uint8_t offset; /// program offset in the PIO instruction memory (needed to point to the same memory location in the next driver)
+	int dmaChannel = -1; /// DMA channel that empties the RX FIFO into the capture buffers
+	bool iError = false; /// shows if there was an error during initialisation
+
+	uint32_t captureBuffer[BIDIR_DSHOT_X4_CAPTURE_WORDS]; /// raw samples of the replies, decoded before the next send
+	uint8_t captureWords; /// RX words per capture at the current speed, see BIDIR_DSHOT_X4_REPLY_SKEW_US
+	bool capturePending = false; /// whether the DMA channel was started and the capture is not decoded yet
+	uint32_t captureTime = 0; /// time_us_32() of the packet that started the capture
+	BidirDShotTelemetryHistory history[4]; /// all received frames of each channel until they are read
+	uint16_t latestRaw[4]; /// raw value of the latest frame of each channel
+	BidirDshotTelemetryType latestType[4]; /// type of the latest frame of each channel
+	uint8_t framesAvailable = 0; /// bit mask of the channels that have an unread frame
+	uint32_t latestTime = 0; /// timestamp of the latest frames, same as in the history
+	BidirDShotLinkCounters linkStats[4]; /// statistics of each channel for getLinkStats
+	BidirDShotTelemetryAggregator telemetry[4]; /// last valid value per type of each channel, for getTelemetryState
+
+	/**
+	 * @brief appends a checksum to the outgoing DShot packet
+	 *
+	 * nibble-wise XOR, then bitwise invert.
+	 *
+	 * @param data 12 bit LSB-aligned (right-aligned) packet data (11 bits data + 1 bit telemetry)
+	 * @return uint16_t 16 bit full packet with checksum appended
+	 */
+	static uint16_t appendChecksum(uint16_t data);
+
+	/**
+	 * @brief takes a finished capture (if there is one), extracts and decodes the telemetry frames of all channels
+	 */
+	void processCapture();
+
+	/**
+	 * @brief stores a NO_REPLY frame for a channel (history, latest type, link stats)
+	 */
+	void storeNoReply(uint8_t channel);
+
+	/**
+	 * @brief reconstructs the 21 bit telemetry frame of one channel from the oversampled capture
+	 *
+	 * @param samples capture buffer
+	 * @param words number of words in the capture buffer
+	 * @param channel the channel (pin offset) to decode
+	 * @param frame pointer to store the frame
+	 * @return true if the ESC replied (start bit found and the reply is complete)
+	 * @return false if the ESC didn't reply or the reply is cut off by the end of the capture
+	 */
+	static bool extractFrame(const uint32_t *samples, uint8_t words, uint8_t channel, uint32_t *frame);
+
+	/**
+	 * @brief calculates the number of RX words per capture, so that it covers a reply and BIDIR_DSHOT_X4_REPLY_SKEW_US
+	 *
+	 * @param speed speed in kBaud
+	 * @return uint8_t number of words, max. BIDIR_DSHOT_X4_CAPTURE_WORDS
+	 */
+	static uint8_t calcCaptureWords(uint32_t speed);
+
+	/**
+	 * @brief clock change callback, see dshotRegisterClockCallback
+	 */
+	static void onClockChange(void *driver);
+};
+
+#endif // BIDIR_DSHOT_X4_H
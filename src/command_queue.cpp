@@ -0,0 +1,82 @@
+#include "command_queue.h"
+#include "hardware/timer.h"
+
+static_assert((DSHOT_COMMAND_QUEUE & (DSHOT_COMMAND_QUEUE - 1)) == 0 && DSHOT_COMMAND_QUEUE <= 128, "DSHOT_COMMAND_QUEUE must be a power of 2, max. 128");
+
+bool DShotCommandQueue::push(uint16_t command) {
+	uint8_t repeats = 1;
+	uint32_t spacingUs = 1000;
+	switch (command) {
+	case 1: // DSHOT_CMD_BEACON1...5
+	case 2:
+	case 3:
+	case 4:
+	case 5:
+		spacingUs = 100000; // let the beep finish
+		break;
+	case 6: // DSHOT_CMD_ESC_INFO
+		spacingUs = 12000; // the ESC answers on the telemetry wire
+		break;
+	case 12: // DSHOT_CMD_SAVE_SETTINGS
+		repeats = 10;
+		spacingUs = 35000; // the ESC writes its flash
+		break;
+	case 7: // DSHOT_CMD_SPIN_DIRECTION_1, _2, 3D_MODE_OFF, _ON
+	case 8:
+	case 9:
+	case 10:
+	case 13: // DSHOT_CMD_EXTENDED_TELEMETRY_ENABLE, _DISABLE
+	case 14:
+	case 20: // DSHOT_CMD_SPIN_DIRECTION_NORMAL, _REVERSED
+	case 21:
+		repeats = 10; // ESCs ignore these commands unless they are received 6 times in a row
+		break;
+	}
+	return this->push(command, repeats, spacingUs);
+}
+
+bool DShotCommandQueue::push(uint16_t command, uint8_t repeats, uint32_t spacingUs) {
+	if (command > 47 || !repeats || (uint8_t)(this->head - this->tail) >= DSHOT_COMMAND_QUEUE) {
+		return false;
+	}
+	Entry &e = this->entries[this->head % DSHOT_COMMAND_QUEUE];
+	e.command = command;
+	e.repeats = repeats;
+	e.spacingUs = spacingUs;
+	this->head++;
+	return true;
+}
+
+bool DShotCommandQueue::next(uint16_t *command) {
+	if (this->spacing) {
+		if (time_us_32() - this->spacingStart < this->spacingUs) {
+			return false;
+		}
+		this->spacing = false;
+	}
+	if (this->head == this->tail) {
+		return false;
+	}
+
+	Entry &e = this->entries[this->tail % DSHOT_COMMAND_QUEUE];
+	*command = e.command;
+	if (++this->sent >= e.repeats) {
+		this->sent = 0;
+		this->tail++;
+		this->spacing = true;
+		this->spacingStart = time_us_32();
+		this->spacingUs = e.spacingUs;
+	}
+	return true;
+}
+
+uint8_t DShotCommandQueue::pending() {
+	uint8_t count = this->head - this->tail;
+	if (this->spacing && time_us_32() - this->spacingStart < this->spacingUs) count++;
+	return count;
+}
+
+void DShotCommandQueue::clear() {
+	this->tail = this->head;
+	this->sent = 0;
+}
@@ -0,0 +1,67 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include "dshot_config.h"
+#include <stdint.h>
+
+/**
+ * @brief Queue of DShot special commands for one ESC, sent in place of the throttle
+ *
+ * Each command is sent on consecutive send calls (ticks) as often as requested, then the queue waits for the spacing time before the next command, during which the normal throttle is sent again. Statically allocated, DSHOT_COMMAND_QUEUE entries (see dshot_config.h).
+ */
+class DShotCommandQueue {
+public:
+	/**
+	 * @brief adds a command with the default repeat count and spacing of that command
+	 *
+	 * 10 repeats for the settings commands (spin direction, 3D mode, save settings, extended telemetry), 1 for all others. Spacing after the command: 100ms for the beacons, 12ms for ESC info, 35ms for save settings, 1ms for all others.
+	 *
+	 * @param command special command, 0...47 (see DShotCommand)
+	 * @return false if the command is invalid or the queue is full
+	 */
+	bool push(uint16_t command);
+
+	/**
+	 * @brief adds a command
+	 *
+	 * @param command special command, 0...47 (see DShotCommand)
+	 * @param repeats number of consecutive packets, 1...255
+	 * @param spacingUs minimum time after the last packet of this command until the next command is sent
+	 * @return false if the command or the repeat count is invalid or the queue is full
+	 */
+	bool push(uint16_t command, uint8_t repeats, uint32_t spacingUs);
+
+	/**
+	 * @brief gets the command for this tick, if any
+	 *
+	 * @param command the command to send instead of the throttle
+	 * @return true if a command is due
+	 */
+	bool next(uint16_t *command);
+
+	/**
+	 * @brief number of commands that are not completely sent yet, including a command whose spacing has not passed yet
+	 */
+	uint8_t pending();
+
+	/**
+	 * @brief removes all commands. A command that was partially sent is cut off.
+	 */
+	void clear();
+
+private:
+	struct Entry {
+		uint8_t command;
+		uint8_t repeats;
+		uint32_t spacingUs;
+	};
+	Entry entries[DSHOT_COMMAND_QUEUE];
+	uint8_t head = 0; /// write count
+	uint8_t tail = 0; /// read count
+	uint8_t sent = 0; /// packets sent of the oldest command
+	bool spacing = false; /// waiting for the spacing of the last command
+	uint32_t spacingStart = 0; /// time_us_32() of the last packet of the last command
+	uint32_t spacingUs = 0; /// spacing of the last command
+};
+
+#endif // COMMAND_QUEUE_H
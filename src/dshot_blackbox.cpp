@@ -0,0 +1,157 @@
+#include "dshot_blackbox.h"
+#include "dshot_common.h"
+#include "hardware/dma.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include <string.h>
+
+DShotBlackbox *volatile dshotBlackbox = nullptr;
+
+DShotBlackbox::DShotBlackbox(uint8_t *buffer, uint32_t size) {
+	this->buffer = buffer;
+	this->size = size;
+}
+
+DShotBlackbox::~DShotBlackbox() {
+	this->stop();
+}
+
+bool DShotBlackbox::start() {
+	if (this->size < 64 || (this->size & (this->size - 1))) {
+		DEBUG_PRINTF("Invalid buffer size: %d, must be a power of 2, min. 64\n", this->size);
+		return false;
+	}
+	uint32_t irqState = save_and_disable_interrupts();
+	this->head = 0;
+	this->tail = 0;
+	this->dmaBytes = 0;
+	this->pendingDrops = 0;
+	this->dropped = 0;
+	memset(this->lastTx, 0, sizeof(this->lastTx));
+	memset(this->lastRx, 0, sizeof(this->lastRx));
+	uint32_t now = time_us_32();
+	this->buffer[0] = (uint8_t)DShotBlackboxEntry::SYNC << 6 | DSHOT_BLACKBOX_NO_PIN;
+	for (int i = 0; i < 4; i++) {
+		this->buffer[1 + i] = now >> (8 * i);
+	}
+	this->lastTime = now;
+	__dmb();
+	this->head = 5;
+	dshotBlackbox = this;
+	restore_interrupts(irqState);
+	return true;
+}
+
+void DShotBlackbox::stop() {
+	if (dshotBlackbox == this) {
+		dshotBlackbox = nullptr;
+	}
+}
+
+bool __not_in_flash_func(DShotBlackbox::append)(uint8_t header, uint32_t now, uint32_t value) {
+	// worst case: header + 2 varints of 5 bytes
+	uint8_t entry[11];
+	uint8_t n = 0;
+	entry[n++] = header;
+	uint32_t delta = now - this->lastTime;
+	while (delta >= 0x80) {
+		entry[n++] = delta | 0x80;
+		delta >>= 7;
+	}
+	entry[n++] = delta;
+	while (value >= 0x80) {
+		entry[n++] = value | 0x80;
+		value >>= 7;
+	}
+	entry[n++] = value;
+
+	uint32_t h = this->head;
+	if (this->size - (h - this->tail) < n) {
+		return false;
+	}
+	uint32_t mask = this->size - 1;
+	for (int i = 0; i < n; i++) {
+		this->buffer[(h + i) & mask] = entry[i];
+	}
+	this->lastTime = now;
+	__dmb(); // the bytes before the new head
+	this->head = h + n;
+	return true;
+}
+
+bool __not_in_flash_func(DShotBlackbox::push)(uint8_t header, uint32_t value) {
+	// the drop entry goes first, so that the decoder sees the gap where it happened
+	uint32_t now = time_us_32();
+	if (this->pendingDrops && this->append((uint8_t)DShotBlackboxEntry::DROP << 6 | DSHOT_BLACKBOX_NO_PIN, now, this->pendingDrops)) {
+		this->pendingDrops = 0;
+	}
+	if (!this->pendingDrops && this->append(header, now, value)) {
+		return true;
+	}
+	this->pendingDrops++;
+	this->dropped++;
+	return false;
+}
+
+void __not_in_flash_func(DShotBlackbox::logTx)(uint8_t pin, uint16_t frame) {
+	if (pin >= DSHOT_BLACKBOX_PINS) return;
+	uint32_t irqState = save_and_disable_interrupts();
+	if (this->push((uint8_t)DShotBlackboxEntry::TX << 6 | pin, frame ^ this->lastTx[pin])) {
+		this->lastTx[pin] = frame;
+	}
+	restore_interrupts(irqState);
+}
+
+void __not_in_flash_func(DShotBlackbox::logRx)(uint8_t pin, uint32_t word) {
+	if (pin >= DSHOT_BLACKBOX_PINS) return;
+	uint32_t irqState = save_and_disable_interrupts();
+	if (this->push((uint8_t)DShotBlackboxEntry::RX << 6 | pin, word ^ this->lastRx[pin])) {
+		this->lastRx[pin] = word;
+	}
+	restore_interrupts(irqState);
+}
+
+uint32_t DShotBlackbox::available() {
+	return this->head - this->tail;
+}
+
+uint32_t DShotBlackbox::read(uint8_t *dst, uint32_t maxBytes) {
+	uint32_t t = this->tail;
+	uint32_t n = this->head - t;
+	__dmb(); // the bytes after reading the head
+	if (n > maxBytes) n = maxBytes;
+	uint32_t mask = this->size - 1;
+	for (uint32_t i = 0; i < n; i++) {
+		dst[i] = this->buffer[(t + i) & mask];
+	}
+	__dmb(); // the bytes before releasing them
+	this->tail = t + n;
+	return n;
+}
+
+uint32_t DShotBlackbox::drainDma(uint channel, volatile void *dst, uint dreq) {
+	if (dma_channel_is_busy(channel)) {
+		return 0;
+	}
+	__dmb();
+	this->tail += this->dmaBytes;
+	this->dmaBytes = 0;
+
+	// up to the end of the buffer, the rest follows with the next call
+	uint32_t t = this->tail;
+	uint32_t n = this->head - t;
+	__dmb();
+	uint32_t start = t & (this->size - 1);
+	if (n > this->size - start) n = this->size - start;
+	if (!n) {
+		return 0;
+	}
+	dma_channel_config c = dma_channel_get_default_config(channel);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+	channel_config_set_read_increment(&c, true);
+	channel_config_set_write_increment(&c, false);
+	channel_config_set_dreq(&c, dreq);
+	this->dmaBytes = n;
+	dma_channel_configure(channel, &c, dst, &this->buffer[start], n, true);
+	return n;
+}
@@ -0,0 +1,168 @@
+#ifndef DSHOT_BLACKBOX_H
+#define DSHOT_BLACKBOX_H
+
+#include "dshot_config.h"
+#include "hardware/pio.h"
+
+#define DSHOT_BLACKBOX_PINS 48 /// GPIOs with their own delta state (all GPIOs of the RP2350B)
+#define DSHOT_BLACKBOX_NO_PIN 63 /// GPIO field of entries that don't belong to a pin (::SYNC, ::DROP)
+
+/**
+ * @brief Entry types of the DShotBlackbox stream, bits 7...6 of the header byte
+ */
+enum class DShotBlackboxEntry : uint8_t {
+	TX, /// transmitted 16 bit frame (with checksum, not inverted), as returned by appendChecksum
+	RX, /// raw telemetry word as read from the PIO (BidirDShotX1, BidirDShotMux: FIFO word incl. turnaround bits; edge capture mode and BidirDShotX4: recovered 21 bit frame), 0 if the ESC didn't reply
+	SYNC, /// start of the stream: absolute timestamp, all delta states are 0
+	DROP, /// entries were dropped because the buffer was full
+};
+
+/**
+ * @brief Binary capture of every frame that goes over the wire, for post mortem analysis (e.g. of a desync)
+ *
+ * While a capture is started, all drivers (BidirDShotX1, BidirDShotX4, DShotX4, DShotX8, BidirDShotMux and the Fixed drivers) log every frame they send and every telemetry word they read, with the GPIO as motor id. The entries go into a byte ring buffer in a delta encoded format, single producer (all drivers on one core, interrupts included), single consumer: drain it with read from the other core, or with drainDma to a peripheral (e.g. a UART), both without locks. If it is full, entries are dropped and reported by a ::DROP entry. extras/blackbox converts a stream to CSV.
+ *
+ * Stream format, one entry after the other:
+ * - header byte: DShotBlackboxEntry in bits 7...6, GPIO in bits 5...0 (DSHOT_BLACKBOX_NO_PIN for ::SYNC and ::DROP)
+ * - ::SYNC: absolute time_us_32() as 4 bytes, little endian
+ * - all others: time since the previous entry in us as varint, then
+ *   - ::TX: frame XOR the previous ::TX frame of the same GPIO, varint
+ *   - ::RX: word XOR the previous ::RX word of the same GPIO, varint
+ *   - ::DROP: number of dropped entries, varint
+ *
+ * varint: 7 bits per byte, least significant first, bit 7 is set if another byte follows. An unchanged frame less than 128us after the previous entry costs 3 bytes, a 4 motor 8kHz loop with telemetry ~250kB/s. Dropped entries are not part of the time and XOR chains.
+ *
+ * Disable the driver hooks completely with DSHOT_BLACKBOX in dshot_config.h. While no capture is started, each hook is a load and a branch.
+ */
+class DShotBlackbox {
+public:
+	DShotBlackbox() = delete;
+	/**
+	 * @brief Initialize a new DShotBlackbox instance on a buffer
+	 *
+	 * @param buffer byte ring buffer, must stay valid while the instance exists
+	 * @param size size of the buffer, power of 2, min. 64
+	 */
+	DShotBlackbox(uint8_t *buffer, uint32_t size);
+
+	/**
+	 * @brief Stops the capture if it is running (so that the drivers don't write into a deleted buffer)
+	 */
+	~DShotBlackbox();
+
+	/**
+	 * @brief Empties the buffer, writes a ::SYNC entry and makes this the capture of all drivers (replaces a running one)
+	 *
+	 * Don't call while a DMA drain is running.
+	 *
+	 * @return false if the size of the buffer is invalid
+	 */
+	bool start();
+
+	/**
+	 * @brief Stops logging, the buffer can still be drained
+	 */
+	void stop();
+
+	/**
+	 * @brief Logs a transmitted frame, called by the drivers
+	 *
+	 * @param pin GPIO of the ESC
+	 * @param frame 16 bit frame with checksum
+	 */
+	void logTx(uint8_t pin, uint16_t frame);
+
+	/**
+	 * @brief Logs a received telemetry word, called by the drivers
+	 *
+	 * @param pin GPIO of the ESC
+	 * @param word raw word, see DShotBlackboxEntry::RX
+	 */
+	void logRx(uint8_t pin, uint32_t word);
+
+	/**
+	 * @brief Returns the number of bytes that can be read
+	 */
+	uint32_t available();
+
+	/**
+	 * @brief Copies and removes bytes from the buffer, e.g. from the second core. Never splits the stream, entries may span two calls.
+	 *
+	 * @param dst destination
+	 * @param maxBytes max. number of bytes to copy
+	 * @return uint32_t number of bytes copied
+	 */
+	uint32_t read(uint8_t *dst, uint32_t maxBytes);
+
+	/**
+	 * @brief Drains the buffer with a DMA channel, call it regularly (e.g. in the loop)
+	 *
+	 * If the last transfer is done, its bytes are released and the next contiguous block is started (8 bit transfers, paced by dreq, fixed write address). Returns immediately while the transfer is running.
+	 *
+	 * @param channel a claimed DMA channel, used only for this until stop and the last transfer are done
+	 * @param dst write address, e.g. &uart_get_hw(uart0)->dr
+	 * @param dreq DREQ of the destination, e.g. uart_get_dreq(uart0, true)
+	 * @return uint32_t number of bytes of the started transfer, 0 if none was started
+	 */
+	uint32_t drainDma(uint channel, volatile void *dst, uint dreq);
+
+	/**
+	 * @brief Returns the number of entries that were dropped since start because the buffer was full
+	 */
+	uint32_t getDropped() {
+		return dropped;
+	}
+
+private:
+	uint8_t *buffer; /// byte ring buffer
+	uint32_t size; /// buffer size, power of 2
+	volatile uint32_t head = 0; /// write count, only changed by the producer
+	volatile uint32_t tail = 0; /// read count, only changed by the consumer
+	uint32_t dmaBytes = 0; /// length of the running DMA transfer, released by the next drainDma
+	uint32_t lastTime = 0; /// time_us_32() of the last entry in the buffer
+	uint32_t pendingDrops = 0; /// entries dropped since the last ::DROP entry
+	volatile uint32_t dropped = 0; /// entries dropped since start
+	uint16_t lastTx[DSHOT_BLACKBOX_PINS]; /// last ::TX frame per GPIO in the buffer
+	uint32_t lastRx[DSHOT_BLACKBOX_PINS]; /// last ::RX word per GPIO in the buffer
+
+	/**
+	 * @brief appends an entry (header, time delta, varint value) or drops it if it doesn't fit. Interrupts must be disabled.
+	 *
+	 * @return false if the entry was dropped
+	 */
+	bool append(uint8_t header, uint32_t now, uint32_t value);
+
+	/**
+	 * @brief appends a pending ::DROP entry and the entry, counts it as dropped if it doesn't fit. Interrupts must be disabled.
+	 *
+	 * @return false if the entry was dropped
+	 */
+	bool push(uint8_t header, uint32_t value);
+};
+
+/**
+ * @brief The running capture, nullptr if none, see DShotBlackbox::start
+ */
+extern DShotBlackbox *volatile dshotBlackbox;
+
+/**
+ * @brief driver hook: logs a transmitted frame into the running capture, if any
+ */
+static inline void dshotBlackboxTx(uint8_t pin, uint16_t frame) {
+#if DSHOT_BLACKBOX
+	DShotBlackbox *b = dshotBlackbox;
+	if (b) b->logTx(pin, frame);
+#endif
+}
+
+/**
+ * @brief driver hook: logs a received telemetry word into the running capture, if any
+ */
+static inline void dshotBlackboxRx(uint8_t pin, uint32_t word) {
+#if DSHOT_BLACKBOX
+	DShotBlackbox *b = dshotBlackbox;
+	if (b) b->logRx(pin, word);
+#endif
+}
+
+#endif // DSHOT_BLACKBOX_H
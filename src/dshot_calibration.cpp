@@ -0,0 +1,51 @@
+#include "dshot_calibration.h"
+#include "dshot_common.h"
+#include "hardware/timer.h"
+
+static const uint32_t calibrationSpeeds[DSHOT_CALIBRATION_SPEEDS] = {300, 600, 1200, 2400};
+
+uint32_t dshotCalibrateSpeed(BidirDShotX1 &driver, BidirDShotSpeedResult *results, uint16_t maxErrorPermille, uint16_t frames, uint32_t rate, uint16_t settleFrames) {
+	if (driver.initError() || !frames || !rate || rate > 1000000) {
+		DEBUG_PRINTF("Invalid calibration parameters: frames=%d, rate=%d\n", frames, rate);
+		return 0;
+	}
+	uint32_t period = 1000000 / rate;
+	uint32_t previousSpeed = driver.getSpeed();
+	uint32_t bestSpeed = 0;
+	driver.stopFreeRunning();
+
+	for (int s = 0; s < DSHOT_CALIBRATION_SPEEDS; s++) {
+		BidirDShotSpeedResult r = {};
+		r.speed = calibrationSpeeds[s];
+		if (driver.setSpeed(r.speed)) {
+			uint32_t raw;
+			for (uint32_t i = 0; i < (uint32_t)settleFrames + frames; i++) {
+				driver.sendThrottle(0);
+				busy_wait_us_32(period);
+				BidirDshotTelemetryType type = driver.getTelemetryRaw(&raw);
+				if (i < settleFrames) continue;
+				switch (type) {
+				case BidirDshotTelemetryType::CHECKSUM_ERROR:
+					r.checksumErrors++;
+					break;
+				case BidirDshotTelemetryType::NO_REPLY:
+				case BidirDshotTelemetryType::NO_PACKET:
+					r.missing++;
+					break;
+				default:
+					r.valid++;
+					break;
+				}
+			}
+			r.frames = frames;
+			r.errorPermille = ((uint32_t)r.checksumErrors + r.missing) * 1000 / frames;
+			r.passed = r.errorPermille <= maxErrorPermille;
+		}
+		DEBUG_PRINTF("DShot%d: %d/%d valid, %d checksum errors, %d missing\n", r.speed, r.valid, r.frames, r.checksumErrors, r.missing);
+		if (r.passed) bestSpeed = r.speed;
+		if (results) results[s] = r;
+	}
+
+	driver.setSpeed(bestSpeed ? bestSpeed : previousSpeed);
+	return bestSpeed;
+}
@@ -0,0 +1,38 @@
+#ifndef DSHOT_CALIBRATION_H
+#define DSHOT_CALIBRATION_H
+
+#include "bidir_dshot_x1.h"
+
+#define DSHOT_CALIBRATION_SPEEDS 4 /// number of speeds tested by dshotCalibrateSpeed: 300, 600, 1200, 2400
+
+/**
+ * @brief Telemetry quality of one speed, measured by dshotCalibrateSpeed
+ */
+struct BidirDShotSpeedResult {
+	uint32_t speed; /// speed in kBaud
+	uint16_t frames; /// measured packets (after the settling packets)
+	uint16_t valid; /// replies with a valid checksum
+	uint16_t checksumErrors; /// replies with ::CHECKSUM_ERROR
+	uint16_t missing; /// packets without a reply (::NO_REPLY or ::NO_PACKET)
+	uint16_t errorPermille; /// (checksumErrors + missing) / frames, in 1/1000
+	bool passed; /// errorPermille is within the budget
+};
+
+/**
+ * @brief Finds the fastest bidirectional DShot speed with clean telemetry
+ *
+ * Steps through DShot300, 600, 1200 and 2400 (setSpeed, the driver stays initialised). At every speed, motor stop packets are sent as keep-alive at the given rate, and the result of getTelemetryRaw is counted after every packet. The first settleFrames packets per speed are not counted, so that the ESC can lock on to the new speed.
+ *
+ * Blocks for (settleFrames + frames) * 4 / rate seconds. Free-running mode is stopped. Don't use while the motor is spinning.
+ *
+ * @param driver an initialised BidirDShotX1
+ * @param results optional array of DSHOT_CALIBRATION_SPEEDS results, in the order of the tested speeds, nullptr if not needed
+ * @param maxErrorPermille error budget: maximum share of checksum errors and missing replies, in 1/1000
+ * @param frames measured packets per speed, 1...65535
+ * @param rate packets per second, the period must fit a packet and its reply window (e.g. 1000 for 1kHz)
+ * @param settleFrames packets sent after every speed change before measuring
+ * @return uint32_t the selected speed in kBaud, the driver is left at this speed. 0 if no speed is within the budget, the driver is left at its previous speed
+ */
+uint32_t dshotCalibrateSpeed(BidirDShotX1 &driver, BidirDShotSpeedResult *results = nullptr, uint16_t maxErrorPermille = 10, uint16_t frames = 200, uint32_t rate = 1000, uint16_t settleFrames = 20);
+
+#endif // DSHOT_CALIBRATION_H
@@ -1,4 +1,7 @@
 #include "dshot_common.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/timer.h"
 
 #if DBG
 void pioToPioStr(PIO pio, char str[32]) {
@@ -22,3 +25,116 @@ extern "C" void _gpio_init(uint gpio) __attribute__((weak));
 extern "C" __attribute__((weak)) void gpio_init(uint gpio) {
 	_gpio_init(gpio);
 }
+
+int claimDmaPacingTimer(uint32_t rate) {
+	if (!rate) {
+		return -1;
+	}
+	uint32_t den = (clock_get_hz(clk_sys) + rate / 2) / rate;
+	if (!den || den > 0xFFFF) {
+		return -1;
+	}
+	int timer = dma_claim_unused_timer(false);
+	if (timer < 0) {
+		return -1;
+	}
+	dma_timer_set_fraction(timer, 1, den);
+	return timer;
+}
+
+void dshotWaitBetweenFrames(PIO pio, uint sm) {
+	// TXSTALL is set while the state machine waits in its pull, i.e. after the last bit of a packet
+	uint32_t stallMask = 1u << (PIO_FDEBUG_TXSTALL_LSB + sm);
+	pio->fdebug = stallMask;
+	for (int i = 0; i < 2000 && !(pio->fdebug & stallMask); i++) {
+		busy_wait_us_32(1);
+	}
+}
+
+void dshotSetClkDivBetweenFrames(PIO pio, uint sm, uint32_t clkDiv) {
+	dshotWaitBetweenFrames(pio, sm);
+	pio_sm_set_clkdiv_int_frac(pio, sm, clkDiv >> 8, clkDiv & 0xFF);
+}
+
+void dshotSmSetPinsHigh(PIO pio, uint sm, uint64_t pinMask) {
+#if defined(PICO_PIO_USE_GPIO_BASE) && PICO_PIO_USE_GPIO_BASE
+	pio_sm_set_pins_with_mask64(pio, sm, pinMask, pinMask);
+#else
+	pio_sm_set_pins_with_mask(pio, sm, (uint32_t)pinMask, (uint32_t)pinMask);
+#endif
+}
+
+// nibble spread tables: bit b of the index is moved to bit 4 * b (X4) or 8 * b (X8)
+// kept in RAM (together with the packers) to avoid XIP cache misses in the send path
+#define SPREAD4(n) (((n) & 1) | ((n) & 2) << 3 | ((n) & 4) << 6 | ((n) & 8) << 9)
+#define SPREAD8(n) (((n) & 1) | ((n) & 2) << 7 | ((n) & 4) << 14 | ((n) & 8) << 21)
+#define SPREAD_TABLE(f) {f(0), f(1), f(2), f(3), f(4), f(5), f(6), f(7), f(8), f(9), f(10), f(11), f(12), f(13), f(14), f(15)}
+
+static const uint32_t __not_in_flash("dshot") spread4[16] = SPREAD_TABLE(SPREAD4);
+static const uint32_t __not_in_flash("dshot") spread8[16] = SPREAD_TABLE(SPREAD8);
+
+void __not_in_flash_func(dshotPackX4)(const uint16_t data[4], uint32_t packet[2]) {
+	uint32_t p0 = 0, p1 = 0;
+	for (int motor = 0; motor < 4; motor++) {
+		uint32_t d = data[motor];
+		p0 |= (spread4[d >> 12 & 0xF] << 16 | spread4[d >> 8 & 0xF]) << motor;
+		p1 |= (spread4[d >> 4 & 0xF] << 16 | spread4[d & 0xF]) << motor;
+	}
+	packet[0] = p0;
+	packet[1] = p1;
+}
+
+void __not_in_flash_func(dshotPackX8)(const uint16_t data[8], uint32_t packet[4]) {
+	uint32_t p0 = 0, p1 = 0, p2 = 0, p3 = 0;
+	for (int motor = 0; motor < 8; motor++) {
+		uint32_t d = data[motor];
+		p0 |= spread8[d >> 12 & 0xF] << motor;
+		p1 |= spread8[d >> 8 & 0xF] << motor;
+		p2 |= spread8[d >> 4 & 0xF] << motor;
+		p3 |= spread8[d & 0xF] << motor;
+	}
+	packet[0] = p0;
+	packet[1] = p1;
+	packet[2] = p2;
+	packet[3] = p3;
+}
+
+uint8_t dshotPinWindows(const uint8_t *pins, uint8_t count, uint8_t maxWidth, uint8_t *pinWindow, uint8_t *windowBase, uint8_t *windowWidth) {
+	uint8_t windows = 0;
+	uint8_t assigned = 0;
+	while (assigned != (1u << count) - 1) {
+		uint8_t base = 0xFF, top = 0;
+		for (int i = 0; i < count; i++) {
+			if (!(assigned & (1u << i)) && pins[i] < base) base = pins[i];
+		}
+		for (int i = 0; i < count; i++) {
+			if (assigned & (1u << i) || pins[i] >= base + maxWidth) continue;
+			assigned |= 1u << i;
+			pinWindow[i] = windows;
+			if (pins[i] > top) top = pins[i];
+		}
+		windowBase[windows] = base;
+		windowWidth[windows] = top - base + 1;
+		windows++;
+	}
+	return windows;
+}
+
+uint64_t dshotClaimedOutPins(PIO pio) {
+	uint64_t pins = 0;
+#if defined(PICO_PIO_USE_GPIO_BASE) && PICO_PIO_USE_GPIO_BASE
+	uint32_t gpioBase = pio_get_gpio_base(pio); // PINCTRL holds pins relative to the GPIO base of the block
+#else
+	uint32_t gpioBase = 0;
+#endif
+	for (int sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+		if (!pio_sm_is_claimed(pio, sm)) continue;
+		uint32_t pinctrl = pio->sm[sm].pinctrl;
+		uint32_t outBase = (pinctrl & PIO_SM0_PINCTRL_OUT_BASE_BITS) >> PIO_SM0_PINCTRL_OUT_BASE_LSB;
+		uint32_t outCount = (pinctrl & PIO_SM0_PINCTRL_OUT_COUNT_BITS) >> PIO_SM0_PINCTRL_OUT_COUNT_LSB;
+		for (uint32_t i = 0; i < outCount; i++) {
+			pins |= 1ull << (((outBase + i) & 31) + gpioBase);
+		}
+	}
+	return pins;
+}
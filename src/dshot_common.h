@@ -1,3 +1,6 @@
+#ifndef DSHOT_COMMON_H
+#define DSHOT_COMMON_H
+
 #include "dshot_config.h"
 #include "hardware/gpio.h"
 #include "hardware/pio.h"
@@ -11,6 +14,106 @@
 
 void gpio_init(uint gpio);
 
+/**
+ * @brief claims a DMA pacing timer and sets it to the given rate (fraction 1/n of the system clock)
+ *
+ * @param rate requests per second, at least clk_sys / 65535
+ * @return int the timer number, -1 if the rate is out of range or no timer is free
+ */
+int claimDmaPacingTimer(uint32_t rate);
+
+/**
+ * @brief calculates the PIO clock divider for a DShot speed
+ *
+ * @param clkSys system clock in Hz
+ * @param speed DShot speed in kBaud, e.g. 600 for DShot600
+ * @param cyclesPerBit PIO cycles per DShot bit of the program, 40 for all programs except bidir_dshot_x1_fast (20)
+ * @return uint32_t divider in 16.8 fixed point (integer part << 8 | fraction), rounded to the nearest 1/256. Below 256 (1.0) if the system clock is too slow.
+ */
+constexpr uint32_t dshotCalcClkDiv(uint32_t clkSys, uint32_t speed, uint32_t cyclesPerBit = 40) {
+	return ((uint64_t)clkSys * 256 + cyclesPerBit * 1000 * speed / 2) / (cyclesPerBit * 1000 * speed); // 12 MHz for DShot300 at 40 cycles per bit
+}
+
+/**
+ * @brief selects the bidirectional single pin program for a speed: bidir_dshot_x1 if the system clock allows 40 PIO cycles per bit, otherwise bidir_dshot_x1_fast
+ *
+ * @param clkSys system clock in Hz
+ * @param speed DShot speed in kBaud, e.g. 600 for DShot600
+ * @return uint8_t PIO cycles per bit (40 or 20), 0 if the system clock is too slow for both programs
+ */
+constexpr uint8_t dshotBidirCyclesPerBit(uint32_t clkSys, uint32_t speed) {
+	return dshotCalcClkDiv(clkSys, speed) >= 256 ? 40 : dshotCalcClkDiv(clkSys, speed, 20) >= 256 ? 20 : 0;
+}
+
+/**
+ * @brief waits until a running DShot state machine stalls on an empty TX FIFO, i.e. it is between two packets
+ *
+ * Max. 2ms, e.g. if a bidirectional program waits for a reply. Nothing must be written to the TX FIFO meanwhile.
+ */
+void dshotWaitBetweenFrames(PIO pio, uint sm);
+
+/**
+ * @brief sets the clock divider of a running DShot state machine between two packets
+ *
+ * Waits until the state machine is between two packets (see dshotWaitBetweenFrames), then writes the divider in one register access. Nothing must be written to the TX FIFO meanwhile.
+ *
+ * @param clkDiv divider in 16.8 fixed point, see dshotCalcClkDiv
+ */
+void dshotSetClkDivBetweenFrames(PIO pio, uint sm, uint32_t clkDiv);
+
+/**
+ * @brief drives GPIOs of a state machine high, e.g. to idle high before the first packet
+ *
+ * Uses the 64 bit variant of the SDK where PIO blocks can be moved to GPIO 16...47 (RP2350B), so GPIO 32...47 work as well.
+ *
+ * @param pinMask bit n = GPIO n
+ */
+void dshotSmSetPinsHigh(PIO pio, uint sm, uint64_t pinMask);
+
+/**
+ * @brief interleaves the 16 bit packets of 4 ESCs into the 2 words that the 4 pin PIO programs shift out
+ *
+ * Bit i of packet[0] is bit (i / 4 + 8) of motor i % 4, bit i of packet[1] is bit (i / 4) of motor i % 4.
+ *
+ * @param data 16 bit packets (with checksum) of the 4 motors
+ * @param packet pointer to 2 words to store the result
+ */
+void dshotPackX4(const uint16_t data[4], uint32_t packet[2]);
+
+/**
+ * @brief interleaves the 16 bit packets of 8 ESCs into the 4 words that the 8 pin PIO programs shift out
+ *
+ * Bit i of packet[w] is bit (i / 8 + 12 - 4 * w) of motor i % 8.
+ *
+ * @param data 16 bit packets (with checksum) of the 8 motors
+ * @param packet pointer to 4 words to store the result
+ */
+void dshotPackX8(const uint16_t data[8], uint32_t packet[4]);
+
+/**
+ * @brief sorts pins into windows of up to maxWidth consecutive GPIOs, e.g. for the out pins of a multi-pin program
+ *
+ * Greedy: every window starts at the lowest pin that is left and takes all pins below base + maxWidth, which gives the fewest windows.
+ *
+ * @param pins array of count distinct pins, any order
+ * @param count number of pins, 1...8
+ * @param maxWidth max. width of a window in GPIOs
+ * @param pinWindow array of count entries, receives the window of each pin
+ * @param windowBase array of count entries, receives the first GPIO of each window
+ * @param windowWidth array of count entries, receives the width of each window (last pin - first pin + 1)
+ * @return uint8_t number of windows
+ */
+uint8_t dshotPinWindows(const uint8_t *pins, uint8_t count, uint8_t maxWidth, uint8_t *pinWindow, uint8_t *windowBase, uint8_t *windowWidth);
+
+/**
+ * @brief returns the GPIOs in the out pin windows of all claimed state machines of a PIO block, read from their PINCTRL registers
+ *
+ * A state machine writes all GPIOs of its out window, so they must not be used by another state machine of the same PIO.
+ *
+ * @return uint64_t bit n is set if GPIO n is in an out window
+ */
+uint64_t dshotClaimedOutPins(PIO pio);
+
 #if DBG
 #include "Arduino.h"
 
@@ -22,3 +125,5 @@ void pioToPioStr(PIO pio, char str[32]);
 #else
 #define DEBUG_PRINTF
 #endif
+
+#endif // DSHOT_COMMON_H
@@ -4,4 +4,19 @@
 // Uncomment the following line to enable debugging
 // #define DSHOT_DEBUG
 
+// Number of telemetry frames that are kept per ESC until they are read with getTelemetryHistory. Must be a power of 2, max. 128
+#define DSHOT_TELEMETRY_HISTORY 16
+
+// Time (in us, after the end of the packet) that BidirDShotX1 waits for the start of a reply before it reports ::NO_REPLY. Replies usually start 25-30us after the packet
+#define DSHOT_REPLY_TIMEOUT_US 40
+
+// Number of special commands that can be queued per ESC with queueCommand. Must be a power of 2, max. 128
+#define DSHOT_COMMAND_QUEUE 8
+
+// Edge times (halfwords) buffered per BidirDShotX1 in the edge capture mode (enableEdgeCapture) until they are decoded, one reply takes up to 23. Must be a power of 2, min. 32
+#define DSHOT_CAPTURE_BUFFER 64
+
+// Compile the DShotBlackbox hooks into the drivers (1) or not (0). While no capture is started, a hook is a load and a branch per frame
+#define DSHOT_BLACKBOX 1
+
 #endif // DSHOT_CONFIG_H
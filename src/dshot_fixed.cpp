@@ -0,0 +1,102 @@
+#include "dshot_fixed.h"
+#include "dshot_registry.h"
+#include "hardware/clocks.h"
+#include "pio/bidir_dshot_x1.pio.h"
+#include "pio/bidir_dshot_x1_fast.pio.h"
+#include "pio/dshotx4.pio.h"
+
+/**
+ * @brief checks the clock, claims the SM and the program
+ *
+ * @return int the program offset, -1 on error
+ */
+static int fixedClaim(PIO pio, uint8_t sm, DShotProgram program, uint32_t clkSys) {
+#if DBG
+	char pioStr[32];
+	pioToPioStr(pio, pioStr);
+#else
+	const char *pioStr = nullptr; // always nullptr, don't use
+#endif
+
+	if (clock_get_hz(clk_sys) != clkSys) {
+		DEBUG_PRINTF("System clock is %d Hz, but the driver was built for %d Hz (clkSys)\n", clock_get_hz(clk_sys), clkSys);
+		return -1;
+	}
+	if (pio_sm_is_claimed(pio, sm)) {
+		DEBUG_PRINTF("SM provided but already claimed, pio=%s, sm=%d", pioStr, sm);
+		return -1;
+	}
+
+	int offset = dshotClaimProgram(pio, program);
+	if (offset < 0) {
+		DEBUG_PRINTF("No space for program on %s", pioStr);
+		return -1;
+	}
+	pio_sm_claim(pio, sm);
+	return offset;
+}
+
+int dshotFixedInitBidirX1(PIO pio, uint8_t sm, uint8_t pin, uint32_t clkDiv, uint32_t clkSys, uint8_t cyclesPerBit) {
+	int offset = fixedClaim(pio, sm, cyclesPerBit == 40 ? DShotProgram::BIDIR_X1 : DShotProgram::BIDIR_X1_FAST, clkSys);
+	if (offset < 0) {
+		return -1;
+	}
+
+	// same setup as BidirDShotX1, but with the precalculated divider
+	pio_gpio_init(pio, pin);
+	gpio_set_pulls(pin, true, false);
+	pio_sm_config c = cyclesPerBit == 40 ? bidir_dshot_x1_program_get_default_config(offset) : bidir_dshot_x1_fast_program_get_default_config(offset);
+	sm_config_set_set_pins(&c, pin, 1);
+	sm_config_set_out_pins(&c, pin, 1);
+	sm_config_set_in_pins(&c, pin);
+	sm_config_set_jmp_pin(&c, pin);
+	sm_config_set_out_shift(&c, false, false, 32);
+	sm_config_set_in_shift(&c, false, false, 32);
+	sm_config_set_clkdiv_int_frac(&c, clkDiv >> 8, clkDiv & 0xFF);
+	pio_sm_init(pio, sm, offset + 2, &c); // skip the push of the empty ISR
+	dshotSmSetPinsHigh(pio, sm, 1ull << pin); // idle high until the first packet
+	pio_sm_set_consecutive_pindirs(pio, sm, pin, 1, true);
+	pio_sm_set_enabled(pio, sm, true);
+	return offset;
+}
+
+int dshotFixedInitX4(PIO pio, uint8_t sm, uint8_t pinBase, uint8_t pinCount, uint32_t clkDiv, uint32_t clkSys) {
+	int offset = fixedClaim(pio, sm, DShotProgram::X4, clkSys);
+	if (offset < 0) {
+		return -1;
+	}
+
+	// same setup as DShotX4, but with the precalculated divider
+	for (int i = 0; i < pinCount; i++) {
+		pio_gpio_init(pio, pinBase + i);
+		gpio_set_pulls(pinBase + i, false, false);
+	}
+	pio_sm_config c = dshotx4_program_get_default_config(offset);
+	sm_config_set_set_pins(&c, pinBase, pinCount);
+	sm_config_set_out_pins(&c, pinBase, pinCount);
+	sm_config_set_out_shift(&c, false, false, 32);
+	sm_config_set_clkdiv_int_frac(&c, clkDiv >> 8, clkDiv & 0xFF);
+	pio_sm_set_consecutive_pindirs(pio, sm, pinBase, pinCount, true);
+	pio_sm_init(pio, sm, offset, &c);
+	pio_sm_set_enabled(pio, sm, true);
+	return offset;
+}
+
+void dshotFixedDeinit(PIO pio, uint8_t sm, DShotProgram program, uint8_t pinBase, uint8_t pinCount) {
+	bool bidir = program != DShotProgram::X4;
+	pio_sm_set_enabled(pio, sm, false);
+	pio_sm_unclaim(pio, sm);
+
+	dshotReleaseProgram(pio, program);
+
+	for (int i = 0; i < pinCount; i++) {
+		if (bidir) {
+			// same as BidirDShotX1: pull up to reduce artifacts
+			gpio_set_pulls(pinBase + i, true, false);
+			gpio_set_dir(pinBase + i, GPIO_IN);
+			gpio_set_function(pinBase + i, GPIO_FUNC_NULL);
+		} else {
+			gpio_init(pinBase + i);
+		}
+	}
+}
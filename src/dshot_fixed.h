@@ -0,0 +1,292 @@
+#ifndef DSHOT_FIXED_H
+#define DSHOT_FIXED_H
+
+#include "bidir_dshot_x1.h"
+#include "dshot_blackbox.h"
+#include "dshot_common.h"
+#include "dshot_registry.h"
+#include "hardware/pio.h"
+
+// system clock the compile-time drivers are built for. The constructor fails if the actual clock differs.
+#ifndef DSHOT_FIXED_CLK_SYS
+#ifdef F_CPU
+#define DSHOT_FIXED_CLK_SYS F_CPU
+#else
+#define DSHOT_FIXED_CLK_SYS SYS_CLK_HZ
+#endif
+#endif
+
+/**
+ * @brief sets up the state machine of a FixedBidirDShotX1 (claims the SM, loads the program, configures pins and clock)
+ *
+ * @param cyclesPerBit 40 for bidir_dshot_x1, 20 for bidir_dshot_x1_fast, see dshotBidirCyclesPerBit
+ * @return int the program offset, -1 on error
+ */
+int dshotFixedInitBidirX1(PIO pio, uint8_t sm, uint8_t pin, uint32_t clkDiv, uint32_t clkSys, uint8_t cyclesPerBit);
+
+/**
+ * @brief sets up the state machine of a FixedDShotX4 (claims the SM, loads the program, configures pins and clock)
+ *
+ * @return int the program offset, -1 on error
+ */
+int dshotFixedInitX4(PIO pio, uint8_t sm, uint8_t pinBase, uint8_t pinCount, uint32_t clkDiv, uint32_t clkSys);
+
+/**
+ * @brief stops the state machine of a compile-time driver and frees the SM, the program (if unused) and the pins
+ */
+void dshotFixedDeinit(PIO pio, uint8_t sm, DShotProgram program, uint8_t pinBase, uint8_t pinCount);
+
+/**
+ * @brief Bidirectional DShot for one ESC, with pin, speed, PIO and state machine fixed at compile time
+ *
+ * Same wire protocol and PIO programs as BidirDShotX1 (the program is selected at compile time), but the parameters are checked by the compiler and the clock divider is calculated at compile time. Sending is a checksum and one FIFO write, reading telemetry is a FIFO read and BidirDShotX1::decodeFrame. No heap allocations. Shares the program memory with BidirDShotX1 (see dshot_registry.h).
+ *
+ * Only the latest reply is kept. For the telemetry history, the interrupt mode and the free-running mode, use BidirDShotX1.
+ *
+ * @tparam pin the ESC pin
+ * @tparam speed DShot speed in kBaud, e.g. 600 for DShot600
+ * @tparam pioIndex the PIO block (0, 1, or 2 on RP2350)
+ * @tparam sm the state machine (0-3), must not be claimed yet
+ * @tparam clkSys the system clock in Hz, default DSHOT_FIXED_CLK_SYS
+ */
+template <uint8_t pin, uint32_t speed = 600, uint8_t pioIndex = 0, uint8_t sm = 0, uint32_t clkSys = DSHOT_FIXED_CLK_SYS>
+class FixedBidirDShotX1 {
+	static_assert(pin < NUM_BANK0_GPIOS, "pin is 0...29 (or 0...47 on RP2350)");
+	static_assert(speed >= 150 && speed <= 4800, "speed is 150...4800");
+	static_assert(pioIndex < NUM_PIOS, "pioIndex is 0 or 1 (or 2 on RP2350)");
+	static_assert(sm < 4, "sm is 0...3");
+
+	static constexpr uint8_t cyclesPerBit = dshotBidirCyclesPerBit(clkSys, speed); // same program selection as BidirDShotX1
+	static_assert(cyclesPerBit, "clkSys is too slow for this speed");
+	static constexpr uint32_t clkDiv = dshotCalcClkDiv(clkSys, speed, cyclesPerBit); // 16.8 fixed point
+	static_assert(clkDiv >= 256 && clkDiv < (65536 << 8), "clkSys is out of range for this speed");
+	static constexpr DShotProgram program = cyclesPerBit == 40 ? DShotProgram::BIDIR_X1 : DShotProgram::BIDIR_X1_FAST;
+	static constexpr uint32_t timeoutLoops = DSHOT_REPLY_TIMEOUT_US * speed * cyclesPerBit / 2000; // see BidirDShotX1
+	static constexpr uint32_t replyTimeout = (timeoutLoops > 0xFFFF ? 0xFFFF : timeoutLoops) << 16;
+
+public:
+	/**
+	 * @brief Initialize the state machine. Check initError() afterwards.
+	 */
+	FixedBidirDShotX1() {
+		this->iError = dshotFixedInitBidirX1(pio(), sm, pin, clkDiv, clkSys, cyclesPerBit) < 0;
+	}
+
+	/**
+	 * @brief Deinitialize the state machine, free the pin, and remove the program if this was the last user on this PIO block
+	 */
+	~FixedBidirDShotX1() {
+		if (!this->iError) {
+			dshotFixedDeinit(pio(), sm, program, pin, 1);
+		}
+	}
+
+	FixedBidirDShotX1(const FixedBidirDShotX1 &) = delete;
+	FixedBidirDShotX1 &operator=(const FixedBidirDShotX1 &) = delete;
+
+	/**
+	 * @brief Send a throttle value to the ESC, same as BidirDShotX1::sendThrottle
+	 *
+	 * @param throttle the throttle value, 0-2000
+	 */
+	inline void sendThrottle(uint16_t throttle) {
+		if (throttle > 2000) {
+			throttle = 2000;
+		}
+		if (throttle) throttle += 47;
+		this->sendRaw12Bit(throttle << 1);
+	}
+
+	/**
+	 * @brief Send a raw packet to the ESC, same as BidirDShotX1::sendRaw11Bit
+	 *
+	 * @param data the raw data to send, 11 bits, or 0-2047
+	 */
+	inline void sendRaw11Bit(uint16_t data) {
+		this->sendRaw12Bit((data << 1) | 1);
+	}
+
+	/**
+	 * @brief Send a raw packet to the ESC, same as BidirDShotX1::sendRaw12Bit
+	 *
+	 * @param data the raw data to send, 12 bits: xxxx dddd dddd dddt where d is data, t is telemetry request bit and x is ignored
+	 */
+	inline void sendRaw12Bit(uint16_t data) {
+		uint32_t csum = data ^ (data >> 4) ^ (data >> 8);
+		uint32_t packet = (uint16_t)((data << 4) | (~csum & 0xF));
+		dshotBlackboxTx(pin, packet);
+		pio_sm_put(pio(), sm, replyTimeout | (uint16_t)~packet);
+	}
+
+	/**
+	 * @brief Get the latest raw telemetry packet, same values as BidirDShotX1::getTelemetryRaw
+	 *
+	 * Older replies that were not read yet are discarded.
+	 *
+	 * @param value pointer to a uint32_t to store the 12 bit raw value. Must be a valid pointer, not nullptr.
+	 * @return BidirDshotTelemetryType, all values except ::OTHER_VALUE may be returned
+	 */
+	inline BidirDshotTelemetryType getTelemetryRaw(uint32_t *value) {
+		if (pio_sm_is_rx_fifo_empty(pio(), sm)) {
+			return BidirDshotTelemetryType::NO_PACKET;
+		}
+		uint32_t frame;
+		do {
+			frame = pio_sm_get(pio(), sm);
+			dshotBlackboxRx(pin, frame);
+		} while (!pio_sm_is_rx_fifo_empty(pio(), sm));
+		if (!frame) {
+			return BidirDshotTelemetryType::NO_REPLY;
+		}
+		return BidirDShotX1::decodeFrame(frame, value);
+	}
+
+	/**
+	 * @brief Get the current eRPM, same as BidirDShotX1::getTelemetryErpm
+	 *
+	 * @param erpm pointer to a uint32_t to store the erpm. Must be a valid pointer, not nullptr.
+	 * @return BidirDshotTelemetryType ::ERPM, ::OTHER_VALUE, ::NO_PACKET, ::NO_REPLY or ::CHECKSUM_ERROR
+	 */
+	inline BidirDshotTelemetryType getTelemetryErpm(uint32_t *erpm) {
+		uint32_t raw;
+		BidirDshotTelemetryType ret = this->getTelemetryRaw(&raw);
+		if (ret > BidirDshotTelemetryType::NO_PACKET) {
+			return BidirDshotTelemetryType::OTHER_VALUE;
+		}
+		if (ret > BidirDshotTelemetryType::ERPM) {
+			return ret;
+		}
+		BidirDShotErpm e;
+		if (!BidirDShotX1::decodeErpm(raw, &e)) {
+			return BidirDshotTelemetryType::CHECKSUM_ERROR; // not quite right, but close enough
+		}
+		*erpm = e.erpm;
+		return BidirDshotTelemetryType::ERPM;
+	}
+
+	/**
+	 * @brief checks if there was an error during initialisation (SM already claimed, no space for the program, or the system clock is not clkSys)
+	 *
+	 * define DSHOT_DEBUG in src/dshot_config.h to enable information on Serial why the initialisation failed
+	 */
+	bool initError() {
+		return iError;
+	}
+
+private:
+	bool iError = true; /// shows if there was an error during initialisation
+
+	static inline PIO pio() {
+		return pio_get_instance(pioIndex);
+	}
+};
+
+/**
+ * @brief Normal DShot for up to 4 ESCs on consecutive pins, with all parameters fixed at compile time
+ *
+ * Same wire protocol and PIO program as DShotX4, but the parameters are checked by the compiler and the clock divider is calculated at compile time. Sending is the checksums, dshotPackX4 and two FIFO writes. No heap allocations. Shares the program memory with DShotX4 (see dshot_registry.h). For the free-running mode, use DShotX4.
+ *
+ * @tparam pinBase the first ESC pin
+ * @tparam pinCount the number of ESC pins (1-4)
+ * @tparam speed DShot speed in kBaud, e.g. 600 for DShot600
+ * @tparam pioIndex the PIO block (0, 1, or 2 on RP2350)
+ * @tparam sm the state machine (0-3), must not be claimed yet
+ * @tparam clkSys the system clock in Hz, default DSHOT_FIXED_CLK_SYS
+ */
+template <uint8_t pinBase, uint8_t pinCount, uint32_t speed = 600, uint8_t pioIndex = 0, uint8_t sm = 0, uint32_t clkSys = DSHOT_FIXED_CLK_SYS>
+class FixedDShotX4 {
+	static_assert(pinCount >= 1 && pinCount <= 4, "pinCount is 1...4");
+	static_assert(pinBase + pinCount <= NUM_BANK0_GPIOS, "pins are 0...29 (or 0...47 on RP2350)");
+	static_assert(speed >= 150 && speed <= 4800, "speed is 150...4800");
+	static_assert(pioIndex < NUM_PIOS, "pioIndex is 0 or 1 (or 2 on RP2350)");
+	static_assert(sm < 4, "sm is 0...3");
+
+	static constexpr uint32_t clkDiv = dshotCalcClkDiv(clkSys, speed); // 16.8 fixed point
+	static_assert(clkDiv >= 256 && clkDiv < (65536 << 8), "clkSys is out of range for this speed");
+
+public:
+	/**
+	 * @brief Initialize the state machine. Check initError() afterwards.
+	 */
+	FixedDShotX4() {
+		this->iError = dshotFixedInitX4(pio(), sm, pinBase, pinCount, clkDiv, clkSys) < 0;
+	}
+
+	/**
+	 * @brief Deinitialize the state machine, free the pins, and remove the program if this was the last user on this PIO block
+	 */
+	~FixedDShotX4() {
+		if (!this->iError) {
+			dshotFixedDeinit(pio(), sm, DShotProgram::X4, pinBase, pinCount);
+		}
+	}
+
+	FixedDShotX4(const FixedDShotX4 &) = delete;
+	FixedDShotX4 &operator=(const FixedDShotX4 &) = delete;
+
+	/**
+	 * @brief Send throttle values to the ESCs, same as DShotX4::sendThrottles (but the array is not modified)
+	 *
+	 * @param throttles the throttle values, 0-2000
+	 */
+	inline void sendThrottles(const uint16_t throttles[4]) {
+		uint16_t data[4];
+		for (int i = 0; i < 4; i++) {
+			uint16_t t = throttles[i] > 2000 ? 2000 : throttles[i];
+			if (t) t += 47;
+			data[i] = t << 1;
+		}
+		this->sendRaw12Bit(data);
+	}
+
+	/**
+	 * @brief Send raw packets to the ESCs, same as DShotX4::sendRaw11Bit (but the array is not modified)
+	 *
+	 * @param data the raw data to send, 11 bits, or 0-2047
+	 */
+	inline void sendRaw11Bit(const uint16_t data[4]) {
+		uint16_t d[4];
+		for (int i = 0; i < 4; i++) {
+			d[i] = (data[i] << 1) | 1;
+		}
+		this->sendRaw12Bit(d);
+	}
+
+	/**
+	 * @brief Send raw packets to the ESCs, same as DShotX4::sendRaw12Bit (but the array is not modified)
+	 *
+	 * @param data the raw data to send, 12 bits: xxxx dddd dddd dddt where d is data, t is telemetry request bit and x is ignored
+	 */
+	inline void sendRaw12Bit(const uint16_t data[4]) {
+		uint16_t d[4];
+		for (int i = 0; i < 4; i++) {
+			uint32_t csum = data[i] ^ (data[i] >> 4) ^ (data[i] >> 8);
+			d[i] = (data[i] << 4) | (csum & 0xF);
+		}
+		for (int i = 0; i < pinCount; i++) {
+			dshotBlackboxTx(pinBase + i, d[i]);
+		}
+		uint32_t packet[2];
+		dshotPackX4(d, packet);
+		pio_sm_put(pio(), sm, packet[0]);
+		pio_sm_put(pio(), sm, packet[1]);
+	}
+
+	/**
+	 * @brief checks if there was an error during initialisation (SM already claimed, no space for the program, or the system clock is not clkSys)
+	 *
+	 * define DSHOT_DEBUG in src/dshot_config.h to enable information on Serial why the initialisation failed
+	 */
+	bool initError() {
+		return iError;
+	}
+
+private:
+	bool iError = true; /// shows if there was an error during initialisation
+
+	static inline PIO pio() {
+		return pio_get_instance(pioIndex);
+	}
+};
+
+#endif // DSHOT_FIXED_H
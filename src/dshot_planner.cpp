@@ -0,0 +1,264 @@
+#include "dshot_planner.h"
+#include "dshot_common.h"
+#include "dshot_registry.h"
+#include "hardware/clocks.h"
+
+// what a PIO block is used for in one candidate assignment, the programs of the classes don't fit next to each other
+enum PlanRole : uint8_t {
+	ROLE_UNUSED,
+	ROLE_X4, // dshotx4 and dshotx8
+	ROLE_BIDIR_X1, // bidir_dshot_x1
+	ROLE_BIDIR_X1_FAST, // bidir_dshot_x1_fast
+	ROLE_COUNT,
+};
+
+// resources of one PIO block while planning
+struct PlanResources {
+	uint32_t freeInstructions; // bit n: instruction n is free
+	uint8_t freeSms;
+	bool loaded[(int)DShotProgram::COUNT]; // loaded by other drivers, or by an earlier driver of the plan
+	uint64_t outPins; // GPIOs in the out windows of the claimed state machines and the drivers of the plan
+	bool touched; // the plan adds a driver
+};
+
+// a driver of the plan before it is placed on a PIO block
+struct PlanItem {
+	PlanRole role;
+	uint8_t windowCount;
+	DShotProgram programs[4]; // program of every window
+	uint64_t outPins; // GPIOs of all windows
+};
+
+static void probeResources(PIO pio, PlanResources *r) {
+	// a one instruction program at every offset shows the free instruction memory, including programs of other libraries
+	static const uint16_t probeInstruction = 0xA042; // mov y, y
+	pio_program_t probe = {};
+	probe.instructions = &probeInstruction;
+	probe.length = 1;
+	probe.origin = -1;
+	r->freeInstructions = 0;
+	for (int i = 0; i < 32; i++) {
+		if (pio_can_add_program_at_offset(pio, &probe, i)) r->freeInstructions |= 1u << i;
+	}
+	r->freeSms = 0;
+	for (int sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+		if (!pio_sm_is_claimed(pio, sm)) r->freeSms++;
+	}
+	for (int p = 0; p < (int)DShotProgram::COUNT; p++) {
+		r->loaded[p] = dshotProgramUsers(pio, (DShotProgram)p) > 0;
+	}
+	r->outPins = dshotClaimedOutPins(pio);
+	r->touched = false;
+}
+
+// same search as pio_add_program: the highest offset that fits
+static bool planProgram(PlanResources *r, DShotProgram program) {
+	if (r->loaded[(int)program]) {
+		return true;
+	}
+	uint8_t length = dshotProgramLength(program);
+	uint32_t mask = (1u << length) - 1;
+	for (int offset = 32 - length; offset >= 0; offset--) {
+		if ((r->freeInstructions >> offset & mask) == mask) {
+			r->freeInstructions &= ~(mask << offset);
+			r->loaded[(int)program] = true;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool planItem(PlanResources *r, const PlanItem &item) {
+	if (r->freeSms < item.windowCount || (r->outPins & item.outPins)) {
+		return false;
+	}
+	PlanResources next = *r;
+	for (int w = 0; w < item.windowCount; w++) {
+		if (!planProgram(&next, item.programs[w])) {
+			return false;
+		}
+	}
+	next.freeSms -= item.windowCount;
+	next.outPins |= item.outPins;
+	next.touched = true;
+	*r = next;
+	return true;
+}
+
+bool dshotPlanMotors(const DShotMotorSpec *motors, uint8_t count, DShotPlan *plan) {
+	plan->driverCount = 0;
+	plan->pioCount = 0;
+	if (!count || count > DSHOT_PLAN_MAX_MOTORS) {
+		DEBUG_PRINTF("Invalid count: %d, must be 1...%d\n", count, DSHOT_PLAN_MAX_MOTORS);
+		return false;
+	}
+	uint64_t usedPins = 0;
+	for (int i = 0; i < count; i++) {
+		if (motors[i].pin >= NUM_BANK0_GPIOS || (usedPins >> motors[i].pin & 1) || motors[i].speed < 150 || motors[i].speed > 4800) {
+			DEBUG_PRINTF("Invalid motor %d: pin=%d, speed=%d. Pins must be 0...29 (or 0...47 on RP2350) and only used once, speed 150...4800\n", i, motors[i].pin, motors[i].speed);
+			return false;
+		}
+		usedPins |= 1ull << motors[i].pin;
+	}
+
+	// bidirectional motors: one BidirDShotX1 each
+	uint32_t clkSys = clock_get_hz(clk_sys);
+	PlanItem items[DSHOT_PLAN_MAX_DRIVERS];
+	DShotPlanDriver drivers[DSHOT_PLAN_MAX_DRIVERS];
+	uint8_t itemCount = 0;
+	for (int i = 0; i < count; i++) {
+		if (!motors[i].bidir) continue;
+		uint8_t cyclesPerBit = dshotBidirCyclesPerBit(clkSys, motors[i].speed);
+		if (!cyclesPerBit) {
+			DEBUG_PRINTF("System clock too slow for bidirectional DShot%d, motor %d\n", motors[i].speed, i);
+			return false;
+		}
+		if (itemCount == DSHOT_PLAN_MAX_DRIVERS) {
+			DEBUG_PRINTF("More drivers than state machines: %d\n", itemCount + 1);
+			return false;
+		}
+		PlanItem &item = items[itemCount];
+		item.role = cyclesPerBit == 40 ? ROLE_BIDIR_X1 : ROLE_BIDIR_X1_FAST;
+		item.windowCount = 1;
+		item.programs[0] = cyclesPerBit == 40 ? DShotProgram::BIDIR_X1 : DShotProgram::BIDIR_X1_FAST;
+		item.outPins = 1ull << motors[i].pin;
+		DShotPlanDriver &d = drivers[itemCount++];
+		d.type = DShotPlanDriverType::BIDIR_X1;
+		d.speed = motors[i].speed;
+		d.pinCount = 1;
+		d.pins[0] = motors[i].pin;
+		d.motors[0] = i;
+		d.stateMachines = 1;
+	}
+
+	// normal motors: sorted by speed and pin, one DShotX4 per 4 motors of the same speed, so that the pin windows of one speed don't overlap
+	uint8_t order[DSHOT_PLAN_MAX_MOTORS];
+	uint8_t normalCount = 0;
+	for (int i = 0; i < count; i++) {
+		if (motors[i].bidir) continue;
+		if (dshotCalcClkDiv(clkSys, motors[i].speed) < 256) {
+			DEBUG_PRINTF("System clock too slow for DShot%d, motor %d\n", motors[i].speed, i);
+			return false;
+		}
+		int j = normalCount++;
+		for (; j > 0; j--) {
+			const DShotMotorSpec &prev = motors[order[j - 1]];
+			if (prev.speed < motors[i].speed || (prev.speed == motors[i].speed && prev.pin < motors[i].pin)) break;
+			order[j] = order[j - 1];
+		}
+		order[j] = i;
+	}
+	for (int start = 0; start < normalCount;) {
+		if (itemCount == DSHOT_PLAN_MAX_DRIVERS) {
+			DEBUG_PRINTF("More drivers than state machines: %d\n", itemCount + 1);
+			return false;
+		}
+		DShotPlanDriver &d = drivers[itemCount];
+		d.type = DShotPlanDriverType::X4;
+		d.speed = motors[order[start]].speed;
+		d.pinCount = 0;
+		while (start < normalCount && d.pinCount < 4 && motors[order[start]].speed == d.speed) {
+			d.motors[d.pinCount] = order[start];
+			d.pins[d.pinCount++] = motors[order[start++]].pin;
+		}
+		PlanItem &item = items[itemCount++];
+		uint8_t pinWindow[4], bases[4], widths[4];
+		item.role = ROLE_X4;
+		item.windowCount = dshotPinWindows(d.pins, d.pinCount, DSHOT_X4_MAX_WINDOW, pinWindow, bases, widths);
+		item.outPins = 0;
+		for (int w = 0; w < item.windowCount; w++) {
+			item.programs[w] = widths[w] > 4 ? DShotProgram::X8 : DShotProgram::X4;
+			item.outPins |= ((1ull << widths[w]) - 1) << bases[w];
+		}
+		d.stateMachines = item.windowCount;
+	}
+
+	// try every role of every PIO block: fewest PIO blocks first, then fewest new instructions
+	PlanResources initial[NUM_PIOS];
+	uint32_t initialFree = 0;
+	for (int p = 0; p < NUM_PIOS; p++) {
+		probeResources(pio_get_instance(p), &initial[p]);
+		initialFree += __builtin_popcount(initial[p].freeInstructions);
+	}
+	uint32_t combinations = 1;
+	for (int p = 0; p < NUM_PIOS; p++) {
+		combinations *= ROLE_COUNT;
+	}
+	uint32_t bestScore = UINT32_MAX;
+	PlanResources best[NUM_PIOS];
+	uint8_t bestPio[DSHOT_PLAN_MAX_DRIVERS];
+	for (uint32_t combination = 0; combination < combinations; combination++) {
+		PlanRole roles[NUM_PIOS];
+		PlanResources res[NUM_PIOS];
+		uint8_t itemPio[DSHOT_PLAN_MAX_DRIVERS];
+		for (uint32_t p = 0, c = combination; p < NUM_PIOS; p++, c /= ROLE_COUNT) {
+			roles[p] = (PlanRole)(c % ROLE_COUNT);
+			res[p] = initial[p];
+		}
+		bool fits = true;
+		for (int i = 0; i < itemCount && fits; i++) {
+			fits = false;
+			for (int p = 0; p < NUM_PIOS && !fits; p++) {
+				if (roles[p] == items[i].role && planItem(&res[p], items[i])) {
+					itemPio[i] = p;
+					fits = true;
+				}
+			}
+		}
+		if (!fits) continue;
+		uint32_t pios = 0, freeInstructions = 0;
+		for (int p = 0; p < NUM_PIOS; p++) {
+			pios += res[p].touched;
+			freeInstructions += __builtin_popcount(res[p].freeInstructions);
+		}
+		uint32_t score = pios << 16 | (initialFree - freeInstructions);
+		if (score < bestScore) {
+			bestScore = score;
+			for (int p = 0; p < NUM_PIOS; p++) {
+				best[p] = res[p];
+			}
+			for (int i = 0; i < itemCount; i++) {
+				bestPio[i] = itemPio[i];
+			}
+		}
+	}
+	if (bestScore == UINT32_MAX) {
+		DEBUG_PRINTF("The motors don't fit into the free state machines and instruction memory, drivers: %d\n", itemCount);
+		return false;
+	}
+
+	// the drivers are created in the order of the plan, so that the programs end up where they were planned
+	for (int i = 0; i < itemCount; i++) {
+		DShotPlanDriver &d = plan->drivers[i];
+		d = drivers[i];
+		d.pio = pio_get_instance(bestPio[i]);
+		for (int c = 0; c < d.pinCount; c++) {
+			plan->motorDriver[d.motors[c]] = i;
+			plan->motorChannel[d.motors[c]] = c;
+		}
+	}
+	plan->driverCount = itemCount;
+	plan->pioCount = bestScore >> 16;
+	for (int p = 0; p < NUM_PIOS; p++) {
+		plan->freeSms[p] = best[p].freeSms;
+		plan->freeInstructions[p] = __builtin_popcount(best[p].freeInstructions);
+	}
+	return true;
+}
+
+bool dshotCreateDrivers(const DShotPlan *plan, BidirDShotX1 **bidir, DShotX4 **normal) {
+	bool ok = true;
+	for (int i = 0; i < plan->driverCount; i++) {
+		const DShotPlanDriver &d = plan->drivers[i];
+		bidir[i] = nullptr;
+		normal[i] = nullptr;
+		if (d.type == DShotPlanDriverType::BIDIR_X1) {
+			bidir[i] = new BidirDShotX1(d.pins[0], d.speed, d.pio);
+			ok &= !bidir[i]->initError();
+		} else {
+			normal[i] = new DShotX4(d.pins, d.pinCount, d.speed, d.pio);
+			ok &= !normal[i]->initError();
+		}
+	}
+	return ok;
+}
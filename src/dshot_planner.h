@@ -0,0 +1,82 @@
+#ifndef DSHOT_PLANNER_H
+#define DSHOT_PLANNER_H
+
+#include "bidir_dshot_x1.h"
+#include "dshot_x4.h"
+#include "hardware/pio.h"
+
+#define DSHOT_PLAN_MAX_MOTORS 48 /// max. motors of one plan (all GPIOs of the RP2350B)
+#define DSHOT_PLAN_MAX_DRIVERS (NUM_PIOS * NUM_PIO_STATE_MACHINES) /// every driver needs at least one state machine
+
+/**
+ * @brief One motor for dshotPlanMotors
+ */
+struct DShotMotorSpec {
+	uint8_t pin; /// ESC pin
+	bool bidir; /// bidirectional DShot (BidirDShotX1), otherwise normal DShot (DShotX4)
+	uint32_t speed; /// speed in kBaud, e.g. 600 for DShot600
+};
+
+/**
+ * @brief Driver class of a planned driver
+ */
+enum class DShotPlanDriverType : uint8_t {
+	BIDIR_X1, /// BidirDShotX1, one bidirectional ESC
+	X4, /// DShotX4, up to 4 normal ESCs of the same speed (pin list constructor)
+};
+
+/**
+ * @brief One driver of a DShotPlan, i.e. the parameters of one constructor call
+ */
+struct DShotPlanDriver {
+	DShotPlanDriverType type; /// driver class
+	PIO pio; /// PIO block of the driver
+	uint32_t speed; /// speed in kBaud
+	uint8_t pinCount; /// 1 for BidirDShotX1, 1...4 for DShotX4
+	uint8_t pins[4]; /// ESC pins, in the order of the channels
+	uint8_t motors[4]; /// index of every channel into the motor list
+	uint8_t stateMachines; /// state machines the driver claims (DShotX4: one per pin window)
+};
+
+/**
+ * @brief Allocation of a list of motors to drivers and PIO blocks, see dshotPlanMotors
+ */
+struct DShotPlan {
+	uint8_t driverCount; /// number of drivers, 0 if no allocation was found
+	DShotPlanDriver drivers[DSHOT_PLAN_MAX_DRIVERS]; /// the drivers, in the order they have to be created
+	uint8_t motorDriver[DSHOT_PLAN_MAX_MOTORS]; /// index into drivers of every motor
+	uint8_t motorChannel[DSHOT_PLAN_MAX_MOTORS]; /// channel of every motor in its driver
+	uint8_t pioCount; /// number of PIO blocks that get a driver
+	uint8_t freeSms[NUM_PIOS]; /// unclaimed state machines of every PIO block after creating the drivers
+	uint8_t freeInstructions[NUM_PIOS]; /// free instruction memory of every PIO block after creating the drivers
+};
+
+/**
+ * @brief Distributes motors to BidirDShotX1 and DShotX4 drivers on all PIO blocks, using the fewest PIO blocks
+ *
+ * Starts from the current state of the hardware: claimed state machines, used instruction memory and the programs already loaded by other drivers (which are reused, see dshot_registry.h). Every bidirectional motor gets a BidirDShotX1 (the program variant depends on the speed and clk_sys, see dshotBidirCyclesPerBit), the normal motors are sorted by speed and pin and get one DShotX4 per 4 motors of the same speed (one state machine per pin window, see the pin list constructor). Then every assignment of the programs to the PIO blocks is tried, the one with the fewest PIO blocks and the fewest new instructions wins.
+ *
+ * Nothing is claimed, use dshotCreateDrivers to create the drivers. No heap allocations.
+ *
+ * @param motors array of count motors
+ * @param count number of motors, 1...DSHOT_PLAN_MAX_MOTORS
+ * @param plan pointer to store the allocation and the remaining resources. Must be a valid pointer, not nullptr.
+ * @return true if all motors fit
+ * @return false if the motors are invalid (pin, duplicate pin, speed, speed too high for clk_sys) or don't fit into the free state machines and instruction memory, plan->driverCount is 0
+ */
+bool dshotPlanMotors(const DShotMotorSpec *motors, uint8_t count, DShotPlan *plan);
+
+/**
+ * @brief Creates the drivers of a plan (with new), in the order of plan->drivers
+ *
+ * Call it right after dshotPlanMotors, before anything else claims PIO resources.
+ *
+ * @param plan the plan of dshotPlanMotors
+ * @param bidir array of plan->driverCount pointers, receives the BidirDShotX1 of every driver of type ::BIDIR_X1, nullptr for the others
+ * @param normal array of plan->driverCount pointers, receives the DShotX4 of every driver of type ::X4, nullptr for the others
+ * @return true if all drivers were initialised without error
+ * @return false if a driver has an initError (it is created anyway, so that it can be inspected and deleted)
+ */
+bool dshotCreateDrivers(const DShotPlan *plan, BidirDShotX1 **bidir, DShotX4 **normal);
+
+#endif // DSHOT_PLANNER_H
@@ -0,0 +1,74 @@
+#include "dshot_registry.h"
+#include "pio/bidir_dshot_x1.pio.h"
+#include "pio/bidir_dshot_x1_capture.pio.h"
+#include "pio/bidir_dshot_x1_fast.pio.h"
+#include "pio/bidir_dshot_x4.pio.h"
+#include "pio/dshotx4.pio.h"
+#include "pio/dshotx8.pio.h"
+
+static const pio_program_t *const programs[(int)DShotProgram::COUNT] = {
+	&bidir_dshot_x1_program,
+	&bidir_dshot_x1_fast_program,
+	&bidir_dshot_x1_capture_program,
+	&bidir_dshot_x4_program,
+	&dshotx4_program,
+	&dshotx8_program,
+};
+
+// offset and number of users of every program on every PIO block
+static struct {
+	uint8_t offset;
+	uint8_t users;
+} registry[NUM_PIOS][(int)DShotProgram::COUNT];
+
+// drivers to notify about clock changes, by PIO block and state machine
+static struct {
+	DShotClockCallback callback;
+	void *driver;
+} clockCallbacks[NUM_PIOS][NUM_PIO_STATE_MACHINES];
+
+int dshotClaimProgram(PIO pio, DShotProgram program) {
+	auto &entry = registry[pio_get_index(pio)][(int)program];
+	if (!entry.users) {
+		if (!pio_can_add_program(pio, programs[(int)program])) {
+			return -1;
+		}
+		entry.offset = pio_add_program(pio, programs[(int)program]);
+	}
+	entry.users++;
+	return entry.offset;
+}
+
+void dshotReleaseProgram(PIO pio, DShotProgram program) {
+	auto &entry = registry[pio_get_index(pio)][(int)program];
+	if (!entry.users) {
+		return;
+	}
+	if (!--entry.users) {
+		pio_remove_program(pio, programs[(int)program], entry.offset);
+	}
+}
+
+uint8_t dshotProgramUsers(PIO pio, DShotProgram program) {
+	return registry[pio_get_index(pio)][(int)program].users;
+}
+
+uint8_t dshotProgramLength(DShotProgram program) {
+	return programs[(int)program]->length;
+}
+
+void dshotRegisterClockCallback(PIO pio, uint sm, DShotClockCallback callback, void *driver) {
+	auto &entry = clockCallbacks[pio_get_index(pio)][sm];
+	entry.callback = callback;
+	entry.driver = driver;
+}
+
+void dshotClockChanged() {
+	for (int p = 0; p < NUM_PIOS; p++) {
+		for (int i = 0; i < NUM_PIO_STATE_MACHINES; i++) {
+			if (clockCallbacks[p][i].callback) {
+				clockCallbacks[p][i].callback(clockCallbacks[p][i].driver);
+			}
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#ifndef DSHOT_REGISTRY_H
+#define DSHOT_REGISTRY_H
+
+#include "hardware/pio.h"
+
+/**
+ * @brief The PIO programs of this library, index into the program registry
+ */
+enum class DShotProgram : uint8_t {
+	BIDIR_X1, /// bidir_dshot_x1, BidirDShotX1 and FixedBidirDShotX1
+	BIDIR_X1_FAST, /// bidir_dshot_x1_fast, BidirDShotX1 and FixedBidirDShotX1 if the system clock is too slow for bidir_dshot_x1
+	BIDIR_X1_CAPTURE, /// bidir_dshot_x1_capture, BidirDShotX1 in the edge capture mode
+	BIDIR_X4, /// bidir_dshot_x4, BidirDShotX4
+	X4, /// dshotx4, DShotX4 and FixedDShotX4
+	X8, /// dshotx8, DShotX8
+	COUNT,
+};
+
+/**
+ * @brief Loads a program into a PIO block, or reuses it if it is already loaded there
+ *
+ * All drivers share one statically allocated, reference counted table per PIO block, so every program is loaded at most once per PIO, no matter which driver uses it. O(1), no heap allocations.
+ *
+ * @param pio the PIO block
+ * @param program the program to load
+ * @return int the program offset, -1 if there is no space in the instruction memory
+ */
+int dshotClaimProgram(PIO pio, DShotProgram program);
+
+/**
+ * @brief Releases a program claimed with dshotClaimProgram, removes it from the PIO block when the last user releases it
+ *
+ * @param pio the PIO block
+ * @param program the program to release
+ */
+void dshotReleaseProgram(PIO pio, DShotProgram program);
+
+/**
+ * @brief Returns the number of drivers that currently use a program on a PIO block
+ *
+ * @param pio the PIO block
+ * @param program the program
+ * @return uint8_t number of users, 0 if the program is not loaded
+ */
+uint8_t dshotProgramUsers(PIO pio, DShotProgram program);
+
+/**
+ * @brief Returns the number of instructions of a program, e.g. to plan the instruction memory
+ */
+uint8_t dshotProgramLength(DShotProgram program);
+
+/**
+ * @brief Function that recalculates the clock divider of a driver, see dshotRegisterClockCallback
+ */
+typedef void (*DShotClockCallback)(void *driver);
+
+/**
+ * @brief Registers a driver to be notified by dshotClockChanged. One entry per state machine, statically allocated.
+ *
+ * @param pio the PIO block of the driver
+ * @param sm the state machine of the driver
+ * @param callback function to call, nullptr to unregister
+ * @param driver passed to the callback
+ */
+void dshotRegisterClockCallback(PIO pio, uint sm, DShotClockCallback callback, void *driver);
+
+/**
+ * @brief Recalculates the clock dividers of all drivers. Call this after changing the system clock (e.g. with set_sys_clock_khz).
+ *
+ * Each state machine is updated between two packets (see setSpeed of the drivers). If the new clock is too slow for the speed of a driver, it keeps its old divider (and sends at a lower speed). The compile-time drivers (FixedBidirDShotX1, FixedDShotX4) are not updated, their divider is fixed.
+ */
+void dshotClockChanged();
+
+#endif // DSHOT_REGISTRY_H
@@ -1,11 +1,35 @@
 #include "dshot_x4.h"
+#include "dshot_blackbox.h"
 #include "dshot_common.h"
+#include "dshot_registry.h"
 #include "hardware/clocks.h"
+#include "hardware/dma.h"
 #include "pio/dshotx4.pio.h"
+#include "pio/dshotx8.pio.h"
 
-vector<DShotX4 *> DShotX4::instances;
+DShotX4::DShotX4(int pinBase, uint8_t pinCount, uint32_t speed, PIO pio, int8_t sm) {
+	if (pinBase < 0 || pinBase >= NUM_BANK0_GPIOS) {
+		DEBUG_PRINTF("Invalid pinBase: %d, must be 0...29 (or 0...47 on RP2350)\n", pinBase);
+		iError = true;
+		return;
+	}
+	uint8_t pins[4];
+	for (int i = 0; i < 4; i++) {
+		pins[i] = pinBase + i;
+	}
+	this->init(pins, pinCount, speed, pio, sm);
+}
 
-DShotX4::DShotX4(uint8_t pinBase, uint8_t pinCount, uint32_t speed, PIO pio, int8_t sm) {
+DShotX4::DShotX4(const uint8_t *pins, uint8_t pinCount, uint32_t speed, PIO pio, int8_t sm) {
+	if (!pins) {
+		DEBUG_PRINTF("No pins supplied, pinCount=%d\n", pinCount);
+		iError = true;
+		return;
+	}
+	this->init(pins, pinCount, speed, pio, sm);
+}
+
+void DShotX4::init(const uint8_t *pins, uint8_t pinCount, uint32_t speed, PIO pio, int8_t sm) {
 #if DBG
 	char pioStr[32] = "";
 	pioToPioStr(pio, pioStr);
@@ -15,87 +39,142 @@ DShotX4::DShotX4(uint8_t pinBase, uint8_t pinCount, uint32_t speed, PIO pio, int
 
 	// ensure valid parameters
 	if (sm >= 4 || sm < -1 ||
-		pinBase >= NUM_BANK0_GPIOS || pinCount > 4 || !pinCount ||
+		pinCount > 4 || !pinCount ||
 		speed < 150 || speed > 4800 ||
 		(pio != pio0 && pio != pio1
 #if NUM_PIOS > 2
 		 && pio != pio2
 #endif
 		 )) {
-		DEBUG_PRINTF("Invalid parameters: Check that sm is -1...3, pinBase is 0...29 (or 0...47 on RP2350), pinCount is 1...4, speed is 150...4800 and pio is pio0 or pio1 (or pio2 on RP2350). You supplied: sm=%d, pinBase=%d, pinCount=%d, speed=%d, pio=%s\n", sm, pinBase, pinCount, speed, pioStr);
+		DEBUG_PRINTF("Invalid parameters: Check that sm is -1...3, pinCount is 1...4, speed is 150...4800 and pio is pio0 or pio1 (or pio2 on RP2350). You supplied: sm=%d, pinCount=%d, speed=%d, pio=%s\n", sm, pinCount, speed, pioStr);
 		iError = true;
 		return;
 	}
+	for (int i = 0; i < pinCount; i++) {
+		bool duplicate = false;
+		for (int j = 0; j < i; j++) {
+			if (pins[j] == pins[i]) duplicate = true;
+		}
+		if (pins[i] >= NUM_BANK0_GPIOS || duplicate) {
+			DEBUG_PRINTF("Invalid pin: %d, must be 0...29 (or 0...47 on RP2350) and only used once\n", pins[i]);
+			iError = true;
+			return;
+		}
+	}
 
 	if (speed != 150 && speed != 300 && speed != 600 && speed != 1200 && speed != 2400) {
 		DEBUG_PRINTF("Unofficial speed: %d. Unless you know what you are doing, please select DShot 150, 300, 600, 1200 or 2400.\n", speed);
 	}
 
-	// Check if SM is claimed, then claim it
-	if (sm == -1) {
-		sm = pio_claim_unused_sm(pio, false);
-		if (sm < 0) {
-			DEBUG_PRINTF("No free state machines available, pio=%s\n", pioStr);
-			iError = true;
-			return;
-		}
-	} else {
-		if (pio_sm_is_claimed(pio, sm)) {
-			DEBUG_PRINTF("SM provided but already claimed, pio=%s, sm=%d", pioStr, sm);
-			iError = true;
-			return;
-		}
-		pio_sm_claim(pio, sm);
+	uint32_t clkSys = clock_get_hz(clk_sys);
+	if (dshotCalcClkDiv(clkSys, speed) < 256) {
+		DEBUG_PRINTF("Speed %d is too high for the system clock of %d Hz\n", speed, clkSys);
+		iError = true;
+		return;
 	}
-	this->sm = sm;
 
-	// check if the program is already loaded, if not, try to load it
-	uint8_t o = 255;
-	for (auto inst : this->instances) {
-		if (inst->pio == pio && inst->initError() == false) {
-			o = inst->offset;
-			break;
-		}
+	this->pio = pio;
+	this->speed = speed;
+	for (int i = 0; i < pinCount; i++) {
+		this->pins[i] = pins[i];
 	}
-	if (o == 255) {
-		if (pio_can_add_program(pio, &dshotx4_program)) {
-			this->offset = pio_add_program(pio, &dshotx4_program);
+
+	uint8_t pinWindow[4], bases[4], widths[4];
+	uint8_t windows = dshotPinWindows(pins, pinCount, DSHOT_X4_MAX_WINDOW, pinWindow, bases, widths);
+	for (int w = 0; w < windows; w++) {
+		uint8_t base = bases[w], width = widths[w], top = base + width - 1;
+		uint32_t used = 0; // pins of this window, relative to base
+		for (int i = 0; i < pinCount; i++) {
+			if (pinWindow[i] != w) continue;
+			this->channelWindow[i] = w;
+			this->channelLane[i] = pins[i] - base;
+			used |= 1u << (pins[i] - base);
+		}
+		bool x8 = width > 4;
+
+		// the gaps are written as well, they must not belong to another state machine of this PIO, and vice versa
+		uint64_t claimedOut = dshotClaimedOutPins(pio);
+		for (int lane = 0; lane < width; lane++) {
+			uint8_t pin = base + lane;
+			bool conflict;
+			if (used & (1u << lane)) {
+				conflict = claimedOut >> pin & 1;
+			} else {
+				conflict = gpio_get_function(pin) == (enum gpio_function)(GPIO_FUNC_PIO0 + pio_get_index(pio));
+			}
+			if (conflict) {
+				DEBUG_PRINTF("Pin %d of the window %d...%d is already used by another state machine of %s\n", pin, base, top, pioStr);
+				this->deinit();
+				iError = true;
+				return;
+			}
+		}
+
+		// Check if SM is claimed, then claim it (only the first window can use the supplied one)
+		int s = this->windowCount ? -1 : sm;
+		if (s == -1) {
+			s = pio_claim_unused_sm(pio, false);
+			if (s < 0) {
+				DEBUG_PRINTF("No free state machines available, pio=%s\n", pioStr);
+				this->deinit();
+				iError = true;
+				return;
+			}
 		} else {
+			if (pio_sm_is_claimed(pio, s)) {
+				DEBUG_PRINTF("SM provided but already claimed, pio=%s, sm=%d", pioStr, s);
+				iError = true;
+				return;
+			}
+			pio_sm_claim(pio, s);
+		}
+
+		// load the program, unless it is already loaded on this PIO
+		int o = dshotClaimProgram(pio, x8 ? DShotProgram::X8 : DShotProgram::X4);
+		if (o < 0) {
 			DEBUG_PRINTF("No space for program on %s", pioStr);
+			pio_sm_unclaim(pio, s);
+			this->deinit();
 			iError = true;
-			pio_sm_unclaim(pio, sm);
 			return;
 		}
-	} else {
-		this->offset = o;
+
+		// set up GPIOs, only the ESC pins are outputs
+		for (int lane = 0; lane < width; lane++) {
+			if (!(used & (1u << lane))) continue;
+			pio_gpio_init(pio, base + lane);
+			gpio_set_pulls(base + lane, false, false);
+		}
+
+		// set up the state machine
+		pio_sm_config c;
+		if (x8) {
+			c = dshotx8_program_get_default_config(o);
+			sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_TX); // 4 words per frame, 8 deep FIFO leaves room for a second frame
+		} else {
+			c = dshotx4_program_get_default_config(o);
+			sm_config_set_set_pins(&c, base, width);
+		}
+		sm_config_set_out_pins(&c, base, width);
+		sm_config_set_out_shift(&c, false, false, 32);
+		uint32_t clkDiv = dshotCalcClkDiv(clkSys, speed);
+		sm_config_set_clkdiv_int_frac(&c, clkDiv >> 8, clkDiv & 0xFF);
+		for (int lane = 0; lane < width; lane++) {
+			if (used & (1u << lane)) pio_sm_set_consecutive_pindirs(pio, s, base + lane, 1, true);
+		}
+		pio_sm_init(pio, s, o, &c);
+		pio_sm_set_enabled(pio, s, true);
+
+		this->sms[this->windowCount] = s;
+		this->windowBase[this->windowCount] = base;
+		this->windowX8[this->windowCount] = x8;
+		this->windowCount++;
 	}
 
-	// set up GPIOs
-	for (int i = 0; i < pinCount; i++) {
-		uint8_t pin = pinBase + i;
-		pio_gpio_init(pio, pin);
-		gpio_set_pulls(pin, false, false);
-	}
-
-	// set up the state machine
-	pio_sm_config c = dshotx4_program_get_default_config(this->offset);
-	sm_config_set_set_pins(&c, pinBase, pinCount);
-	sm_config_set_out_pins(&c, pinBase, pinCount);
-	sm_config_set_out_shift(&c, false, false, 32);
-	pio_sm_set_consecutive_pindirs(pio, this->sm, pinBase, pinCount, true);
-	pio_sm_init(pio, this->sm, this->offset, &c);
-	pio_sm_set_enabled(pio, this->sm, true);
-	uint32_t targetClock = 12000000 / 300 * speed; // 12 MHz for DShot300
-	uint32_t cpuClock = clock_get_hz(clk_sys);
-	pio_sm_set_clkdiv(pio, this->sm, (float)cpuClock / targetClock);
-
-	// add this instance to the list of instances
-	this->pio = pio;
-	this->pinBase = pinBase;
+	// store the parameters
 	this->pinCount = pinCount;
-	this->speed = speed;
 	this->iError = false;
-	DShotX4::instances.push_back(this);
+	dshotRegisterClockCallback(pio, this->sms[0], DShotX4::onClockChange, this);
 }
 
 DShotX4::~DShotX4() {
@@ -104,41 +183,34 @@ DShotX4::~DShotX4() {
 		return;
 	}
 
-	// stop the state machine
-	pio_sm_set_enabled(this->pio, this->sm, false);
-	if (this->sm >= 0) {
-		pio_sm_unclaim(this->pio, this->sm);
-	}
-	bool isLast = true;
-	for (auto inst : DShotX4::instances) {
-		if (inst != this && inst->pio == this->pio && inst->initError() == false) {
-			isLast = false;
-			break;
-		}
-	}
-	if (isLast) {
-		pio_remove_program(this->pio, &dshotx4_program, this->offset);
-	}
+	this->stopFreeRunning();
+	dshotRegisterClockCallback(this->pio, this->sms[0], nullptr, nullptr);
+	this->deinit();
+}
 
-	// free the pins
-	for (int i = 0; i < this->pinCount; i++) {
-		gpio_init(this->pinBase + i);
-	}
+void DShotX4::deinit() {
+	for (int w = 0; w < this->windowCount; w++) {
+		// stop the state machine
+		pio_sm_set_enabled(this->pio, this->sms[w], false);
+		pio_sm_unclaim(this->pio, this->sms[w]);
+		dshotReleaseProgram(this->pio, this->windowX8[w] ? DShotProgram::X8 : DShotProgram::X4);
 
-	// remove this instance from the list of instances
-	auto it = DShotX4::instances.begin();
-	while (it != DShotX4::instances.end()) {
-		if (*it == this) {
-			it = DShotX4::instances.erase(it);
-		} else {
-			it++;
+		// free the pins
+		for (int i = 0; i < 4; i++) {
+			if (this->channelWindow[i] == w) gpio_init(this->pins[i]);
 		}
 	}
+	this->windowCount = 0;
 }
 
 void DShotX4::sendThrottles(uint16_t throttles[4]) {
-	// check if the throttle value is valid
+	// check if the throttle value is valid, queued commands replace the throttle
 	for (int i = 0; i < 4; i++) {
+		uint16_t command;
+		if (this->commands[i].next(&command)) {
+			throttles[i] = (command << 1) | 1;
+			continue;
+		}
 		if (throttles[i] > 2000) {
 			throttles[i] = 2000;
 		}
@@ -157,16 +229,167 @@ void DShotX4::sendRaw11Bit(uint16_t data[4]) {
 void DShotX4::sendRaw12Bit(uint16_t data[4]) {
 	for (int i = 0; i < 4; i++)
 		data[i] = this->appendChecksum(data[i]);
+	for (int i = 0; i < this->pinCount; i++)
+		dshotBlackboxTx(this->pins[i], data[i]);
+
+	for (int w = 0; w < this->windowCount; w++) {
+		// lanes of the gaps are 0, they are not driven
+		uint16_t lanes[8] = {};
+		for (int i = 0; i < this->pinCount; i++) {
+			if (this->channelWindow[i] == w) lanes[this->channelLane[i]] = data[i];
+		}
+
+		// the first window writes the inactive buffer, then swaps (there is only one window in free-running mode)
+		uint32_t packet[4];
+		uint32_t *motorPacket = w ? packet : this->freeRunPackets[this->freeRunActive == this->freeRunPackets[0] ? 1 : 0];
+		if (this->windowX8[w]) {
+			dshotPackX8(lanes, motorPacket);
+		} else {
+			dshotPackX4(lanes, motorPacket);
+		}
+		if (!w) {
+			this->freeRunActive = motorPacket;
+			if (this->freeRunTimer >= 0) {
+				return;
+			}
+		}
+		for (int i = 0; i < (this->windowX8[w] ? 4 : 2); i++) {
+			pio_sm_put(this->pio, this->sms[w], motorPacket[i]);
+		}
+	}
+}
+
+bool DShotX4::queueCommand(uint8_t channel, uint16_t command) {
+	if (channel >= this->pinCount) {
+		return false;
+	}
+	return this->commands[channel].push(command);
+}
+
+bool DShotX4::queueCommand(uint8_t channel, uint16_t command, uint8_t repeats, uint32_t spacingUs) {
+	if (channel >= this->pinCount) {
+		return false;
+	}
+	return this->commands[channel].push(command, repeats, spacingUs);
+}
+
+uint8_t DShotX4::getQueuedCommands(uint8_t channel) {
+	if (channel >= this->pinCount) {
+		return 0;
+	}
+	return this->commands[channel].pending();
+}
+
+void DShotX4::clearCommandQueue() {
+	for (int i = 0; i < 4; i++)
+		this->commands[i].clear();
+}
+
+bool DShotX4::startFreeRunning(uint32_t rate) {
+	if (this->iError) {
+		return false;
+	}
+	this->stopFreeRunning();
+	if (this->windowCount > 1) {
+		DEBUG_PRINTF("Free-running mode needs all pins in one window, the pins need %d\n", this->windowCount);
+		return false;
+	}
+
+	// the packet plus a short pause need to fit into one period
+	uint32_t minPeriod = 20000 / this->speed;
+	if (!rate || 1000000 / rate < minPeriod) {
+		DEBUG_PRINTF("Rate too high: %d, the period must be at least %dus\n", rate, minPeriod);
+		return false;
+	}
+	int timer = claimDmaPacingTimer(rate);
+	if (timer < 0) {
+		DEBUG_PRINTF("No DMA timer available or rate out of range: %d\n", rate);
+		return false;
+	}
+	int startCh = dma_claim_unused_channel(false);
+	int packetCh = startCh < 0 ? -1 : dma_claim_unused_channel(false);
+	if (packetCh < 0) {
+		DEBUG_PRINTF("No free DMA channels available, pin=%d\n", this->pins[0]);
+		if (startCh >= 0) dma_channel_unclaim(startCh);
+		dma_timer_unclaim(timer);
+		return false;
+	}
+
+	// every period, [0] points [1] to the current buffer (and triggers it), [1] writes all words and re-arms [0]
+	dma_channel_config c = dma_channel_get_default_config(startCh);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+	channel_config_set_read_increment(&c, false);
+	channel_config_set_write_increment(&c, false);
+	channel_config_set_dreq(&c, dma_get_timer_dreq(timer));
+	dma_channel_configure(startCh, &c, &dma_hw->ch[packetCh].al3_read_addr_trig, &this->freeRunActive, 1, false);
+	c = dma_channel_get_default_config(packetCh);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+	channel_config_set_read_increment(&c, true);
+	channel_config_set_write_increment(&c, false);
+	channel_config_set_dreq(&c, pio_get_dreq(this->pio, this->sms[0], true));
+	channel_config_set_chain_to(&c, startCh);
+	dma_channel_configure(packetCh, &c, &this->pio->txf[this->sms[0]], this->freeRunActive, this->windowX8[0] ? 4 : 2, false);
+
+	this->freeRunTimer = timer;
+	this->freeRunRate = rate;
+	this->freeRunDma[0] = startCh;
+	this->freeRunDma[1] = packetCh;
+	dma_channel_start(startCh);
+	return true;
+}
+
+void DShotX4::stopFreeRunning() {
+	if (this->freeRunTimer < 0) {
+		return;
+	}
+
+	// disable both channels first, so that an abort can't be undone by the chain trigger of the other one
+	for (int i = 0; i < 2; i++) {
+		hw_clear_bits(&dma_hw->ch[this->freeRunDma[i]].al1_ctrl, DMA_CH0_CTRL_TRIG_EN_BITS);
+	}
+	for (int i = 0; i < 2; i++) {
+		dma_channel_abort(this->freeRunDma[i]);
+		dma_channel_unclaim(this->freeRunDma[i]);
+		this->freeRunDma[i] = -1;
+	}
+	dma_timer_set_fraction(this->freeRunTimer, 0, 0); // stop the timer
+	dma_timer_unclaim(this->freeRunTimer);
+	this->freeRunTimer = -1;
+}
 
-	uint32_t motorPacket[2] = {0, 0};
-	for (int i = 31; i >= 0; i--) {
-		int pos = i / 4;
-		int motor = i % 4;
-		motorPacket[0] |= ((data[motor] >> (pos + 8)) & 1) << i;
-		motorPacket[1] |= ((data[motor] >> pos) & 1) << i;
+bool DShotX4::setSpeed(uint32_t speed) {
+	if (this->iError) {
+		return false;
+	}
+	if (speed < 150 || speed > 4800) {
+		DEBUG_PRINTF("Invalid speed: %d, must be 150...4800\n", speed);
+		return false;
 	}
-	pio_sm_put(this->pio, this->sm, motorPacket[0]);
-	pio_sm_put(this->pio, this->sm, motorPacket[1]);
+	uint32_t clkSys = clock_get_hz(clk_sys);
+	uint32_t clkDiv = dshotCalcClkDiv(clkSys, speed);
+	if (clkDiv < 256) {
+		DEBUG_PRINTF("Speed %d is too high for the system clock of %d Hz\n", speed, clkSys);
+		return false;
+	}
+
+	// the DMA would keep sending while waiting for the gap, and its pacing timer runs on clk_sys
+	uint32_t rate = this->freeRunTimer >= 0 ? this->freeRunRate : 0;
+	this->stopFreeRunning();
+
+	for (int w = 0; w < this->windowCount; w++) {
+		dshotSetClkDivBetweenFrames(this->pio, this->sms[w], clkDiv);
+	}
+	this->speed = speed;
+
+	if (rate) {
+		return this->startFreeRunning(rate);
+	}
+	return true;
+}
+
+void DShotX4::onClockChange(void *driver) {
+	DShotX4 *d = (DShotX4 *)driver;
+	d->setSpeed(d->speed);
 }
 
 uint16_t DShotX4::appendChecksum(uint16_t data) {
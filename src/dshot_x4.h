@@ -1,30 +1,44 @@
 #ifndef DSHOT_X4_H
 #define DSHOT_X4_H
 
+#include "command_queue.h"
 #include "hardware/pio.h"
-#include <vector>
-using std::vector;
+
+#define DSHOT_X4_MAX_WINDOW 8 /// max. width (in GPIOs) of a pin window of DShotX4, i.e. the out pins of the dshotx8 program
 
 class DShotX4 {
 public:
-	static vector<DShotX4 *> instances;
-
 	DShotX4() = delete;
 	/**
 	 * @brief Initialize a new DShotX4 instance
 	 *
-	 * @param pinBase the first ESC pin
+	 * @param pinBase the first ESC pin (int, so that a literal 0 does not make the call ambiguous with the pin list constructor)
 	 * @param pinCount the number of ESC pins
-	 * @param speed DShot speed in kBaud, e.g. 600 for DShot600
+	 * @param speed DShot speed in kBaud, e.g. 600 for DShot600, max. clk_sys / 40 kHz (DShot3125 at 125 MHz), otherwise initError
 	 * @param pio the PIO instance to use, default is pio0
 	 * @param sm the state machine to use, default (-1) is autodetect
 	 */
-	DShotX4(uint8_t pinBase, uint8_t pinCount, uint32_t speed = 600, PIO pio = pio0, int8_t sm = -1);
+	DShotX4(int pinBase, uint8_t pinCount, uint32_t speed = 600, PIO pio = pio0, int8_t sm = -1);
+
+	/**
+	 * @brief Initialize a new DShotX4 instance with arbitrary pins
+	 *
+	 * The pins don't need to be consecutive: they are sorted into windows of up to DSHOT_X4_MAX_WINDOW consecutive GPIOs, and every window gets its own state machine (dshotx4 program up to 4 GPIOs, dshotx8 program above). Each send call writes one FIFO burst per window, e.g. pins {2, 5, 9, 14} need 2 state machines (2...9 and 14), pins {2, 3, 4, 5} only one, like the other constructor.
+	 *
+	 * Only the ESC pins are outputs, but the state machine also writes the GPIOs in the gaps of its window. They can be used for anything else except another state machine of the same PIO (checked here, but not if they are assigned later).
+	 *
+	 * @param pins array of pinCount ESC pins, any order. Copied.
+	 * @param pinCount the number of ESC pins, 1...4
+	 * @param speed DShot speed in kBaud, e.g. 600 for DShot600, max. clk_sys / 40 kHz (DShot3125 at 125 MHz), otherwise initError
+	 * @param pio the PIO instance to use, default is pio0
+	 * @param sm the state machine of the first window, default (-1) is autodetect. Other windows always use autodetected state machines.
+	 */
+	DShotX4(const uint8_t *pins, uint8_t pinCount, uint32_t speed = 600, PIO pio = pio0, int8_t sm = -1);
 
 	/**
 	 * @brief Deinitialize the DShotX4 instance
 	 *
-	 * This will stop the state machine and free the pin. If this is the last instance on this PIO block, the PIO programm will be removed.
+	 * This will stop the state machines and free the pins. If this is the last instance on this PIO block, the PIO programm will be removed.
 	 */
 	~DShotX4();
 
@@ -55,6 +69,69 @@ public:
 	 */
 	void sendRaw12Bit(uint16_t data[4]);
 
+	/**
+	 * @brief Queue a special command for one ESC, sent by the next calls of sendThrottles instead of its throttle
+	 *
+	 * Same as BidirDShotX1::queueCommand, every ESC has its own queue. The other ESCs keep receiving their throttle values.
+	 *
+	 * @param channel the ESC (index into the pins, 0 = pinBase, 1 = pinBase + 1, ...)
+	 * @param command special command, 0...47 (see DShotCommand)
+	 * @return true if the command was queued
+	 * @return false if the channel or command is invalid or the queue (DSHOT_COMMAND_QUEUE entries) is full
+	 */
+	bool queueCommand(uint8_t channel, uint16_t command);
+
+	/**
+	 * @brief Queue a special command with a custom repeat count and spacing, see BidirDShotX1::queueCommand(uint16_t, uint8_t, uint32_t)
+	 *
+	 * @param channel the ESC (index into the pins, 0 = pinBase, 1 = pinBase + 1, ...)
+	 * @param command special command, 0...47 (see DShotCommand)
+	 * @param repeats number of consecutive packets, 1...255
+	 * @param spacingUs minimum time after the last packet of this command until the next command is sent
+	 * @return true if the command was queued
+	 * @return false if the parameters are invalid or the queue is full
+	 */
+	bool queueCommand(uint8_t channel, uint16_t command, uint8_t repeats, uint32_t spacingUs);
+
+	/**
+	 * @brief Get the number of queued commands of an ESC that were not completely sent yet (including the spacing after the last one)
+	 *
+	 * @param channel the ESC (index into the pins, 0 = pinBase, 1 = pinBase + 1, ...)
+	 */
+	uint8_t getQueuedCommands(uint8_t channel);
+
+	/**
+	 * @brief Remove all queued commands of all ESCs, partially sent commands are cut off
+	 */
+	void clearCommandQueue();
+
+	/**
+	 * @brief Let the DMA resend the packet at a fixed rate, without any CPU involvement
+	 *
+	 * Uses 2 DMA channels and 1 DMA pacing timer. The send functions then only replace the packet that is sent with the next period, so the ESCs stay armed even if the CPU is busy. Only available if all pins fit into one window (see the pin list constructor).
+	 *
+	 * @param rate packets per second, max. 1.25 times the packet length (e.g. ~30kHz for DShot600), min. clk_sys / 65535 (~1.9kHz at 125MHz)
+	 * @return true if the free-running mode was started
+	 * @return false if the rate is out of range, no DMA channel/timer is free, the pins need more than one window or there was an initialisation error
+	 */
+	bool startFreeRunning(uint32_t rate);
+
+	/**
+	 * @brief Stop the free-running mode, the send functions send immediately again
+	 */
+	void stopFreeRunning();
+
+	/**
+	 * @brief Changes the DShot speed without reinitialising the driver
+	 *
+	 * The state machine, the pins and the program stay claimed. The new divider is applied between two packets (the call blocks until the current packet is done). Free-running mode is stopped and restarted with the same rate. Also used by dshotClockChanged to recalculate the divider for a new system clock.
+	 *
+	 * @param speed speed in kBaud, e.g. 600 for DShot600, 150...4800
+	 * @return true if the speed was changed
+	 * @return false if the driver is not initialised, the speed is invalid or too high for the system clock (the old divider is kept), or free-running mode could not be restarted
+	 */
+	bool setSpeed(uint32_t speed);
+
 	/**
 	 * @brief checks if there was an error during initialisation of the DShot driver
 	 *
@@ -69,12 +146,32 @@ public:
 
 private:
 	PIO pio; /// which PIO is used for the DShot driver
-	uint8_t pinBase; /// the first pin that is used for DShot output/input
-	uint8_t pinCount; /// the assigned pin count (up to 4)
-	uint8_t sm; /// which state machine is used for the DShot driver
+	uint8_t pins[4]; /// the ESC pins, in the order of the channels
+	uint8_t pinCount = 0; /// the assigned pin count (up to 4)
+	uint8_t windowCount = 0; /// number of pin windows, each with its own state machine
+	uint8_t sms[4]; /// state machine of each window
+	uint8_t windowBase[4]; /// first GPIO of each window
+	bool windowX8[4]; /// whether the window is wider than 4 GPIOs and uses the dshotx8 program (4 words per packet instead of 2)
+	uint8_t channelWindow[4] = {0xFF, 0xFF, 0xFF, 0xFF}; /// window of each channel, 0xFF until assigned
+	uint8_t channelLane[4]; /// bit of each channel in its window (pin - windowBase)
 	uint32_t speed; /// speed in kBaud, e.g. 600 for DShot600
-	uint8_t offset; /// program offset in the PIO instruction memory (needed to point to the same memory location in the next driver)
 	bool iError = false; /// shows if there was an error during initialisation
+	int freeRunTimer = -1; /// DMA pacing timer in free-running mode, -1 if not free-running
+	uint32_t freeRunRate = 0; /// packets per second in free-running mode, used to restart it after a speed change
+	int freeRunDma[2] = {-1, -1}; /// free-running DMA channels: [0] paced by the timer, starts [1], [1] writes the packet
+	uint32_t freeRunPackets[2][4] = {}; /// last packet of the first window (as written to the TX FIFO), double buffered so that [1] never sends a half updated packet
+	uint32_t *volatile freeRunActive = freeRunPackets[0]; /// the buffer with the last packet, [0] copies this to the read address of [1]
+	DShotCommandQueue commands[4]; /// special commands of each ESC that are sent instead of the throttle
+
+	/**
+	 * @brief sorts the pins into windows and sets up one state machine per window, shared by both constructors
+	 */
+	void init(const uint8_t *pins, uint8_t pinCount, uint32_t speed, PIO pio, int8_t sm);
+
+	/**
+	 * @brief stops and releases the state machines, programs and pins of all windows that were set up
+	 */
+	void deinit();
 
 	/**
 	 * @brief appends a checksum to the outgoing DShot packet
@@ -85,6 +182,11 @@ private:
 	 * @return uint16_t 16 bit full packet with checksum appended
 	 */
 	static uint16_t appendChecksum(uint16_t data);
+
+	/**
+	 * @brief clock change callback, see dshotRegisterClockCallback
+	 */
+	static void onClockChange(void *driver);
 };
 
 #endif // DSHOT_X4_H
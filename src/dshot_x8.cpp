@@ -0,0 +1,183 @@
+#include "dshot_x8.h"
+#include "dshot_blackbox.h"
+#include "dshot_common.h"
+#include "dshot_registry.h"
+#include "hardware/clocks.h"
+#include "pio/dshotx8.pio.h"
+
+DShotX8::DShotX8(uint8_t pinBase, uint8_t pinCount, uint32_t speed, PIO pio, int8_t sm) {
+#if DBG
+	char pioStr[32] = "";
+	pioToPioStr(pio, pioStr);
+#else
+	char *pioStr = nullptr;
+#endif
+
+	// ensure valid parameters
+	if (sm >= 4 || sm < -1 ||
+		pinBase >= NUM_BANK0_GPIOS || pinCount > 8 || !pinCount ||
+		speed < 150 || speed > 4800 ||
+		(pio != pio0 && pio != pio1
+#if NUM_PIOS > 2
+		 && pio != pio2
+#endif
+		 )) {
+		DEBUG_PRINTF("Invalid parameters: Check that sm is -1...3, pinBase is 0...29 (or 0...47 on RP2350), pinCount is 1...8, speed is 150...4800 and pio is pio0 or pio1 (or pio2 on RP2350). You supplied: sm=%d, pinBase=%d, pinCount=%d, speed=%d, pio=%s\n", sm, pinBase, pinCount, speed, pioStr);
+		iError = true;
+		return;
+	}
+
+	if (speed != 150 && speed != 300 && speed != 600 && speed != 1200 && speed != 2400) {
+		DEBUG_PRINTF("Unofficial speed: %d. Unless you know what you are doing, please select DShot 150, 300, 600, 1200 or 2400.\n", speed);
+	}
+
+	uint32_t clkSys = clock_get_hz(clk_sys);
+	if (dshotCalcClkDiv(clkSys, speed) < 256) {
+		DEBUG_PRINTF("Speed %d is too high for the system clock of %d Hz\n", speed, clkSys);
+		iError = true;
+		return;
+	}
+
+	// Check if SM is claimed, then claim it
+	if (sm == -1) {
+		sm = pio_claim_unused_sm(pio, false);
+		if (sm < 0) {
+			DEBUG_PRINTF("No free state machines available, pio=%s\n", pioStr);
+			iError = true;
+			return;
+		}
+	} else {
+		if (pio_sm_is_claimed(pio, sm)) {
+			DEBUG_PRINTF("SM provided but already claimed, pio=%s, sm=%d", pioStr, sm);
+			iError = true;
+			return;
+		}
+		pio_sm_claim(pio, sm);
+	}
+	this->sm = sm;
+
+	// load the program, unless it is already loaded on this PIO
+	int o = dshotClaimProgram(pio, DShotProgram::X8);
+	if (o < 0) {
+		DEBUG_PRINTF("No space for program on %s", pioStr);
+		iError = true;
+		pio_sm_unclaim(pio, sm);
+		return;
+	}
+	this->offset = o;
+
+	// set up GPIOs
+	for (int i = 0; i < pinCount; i++) {
+		uint8_t pin = pinBase + i;
+		pio_gpio_init(pio, pin);
+		gpio_set_pulls(pin, false, false);
+	}
+
+	// set up the state machine
+	pio_sm_config c = dshotx8_program_get_default_config(this->offset);
+	sm_config_set_out_pins(&c, pinBase, pinCount);
+	sm_config_set_out_shift(&c, false, false, 32);
+	sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_TX); // 4 words per frame, 8 deep FIFO leaves room for a second frame
+	uint32_t clkDiv = dshotCalcClkDiv(clkSys, speed);
+	sm_config_set_clkdiv_int_frac(&c, clkDiv >> 8, clkDiv & 0xFF);
+	pio_sm_set_consecutive_pindirs(pio, this->sm, pinBase, pinCount, true);
+	pio_sm_init(pio, this->sm, this->offset, &c);
+	pio_sm_set_enabled(pio, this->sm, true);
+
+	// store the parameters
+	this->pio = pio;
+	this->pinBase = pinBase;
+	this->pinCount = pinCount;
+	this->speed = speed;
+	this->iError = false;
+	dshotRegisterClockCallback(pio, this->sm, DShotX8::onClockChange, this);
+}
+
+DShotX8::~DShotX8() {
+	// if this instance is not initialized, do nothing
+	if (this->iError) {
+		return;
+	}
+
+	// stop the state machine
+	pio_sm_set_enabled(this->pio, this->sm, false);
+	if (this->sm >= 0) {
+		pio_sm_unclaim(this->pio, this->sm);
+	}
+	dshotReleaseProgram(this->pio, DShotProgram::X8);
+	dshotRegisterClockCallback(this->pio, this->sm, nullptr, nullptr);
+
+	// free the pins
+	for (int i = 0; i < this->pinCount; i++) {
+		gpio_init(this->pinBase + i);
+	}
+}
+
+bool DShotX8::setSpeed(uint32_t speed) {
+	if (this->iError) {
+		return false;
+	}
+	if (speed < 150 || speed > 4800) {
+		DEBUG_PRINTF("Invalid speed: %d, must be 150...4800\n", speed);
+		return false;
+	}
+	uint32_t clkSys = clock_get_hz(clk_sys);
+	uint32_t clkDiv = dshotCalcClkDiv(clkSys, speed);
+	if (clkDiv < 256) {
+		DEBUG_PRINTF("Speed %d is too high for the system clock of %d Hz\n", speed, clkSys);
+		return false;
+	}
+
+	dshotSetClkDivBetweenFrames(this->pio, this->sm, clkDiv);
+	this->speed = speed;
+	return true;
+}
+
+void DShotX8::onClockChange(void *driver) {
+	DShotX8 *d = (DShotX8 *)driver;
+	d->setSpeed(d->speed);
+}
+
+void DShotX8::sendThrottles(uint16_t throttles[8]) {
+	// check if the throttle value is valid
+	for (int i = 0; i < 8; i++) {
+		if (throttles[i] > 2000) {
+			throttles[i] = 2000;
+		}
+		if (throttles[i]) throttles[i] += 47;
+		throttles[i] <<= 1;
+	}
+	this->sendRaw12Bit(throttles);
+}
+
+void DShotX8::sendRaw11Bit(uint16_t data[8]) {
+	for (int i = 0; i < 8; i++)
+		data[i] = (data[i] << 1) | 1;
+	this->sendRaw12Bit(data);
+}
+
+void DShotX8::sendRaw12Bit(uint16_t data[8]) {
+	for (int i = 0; i < 8; i++)
+		data[i] = this->appendChecksum(data[i]);
+	for (int i = 0; i < this->pinCount; i++)
+		dshotBlackboxTx(this->pinBase + i, data[i]);
+
+	uint32_t motorPacket[4];
+	dshotPackX8(data, motorPacket);
+
+	// a partially accepted packet would shift all following packets, so drop it entirely if it doesn't fit
+	if (pio_sm_get_tx_fifo_level(this->pio, this->sm) > 4) return;
+	pio_sm_put(this->pio, this->sm, motorPacket[0]);
+	pio_sm_put(this->pio, this->sm, motorPacket[1]);
+	pio_sm_put(this->pio, this->sm, motorPacket[2]);
+	pio_sm_put(this->pio, this->sm, motorPacket[3]);
+}
+
+uint16_t DShotX8::appendChecksum(uint16_t data) {
+	int csum = data;
+	csum ^= data >> 4;
+	csum ^= data >> 8;
+	csum = csum;
+	csum &= 0xF;
+	return (data << 4) | csum;
+}
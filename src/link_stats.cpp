@@ -0,0 +1,37 @@
+#include "link_stats.h"
+
+void BidirDShotLinkCounters::countLatency(uint32_t us) {
+	uint32_t b = us >> 4;
+	uint32_t bucket = b ? 31 - __builtin_clz(b) : 0;
+	if (bucket >= DSHOT_LATENCY_BUCKETS) bucket = DSHOT_LATENCY_BUCKETS - 1;
+	stats.latency[bucket] = stats.latency[bucket] + 1;
+}
+
+void BidirDShotLinkCounters::snapshot(BidirDShotLinkStats *out) const {
+	out->framesSent = stats.framesSent;
+	out->replies = stats.replies;
+	out->checksumErrors = stats.checksumErrors;
+	out->invalidGcr = stats.invalidGcr;
+	out->missingReplies = stats.missingReplies;
+	out->fifoOverruns = stats.fifoOverruns;
+	out->historyDrops = 0;
+	out->turnaroundMinNs = stats.turnaroundMinNs;
+	out->turnaroundMaxNs = stats.turnaroundMaxNs;
+	for (int i = 0; i < DSHOT_LATENCY_BUCKETS; i++) {
+		out->latency[i] = stats.latency[i];
+	}
+}
+
+void BidirDShotLinkCounters::reset() {
+	stats.framesSent = 0;
+	stats.replies = 0;
+	stats.checksumErrors = 0;
+	stats.invalidGcr = 0;
+	stats.missingReplies = 0;
+	stats.fifoOverruns = 0;
+	stats.turnaroundMinNs = 0;
+	stats.turnaroundMaxNs = 0;
+	for (int i = 0; i < DSHOT_LATENCY_BUCKETS; i++) {
+		stats.latency[i] = 0;
+	}
+}
@@ -0,0 +1,103 @@
+#ifndef LINK_STATS_H
+#define LINK_STATS_H
+
+#include <stdint.h>
+
+#define DSHOT_LATENCY_BUCKETS 12 /// buckets of the latency histogram: < 32us, 32-63us, 64-127us, ..., >= 32768us
+
+/**
+ * @brief Link statistics of one ESC, a plain copy of the counters
+ *
+ * All counters start at 0 and wrap around. checksumErrors + invalidGcr are the frames reported as ::CHECKSUM_ERROR.
+ */
+struct BidirDShotLinkStats {
+	uint32_t framesSent; /// packets written to the PIO (in free-running mode: packets that were answered or timed out)
+	uint32_t replies; /// replies with a valid checksum
+	uint32_t checksumErrors; /// replies with valid GCR symbols, but a wrong checksum
+	uint32_t invalidGcr; /// replies with at least one invalid GCR symbol (wrong bit timing or noise)
+	uint32_t missingReplies; /// packets without a reply (::NO_REPLY)
+	uint32_t fifoOverruns; /// packets or replies that were lost or delayed because a FIFO was full or a capture was still running
+	uint32_t historyDrops; /// frames dropped because the history was full, same as getTelemetryOverflows
+	uint16_t turnaroundMinNs; /// shortest time from the end of a packet to the start of its reply, 0 if none was measured (see BidirDShotTelemetryFrame::turnaroundNs)
+	uint16_t turnaroundMaxNs; /// longest time from the end of a packet to the start of its reply, use it to size the packet period
+	uint32_t latency[DSHOT_LATENCY_BUCKETS]; /// histogram of the time from the frame timestamp (see getTelemetryHistory) until the frame was read by the application. Bucket 0: < 32us, bucket n: 16 << n ... (32 << n) - 1 us, the last bucket counts everything above
+};
+
+/**
+ * @brief Counters for BidirDShotLinkStats, owned by a driver
+ *
+ * Every counter is a single word (read and written in one access) with a single writer, so a snapshot can be taken from the other core or an interrupt at any time without locking. The counters of one snapshot are not guaranteed to belong to the exact same instant.
+ */
+class BidirDShotLinkCounters {
+public:
+	/**
+	 * @brief counts sent packets
+	 */
+	void countSent(uint32_t count = 1) {
+		stats.framesSent = stats.framesSent + count;
+	}
+
+	/**
+	 * @brief counts a received frame
+	 *
+	 * @param valid the checksum is valid
+	 * @param gcrValid all GCR symbols are valid (only used if !valid)
+	 */
+	void countReply(bool valid, bool gcrValid) {
+		if (valid)
+			stats.replies = stats.replies + 1;
+		else if (gcrValid)
+			stats.checksumErrors = stats.checksumErrors + 1;
+		else
+			stats.invalidGcr = stats.invalidGcr + 1;
+	}
+
+	/**
+	 * @brief updates the turnaround range
+	 *
+	 * @param ns measured turnaround, 0 is ignored
+	 */
+	void countTurnaround(uint16_t ns) {
+		if (!ns) return;
+		if (!stats.turnaroundMinNs || ns < stats.turnaroundMinNs) stats.turnaroundMinNs = ns;
+		if (ns > stats.turnaroundMaxNs) stats.turnaroundMaxNs = ns;
+	}
+
+	/**
+	 * @brief counts a packet that was not answered
+	 */
+	void countMissing() {
+		stats.missingReplies = stats.missingReplies + 1;
+	}
+
+	/**
+	 * @brief counts a FIFO overrun or an aborted capture
+	 */
+	void countOverrun() {
+		stats.fifoOverruns = stats.fifoOverruns + 1;
+	}
+
+	/**
+	 * @brief adds a read latency to the histogram
+	 *
+	 * @param us time from the frame timestamp until it was read
+	 */
+	void countLatency(uint32_t us);
+
+	/**
+	 * @brief copies all counters
+	 *
+	 * @param out the snapshot, historyDrops is filled by the driver
+	 */
+	void snapshot(BidirDShotLinkStats *out) const;
+
+	/**
+	 * @brief sets all counters to 0. Only call from the core that uses the driver, while no packet is sent.
+	 */
+	void reset();
+
+private:
+	volatile BidirDShotLinkStats stats = {};
+};
+
+#endif // LINK_STATS_H
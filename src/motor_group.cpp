@@ -0,0 +1,133 @@
+#include "motor_group.h"
+#include "dshot_common.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+
+DShotMotorGroup::DShotMotorGroup(BidirDShotX1 *const *drivers, uint8_t count) {
+	if (!count || count > DSHOT_GROUP_MAX_MOTORS) {
+		DEBUG_PRINTF("Invalid count: %d, must be 1...%d\n", count, DSHOT_GROUP_MAX_MOTORS);
+		iError = true;
+		return;
+	}
+
+	uint8_t used[NUM_PIOS] = {};
+	for (int i = 0; i < count; i++) {
+		BidirDShotX1 *d = drivers[i];
+		if (!d || d->iError) {
+			DEBUG_PRINTF("Driver %d is not initialised\n", i);
+			iError = true;
+			return;
+		}
+		uint pioIndex = pio_get_index(d->pio);
+		if (used[pioIndex] & (1u << d->sm)) {
+			DEBUG_PRINTF("Driver %d uses the same state machine as another driver, sm=%d\n", i, d->sm);
+			iError = true;
+			return;
+		}
+		used[pioIndex] |= 1u << d->sm;
+		this->pios[pioIndex] = d->pio;
+		this->drivers[i] = d;
+	}
+	this->count = count;
+}
+
+uint16_t DShotMotorGroup::waitIdle(uint16_t mask) {
+	// one packet + reply window of the slowest driver, recalculated as the speeds may change
+	uint32_t timeoutUs = 0;
+	for (int i = 0; i < this->count; i++) {
+		BidirDShotX1 *d = this->drivers[i];
+		uint32_t window = 33000 / d->speed + DSHOT_REPLY_TIMEOUT_US;
+		// the edge capture mode always waits for its full window (loops of 2 cycles), which also covers the reply
+		if (d->capture) window = (16000 + (d->replyTimeout >> 16) * (2000 / d->cyclesPerBit)) / d->speed + 5;
+		if (window > timeoutUs) timeoutUs = window;
+	}
+	uint16_t idle = 0;
+	for (uint32_t us = 0;; us++) {
+		for (int i = 0; i < this->count; i++) {
+			BidirDShotX1 *d = this->drivers[i];
+			if (!(mask & (1u << i)) || (idle & (1u << i))) continue;
+			// replies that are not read stall the push before the pull
+			if (!d->irqEnabled) d->readFifo();
+			if (d->isIdle()) {
+				idle |= 1u << i;
+			}
+		}
+		if (idle == mask || us >= timeoutUs) {
+			return idle;
+		}
+		busy_wait_us_32(1);
+	}
+}
+
+bool DShotMotorGroup::sendThrottles(const uint16_t *throttles) {
+	if (this->iError) {
+		return false;
+	}
+
+	uint16_t mask = 0;
+	for (int i = 0; i < this->count; i++) {
+		if (this->drivers[i]->freeRunTimer < 0) mask |= 1u << i;
+	}
+
+	// a state machine can only be stopped without cutting a packet or reply while it waits in its pull
+	uint16_t idle = this->waitIdle(mask);
+	uint32_t packets[DSHOT_GROUP_MAX_MOTORS];
+	uint32_t smMasks[NUM_PIOS] = {};
+	for (int i = 0; i < this->count; i++) {
+		BidirDShotX1 *d = this->drivers[i];
+		packets[i] = d->makePacket(d->nextThrottleData(throttles[i]));
+		if (idle & (1u << i)) smMasks[pio_get_index(d->pio)] |= 1u << d->sm;
+	}
+
+	uint32_t irqState = save_and_disable_interrupts();
+	for (int p = 0; p < NUM_PIOS; p++) {
+		if (smMasks[p]) pio_set_sm_mask_enabled(this->pios[p], smMasks[p], false);
+	}
+	for (int i = 0; i < this->count; i++) {
+		if (idle & (1u << i)) pio_sm_put(this->drivers[i]->pio, this->drivers[i]->sm, packets[i]);
+	}
+	for (int p = 0; p < NUM_PIOS; p++) {
+		if (smMasks[p]) pio_enable_sm_mask_in_sync(this->pios[p], smMasks[p]);
+	}
+	restore_interrupts(irqState);
+
+	uint32_t now = time_us_32();
+	for (int i = 0; i < this->count; i++) {
+		BidirDShotX1 *d = this->drivers[i];
+		d->freeRunPacket = packets[i];
+		if (idle & (1u << i)) {
+			d->lastSendTime = now;
+			d->linkStats.countSent();
+		} else if (mask & (1u << i)) {
+			d->linkStats.countOverrun();
+			d->sendPacket(packets[i]);
+		}
+	}
+	return idle == mask && mask == (1u << this->count) - 1;
+}
+
+bool DShotMotorGroup::waitForReplies() {
+	if (this->iError) {
+		return false;
+	}
+	uint16_t mask = 0;
+	for (int i = 0; i < this->count; i++) {
+		if (this->drivers[i]->freeRunTimer < 0) mask |= 1u << i;
+	}
+	return this->waitIdle(mask) == mask;
+}
+
+uint16_t DShotMotorGroup::getTelemetryRaw(uint32_t *values, BidirDshotTelemetryType *types) {
+	uint16_t valid = 0;
+	for (int i = 0; i < this->count; i++) {
+		types[i] = this->drivers[i]->getTelemetryRaw(&values[i]);
+		if (types[i] != BidirDshotTelemetryType::CHECKSUM_ERROR && types[i] != BidirDshotTelemetryType::NO_REPLY && types[i] != BidirDshotTelemetryType::NO_PACKET) {
+			valid |= 1u << i;
+		}
+	}
+	return valid;
+}
+
+void DShotMotorGroup::getTelemetryStates(BidirDShotTelemetryState *states) {
+	BidirDShotX1::getTelemetryStates(this->drivers, this->count, states);
+}
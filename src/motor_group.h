@@ -0,0 +1,94 @@
+#ifndef MOTOR_GROUP_H
+#define MOTOR_GROUP_H
+
+#include "bidir_dshot_x1.h"
+
+#define DSHOT_GROUP_MAX_MOTORS (4 * NUM_PIOS) /// one BidirDShotX1 per state machine
+
+/**
+ * @brief Sends the packets of several BidirDShotX1 instances at the same time and reads all their replies at once
+ *
+ * The drivers stay usable on their own (e.g. for getLinkStats or queueCommand), but their packets should only be sent through the group. The drivers may be on different PIOs and use different speeds. They are not owned by the group and must outlive it.
+ *
+ * sendThrottles waits until every state machine is idle (previous packet and reply done), stops them, fills all TX FIFOs and starts them together with their clock dividers reset: all packets of one PIO start in the same cycle, the PIOs follow each other within a few system clock cycles. All replies then arrive at about the same time, so one waitForReplies and one getTelemetryRaw call are enough per loop.
+ */
+class DShotMotorGroup {
+public:
+	DShotMotorGroup() = delete;
+	/**
+	 * @brief Initialize a new motor group
+	 *
+	 * @param drivers array of count initialised drivers, copied. The order is the order of all arrays of the group functions.
+	 * @param count number of drivers, 1...DSHOT_GROUP_MAX_MOTORS
+	 */
+	DShotMotorGroup(BidirDShotX1 *const *drivers, uint8_t count);
+
+	/**
+	 * @brief Send throttle values to all ESCs, starting all packets together
+	 *
+	 * Same as BidirDShotX1::sendThrottle (queued special commands are sent instead of the throttle). Waits for state machines that are still receiving the previous reply, at most one packet + reply window (e.g. ~95us at DShot600). A driver that doesn't get idle in time (e.g. because its reply window is longer than the period) gets its packet queued as usual and is counted as a FIFO overrun. Drivers in free-running mode only get their packet replaced.
+	 *
+	 * @param throttles array of count throttle values, 0-2000
+	 * @return true if all packets were started together
+	 * @return false if one or more packets were delayed or are sent by the free-running DMA, or there was an initialisation error
+	 */
+	bool sendThrottles(const uint16_t *throttles);
+
+	/**
+	 * @brief Wait until the packets and replies of all ESCs are done
+	 *
+	 * Blocks at most one packet + reply window after the last sendThrottles (the slowest driver counts). Afterwards, getTelemetryRaw returns the replies of all ESCs to the last packets.
+	 *
+	 * @return true if all state machines are idle
+	 * @return false if the timeout passed or there was an initialisation error
+	 */
+	bool waitForReplies();
+
+	/**
+	 * @brief Get the raw telemetry of all ESCs, see BidirDShotX1::getTelemetryRaw
+	 *
+	 * @param values array of count values, only written for valid frames
+	 * @param types array of count types, ::NO_PACKET if an ESC has no new frame
+	 * @return uint16_t bit mask of the ESCs with a new valid frame (bit n = driver n)
+	 */
+	uint16_t getTelemetryRaw(uint32_t *values, BidirDshotTelemetryType *types);
+
+	/**
+	 * @brief Get the telemetry state of all ESCs, see BidirDShotX1::getTelemetryState
+	 *
+	 * @param states array of count states
+	 */
+	void getTelemetryStates(BidirDShotTelemetryState *states);
+
+	/**
+	 * @brief Get the number of drivers in the group
+	 */
+	uint8_t getCount() {
+		return count;
+	}
+
+	/**
+	 * @brief checks if there was an error during initialisation of the group
+	 *
+	 * @return true if the parameters were invalid or one of the drivers had an initialisation error
+	 * @return false if everything worked fine
+	 */
+	bool initError() {
+		return iError;
+	}
+
+private:
+	BidirDShotX1 *drivers[DSHOT_GROUP_MAX_MOTORS] = {}; /// the drivers, in the order of the arrays
+	uint8_t count = 0; /// number of drivers
+	PIO pios[NUM_PIOS] = {}; /// PIO of each index in smMasks, nullptr if no driver uses it
+	bool iError = false; /// shows if there was an error during initialisation
+
+	/**
+	 * @brief waits until the state machines of the drivers in mask wait for a packet (max. one packet + reply window of the slowest driver), reads their RX FIFOs meanwhile
+	 *
+	 * @return uint16_t mask of the idle drivers
+	 */
+	uint16_t waitIdle(uint16_t mask);
+};
+
+#endif // MOTOR_GROUP_H
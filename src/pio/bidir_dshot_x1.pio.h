@@ -12,46 +12,48 @@
 // bidir_dshot_x1 //
 // -------------- //
 
-#define bidir_dshot_x1_wrap_target 0
-#define bidir_dshot_x1_wrap 27
+#define bidir_dshot_x1_wrap_target 1
+#define bidir_dshot_x1_wrap 29
 
 static const uint16_t bidir_dshot_x1_program_instructions[] = {
+	0x008c, //  0: jmp    y--, 12
 	//     .wrap_target
-	0x8020, //  0: push   block
-	0xe081, //  1: set    pindirs, 1
-	0x80a0, //  2: pull   block
-	0x6070, //  3: out    null, 16
-	0xed00, //  4: set    pins, 0                [13]
-	0x6d01, //  5: out    pins, 1                [13]
-	0xea01, //  6: set    pins, 1                [10]
-	0x00e4, //  7: jmp    !osre, 4
-	0xe034, //  8: set    x, 20
-	0xa0eb, //  9: mov    osr, !null
-	0xe080, // 10: set    pindirs, 0
-	0x01cb, // 11: jmp    pin, 11                [1]
-	0xe046, // 12: set    y, 6
-	0x000f, // 13: jmp    15
-	0xe14d, // 14: set    y, 13                  [1]
-	0x00d4, // 15: jmp    pin, 20
-	0x008f, // 16: jmp    y--, 15
-	0x4061, // 17: in     null, 1
-	0x004e, // 18: jmp    x--, 14
-	0x0000, // 19: jmp    0
-	0xe146, // 20: set    y, 6                   [1]
-	0x0017, // 21: jmp    23
-	0xe14d, // 22: set    y, 13                  [1]
-	0x00d9, // 23: jmp    pin, 25
-	0x000c, // 24: jmp    12
-	0x0097, // 25: jmp    y--, 23
-	0x40e1, // 26: in     osr, 1
-	0x0056, // 27: jmp    x--, 22
+	0x8020, //  1: push   block
+	0xe081, //  2: set    pindirs, 1
+	0x80a0, //  3: pull   block
+	0x6050, //  4: out    y, 16
+	0xed00, //  5: set    pins, 0                [13]
+	0x6d01, //  6: out    pins, 1                [13]
+	0xea01, //  7: set    pins, 1                [10]
+	0x00e5, //  8: jmp    !osre, 5
+	0xe034, //  9: set    x, 20
+	0xa0eb, // 10: mov    osr, !null
+	0xe080, // 11: set    pindirs, 0
+	0x00c0, // 12: jmp    pin, 0
+	0x404b, // 13: in     y, 11
+	0xe046, // 14: set    y, 6
+	0x0011, // 15: jmp    17
+	0xe14d, // 16: set    y, 13                  [1]
+	0x00d6, // 17: jmp    pin, 22
+	0x0091, // 18: jmp    y--, 17
+	0x4061, // 19: in     null, 1
+	0x0050, // 20: jmp    x--, 16
+	0x0001, // 21: jmp    1
+	0xe146, // 22: set    y, 6                   [1]
+	0x0019, // 23: jmp    25
+	0xe14d, // 24: set    y, 13                  [1]
+	0x00db, // 25: jmp    pin, 27
+	0x000e, // 26: jmp    14
+	0x0099, // 27: jmp    y--, 25
+	0x40e1, // 28: in     osr, 1
+	0x0058, // 29: jmp    x--, 24
 	//     .wrap
 };
 
 #if !PICO_NO_HARDWARE
 static const struct pio_program bidir_dshot_x1_program = {
 	.instructions = bidir_dshot_x1_program_instructions,
-	.length = 28,
+	.length = 30,
 	.origin = -1,
 };
 
@@ -0,0 +1,56 @@
+// -------------------------------------------------- //
+// This file is autogenerated by pioasm; do not edit! //
+// -------------------------------------------------- //
+
+#pragma once
+
+#if !PICO_NO_HARDWARE
+#include "hardware/pio.h"
+#endif
+
+// ---------------------- //
+// bidir_dshot_x1_capture //
+// ---------------------- //
+
+#define bidir_dshot_x1_capture_wrap_target 0
+#define bidir_dshot_x1_capture_wrap 20
+
+static const uint16_t bidir_dshot_x1_capture_program_instructions[] = {
+	//     .wrap_target
+	0xe081, //  0: set    pindirs, 1
+	0x80a0, //  1: pull   block
+	0x6030, //  2: out    x, 16
+	0xe600, //  3: set    pins, 0                [6]
+	0x6601, //  4: out    pins, 1                [6]
+	0xe401, //  5: set    pins, 1                [4]
+	0x00e3, //  6: jmp    !osre, 3
+	0xa0eb, //  7: mov    osr, !null
+	0xe080, //  8: set    pindirs, 0
+	0x00cd, //  9: jmp    pin, 13
+	0x4030, // 10: in     x, 16
+	0x014f, // 11: jmp    x--, 15                [1]
+	0x0014, // 12: jmp    20
+	0x0049, // 13: jmp    x--, 9
+	0x0014, // 14: jmp    20
+	0x00d2, // 15: jmp    pin, 18
+	0x004f, // 16: jmp    x--, 15
+	0x0014, // 17: jmp    20
+	0x4030, // 18: in     x, 16
+	0x0149, // 19: jmp    x--, 9                 [1]
+	0x40f0, // 20: in     osr, 16
+	//     .wrap
+};
+
+#if !PICO_NO_HARDWARE
+static const struct pio_program bidir_dshot_x1_capture_program = {
+	.instructions = bidir_dshot_x1_capture_program_instructions,
+	.length = 21,
+	.origin = -1,
+};
+
+static inline pio_sm_config bidir_dshot_x1_capture_program_get_default_config(uint offset) {
+	pio_sm_config c = pio_get_default_sm_config();
+	sm_config_set_wrap(&c, offset + bidir_dshot_x1_capture_wrap_target, offset + bidir_dshot_x1_capture_wrap);
+	return c;
+}
+#endif
@@ -0,0 +1,65 @@
+// -------------------------------------------------- //
+// This file is autogenerated by pioasm; do not edit! //
+// -------------------------------------------------- //
+
+#pragma once
+
+#if !PICO_NO_HARDWARE
+#include "hardware/pio.h"
+#endif
+
+// ------------------- //
+// bidir_dshot_x1_fast //
+// ------------------- //
+
+#define bidir_dshot_x1_fast_wrap_target 1
+#define bidir_dshot_x1_fast_wrap 29
+
+static const uint16_t bidir_dshot_x1_fast_program_instructions[] = {
+	0x008c, //  0: jmp    y--, 12
+	//     .wrap_target
+	0x8020, //  1: push   block
+	0xe081, //  2: set    pindirs, 1
+	0x80a0, //  3: pull   block
+	0x6050, //  4: out    y, 16
+	0xe600, //  5: set    pins, 0                [6]
+	0x6601, //  6: out    pins, 1                [6]
+	0xe401, //  7: set    pins, 1                [4]
+	0x00e5, //  8: jmp    !osre, 5
+	0xe034, //  9: set    x, 20
+	0xa0eb, // 10: mov    osr, !null
+	0xe080, // 11: set    pindirs, 0
+	0x00c0, // 12: jmp    pin, 0
+	0x404b, // 13: in     y, 11
+	0xe041, // 14: set    y, 1
+	0x0011, // 15: jmp    17
+	0xe145, // 16: set    y, 5                   [1]
+	0x00d6, // 17: jmp    pin, 22
+	0x0091, // 18: jmp    y--, 17
+	0x4061, // 19: in     null, 1
+	0x0050, // 20: jmp    x--, 16
+	0x0001, // 21: jmp    1
+	0xe141, // 22: set    y, 1                   [1]
+	0x0019, // 23: jmp    25
+	0xe145, // 24: set    y, 5                   [1]
+	0x00db, // 25: jmp    pin, 27
+	0x000e, // 26: jmp    14
+	0x0099, // 27: jmp    y--, 25
+	0x40e1, // 28: in     osr, 1
+	0x0058, // 29: jmp    x--, 24
+	//     .wrap
+};
+
+#if !PICO_NO_HARDWARE
+static const struct pio_program bidir_dshot_x1_fast_program = {
+	.instructions = bidir_dshot_x1_fast_program_instructions,
+	.length = 30,
+	.origin = -1,
+};
+
+static inline pio_sm_config bidir_dshot_x1_fast_program_get_default_config(uint offset) {
+	pio_sm_config c = pio_get_default_sm_config();
+	sm_config_set_wrap(&c, offset + bidir_dshot_x1_fast_wrap_target, offset + bidir_dshot_x1_fast_wrap);
+	return c;
+}
+#endif
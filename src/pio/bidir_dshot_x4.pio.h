@@ -0,0 +1,58 @@
+// -------------------------------------------------- //
+// This file is autogenerated by pioasm; do not edit! //
+// -------------------------------------------------- //
+
+#pragma once
+
+#if !PICO_NO_HARDWARE
+#include "hardware/pio.h"
+#endif
+
+// -------------- //
+// bidir_dshot_x4 //
+// -------------- //
+
+#define bidir_dshot_x4_wrap_target 0
+#define bidir_dshot_x4_wrap 22
+
+static const uint16_t bidir_dshot_x4_program_instructions[] = {
+	//     .wrap_target
+	0xe08f, //  0: set    pindirs, 15
+	0xe02f, //  1: set    x, 15
+	0x80a0, //  2: pull   block
+	0xed00, //  3: set    pins, 0                [13]
+	0x6d04, //  4: out    pins, 4                [13]
+	0xe90f, //  5: set    pins, 15               [9]
+	0x80c0, //  6: pull   ifempty noblock
+	0x0043, //  7: jmp    x--, 3
+	0xe080, //  8: set    pindirs, 0
+	0xa0c3, //  9: mov    isr, null
+	0x4004, // 10: in     pins, 4
+	0xa046, // 11: mov    y, isr
+	0xa0c3, // 12: mov    isr, null
+	0x4004, // 13: in     pins, 4
+	0xa026, // 14: mov    x, isr
+	0x00b1, // 15: jmp    x!=y, 17
+	0x000c, // 16: jmp    12
+	0xa327, // 17: mov    x, osr                 [3]
+	0x4704, // 18: in     pins, 4                [7]
+	0x4704, // 19: in     pins, 4                [7]
+	0x4704, // 20: in     pins, 4                [7]
+	0x4604, // 21: in     pins, 4                [6]
+	0x0052, // 22: jmp    x--, 18
+	//     .wrap
+};
+
+#if !PICO_NO_HARDWARE
+static const struct pio_program bidir_dshot_x4_program = {
+	.instructions = bidir_dshot_x4_program_instructions,
+	.length = 23,
+	.origin = -1,
+};
+
+static inline pio_sm_config bidir_dshot_x4_program_get_default_config(uint offset) {
+	pio_sm_config c = pio_get_default_sm_config();
+	sm_config_set_wrap(&c, offset + bidir_dshot_x4_wrap_target, offset + bidir_dshot_x4_wrap);
+	return c;
+}
+#endif
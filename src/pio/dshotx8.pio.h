@@ -0,0 +1,39 @@
+// -------------------------------------------------- //
+// This file is autogenerated by pioasm; do not edit! //
+// -------------------------------------------------- //
+
+#pragma once
+
+#if !PICO_NO_HARDWARE
+#include "hardware/pio.h"
+#endif
+
+// ------- //
+// dshotx8 //
+// ------- //
+
+#define dshotx8_wrap_target 0
+#define dshotx8_wrap 3
+
+static const uint16_t dshotx8_program_instructions[] = {
+	//     .wrap_target
+	0x80e0, //  0: pull   ifempty block
+	0xad0b, //  1: mov    pins, !null            [13]
+	0x6d08, //  2: out    pins, 8                [13]
+	0xaa03, //  3: mov    pins, null             [10]
+	//     .wrap
+};
+
+#if !PICO_NO_HARDWARE
+static const struct pio_program dshotx8_program = {
+	.instructions = dshotx8_program_instructions,
+	.length = 4,
+	.origin = -1,
+};
+
+static inline pio_sm_config dshotx8_program_get_default_config(uint offset) {
+	pio_sm_config c = pio_get_default_sm_config();
+	sm_config_set_wrap(&c, offset + dshotx8_wrap_target, offset + dshotx8_wrap);
+	return c;
+}
+#endif
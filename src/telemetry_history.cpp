@@ -0,0 +1,32 @@
+#include "telemetry_history.h"
+#include "bidir_dshot_x1.h"
+
+static_assert((DSHOT_TELEMETRY_HISTORY & (DSHOT_TELEMETRY_HISTORY - 1)) == 0 && DSHOT_TELEMETRY_HISTORY <= 128, "DSHOT_TELEMETRY_HISTORY must be a power of 2, max. 128");
+
+void BidirDShotTelemetryHistory::push(uint16_t raw, BidirDshotTelemetryType type, uint32_t timestamp, uint16_t turnaroundNs) {
+	uint8_t h = this->head;
+	if ((uint8_t)(h - this->tail) >= DSHOT_TELEMETRY_HISTORY) {
+		this->overflows = this->overflows + 1;
+		return;
+	}
+	BidirDShotTelemetryFrame &f = this->buffer[h & (DSHOT_TELEMETRY_HISTORY - 1)];
+	f.timestamp = timestamp;
+	f.raw = raw;
+	f.type = type;
+	f.turnaroundNs = turnaroundNs;
+	__asm__ volatile("" ::: "memory"); // frame must be complete before it is published
+	this->head = h + 1;
+}
+
+uint8_t BidirDShotTelemetryHistory::read(BidirDShotTelemetryFrame *frames, uint8_t maxFrames) {
+	uint8_t t = this->tail;
+	uint8_t count = this->head - t;
+	if (count > maxFrames) count = maxFrames;
+	__asm__ volatile("" ::: "memory");
+	for (uint8_t i = 0; i < count; i++) {
+		frames[i] = this->buffer[(uint8_t)(t + i) & (DSHOT_TELEMETRY_HISTORY - 1)];
+	}
+	__asm__ volatile("" ::: "memory"); // frames must be copied before they are released
+	this->tail = t + count;
+	return count;
+}
@@ -0,0 +1,54 @@
+#ifndef TELEMETRY_HISTORY_H
+#define TELEMETRY_HISTORY_H
+
+#include "dshot_config.h"
+#include <stdint.h>
+
+enum class BidirDshotTelemetryType : uint8_t;
+
+/**
+ * @brief One telemetry frame as it is stored in the history
+ */
+struct BidirDShotTelemetryFrame {
+	uint32_t timestamp; /// time_us_32() when the DShot packet was sent that this frame answers
+	uint16_t raw; /// 12 bit raw value, same as getTelemetryRaw, 0 if the checksum was invalid
+	BidirDshotTelemetryType type; /// frame type, ::CHECKSUM_ERROR if the frame was corrupted
+	uint16_t turnaroundNs; /// time from the end of the packet to the start of the reply in ns (resolution 1/20 bit), 0 if not measured (::NO_REPLY, BidirDShotX4, or reply window longer than 2047 PIO loops, i.e. above DShot2400 with the default DSHOT_REPLY_TIMEOUT_US)
+};
+
+/**
+ * @brief Ring buffer of telemetry frames for one ESC
+ *
+ * Single producer (driver), single consumer (user). Safe to push from an interrupt while the user is reading. If the buffer is full, new frames are dropped and counted as overflows.
+ */
+class BidirDShotTelemetryHistory {
+public:
+	/**
+	 * @brief stores a new frame, or counts an overflow if the buffer is full
+	 */
+	void push(uint16_t raw, BidirDshotTelemetryType type, uint32_t timestamp, uint16_t turnaroundNs = 0);
+
+	/**
+	 * @brief copies the stored frames (oldest first) and removes them from the buffer
+	 *
+	 * @param frames array to store the frames
+	 * @param maxFrames size of the array, frames that don't fit stay in the buffer
+	 * @return uint8_t number of frames copied
+	 */
+	uint8_t read(BidirDShotTelemetryFrame *frames, uint8_t maxFrames);
+
+	/**
+	 * @brief number of frames that were dropped because the buffer was full
+	 */
+	uint32_t getOverflows() {
+		return overflows;
+	}
+
+private:
+	BidirDShotTelemetryFrame buffer[DSHOT_TELEMETRY_HISTORY];
+	volatile uint8_t head = 0; /// write count, only changed by push
+	volatile uint8_t tail = 0; /// read count, only changed by read
+	volatile uint32_t overflows = 0; /// number of dropped frames
+};
+
+#endif // TELEMETRY_HISTORY_H
@@ -0,0 +1,59 @@
+#include "telemetry_state.h"
+#include "bidir_dshot_x1.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+
+static_assert((int)BidirDshotTelemetryType::DEBUG_FRAME_2 + 1 == DSHOT_TELEMETRY_TYPES, "DSHOT_TELEMETRY_TYPES must match BidirDshotTelemetryType");
+
+uint16_t BidirDShotTelemetryState::getStaleMask(uint32_t maxAgeUs) const {
+	uint16_t mask = 0;
+	for (int i = 0; i < DSHOT_TELEMETRY_TYPES; i++) {
+		if (this->isStale((BidirDshotTelemetryType)i, maxAgeUs)) mask |= 1 << i;
+	}
+	return mask;
+}
+
+void BidirDShotTelemetryAggregator::update(BidirDshotTelemetryType type, uint32_t value, uint32_t timestamp) {
+	BidirDShotTelemetryField &f = this->fields[(uint8_t)type];
+	uint32_t irqState = save_and_disable_interrupts();
+	this->sequence = this->sequence + 1;
+	__mem_fence_release();
+	f.value = value;
+	f.timestamp = timestamp;
+	f.count++;
+	__mem_fence_release();
+	this->sequence = this->sequence + 1;
+	restore_interrupts(irqState);
+}
+
+void BidirDShotTelemetryAggregator::snapshot(BidirDShotTelemetryState *state) const {
+	uint32_t seq;
+	do {
+		seq = this->sequence;
+		__mem_fence_acquire();
+		for (int i = 0; i < DSHOT_TELEMETRY_TYPES; i++) {
+			state->fields[i] = this->fields[i];
+		}
+		__mem_fence_acquire();
+	} while ((seq & 1) || seq != this->sequence);
+	state->time = time_us_32();
+}
+
+bool BidirDShotTelemetryAggregator::get(BidirDshotTelemetryType type, uint32_t *value) const {
+	if ((uint8_t)type >= DSHOT_TELEMETRY_TYPES) {
+		return false;
+	}
+	uint32_t seq, v, count;
+	do {
+		seq = this->sequence;
+		__mem_fence_acquire();
+		v = this->fields[(uint8_t)type].value;
+		count = this->fields[(uint8_t)type].count;
+		__mem_fence_acquire();
+	} while ((seq & 1) || seq != this->sequence);
+	if (!count) {
+		return false;
+	}
+	*value = v;
+	return true;
+}
@@ -0,0 +1,78 @@
+#ifndef TELEMETRY_STATE_H
+#define TELEMETRY_STATE_H
+
+#include <stdint.h>
+
+enum class BidirDshotTelemetryType : uint8_t;
+
+#define DSHOT_TELEMETRY_TYPES 12 /// number of BidirDshotTelemetryType values, size of the field arrays
+
+/**
+ * @brief Latest value of one telemetry type
+ */
+struct BidirDShotTelemetryField {
+	uint32_t value; /// last valid value, converted like getTelemetryPacket (eRPM, voltage in 0.25V, current in A, temperature in °C, ...)
+	uint32_t timestamp; /// timestamp of the frame (see BidirDShotTelemetryFrame), only valid if count > 0
+	uint32_t count; /// number of valid frames of this type since initialisation
+};
+
+/**
+ * @brief Snapshot of all telemetry values of one ESC, see getTelemetryState
+ *
+ * Indexed by BidirDshotTelemetryType, the entries of ::OTHER_VALUE, ::CHECKSUM_ERROR, ::NO_REPLY and ::NO_PACKET are always empty.
+ */
+struct BidirDShotTelemetryState {
+	BidirDShotTelemetryField fields[DSHOT_TELEMETRY_TYPES]; /// one entry per telemetry type
+	uint32_t time; /// time_us_32() when the snapshot was taken
+
+	/**
+	 * @brief the field of a telemetry type
+	 */
+	const BidirDShotTelemetryField &get(BidirDshotTelemetryType type) const {
+		return fields[(uint8_t)type];
+	}
+
+	/**
+	 * @brief checks if a value was never received or is older than maxAgeUs (at the time of the snapshot)
+	 */
+	bool isStale(BidirDshotTelemetryType type, uint32_t maxAgeUs) const {
+		const BidirDShotTelemetryField &f = fields[(uint8_t)type];
+		return !f.count || time - f.timestamp > maxAgeUs;
+	}
+
+	/**
+	 * @brief bit mask of all stale types (bit n = BidirDshotTelemetryType n), including the ones that are never sent
+	 */
+	uint16_t getStaleMask(uint32_t maxAgeUs) const;
+};
+
+/**
+ * @brief Keeps the latest value of every telemetry type of one ESC, updated by the driver whenever a frame is decoded
+ *
+ * O(1) per frame and per read. The update is short and runs with interrupts disabled, snapshot retries if it overlaps with an update (sequence counter), so a snapshot is consistent even when taken from the other core.
+ */
+class BidirDShotTelemetryAggregator {
+public:
+	/**
+	 * @brief stores a valid value
+	 */
+	void update(BidirDshotTelemetryType type, uint32_t value, uint32_t timestamp);
+
+	/**
+	 * @brief copies all fields
+	 */
+	void snapshot(BidirDShotTelemetryState *state) const;
+
+	/**
+	 * @brief gets the latest value of one type
+	 *
+	 * @return false if no value of this type was received, value is left unchanged
+	 */
+	bool get(BidirDshotTelemetryType type, uint32_t *value) const;
+
+private:
+	BidirDShotTelemetryField fields[DSHOT_TELEMETRY_TYPES] = {};
+	volatile uint32_t sequence = 0; /// odd while an update is running
+};
+
+#endif // TELEMETRY_STATE_H
@@ -0,0 +1,140 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include "hardware/clocks.h"
+#include "pio_emu.h"
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+static int testFailures = 0;
+
+/// counts and prints a failed condition, the test keeps running
+#define CHECK(cond, ...)                                              \
+	do {                                                              \
+		if (!(cond)) {                                                \
+			testFailures++;                                           \
+			printf("%s:%d: check failed: %s: ", __FILE__, __LINE__, #cond); \
+			printf(__VA_ARGS__);                                      \
+			printf("\n");                                             \
+		}                                                             \
+	} while (0)
+
+/// exit code of the test: 0 if all checks passed
+static inline int testResult() {
+	printf(testFailures ? "%d checks failed\n" : "all ok\n", testFailures);
+	return testFailures != 0;
+}
+
+/**
+ * @brief Waveform model of an ESC on one GPIO, clocked by the emulator every cycle
+ *
+ * Decodes the DShot frames on the pin (normal or inverted) and, in bidirectional mode, answers every valid frame with a GCR telemetry reply after replyDelayUs, at 5/4 of the DShot speed. clockError stretches (> 0) or shortens (< 0) the reply bits, like an ESC with a drifting clock.
+ */
+struct EscModel {
+	uint8_t pin; /// GPIO of the ESC
+	uint32_t speed; /// DShot speed in kBaud
+	bool bidir = true; /// inverted frames with telemetry reply, otherwise normal DShot
+	bool replies = true; /// whether a valid frame is answered
+	uint32_t replyDelayUs = 30; /// turnaround from the end of the frame to the start of the reply
+	uint16_t telemetry12 = 0xFFF; /// 12 bit telemetry value of the reply (eee mmmmmmmmm for eRPM)
+	bool corrupt = false; /// flips a bit of the reply, so that its checksum is wrong
+	double clockError = 0; /// relative error of the reply bit time
+
+	std::vector<uint16_t> frames; /// all received frames with a valid checksum
+	uint32_t badFrames = 0; /// received frames with a wrong checksum
+
+	bool last = true;
+	uint64_t lowStart = 0, lastEdge = 0;
+	uint32_t bits = 0, bitCount = 0;
+	int hookId = -1;
+	bool replying = false;
+	uint64_t replyStart = 0;
+	uint32_t replyWord = 0, replyBit = 0;
+	double replyBitCycles = 0;
+
+	EscModel(uint8_t pin, uint32_t speed, bool bidir = true) : pin(pin), speed(speed), bidir(bidir), last(bidir) {
+		this->hookId = pio_emu_add_hook([](void *ctx, uint64_t cycle) { ((EscModel *)ctx)->tick(cycle); }, this);
+	}
+	EscModel(const EscModel &) = delete;
+	~EscModel() {
+		pio_emu_remove_hook(this->hookId);
+		pio_emu_gpio_release(this->pin);
+	}
+
+	/// 20 bit GCR reply with the start bit, as sent by an ESC (level in bit 20...0, idle high)
+	static uint32_t encodeReply(uint16_t value, bool corrupt) {
+		static const uint8_t gcr[16] = {0x19, 0x1B, 0x12, 0x13, 0x1D, 0x15, 0x16, 0x17, 0x1A, 0x09, 0x0A, 0x0B, 0x1E, 0x0D, 0x0E, 0x0F};
+		uint16_t v = value << 4 | (~(value ^ value >> 4 ^ value >> 8) & 0xF);
+		if (corrupt) v ^= 0x10;
+		uint32_t g = 0;
+		for (int i = 3; i >= 0; i--) g = g << 5 | gcr[v >> (4 * i) & 0xF];
+		uint32_t raw = 0, level = 0;
+		for (int i = 19; i >= 0; i--) {
+			level ^= g >> i & 1;
+			raw |= level << i;
+		}
+		return raw;
+	}
+
+	/// 12 bit eRPM value (period in us as eee mmmmmmmmm)
+	static uint16_t erpmTo12(uint32_t erpm) {
+		if (!erpm) return 0xFFF;
+		uint32_t p = 60000000 / erpm, e = 0;
+		for (; p > 0x1FF; e++) p >>= 1;
+		return e << 9 | p;
+	}
+
+	void tick(uint64_t cycle) {
+		double bitCycles = (double)clock_get_hz(clk_sys) / (this->speed * 1000.0);
+		if (this->replying) {
+			uint64_t next = this->replyStart + (uint64_t)(this->replyBit * this->replyBitCycles + 0.5);
+			if (cycle < next) return;
+			if (this->replyBit == 21) {
+				pio_emu_gpio_release(this->pin);
+				this->replying = false;
+			} else {
+				pio_emu_gpio_drive(this->pin, this->replyWord >> (20 - this->replyBit++) & 1);
+			}
+			return;
+		}
+		bool level = pio_emu_gpio_level(this->pin);
+		if (level == this->last) {
+			if (this->bitCount && cycle - this->lastEdge > 3 * bitCycles) this->bitCount = 0;
+			return;
+		}
+		this->last = level;
+		bool active = level != this->bidir;
+		if (active && cycle - this->lastEdge > 3 * bitCycles) this->bitCount = 0;
+		this->lastEdge = cycle;
+		if (active) {
+			this->lowStart = cycle;
+			return;
+		}
+		this->bits = this->bits << 1 | (cycle - this->lowStart > bitCycles / 2);
+		if (++this->bitCount < 16) return;
+		this->bitCount = 0;
+		uint16_t frame = this->bits;
+		uint16_t cs = (frame >> 4 ^ frame >> 8 ^ frame >> 12) & 0xF;
+		if (this->bidir) cs = ~cs & 0xF;
+		if (cs != (frame & 0xF)) {
+			this->badFrames++;
+			return;
+		}
+		this->frames.push_back(frame);
+		if (this->bidir && this->replies) {
+			this->replying = true;
+			this->replyStart = cycle + (uint64_t)this->replyDelayUs * clock_get_hz(clk_sys) / 1000000;
+			this->replyWord = encodeReply(this->telemetry12, this->corrupt);
+			this->replyBit = 0;
+			this->replyBitCycles = bitCycles * 4 / 5 * (1 + this->clockError);
+		}
+	}
+
+	/// 11 bit value of the last valid frame (throttle + 47 or command), 0xFFFF if none
+	uint16_t lastValue() {
+		return this->frames.empty() ? 0xFFFF : this->frames.back() >> 5;
+	}
+};
+
+#endif // HOST_TEST_H
@@ -0,0 +1,57 @@
+// BidirDShotX1: frames and eRPM replies at all speeds, silent ESC, ESC clock errors with the reduced oversampling
+#include "bidir_dshot_x1.h"
+#include "host_test.h"
+
+int main() {
+	pio_emu_reset();
+	for (uint32_t speed : {300, 600, 1200, 2400, 4800}) {
+		BidirDShotX1 driver(5, speed, pio0);
+		CHECK(!driver.initError(), "DShot%u", speed);
+		EscModel esc(5, speed);
+		for (int i = 0; i < 10; i++) {
+			uint16_t throttle = 100 + 150 * i;
+			esc.telemetry12 = EscModel::erpmTo12(1000 + 3100 * i);
+			driver.sendThrottle(throttle);
+			pio_emu_run_us(400);
+			uint32_t erpm = 0;
+			BidirDshotTelemetryType type = driver.getTelemetryErpm(&erpm);
+			uint32_t expected = BidirDShotX1::convertFromRaw(esc.telemetry12, BidirDshotTelemetryType::ERPM);
+			CHECK(type == BidirDshotTelemetryType::ERPM && erpm == expected, "DShot%u frame %d: type %d, eRPM %u, expected %u", speed, i, (int)type, erpm, expected);
+			CHECK(esc.lastValue() == throttle + 47, "DShot%u frame %d: ESC got %u", speed, i, esc.lastValue());
+		}
+		esc.replies = false;
+		driver.sendThrottle(0);
+		pio_emu_run_us(400);
+		uint32_t erpm = 1234;
+		BidirDshotTelemetryType type = driver.getTelemetryErpm(&erpm);
+		CHECK(type == BidirDshotTelemetryType::NO_REPLY && erpm == 1234, "DShot%u silent ESC: type %d", speed, (int)type);
+		CHECK(esc.frames.size() == 11 && esc.badFrames == 0, "DShot%u: %zu frames, %u bad", speed, esc.frames.size(), esc.badFrames);
+	}
+
+	// bidir_dshot_x1_fast (20 cycles per bit) must decode replies with bit times up to 10% off in both directions
+	struct {
+		uint32_t clkSys, speed;
+	} fastCases[] = {{125000000, 4800}, {60000000, 2400}};
+	for (auto c : fastCases) {
+		for (double clockError : {-0.1, -0.08, 0.08, 0.1}) {
+			pio_emu_reset();
+			pio_emu_set_sys_clock(c.clkSys);
+			BidirDShotX1 driver(5, c.speed, pio0);
+			CHECK(!driver.initError(), "DShot%u at %u Hz", c.speed, c.clkSys);
+			EscModel esc(5, c.speed);
+			esc.clockError = clockError;
+			int decoded = 0;
+			for (int i = 0; i < 20; i++) {
+				esc.telemetry12 = (i * 2654435761u >> 7) & 0xFFF; // varied bit patterns
+				esc.replyDelayUs = 25 + i % 7;
+				driver.sendThrottle(100 + i);
+				pio_emu_run_us(400);
+				uint32_t raw = 0;
+				BidirDshotTelemetryType type = driver.getTelemetryRaw(&raw);
+				if (type != BidirDshotTelemetryType::NO_REPLY && type != BidirDshotTelemetryType::CHECKSUM_ERROR && raw == esc.telemetry12) decoded++;
+			}
+			CHECK(decoded == 20, "DShot%u at %u Hz, ESC clock %+.0f%%: %d/20 replies decoded", c.speed, c.clkSys, clockError * 100, decoded);
+		}
+	}
+	return testResult();
+}
@@ -0,0 +1,111 @@
+// BidirDShotX4: replies of four ESCs, missing and corrupt replies, release of the resources after a failed init
+#include "bidir_dshot_x4.h"
+#include "hardware/dma.h"
+#include "host_test.h"
+
+int main() {
+	pio_emu_reset();
+	for (uint32_t speed : {300, 600, 1200, 2400}) {
+		BidirDShotX4 driver(6, 4, speed, pio1);
+		CHECK(!driver.initError(), "DShot%u", speed);
+		EscModel esc[4] = {{6, speed}, {7, speed}, {8, speed}, {9, speed}};
+		for (int k = 0; k < 4; k++) {
+			esc[k].replyDelayUs = 27 + k;
+			esc[k].clockError = (k - 1.5) * 0.03;
+		}
+		for (int i = 0; i < 10; i++) {
+			uint16_t throttles[4], packets[4];
+			for (int k = 0; k < 4; k++) {
+				packets[k] = throttles[k] = 100 * k + i;
+				esc[k].telemetry12 = EscModel::erpmTo12(1000 + 997 * i + 3000 * k);
+			}
+			esc[1].replies = i != 3;
+			esc[2].corrupt = i == 5;
+			driver.sendThrottles(packets); // converted in place
+			pio_emu_run_us(400);
+			for (int k = 0; k < 4; k++) {
+				uint32_t value = 0;
+				BidirDshotTelemetryType type = driver.getTelemetryPacket(k, &value);
+				uint32_t expected = BidirDShotX1::convertFromRaw(esc[k].telemetry12, BidirDshotTelemetryType::ERPM);
+				if (k == 1 && i == 3) {
+					CHECK(type == BidirDshotTelemetryType::NO_REPLY, "DShot%u frame %d: type %d", speed, i, (int)type);
+				} else if (k == 2 && i == 5) {
+					CHECK(type == BidirDshotTelemetryType::CHECKSUM_ERROR, "DShot%u frame %d: type %d", speed, i, (int)type);
+				} else {
+					CHECK(type == BidirDshotTelemetryType::ERPM && value == expected, "DShot%u ESC %d frame %d: type %d, eRPM %u, expected %u", speed, k, i, (int)type, value, expected);
+				}
+				uint16_t sent = throttles[k] ? throttles[k] + 47 : 0;
+				CHECK(esc[k].lastValue() == sent, "DShot%u ESC %d frame %d: ESC got %u, expected %u", speed, k, i, esc[k].lastValue(), sent);
+			}
+		}
+	}
+
+	// turnaround spread of 9us, and one reply too late for the capture
+	for (uint32_t speed : {600, 1200, 2400}) {
+		BidirDShotX4 driver(6, 4, speed, pio1);
+		EscModel esc[4] = {{6, speed}, {7, speed}, {8, speed}, {9, speed}};
+		for (int i = 0; i < 20; i++) {
+			for (int k = 0; k < 4; k++) {
+				esc[k].replyDelayUs = 28 + 3 * k;
+				esc[k].telemetry12 = EscModel::erpmTo12(2000 + 1000 * k + 100 * i);
+			}
+			if (i >= 10) esc[3].replyDelayUs = 28 + BIDIR_DSHOT_X4_REPLY_SKEW_US + 5;
+			uint16_t packets[4] = {100, 200, 300, 400};
+			driver.sendThrottles(packets);
+			pio_emu_run_us(400);
+			for (int k = 0; k < 4; k++) {
+				uint32_t value = 0;
+				BidirDshotTelemetryType type = driver.getTelemetryPacket(k, &value);
+				uint32_t expected = BidirDShotX1::convertFromRaw(esc[k].telemetry12, BidirDshotTelemetryType::ERPM);
+				if (k == 3 && i >= 10) {
+					CHECK(type == BidirDshotTelemetryType::NO_REPLY, "DShot%u cut off reply: type %d", speed, (int)type);
+				} else {
+					CHECK(type == BidirDshotTelemetryType::ERPM && value == expected, "DShot%u ESC %d frame %d: type %d, eRPM %u, expected %u", speed, k, i, (int)type, value, expected);
+				}
+			}
+		}
+		BidirDShotLinkStats stats;
+		driver.getLinkStats(3, &stats);
+		CHECK(stats.replies == 10 && stats.missingReplies == 10 && stats.invalidGcr == 0 && stats.checksumErrors == 0, "DShot%u: %u replies, %u missing, %u invalid GCR", speed, stats.replies, stats.missingReplies, stats.invalidGcr);
+	}
+
+	// no ESC replies at all: the next packet ends the capture, every channel reports NO_REPLY
+	{
+		BidirDShotX4 driver(6, 4, 600, pio1);
+		EscModel esc[4] = {{6, 600}, {7, 600}, {8, 600}, {9, 600}};
+		for (auto &e : esc) e.replies = false;
+		for (int i = 0; i < 3; i++) {
+			uint16_t packets[4] = {100, 200, 300, 400};
+			driver.sendThrottles(packets);
+			pio_emu_run_us(400);
+		}
+		for (int k = 0; k < 4; k++) {
+			uint32_t raw = 1234;
+			BidirDshotTelemetryType type = driver.getTelemetryRaw(k, &raw);
+			CHECK(type == BidirDshotTelemetryType::NO_REPLY, "silent ESC %d: type %d", k, (int)type);
+			BidirDShotLinkStats stats;
+			driver.getLinkStats(k, &stats);
+			CHECK(stats.missingReplies == 2 && stats.replies == 0, "silent ESC %d: %u missing, %u replies", k, stats.missingReplies, stats.replies);
+		}
+	}
+
+	// 125 MHz / 40 cycles per bit: max. DShot3125
+	BidirDShotX4 tooFast(6, 4, 4800, pio1);
+	CHECK(tooFast.initError(), "DShot4800");
+
+	// no space for the program: the state machine and the DMA channel must be released again
+	static const uint16_t filler[32] = {};
+	const pio_program_t fillerProgram = {filler, 32, -1};
+	pio_add_program(pio0, &fillerProgram);
+	int claimedBefore = 0, claimedAfter = 0;
+	for (uint ch = 0; ch < NUM_DMA_CHANNELS; ch++) claimedBefore += dma_channel_is_claimed(ch);
+	{
+		BidirDShotX4 noSpace(6, 4, 600, pio0);
+		CHECK(noSpace.initError(), "no space for the program");
+	}
+	for (uint ch = 0; ch < NUM_DMA_CHANNELS; ch++) claimedAfter += dma_channel_is_claimed(ch);
+	CHECK(claimedAfter == claimedBefore, "DMA channels claimed: %d before, %d after a failed init", claimedBefore, claimedAfter);
+	CHECK(!pio_sm_is_claimed(pio0, 0), "SM 0 still claimed after a failed init");
+	pio_remove_program(pio0, &fillerProgram, 0);
+	return testResult();
+}
@@ -0,0 +1,165 @@
+// DShotBlackbox: a known TX/RX sequence on several GPIOs, through a forced overflow (DROP entry), the wraparound of time_us_32 and of the ring buffer, decoded back with extras/blackbox
+#include "bidir_dshot_x1.h"
+#include "dshot_blackbox.h"
+#include "host_test.h"
+#include "pico/time.h"
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+struct Expected {
+	uint64_t time; /// time_us_64 of the entry, the decoder counts with 64 bit
+	int gpio; /// -1 for ::DROP
+	DShotBlackboxEntry entry;
+	uint32_t value; /// frame, word or number of dropped entries
+};
+
+static std::vector<Expected> expected;
+static std::vector<uint8_t> stream;
+static uint32_t pendingDrops = 0;
+
+// logs through the driver hooks and notes what the decoder must see
+static void logEntry(DShotBlackbox &bb, uint8_t pin, DShotBlackboxEntry entry, uint32_t value) {
+	uint32_t dropped = bb.getDropped(), available = bb.available();
+	uint64_t now = time_us_64();
+	if (entry == DShotBlackboxEntry::TX) {
+		dshotBlackboxTx(pin, value);
+	} else {
+		dshotBlackboxRx(pin, value);
+	}
+	if (bb.getDropped() != dropped) {
+		if (bb.available() != available) {
+			// the pending DROP entry still fit, but not the entry itself
+			expected.push_back({now, -1, DShotBlackboxEntry::DROP, pendingDrops});
+			pendingDrops = 0;
+		}
+		pendingDrops++;
+		return;
+	}
+	if (pendingDrops) {
+		expected.push_back({now, -1, DShotBlackboxEntry::DROP, pendingDrops});
+		pendingDrops = 0;
+	}
+	expected.push_back({now, pin, entry, value});
+}
+
+// reads in odd chunks, so that entries span two reads
+static void drain(DShotBlackbox &bb) {
+	uint8_t chunk[37];
+	uint32_t n;
+	while ((n = bb.read(chunk, sizeof(chunk))) > 0) {
+		stream.insert(stream.end(), chunk, chunk + n);
+	}
+}
+
+static std::vector<std::string> split(const std::string &line) {
+	std::vector<std::string> fields;
+	size_t start = 0, comma;
+	while ((comma = line.find(',', start)) != std::string::npos) {
+		fields.push_back(line.substr(start, comma - start));
+		start = comma + 1;
+	}
+	fields.push_back(line.substr(start));
+	return fields;
+}
+
+int main() {
+	pio_emu_reset();
+	pio_emu_set_time_us(0xFFFFFFFFull - 5000); // time_us_32 wraps 5ms into the capture
+	const uint64_t startTime = time_us_64();
+	static uint8_t buffer[256];
+	DShotBlackbox bb(buffer, sizeof(buffer));
+	CHECK(bb.start(), "start");
+	CHECK(dshotBlackbox == &bb, "not the running capture");
+
+	const uint8_t pins[4] = {0, 7, 29, 47};
+	uint32_t seed = 12345;
+	auto rnd = [&seed]() {
+		seed = seed * 1103515245 + 12345;
+		return seed >> 8;
+	};
+	uint16_t tx[4] = {};
+	for (int phase = 0; phase < 3; phase++) {
+		// 0: drained after every loop, 1: never drained (overflow), 2: drained again, starts with the DROP entry
+		for (int i = 0; i < 120; i++) {
+			for (int k = 0; k < 4; k++) {
+				// mostly small changes of the throttle, sometimes the same frame or a big jump
+				uint32_t r = rnd();
+				if (r % 4 == 0) tx[k] = rnd();
+				else if (r % 4 == 1) tx[k] ^= rnd() & 0x3F0;
+				logEntry(bb, pins[k], DShotBlackboxEntry::TX, tx[k]);
+				// no reply, a valid 21 bit frame, a corrupted frame or a 32 bit FIFO word
+				uint32_t word = 0;
+				r = rnd();
+				if (r % 4 == 1) word = EscModel::encodeReply(EscModel::erpmTo12(1000 + rnd() % 50000), false);
+				else if (r % 4 == 2) word = EscModel::encodeReply(rnd() & 0xFFF, true);
+				else if (r % 4 == 3) word = rnd() << 8 | (rnd() & 0xFF);
+				logEntry(bb, pins[k], DShotBlackboxEntry::RX, word);
+			}
+			pio_emu_run_us(i == 60 ? 20000 : 20 + rnd() % 200);
+			if (phase != 1) drain(bb);
+		}
+		if (phase == 1) {
+			CHECK(bb.getDropped() > 0 && pendingDrops > 0, "no entries were dropped");
+			drain(bb);
+		}
+	}
+	CHECK(time_us_32() < startTime, "time_us_32 did not wrap");
+	CHECK(stream.size() > 4 * sizeof(buffer), "ring buffer did not wrap: %zu bytes", stream.size());
+	bb.stop();
+	CHECK(dshotBlackbox == nullptr, "capture still running after stop");
+	drain(bb);
+
+	const char *path = "test_blackbox.bin";
+	FILE *f = fopen(path, "wb");
+	CHECK(f && fwrite(stream.data(), 1, stream.size(), f) == stream.size(), "cannot write %s", path);
+	if (f) fclose(f);
+	std::string command = std::string(BLACKBOX_DECODE) + " " + path;
+	FILE *csv = popen(command.c_str(), "r");
+	CHECK(csv, "cannot run %s", command.c_str());
+	if (!csv) return testResult();
+	std::vector<std::vector<std::string>> lines;
+	char line[256];
+	while (fgets(line, sizeof(line), csv)) {
+		std::string s(line);
+		while (!s.empty() && (s.back() == '\n' || s.back() == '\r')) s.pop_back();
+		lines.push_back(split(s));
+	}
+	CHECK(pclose(csv) == 0, "decoder failed");
+	remove(path);
+
+	CHECK(lines.size() == expected.size() + 2, "%zu lines, expected %zu", lines.size(), expected.size() + 2);
+	if (lines.size() < 2) return testResult();
+	CHECK(lines[1].size() == 9 && lines[1][2] == "SYNC" && strtoull(lines[1][0].c_str(), nullptr, 10) == (uint32_t)startTime, "SYNC entry");
+	uint32_t drops = 0, dropEntries = 0, errors = 0;
+	for (size_t i = 0; i < expected.size() && i + 2 < lines.size(); i++) {
+		const Expected &e = expected[i];
+		const std::vector<std::string> &l = lines[i + 2];
+		if (l.size() != 9) {
+			errors++;
+			continue;
+		}
+		bool ok = strtoull(l[0].c_str(), nullptr, 10) == e.time;
+		if (e.entry == DShotBlackboxEntry::DROP) {
+			ok = ok && l[1].empty() && l[2] == "DROP" && strtoul(l[8].c_str(), nullptr, 10) == e.value;
+			drops += e.value;
+			dropEntries++;
+		} else if (e.entry == DShotBlackboxEntry::TX) {
+			ok = ok && atoi(l[1].c_str()) == e.gpio && l[2] == "TX" && strtoul(l[3].c_str(), nullptr, 16) == e.value;
+		} else {
+			ok = ok && atoi(l[1].c_str()) == e.gpio && l[2] == "RX" && strtoul(l[3].c_str(), nullptr, 16) == e.value;
+			uint32_t raw = 0;
+			BidirDshotTelemetryType type = e.value ? BidirDShotX1::decodeFrame(e.value, &raw) : BidirDshotTelemetryType::NO_REPLY;
+			if (type == BidirDshotTelemetryType::NO_REPLY) ok = ok && l[7] == "NO_REPLY";
+			if (type == BidirDshotTelemetryType::CHECKSUM_ERROR) ok = ok && l[7] == "CHECKSUM_ERROR";
+			if (type == BidirDshotTelemetryType::ERPM) ok = ok && l[7] == "ERPM" && strtoul(l[8].c_str(), nullptr, 10) == BidirDShotX1::convertFromRaw(raw, type);
+		}
+		if (!ok && errors++ < 5) {
+			printf("entry %zu: time %llu, gpio %d, entry %d, value 0x%X, decoded as %s,%s,%s,%s,...,%s\n", i, (unsigned long long)e.time, e.gpio, (int)e.entry, e.value, l[0].c_str(), l[1].c_str(), l[2].c_str(), l[3].c_str(), l[8].c_str());
+		}
+	}
+	CHECK(errors == 0, "%u entries decoded wrong", errors);
+	CHECK(dropEntries > 0 && drops == bb.getDropped(), "%u DROP entries with %u entries, %u dropped", dropEntries, drops, bb.getDropped());
+	printf("%zu entries, %zu bytes, %u dropped\n", expected.size(), stream.size(), drops);
+	return testResult();
+}
@@ -0,0 +1,36 @@
+// decodeFrames: same types, values and valid mask as decodeFrame for all 2^21 frames, with odd and even batch sizes
+#include "bidir_dshot_x1.h"
+#include "host_test.h"
+
+int main() {
+	const uint32_t untouched = 0xDEADBEEF;
+	uint32_t frames[32], values[32], expectedValues[32];
+	BidirDshotTelemetryType types[32], expectedTypes[32];
+	int wrongTypes = 0, wrongValues = 0, wrongMasks = 0;
+	uint32_t validFrames = 0;
+	uint8_t count = 1;
+	for (uint32_t first = 0; first < 1u << 21; first += count, count = count % 32 + 1) {
+		if (first + count > 1u << 21) count = (1u << 21) - first;
+		uint32_t expectedMask = 0;
+		for (int i = 0; i < count; i++) {
+			frames[i] = first + i;
+			values[i] = expectedValues[i] = untouched;
+			types[i] = BidirDshotTelemetryType::NO_PACKET;
+			expectedTypes[i] = BidirDShotX1::decodeFrame(frames[i], &expectedValues[i]);
+			if (expectedTypes[i] != BidirDshotTelemetryType::CHECKSUM_ERROR) expectedMask |= 1u << i;
+		}
+		uint32_t mask = BidirDShotX1::decodeFrames(frames, count, values, types);
+		wrongMasks += mask != expectedMask;
+		for (int i = 0; i < count; i++) {
+			wrongTypes += types[i] != expectedTypes[i];
+			wrongValues += values[i] != expectedValues[i]; // also checks that invalid frames leave the value alone
+		}
+		validFrames += __builtin_popcount(mask);
+	}
+	CHECK(wrongTypes == 0, "%d types differ from decodeFrame", wrongTypes);
+	CHECK(wrongValues == 0, "%d values differ from decodeFrame", wrongValues);
+	CHECK(wrongMasks == 0, "%d batches with a wrong valid mask", wrongMasks);
+	// only the transitions count, so every 12 bit value is valid once per polarity of the frame
+	CHECK(validFrames == 2 * 4096, "%u valid frames, expected two per 12 bit value", validFrames);
+	return testResult();
+}
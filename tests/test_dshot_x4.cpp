@@ -0,0 +1,35 @@
+// DShotX4: frames on consecutive and on scattered pins
+#include "dshot_x4.h"
+#include "host_test.h"
+
+static void run(DShotX4 &driver, const uint8_t *pins, uint32_t speed) {
+	CHECK(!driver.initError(), "DShot%u, pin %d", speed, pins[0]);
+	EscModel esc[4] = {{pins[0], speed, false}, {pins[1], speed, false}, {pins[2], speed, false}, {pins[3], speed, false}};
+	for (int i = 0; i < 10; i++) {
+		uint16_t throttles[4], packets[4];
+		for (int k = 0; k < 4; k++) packets[k] = throttles[k] = (i * 53 + k * 251) % 2001;
+		driver.sendThrottles(packets); // converted in place
+		pio_emu_run_us(150);
+		for (int k = 0; k < 4; k++) {
+			uint16_t expected = throttles[k] ? throttles[k] + 47 : 0;
+			CHECK(esc[k].lastValue() == expected && esc[k].badFrames == 0, "DShot%u pin %d frame %d: ESC got %u, expected %u, %u bad", speed, pins[k], i, esc[k].lastValue(), expected, esc[k].badFrames);
+		}
+	}
+}
+
+int main() {
+	pio_emu_reset();
+	const uint8_t consecutive[4] = {10, 11, 12, 13};
+	const uint8_t scattered[4] = {14, 5, 2, 9}; // windows 2...9 (dshotx8) and 14 (dshotx4)
+	for (uint32_t speed : {300, 600, 1200}) {
+		{
+			DShotX4 driver(10, 4, speed, pio0);
+			run(driver, consecutive, speed);
+		}
+		{
+			DShotX4 driver(scattered, 4, speed, pio0);
+			run(driver, scattered, speed);
+		}
+	}
+	return testResult();
+}
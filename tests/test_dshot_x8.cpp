@@ -0,0 +1,32 @@
+// DShotX8: frames on 8 pins, speeds that are too high for the system clock
+#include "dshot_x4.h"
+#include "dshot_x8.h"
+#include "host_test.h"
+
+int main() {
+	pio_emu_reset();
+	for (uint32_t speed : {300, 600, 1200, 2400}) {
+		DShotX8 driver(4, 8, speed, pio0);
+		CHECK(!driver.initError(), "DShot%u", speed);
+		EscModel esc[8] = {{4, speed, false}, {5, speed, false}, {6, speed, false}, {7, speed, false}, {8, speed, false}, {9, speed, false}, {10, speed, false}, {11, speed, false}};
+		for (int i = 0; i < 10; i++) {
+			uint16_t throttles[8], packets[8];
+			for (int k = 0; k < 8; k++) packets[k] = throttles[k] = (i * 97 + k * 233) % 2001;
+			driver.sendThrottles(packets); // converted in place
+			pio_emu_run_us(150);
+			for (int k = 0; k < 8; k++) {
+				uint16_t expected = throttles[k] ? throttles[k] + 47 : 0;
+				CHECK(esc[k].lastValue() == expected && esc[k].badFrames == 0, "DShot%u pin %d frame %d: ESC got %u, expected %u, %u bad", speed, 4 + k, i, esc[k].lastValue(), expected, esc[k].badFrames);
+			}
+		}
+	}
+
+	// 125 MHz / 40 cycles per bit: max. DShot3125
+	DShotX8 x8(4, 8, 4800, pio0);
+	CHECK(x8.initError(), "DShotX8 at DShot4800");
+	DShotX4 x4(4, 4, 4800, pio0);
+	CHECK(x4.initError(), "DShotX4 at DShot4800");
+	DShotX4 x4Fast(4, 4, 3000, pio0);
+	CHECK(!x4Fast.initError(), "DShotX4 at DShot3000");
+	return testResult();
+}
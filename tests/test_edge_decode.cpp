@@ -0,0 +1,55 @@
+// edge capture mode: decodeEdges (CPU clock recovery) for every reply value, bit time drift and phase, and the whole path on the emulator
+#include "bidir_dshot_x1.h"
+#include "host_test.h"
+#include <cmath>
+
+// edge times as the capture program delivers them: 8 units per nominal reply bit (20 PIO cycles per packet bit), truncated
+static uint8_t makeEdges(uint32_t reply, double bitUnits, double phase, uint16_t *edges) {
+	uint8_t count = 0;
+	uint32_t level = 1; // idle high
+	for (int bit = 0; bit <= 21; bit++) {
+		uint32_t next = bit < 21 ? reply >> (20 - bit) & 1 : 1; // the line returns to idle after the last bit
+		if (next != level) edges[count++] = (uint16_t)floor(100 + phase + bit * bitUnits);
+		level = next;
+	}
+	return count;
+}
+
+int main() {
+	// the documented ±20% drift, all 4096 values at 4 phases each
+	const uint32_t bitTime256 = 8 * 256;
+	uint16_t edges[DSHOT_CAPTURE_EDGES];
+	for (int percent = -20; percent <= 20; percent++) {
+		int wrong = 0;
+		for (uint32_t value = 0; value < 0x1000; value++) {
+			uint32_t reply = EscModel::encodeReply(value, false);
+			for (int p = 0; p < 4; p++) {
+				uint8_t count = makeEdges(reply, 8 * (1 + percent / 100.0), p / 4.0, edges);
+				uint32_t decoded = 0xFFFFFFFF;
+				BidirDshotTelemetryType type = BidirDShotX1::decodeFrame(BidirDShotX1::decodeEdges(edges, count, bitTime256), &decoded);
+				wrong += type == BidirDshotTelemetryType::CHECKSUM_ERROR || decoded != value;
+			}
+		}
+		CHECK(wrong == 0, "bit time %+d%%: %d/16384 frames wrong", percent, wrong);
+	}
+
+	// capture program, DMA and decoding together: DShot4800 at 125 MHz with an ESC clock 20% off
+	for (double clockError : {-0.2, 0.2}) {
+		pio_emu_reset();
+		BidirDShotX1 driver(5, 4800, pio0);
+		CHECK(!driver.initError() && driver.enableEdgeCapture(), "edge capture at DShot4800");
+		EscModel esc(5, 4800);
+		esc.clockError = clockError;
+		int decoded = 0;
+		for (int i = 0; i < 20; i++) {
+			esc.telemetry12 = (i * 2654435761u >> 7) & 0xFFF;
+			driver.sendThrottle(100 + i);
+			pio_emu_run_us(400);
+			uint32_t raw = 0;
+			BidirDshotTelemetryType type = driver.getTelemetryRaw(&raw);
+			decoded += type != BidirDshotTelemetryType::NO_REPLY && type != BidirDshotTelemetryType::CHECKSUM_ERROR && raw == esc.telemetry12;
+		}
+		CHECK(decoded == 20, "ESC clock %+.0f%%: %d/20 replies decoded", clockError * 100, decoded);
+	}
+	return testResult();
+}
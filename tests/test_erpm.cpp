@@ -0,0 +1,79 @@
+// decodeErpm/decodeErpmBatch/convertFromRaw: same eRPM as the division they replaced for every raw value, plus a micro-benchmark
+#include "bidir_dshot_x1.h"
+#include "host_test.h"
+#include <chrono>
+
+// the division that getTelemetryErpm, getTelemetryPacket and convertFromRaw used before the reciprocal table, -1 if invalid
+static uint32_t referenceErpm(uint32_t raw) {
+	if (raw == 0xFFF) return 0;
+	uint32_t p = (raw & 0x1FF) << (raw >> 9); // eeem mmmm mmmm
+	if (!p) return -1;
+	return (60000000 + 50 * p) / p;
+}
+
+// ns per frame, decoding 8 motors per call like a flight controller loop
+static double benchmark(bool table) {
+	uint16_t raw[8];
+	BidirDShotErpm out[8];
+	volatile uint32_t sink = 0;
+	const int rounds = 200000;
+	auto start = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; r++) {
+		for (int i = 0; i < 8; i++) raw[i] = (r * 8 + i) % 0xFFF + 1;
+		if (table) {
+			BidirDShotX1::decodeErpmBatch(raw, out, 8);
+			sink = sink + out[0].erpm + out[7].erpm;
+		} else {
+			for (int i = 0; i < 8; i++) sink = sink + referenceErpm(raw[i]);
+		}
+	}
+	std::chrono::duration<double, std::nano> t = std::chrono::steady_clock::now() - start;
+	return t.count() / rounds / 8;
+}
+
+int main() {
+	int wrongConvert = 0, wrongDecode = 0, wrongPeriod = 0, wrongMech = 0;
+	const uint8_t poles = 14;
+	uint32_t hzFactor = BidirDShotX1::getHzFactor(poles);
+	for (uint32_t raw = 0; raw < 0x1000; raw++) {
+		uint32_t expected = referenceErpm(raw);
+		wrongConvert += BidirDShotX1::convertFromRaw(raw, BidirDshotTelemetryType::ERPM) != expected;
+		BidirDShotErpm e = {1, 2, 3};
+		bool valid = BidirDShotX1::decodeErpm(raw, &e, hzFactor);
+		if (expected == (uint32_t)-1) {
+			wrongDecode += valid || e.periodUs != 1 || e.erpm != 2 || e.mechHz != 3; // left unchanged
+			continue;
+		}
+		wrongDecode += !valid || e.erpm != expected;
+		uint32_t period = raw == 0xFFF ? 0 : (raw & 0x1FF) << (raw >> 9);
+		wrongPeriod += e.periodUs != period;
+		// mechanical speed in 1/256 Hz: 60000000 / p eRPM * 2 / 60 / poles * 256, the factor has 16 fractional bits
+		double mech = period ? 512e6 / ((double)poles * period) : 0;
+		double err = e.mechHz > mech ? e.mechHz - mech : mech - e.mechHz;
+		if (err > 1 + mech * 2e-5) wrongMech++;
+	}
+	CHECK(wrongConvert == 0, "convertFromRaw: %d values differ from the division", wrongConvert);
+	CHECK(wrongDecode == 0, "decodeErpm: %d values differ from the division", wrongDecode);
+	CHECK(wrongPeriod == 0, "decodeErpm: %d wrong periods", wrongPeriod);
+	CHECK(wrongMech == 0, "decodeErpm: %d mechanical speeds off by more than 1/256 Hz + 20 ppm", wrongMech);
+
+	// batch of 8: same results and valid mask, 0x000 (mantissa 0) is invalid
+	int wrongBatch = 0;
+	for (uint32_t first = 0; first < 0x1000; first += 8) {
+		uint16_t raw[8];
+		BidirDShotErpm out[8] = {};
+		uint8_t expectedMask = 0;
+		for (int i = 0; i < 8; i++) {
+			raw[i] = (first + i * 517) & 0xFFF; // mixed exponents
+			if (referenceErpm(raw[i]) != (uint32_t)-1) expectedMask |= 1 << i;
+		}
+		uint8_t mask = BidirDShotX1::decodeErpmBatch(raw, out, 8);
+		wrongBatch += mask != expectedMask;
+		for (int i = 0; i < 8; i++) wrongBatch += (mask >> i & 1) && out[i].erpm != referenceErpm(raw[i]);
+	}
+	CHECK(wrongBatch == 0, "decodeErpmBatch: %d wrong values or masks", wrongBatch);
+
+	// informational only, the host has a hardware divider (see examples/11_Decode_Benchmark for the RP2040)
+	printf("eRPM: division %.1f ns, decodeErpmBatch %.1f ns per frame\n", benchmark(false), benchmark(true));
+	return testResult();
+}
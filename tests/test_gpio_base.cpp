@@ -0,0 +1,90 @@
+// GPIO 32...47 with the PIO GPIO base at 16 (RP2350B), needs the 3 PIO host build (PICO_BIDIR_DSHOT_HOST_NUM_PIOS=3)
+#include "bidir_dshot_mux.h"
+#include "bidir_dshot_x1.h"
+#include "bidir_dshot_x4.h"
+#include "dshot_fixed.h"
+#include "dshot_x4.h"
+#include "host_test.h"
+
+#if PICO_PIO_USE_GPIO_BASE
+int main() {
+	pio_emu_reset();
+	CHECK(pio_set_gpio_base(pio0, 16) == 0 && pio_set_gpio_base(pio1, 16) == 0 && pio_set_gpio_base(pio2, 16) == 0, "GPIO base not accepted");
+
+	{
+		BidirDShotX1 driver(40, 600, pio0);
+		CHECK(!driver.initError(), "BidirDShotX1");
+		pio_emu_run_us(10);
+		CHECK(pio_emu_gpio_is_output(40) && pio_emu_gpio_level(40), "BidirDShotX1 does not idle high");
+		EscModel esc(40, 600);
+		for (int i = 0; i < 5; i++) {
+			esc.telemetry12 = EscModel::erpmTo12(2000 + 1000 * i);
+			driver.sendThrottle(200 + i);
+			pio_emu_run_us(400);
+			uint32_t erpm = 0;
+			BidirDshotTelemetryType type = driver.getTelemetryErpm(&erpm);
+			uint32_t expected = BidirDShotX1::convertFromRaw(esc.telemetry12, BidirDshotTelemetryType::ERPM);
+			CHECK(type == BidirDshotTelemetryType::ERPM && erpm == expected, "BidirDShotX1 frame %d: type %d, eRPM %u, expected %u", i, (int)type, erpm, expected);
+			CHECK(esc.lastValue() == 200 + i + 47, "BidirDShotX1 frame %d: ESC got %u", i, esc.lastValue());
+		}
+		CHECK(esc.badFrames == 0, "BidirDShotX1: %u bad frames", esc.badFrames);
+	}
+
+	{
+		BidirDShotX4 driver(36, 4, 600, pio1);
+		CHECK(!driver.initError(), "BidirDShotX4");
+		EscModel esc[4] = {{36, 600}, {37, 600}, {38, 600}, {39, 600}};
+		for (int i = 0; i < 5; i++) {
+			uint16_t packets[4];
+			for (int k = 0; k < 4; k++) {
+				packets[k] = 300 + 10 * k + i;
+				esc[k].telemetry12 = EscModel::erpmTo12(1000 + 500 * k + 100 * i);
+			}
+			driver.sendThrottles(packets); // converted in place
+			pio_emu_run_us(400);
+			for (int k = 0; k < 4; k++) {
+				uint32_t value = 0;
+				BidirDshotTelemetryType type = driver.getTelemetryPacket(k, &value);
+				uint32_t expected = BidirDShotX1::convertFromRaw(esc[k].telemetry12, BidirDshotTelemetryType::ERPM);
+				CHECK(type == BidirDshotTelemetryType::ERPM && value == expected, "BidirDShotX4 ESC %d frame %d: type %d, eRPM %u, expected %u", k, i, (int)type, value, expected);
+				CHECK(esc[k].lastValue() == 300 + 10 * k + i + 47, "BidirDShotX4 ESC %d frame %d: ESC got %u", k, i, esc[k].lastValue());
+			}
+		}
+		CHECK(dshotClaimedOutPins(pio1) == 0xFull << 36, "claimed out pins %llx", (unsigned long long)dshotClaimedOutPins(pio1));
+		const uint8_t overlapping[2] = {35, 38}; // window 35...38 overlaps with the BidirDShotX4 pins
+		DShotX4 other(overlapping, 2, 600, pio1);
+		CHECK(other.initError(), "DShotX4 on GPIO 35 and 38 must not share pio1 with BidirDShotX4 on GPIO 36...39");
+	}
+
+	{
+		FixedBidirDShotX1<44, 600, 2> driver;
+		CHECK(!driver.initError(), "FixedBidirDShotX1");
+		EscModel esc(44, 600);
+		for (int i = 0; i < 5; i++) {
+			driver.sendThrottle(500 + i);
+			pio_emu_run_us(400);
+			CHECK(esc.lastValue() == 500 + i + 47, "FixedBidirDShotX1 frame %d: ESC got %u", i, esc.lastValue());
+		}
+		CHECK(esc.badFrames == 0, "FixedBidirDShotX1: %u bad frames", esc.badFrames);
+	}
+
+	{
+		const uint8_t pins[2] = {45, 33};
+		BidirDShotMux driver(pins, 2, 600, pio0);
+		CHECK(!driver.initError(), "BidirDShotMux");
+		EscModel esc[2] = {{45, 600}, {33, 600}};
+		const uint16_t throttles[2] = {700, 800};
+		driver.sendThrottles(throttles);
+		pio_emu_run_us(3000);
+		for (int k = 0; k < 2; k++) {
+			CHECK(esc[k].lastValue() == throttles[k] + 47 && esc[k].badFrames == 0, "BidirDShotMux ESC %d: got %u, %u bad frames", k, esc[k].lastValue(), esc[k].badFrames);
+		}
+	}
+	return testResult();
+}
+#else
+int main() {
+	printf("skipped: no PIO GPIO base on this chip\n");
+	return 0;
+}
+#endif
@@ -0,0 +1,78 @@
+// dshotPackX4/dshotPackX8: same output as the per-bit reference for every 16 bit value on every lane, plus a micro-benchmark
+#include "dshot_common.h"
+#include "host_test.h"
+#include <chrono>
+
+// the per-bit loop that DShotX4 and BidirDShotX4 used before the spread tables
+static void referencePackX4(const uint16_t data[4], uint32_t packet[2]) {
+	packet[0] = packet[1] = 0;
+	for (int i = 31; i >= 0; i--) {
+		int pos = i / 4;
+		int motor = i % 4;
+		packet[0] |= ((data[motor] >> (pos + 8)) & 1) << i;
+		packet[1] |= ((data[motor] >> pos) & 1) << i;
+	}
+}
+
+// bit i of packet[w] is bit (i / 8 + 12 - 4 * w) of motor i % 8
+static void referencePackX8(const uint16_t data[8], uint32_t packet[4]) {
+	for (int w = 0; w < 4; w++) {
+		packet[w] = 0;
+		for (int i = 31; i >= 0; i--) {
+			packet[w] |= (uint32_t)((data[i % 8] >> (i / 8 + 12 - 4 * w)) & 1) << i;
+		}
+	}
+}
+
+static uint32_t rng = 1;
+static uint16_t random16() {
+	rng = rng * 1664525 + 1013904223;
+	return rng >> 16;
+}
+
+// ns per call of pack over a set of random packets
+template <int lanes, int words>
+static double benchmark(void (*pack)(const uint16_t *, uint32_t *)) {
+	static uint16_t data[256][lanes];
+	for (auto &d : data)
+		for (auto &v : d) v = random16();
+	volatile uint32_t sink = 0;
+	const int rounds = 4000;
+	auto start = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; r++) {
+		for (auto &d : data) {
+			uint32_t packet[words];
+			pack(d, packet);
+			sink = sink + packet[0] + packet[words - 1];
+		}
+	}
+	std::chrono::duration<double, std::nano> t = std::chrono::steady_clock::now() - start;
+	return t.count() / rounds / 256;
+}
+
+int main() {
+	int wrongX4 = 0, wrongX8 = 0;
+	for (int lane = 0; lane < 8; lane++) {
+		for (uint32_t v = 0; v < 0x10000; v++) {
+			uint16_t data[8];
+			for (auto &d : data) d = random16();
+			data[lane] = v;
+			uint32_t packet[4], reference[4];
+			if (lane < 4) {
+				dshotPackX4(data, packet);
+				referencePackX4(data, reference);
+				wrongX4 += packet[0] != reference[0] || packet[1] != reference[1];
+			}
+			dshotPackX8(data, packet);
+			referencePackX8(data, reference);
+			wrongX8 += packet[0] != reference[0] || packet[1] != reference[1] || packet[2] != reference[2] || packet[3] != reference[3];
+		}
+	}
+	CHECK(wrongX4 == 0, "dshotPackX4: %d packets differ", wrongX4);
+	CHECK(wrongX8 == 0, "dshotPackX8: %d packets differ", wrongX8);
+
+	// informational only, host timings say little about the RP2040 (see examples/16_Pack_Benchmark)
+	printf("X4: per-bit %.1f ns, dshotPackX4 %.1f ns per call\n", benchmark<4, 2>(referencePackX4), benchmark<4, 2>(dshotPackX4));
+	printf("X8: per-bit %.1f ns, dshotPackX8 %.1f ns per call\n", benchmark<8, 4>(referencePackX8), benchmark<8, 4>(dshotPackX8));
+	return testResult();
+}
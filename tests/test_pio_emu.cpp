@@ -0,0 +1,76 @@
+// the emulator itself: instruction timing with integer and fractional dividers, FIFOs with DMA in both directions
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+#include "host_test.h"
+
+// checks the edges of a square wave with 5 state machine cycles per half period
+static void checkSquareWave(uint16_t divInt, uint8_t divFrac) {
+	pio_emu_reset();
+	static const uint16_t instructions[] = {
+		(uint16_t)(pio_encode_set(pio_pins, 1) | pio_encode_delay(4)),
+		(uint16_t)(pio_encode_set(pio_pins, 0) | pio_encode_delay(4)),
+	};
+	pio_program_t program = {instructions, 2, -1};
+	uint offset = pio_add_program(pio0, &program);
+	pio_sm_config c = pio_get_default_sm_config();
+	sm_config_set_wrap(&c, offset, offset + 1);
+	sm_config_set_set_pins(&c, 3, 1);
+	sm_config_set_clkdiv_int_frac(&c, divInt, divFrac);
+	pio_gpio_init(pio0, 3);
+	pio_sm_set_consecutive_pindirs(pio0, 0, 3, 1, true);
+	pio_sm_init(pio0, 0, offset, &c);
+	pio_emu_trace_pins(1ull << 3);
+	pio_sm_set_enabled(pio0, 0, true);
+	pio_emu_step(100 * 10 * divInt + 100);
+
+	size_t count = pio_emu_trace_count();
+	const pio_emu_edge_t *edges = pio_emu_trace_data();
+	CHECK(count >= 100, "divider %u.%u: %zu edges", divInt, divFrac, count);
+	if (count < 100) return;
+	double expected = 5 * (divInt + divFrac / 256.0); // system clock cycles per half period
+	for (size_t i = 1; i < count; i++) {
+		uint64_t d = edges[i].cycle - edges[i - 1].cycle;
+		CHECK(edges[i].level != edges[i - 1].level && d >= (uint64_t)expected && d <= (uint64_t)expected + 1, "divider %u.%u edge %zu: %llu cycles", divInt, divFrac, i, (unsigned long long)d);
+	}
+	double average = (double)(edges[count - 1].cycle - edges[0].cycle) / (count - 1);
+	CHECK(average > expected - 0.05 && average < expected + 0.05, "divider %u.%u: average %f", divInt, divFrac, average);
+}
+
+int main() {
+	checkSquareWave(1, 0);
+	checkSquareWave(3, 0);
+	checkSquareWave(2, 128);
+
+	// DMA -> TX FIFO -> pull, mov isr, ~osr, push -> RX FIFO -> DMA
+	pio_emu_reset();
+	static const uint16_t instructions[] = {
+		(uint16_t)pio_encode_pull(false, true),
+		(uint16_t)pio_encode_mov_not(pio_isr, pio_osr),
+		(uint16_t)pio_encode_push(false, true),
+	};
+	pio_program_t program = {instructions, 3, -1};
+	uint offset = pio_add_program(pio1, &program);
+	pio_sm_config c = pio_get_default_sm_config();
+	sm_config_set_wrap(&c, offset, offset + 2);
+	pio_sm_init(pio1, 2, offset, &c);
+	pio_sm_set_enabled(pio1, 2, true);
+
+	static uint32_t src[64], dst[64];
+	for (int i = 0; i < 64; i++) src[i] = i * 0x9E3779B9u;
+	int tx = dma_claim_unused_channel(true), rx = dma_claim_unused_channel(true);
+	dma_channel_config cfg = dma_channel_get_default_config(tx);
+	channel_config_set_dreq(&cfg, pio_get_dreq(pio1, 2, true));
+	dma_channel_configure(tx, &cfg, &pio1->txf[2], src, 64, false);
+	cfg = dma_channel_get_default_config(rx);
+	channel_config_set_read_increment(&cfg, false);
+	channel_config_set_write_increment(&cfg, true);
+	channel_config_set_dreq(&cfg, pio_get_dreq(pio1, 2, false));
+	dma_channel_configure(rx, &cfg, dst, &pio1->rxf[2], 64, true);
+	dma_channel_start(tx);
+	pio_emu_step(2000);
+	CHECK(!dma_channel_is_busy(tx) && !dma_channel_is_busy(rx), "DMA still busy");
+	int wrong = 0;
+	for (int i = 0; i < 64; i++) wrong += dst[i] != ~src[i];
+	CHECK(wrong == 0, "%d words wrong", wrong);
+	return testResult();
+}
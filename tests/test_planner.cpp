@@ -0,0 +1,71 @@
+// dshotPlanMotors/dshotCreateDrivers: mixed motor lists, reuse of loaded programs, invalid and too fast motors
+#include "dshot_planner.h"
+#include "host_test.h"
+
+/// creates the drivers of a plan, checks the remaining state machines against the plan and deletes the drivers again
+static bool createAndCheck(const DShotPlan &plan) {
+	BidirDShotX1 *bidir[DSHOT_PLAN_MAX_DRIVERS];
+	DShotX4 *normal[DSHOT_PLAN_MAX_DRIVERS];
+	bool ok = dshotCreateDrivers(&plan, bidir, normal);
+	for (int p = 0; p < NUM_PIOS; p++) {
+		int freeSms = 0;
+		for (int s = 0; s < NUM_PIO_STATE_MACHINES; s++) freeSms += !pio_sm_is_claimed(pio_get_instance(p), s);
+		CHECK(freeSms == plan.freeSms[p], "pio%d: %d free state machines, plan says %d", p, freeSms, plan.freeSms[p]);
+	}
+	for (int i = 0; i < plan.driverCount; i++) {
+		delete bidir[i];
+		delete normal[i];
+	}
+	return ok;
+}
+
+int main() {
+	pio_emu_reset();
+	DShotPlan plan;
+
+	// 4 bidirectional + 8 normal motors on scattered pins
+	{
+		DShotMotorSpec m[12];
+		for (int i = 0; i < 4; i++) m[i] = {(uint8_t)(2 + 3 * i), true, 600};
+		for (int i = 0; i < 8; i++) m[4 + i] = {(uint8_t)(15 + i + (i > 3 ? 4 : 0)), false, 600};
+		CHECK(dshotPlanMotors(m, 12, &plan) && plan.pioCount == 2, "mixed list: %d PIOs", plan.pioCount);
+		CHECK(createAndCheck(plan), "mixed list: drivers not created");
+	}
+
+	// 6 bidirectional motors need both PIOs of an RP2040, no room for more
+	{
+		DShotMotorSpec m[10];
+		for (int i = 0; i < 6; i++) m[i] = {(uint8_t)i, true, 600};
+		for (int i = 0; i < 4; i++) m[6 + i] = {(uint8_t)(10 + i), false, 300};
+		bool fits = dshotPlanMotors(m, 10, &plan);
+		CHECK(fits == (NUM_PIOS > 2) && (fits || plan.driverCount == 0), "6 bidir + 4 normal: fits %d, %d drivers", fits, plan.driverCount);
+		CHECK(dshotPlanMotors(m, 6, &plan) && createAndCheck(plan), "6 bidir");
+	}
+
+	// reuse of a program loaded by an existing driver
+	{
+		BidirDShotX1 existing(20, 600, pio1);
+		DShotMotorSpec m[3] = {{1, true, 600}, {2, true, 600}, {3, true, 600}};
+		CHECK(dshotPlanMotors(m, 3, &plan) && plan.drivers[0].pio == pio1 && plan.freeInstructions[1] == 2, "program on pio1 not reused");
+		CHECK(createAndCheck(plan), "reuse: drivers not created");
+	}
+
+	// invalid lists
+	{
+		DShotMotorSpec m[2] = {{2, false, 600}, {2, true, 600}};
+		CHECK(!dshotPlanMotors(m, 2, &plan) && plan.driverCount == 0, "duplicate pin accepted");
+	}
+
+	// speeds the system clock can't reach (max. clk_sys / 40 kHz for normal DShot, clk_sys / 20 kHz for bidirectional DShot)
+	{
+		uint32_t maxNormal = clock_get_hz(clk_sys) / 40000;
+		DShotMotorSpec m[2] = {{2, false, 4800}, {3, false, 4800}};
+		CHECK(!dshotPlanMotors(m, 2, &plan) && plan.driverCount == 0, "normal DShot4800 at %u Hz accepted", clock_get_hz(clk_sys));
+		m[0].speed = m[1].speed = maxNormal;
+		CHECK(dshotPlanMotors(m, 2, &plan) && createAndCheck(plan), "normal DShot%u rejected", maxNormal);
+		pio_emu_set_sys_clock(60000000);
+		DShotMotorSpec bidir[1] = {{2, true, 4800}};
+		CHECK(!dshotPlanMotors(bidir, 1, &plan) && plan.driverCount == 0, "bidirectional DShot4800 at 60 MHz accepted");
+	}
+	return testResult();
+}
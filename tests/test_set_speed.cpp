@@ -0,0 +1,52 @@
+// setSpeed and dshotClockChanged: speeds that are too high for the system clock keep the old divider
+#include "bidir_dshot_x4.h"
+#include "dshot_registry.h"
+#include "dshot_x4.h"
+#include "dshot_x8.h"
+#include "host_test.h"
+
+static void readDividers(uint32_t *dividers) {
+	for (int sm = 0; sm < 4; sm++) {
+		dividers[sm] = pio0->sm[sm].clkdiv;
+		dividers[4 + sm] = pio1->sm[sm].clkdiv;
+	}
+}
+
+static bool sameDividers(const uint32_t *dividers) {
+	uint32_t now[8];
+	readDividers(now);
+	for (int i = 0; i < 8; i++) {
+		if (now[i] != dividers[i]) return false;
+	}
+	return true;
+}
+
+int main() {
+	pio_emu_reset();
+	DShotX4 x4(2, 4, 2400, pio0);
+	DShotX8 x8(6, 8, 2400, pio0);
+	BidirDShotX4 bidirX4(16, 4, 2400, pio1);
+	CHECK(!x4.initError() && !x8.initError() && !bidirX4.initError(), "init");
+
+	// 125 MHz / 40 cycles per bit: max. DShot3125
+	uint32_t dividers[8];
+	readDividers(dividers);
+	CHECK(!x4.setSpeed(4800), "DShotX4");
+	CHECK(!x8.setSpeed(4800), "DShotX8");
+	CHECK(!bidirX4.setSpeed(4800), "BidirDShotX4");
+	CHECK(sameDividers(dividers), "divider changed");
+
+	// 60 MHz: max. DShot1500, the drivers keep DShot2400 at the old divider
+	pio_emu_set_sys_clock(60000000);
+	dshotClockChanged();
+	CHECK(sameDividers(dividers), "divider changed by dshotClockChanged");
+
+	// the other speeds still work
+	CHECK(x4.setSpeed(1200) && x8.setSpeed(1200) && bidirX4.setSpeed(1200), "DShot1200 at 60 MHz");
+	EscModel esc[4] = {{2, 1200, false}, {3, 1200, false}, {4, 1200, false}, {5, 1200, false}};
+	uint16_t packets[4] = {0, 500, 1000, 2000};
+	x4.sendThrottles(packets);
+	pio_emu_run_us(100);
+	CHECK(esc[0].lastValue() == 0 && esc[1].lastValue() == 547 && esc[2].lastValue() == 1047 && esc[3].lastValue() == 2047, "frames at DShot1200: %u %u %u %u", esc[0].lastValue(), esc[1].lastValue(), esc[2].lastValue(), esc[3].lastValue());
+	return testResult();
+}